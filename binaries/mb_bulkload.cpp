@@ -0,0 +1,151 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Build a new mabain DB from a file of sorted key-value pairs
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "db.h"
+#include "bulk_loader.h"
+#include "error.h"
+
+using namespace mabain;
+
+static void usage(const char *prog)
+{
+    std::cout << "Usage: " << prog << " -d mabain-directory [-f input-file] [-t separator] [-im index-memcap] [-dm data-memcap]\n";
+    std::cout <<"\t-d mabain databse directory; the DB must be empty\n";
+    std::cout <<"\t-f input file with one key-value pair per line; default is stdin\n";
+    std::cout <<"\t   keys must be sorted in byte order, e.g., by LC_ALL=C sort\n";
+    std::cout <<"\t-t separator between key and value; default is tab\n";
+    std::cout <<"\t-im index memcap\n";
+    std::cout <<"\t-dm data memcap\n";
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t memcap_i = 64*1024*1024LL;
+    int64_t memcap_d = 64*1024*1024LL;
+    const char *db_dir = NULL;
+    const char *input = NULL;
+    char separator = '\t';
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-d") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            db_dir = argv[i];
+        }
+        else if(strcmp(argv[i], "-f") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            input = argv[i];
+        }
+        else if(strcmp(argv[i], "-t") == 0)
+        {
+            if(++i >= argc || strlen(argv[i]) != 1)
+                usage(argv[0]);
+            separator = argv[i][0];
+        }
+        else if(strcmp(argv[i], "-im") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            memcap_i = atoll(argv[i]);
+        }
+        else if(strcmp(argv[i], "-dm") == 0)
+        {
+            if(++i >= argc)
+                usage(argv[0]);
+            memcap_d = atoll(argv[i]);
+        }
+        else
+            usage(argv[0]);
+    }
+
+    if(db_dir == NULL)
+        usage(argv[0]);
+
+    std::ifstream in_file;
+    if(input != NULL)
+    {
+        in_file.open(input);
+        if(!in_file.is_open())
+        {
+            std::cerr << "failed to open " << input << "\n";
+            exit(1);
+        }
+    }
+    std::istream &in = (input != NULL) ? in_file : std::cin;
+
+    DB db(db_dir, CONSTS::WriterOptions(), memcap_i, memcap_d);
+    if(!db.is_open())
+    {
+        std::cerr << db.StatusStr() << "\n";
+        exit(1);
+    }
+
+    int rval = MBError::SUCCESS;
+    try {
+        BulkLoader loader(db);
+        std::string line;
+        int64_t line_num = 0;
+        while(std::getline(in, line))
+        {
+            line_num++;
+            size_t pos = line.find(separator);
+            if(pos == std::string::npos)
+            {
+                std::cerr << "missing separator at line " << line_num << "\n";
+                rval = MBError::INVALID_ARG;
+                break;
+            }
+            rval = loader.Add(line.data(), pos, line.data() + pos + 1,
+                              line.size() - pos - 1);
+            if(rval != MBError::SUCCESS)
+            {
+                std::cerr << "failed to load line " << line_num << ": "
+                          << MBError::get_error_str(rval) << "\n";
+                break;
+            }
+            if(line_num % 10000000 == 0)
+                std::cout << "loaded " << line_num << " keys\n";
+        }
+
+        if(rval == MBError::SUCCESS)
+        {
+            rval = loader.Finish();
+            if(rval == MBError::SUCCESS)
+                std::cout << "loaded " << loader.Count() << " keys\n";
+            else
+                std::cerr << "failed to finish: " << MBError::get_error_str(rval) << "\n";
+        }
+    } catch (int error) {
+        std::cerr << "failed to start bulk load: " << MBError::get_error_str(error) << "\n";
+        rval = error;
+    }
+
+    db.Close();
+    return rval == MBError::SUCCESS ? 0 : 1;
+}
@@ -316,12 +316,17 @@ static void display_all_kvs(DB *db)
     if(db == NULL)
         return;
 
+    // Only the values on the displayed pages are read.
     int count = 0;
-    for(DB::iterator iter = db->begin(); iter != db->end(); ++iter)
+    MBData mbd;
+    for(DB::iterator iter = db->begin(true, false, CONSTS::OPTION_KEY_ONLY);
+        iter != db->end(); ++iter)
     {
+        if(db->ReadValue(iter.value.data_offset, mbd) != MBError::SUCCESS)
+            continue;
         count++;
         std::cout << iter.key << ": " <<
-                     std::string((char *)iter.value.buff, iter.value.data_len) << "\n";
+                     std::string((char *)mbd.buff, mbd.data_len) << "\n";
         if(count % ENTRY_PER_PAGE == 0)
         {
             std::string show_more;
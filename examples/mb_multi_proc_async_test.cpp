@@ -0,0 +1,168 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Multiple reader processes write to the DB through the shared async queue
+// of the writer process. One of the producers can be killed in the middle
+// to check that the others keep going.
+
+#include <unistd.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <mabain/db.h>
+
+const char* mb_dir = "/var/tmp/mabain_test/";
+
+using namespace mabain;
+
+static int num_producer = 4;
+static int num_keys = 100000;
+static int value_size = 32;
+static bool kill_one = false;
+
+static std::string get_key(int producer, int i)
+{
+    return std::string("key") + std::to_string(producer) + "_" + std::to_string(i);
+}
+
+static void Producer(int id)
+{
+    DB db(mb_dir, CONSTS::ReaderOptions() | CONSTS::SHM_ASYNC_QUEUE);
+    if(!db.is_open()) {
+        std::cerr << "producer " << id << " failed to open db: "
+                  << db.StatusStr() << "\n";
+        exit(1);
+    }
+
+    std::string value(value_size, 'a' + id % 26);
+    int rval;
+    for(int i = 0; i < num_keys; i++) {
+        rval = db.Add(get_key(id, i), value);
+        if(rval != MBError::SUCCESS) {
+            std::cerr << "producer " << id << " failed to add: "
+                      << MBError::get_error_str(rval) << "\n";
+            exit(1);
+        }
+    }
+
+    db.Close();
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc >= 2)
+        num_producer = atoi(argv[1]);
+    if(argc >= 3)
+        num_keys = atoi(argv[2]);
+    if(argc >= 4)
+        value_size = atoi(argv[3]);
+    if(argc >= 5)
+        kill_one = (atoi(argv[4]) != 0);
+    if(num_producer <= 0 || num_keys <= 0 || value_size <= 0) {
+        std::cerr << "usage: " << argv[0]
+                  << " [num_producer] [num_keys] [value_size] [kill_one]\n";
+        exit(1);
+    }
+
+    std::string cmd = std::string("mkdir -p ") + mb_dir;
+    if(system(cmd.c_str()) != 0) {
+    }
+    cmd = std::string("rm -f ") + mb_dir + "_mabain_*";
+    if(system(cmd.c_str()) != 0) {
+    }
+
+    MBConfig mbconf;
+    memset(&mbconf, 0, sizeof(mbconf));
+    mbconf.mbdir = mb_dir;
+    mbconf.options = CONSTS::WriterOptions() | CONSTS::ASYNC_WRITER_MODE |
+                     CONSTS::SHM_ASYNC_QUEUE;
+    mbconf.memcap_index = 256*1024*1024LL;
+    mbconf.memcap_data  = 256*1024*1024LL;
+    DB db(mbconf);
+    if(!db.is_open()) {
+        std::cerr << "failed to open writer: " << db.StatusStr() << "\n";
+        exit(1);
+    }
+
+    struct timeval start_tm;
+    gettimeofday(&start_tm, NULL);
+    std::vector<pid_t> pid_arr;
+    for(int i = 0; i < num_producer; i++) {
+        pid_t pid = fork();
+        if(pid < 0) {
+            std::cerr << "fork failed\n";
+            break;
+        }
+        if(pid == 0)
+            Producer(i);
+        pid_arr.push_back(pid);
+    }
+
+    if(kill_one && !pid_arr.empty()) {
+        usleep(10000);
+        kill(pid_arr.back(), SIGKILL);
+    }
+
+    int failed = 0;
+    for(size_t i = 0; i < pid_arr.size(); i++) {
+        int status;
+        waitpid(pid_arr[i], &status, 0);
+        if(kill_one && i == pid_arr.size() - 1)
+            continue;
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed++;
+    }
+    while(db.AsyncWriterBusy())
+        usleep(100);
+
+    struct timeval stop_tm;
+    gettimeofday(&stop_tm, NULL);
+    double tm = (stop_tm.tv_sec - start_tm.tv_sec) * 1000000.0 +
+                (stop_tm.tv_usec - start_tm.tv_usec);
+    int64_t count = db.Count();
+    std::cout << "===== " << tm / count << " micro seconds per insertion ("
+              << count << " keys by " << num_producer << " producers)\n";
+
+    // Check the keys of the producers that were not killed.
+    DB db_r(mb_dir, CONSTS::ReaderOptions());
+    MBData mbd;
+    int num_check = (int) pid_arr.size() - (kill_one ? 1 : 0);
+    for(int i = 0; i < num_check; i++) {
+        for(int j = 0; j < num_keys; j++) {
+            if(db_r.Find(get_key(i, j), mbd) != MBError::SUCCESS ||
+               mbd.data_len != value_size) {
+                std::cerr << "key " << get_key(i, j) << " not found\n";
+                failed++;
+                break;
+            }
+        }
+    }
+    db_r.Close();
+    db.Close();
+
+    if(failed > 0) {
+        std::cerr << failed << " producers failed\n";
+        return 1;
+    }
+    return 0;
+}
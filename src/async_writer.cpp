@@ -16,8 +16,12 @@
 
 // @author Changxue Deng <chadeng@cisco.com>
 
+#include <errno.h>
+#include <time.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
+#include <new>
 
 #include "async_writer.h"
 #include "error.h"
@@ -25,39 +29,51 @@
 #include "mb_data.h"
 #include "mb_rc.h"
 #include "integer_4b_5b.h"
+#include "mb_futex.h"
 
-namespace mabain {
+// Number of checks before a thread goes to sleep on a futex. There is no
+// spinning on a single CPU since the thread to wait for cannot run.
+#define ASYNC_SPIN_COUNT     1024
+// Number of tasks the writer runs before waking up producers
+#define ASYNC_BATCH_SIZE     64
+// Writer checks for dead producers of the shared queue at this interval.
+#define ASYNC_SHARED_WAIT_NS (100*1000*1000)
 
-const int AsyncWriter::max_num_queue_node = 2048;
+namespace mabain {
 
-static void free_async_node(AsyncNode *node_ptr)
+static int slab_buffer_count(int queue_size)
 {
-    if(node_ptr->key != NULL)
-    {
-        free(node_ptr->key);
-        node_ptr->key = NULL;
-        node_ptr->key_len = 0; 
-    }
-
-    if(node_ptr->data != NULL)
-    {
-        free(node_ptr->data);
-        node_ptr->data = NULL;
-        node_ptr->data_len = 0; 
-    }
-
-    node_ptr->type = MABAIN_ASYNC_TYPE_NONE;
+    return queue_size >= 128 ? queue_size / 16 : 8;
 }
 
-AsyncWriter::AsyncWriter(DB *db_ptr)
+AsyncWriter::AsyncWriter(DB *db_ptr, int queue_size, ShmQueue *shm_queue_ptr)
                        : db(db_ptr),
                          num_users(0),
                          queue(NULL),
+                         queue_mask(0),
+                         slab_pool(slab_buffer_count(queue_size)),
                          tid(0),
                          stop_processing(false),
                          queue_index(0),
-                         writer_index(0)
+                         writer_index(0),
+                         release_seq(0),
+                         num_waiting_producers(0),
+                         num_seq_waiters(0),
+                         local_submit_seq(0),
+                         local_writer_waiting(0),
+                         shm_queue(shm_queue_ptr)
 {
+    if(shm_queue != NULL)
+    {
+        submit_seq = shm_queue->GetSubmitSeq();
+        writer_waiting = shm_queue->GetWriterWaiting();
+    }
+    else
+    {
+        submit_seq = &local_submit_seq;
+        writer_waiting = &local_writer_waiting;
+    }
+    spin_count = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? ASYNC_SPIN_COUNT : 0;
     dict = NULL;
     if(!(db_ptr->GetDBOptions() & CONSTS::ACCESS_MODE_WRITER))
         throw (int) MBError::NOT_ALLOWED;
@@ -66,23 +82,35 @@ AsyncWriter::AsyncWriter(DB *db_ptr)
     dict = db->GetDictPtr();
     if(dict == NULL) 
         throw (int) MBError::NOT_INITIALIZED;
+    // With a single slot, a task ready for index i could not be told from
+    // the slot being free for index i+1.
+    if(queue_size < 2 || (queue_size & (queue_size - 1)) != 0)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "invalid async queue size %d", queue_size);
+        throw (int) MBError::INVALID_ARG;
+    }
 
-    queue = new AsyncNode[max_num_queue_node];
-    memset(queue, 0, max_num_queue_node * sizeof(AsyncNode));
-    for(int i = 0; i < max_num_queue_node; i++)
+    // Align the slots to cache lines so that producers filling adjacent
+    // slots do not share lines.
+    void *ptr;
+    if(posix_memalign(&ptr, 64, queue_size * sizeof(AsyncNode)) != 0)
+        throw (int) MBError::NO_MEMORY;
+    queue = static_cast<AsyncNode *>(ptr);
+    queue_mask = queue_size - 1;
+    for(int i = 0; i < queue_size; i++)
     {
-        queue[i].in_use.store(false, std::memory_order_release);
-        if(pthread_mutex_init(&queue[i].mutex, NULL) != 0)
-        {
-            Logger::Log(LOG_LEVEL_ERROR, "failed to init mutex");
-            throw (int) MBError::MUTEX_ERROR;
-        } 
-        if(pthread_cond_init(&queue[i].cond, NULL) != 0)
-        {
-            Logger::Log(LOG_LEVEL_ERROR, "failed to init conditional variable");
-            throw (int) MBError::MUTEX_ERROR;
-        }
+        new (&queue[i]) AsyncNode;
+        queue[i].seq.store(i, std::memory_order_relaxed);
+        queue[i].type = MABAIN_ASYNC_TYPE_NONE;
+        queue[i].overwrite = false;
+        queue[i].key_len = 0;
+        queue[i].data_len = 0;
+        queue[i].slab_id = -1;
+        queue[i].key = NULL;
+        queue[i].data = NULL;
+        queue[i].callback = NULL;
     }
+    std::atomic_thread_fence(std::memory_order_release);
 
     is_rc_running = false;
     rc_backup_dir = NULL;
@@ -116,12 +144,9 @@ int AsyncWriter::StopAsyncThread()
         return MBError::NOT_ALLOWED;
     }
 
-    stop_processing = true;
-
-    for(int i = 0; i < max_num_queue_node; i++)
-    {
-        pthread_cond_signal(&queue[i].cond);
-    }
+    stop_processing.store(true);
+    submit_seq->fetch_add(1);
+    FutexWake(submit_seq, INT_MAX, shm_queue != NULL);
 
     if(tid != 0)
     {
@@ -129,138 +154,429 @@ int AsyncWriter::StopAsyncThread()
         pthread_join(tid, NULL);
     }
 
-    for(int i = 0; i < max_num_queue_node; i++)
+    if(queue != NULL)
     {
-        pthread_mutex_destroy(&queue[i].mutex);
-        pthread_cond_destroy(&queue[i].cond);
+        for(uint32_t i = 0; i <= queue_mask; i++)
+            FreeSlot(&queue[i]);
+        free(queue);
+        queue = NULL;
     }
 
-    if(queue != NULL)
-        delete [] queue;
-
     return MBError::SUCCESS;
 }
 
 // Check if async tasks are completed.
 bool AsyncWriter::Busy() const
 {
-    uint32_t index = queue_index.load(std::memory_order_consume);
-    return index != writer_index || is_rc_running;
+    uint64_t index = queue_index.load(std::memory_order_consume);
+    return index != writer_index.load(std::memory_order_consume) || is_rc_running ||
+           (shm_queue != NULL && shm_queue->Busy());
 }
 
-AsyncNode* AsyncWriter::AcquireSlot()
+// Take the next queue index and wait for its slot to be released by the
+// writer. Producers only sleep if the queue is full.
+AsyncNode* AsyncWriter::AcquireSlot(uint64_t *seq)
 {
-    uint32_t index = queue_index.fetch_add(1, std::memory_order_release);
-    AsyncNode *node_ptr = queue + (index % max_num_queue_node);
+    uint64_t index = queue_index.fetch_add(1, std::memory_order_relaxed);
+    AsyncNode *node_ptr = &queue[index & queue_mask];
+    if(seq != NULL)
+        *seq = index + 1;
 
-    if(pthread_mutex_lock(&node_ptr->mutex) != 0)
+    int spin = 0;
+    while(node_ptr->seq.load(std::memory_order_acquire) != static_cast<uint32_t>(index))
     {
-        Logger::Log(LOG_LEVEL_ERROR, "failed to lock mutex");
-        return NULL;
+        if(++spin < spin_count)
+        {
+            CpuRelax();
+            continue;
+        }
+        num_waiting_producers.fetch_add(1);
+        uint32_t release = release_seq.load();
+        if(node_ptr->seq.load() != static_cast<uint32_t>(index))
+            FutexWait(&release_seq, release, false);
+        num_waiting_producers.fetch_sub(1);
     }
 
-    while(node_ptr->in_use.load(std::memory_order_consume))
+    return node_ptr;
+}
+
+// Hand the slot over to the writer. Slots that failed to be filled must
+// still be passed on with type MABAIN_ASYNC_TYPE_NONE.
+int AsyncWriter::PrepareSlot(AsyncNode *node_ptr)
+{
+    node_ptr->seq.store(node_ptr->seq.load(std::memory_order_relaxed) + 1);
+    if(writer_waiting->load())
     {
-        pthread_cond_wait(&node_ptr->cond, &node_ptr->mutex);
+        submit_seq->fetch_add(1);
+        FutexWake(submit_seq, 1, shm_queue != NULL);
     }
+    return MBError::SUCCESS;
+}
 
-    return node_ptr;
+// Copy key and data to the slot buffer. The buffer is inline_buff if they
+// fit and from the slab pool otherwise.
+int AsyncWriter::CopyToSlot(AsyncNode *node_ptr, const char *key, int key_len,
+                            const char *data, int data_len)
+{
+    int size = key_len + data_len;
+    if(size <= MABAIN_ASYNC_INLINE_SIZE)
+    {
+        node_ptr->key = node_ptr->inline_buff;
+    }
+    else
+    {
+        node_ptr->key = slab_pool.Alloc(size, node_ptr->slab_id);
+        if(node_ptr->key == NULL)
+            return MBError::NO_MEMORY;
+    }
+
+    memcpy(node_ptr->key, key, key_len);
+    node_ptr->key_len = key_len;
+    node_ptr->data = node_ptr->key + key_len;
+    if(data_len > 0)
+        memcpy(node_ptr->data, data, data_len);
+    node_ptr->data_len = data_len;
+    return MBError::SUCCESS;
+}
+
+void AsyncWriter::FreeSlot(AsyncNode *node_ptr)
+{
+    if(node_ptr->key != NULL && node_ptr->key != node_ptr->inline_buff)
+        slab_pool.Free(node_ptr->key, node_ptr->slab_id);
+    node_ptr->key = NULL;
+    node_ptr->key_len = 0;
+
+    switch(node_ptr->type)
+    {
+        case MABAIN_ASYNC_TYPE_ADD:
+        case MABAIN_ASYNC_TYPE_REMOVE:
+        case MABAIN_ASYNC_TYPE_REMOVE_PREFIX:
+            // data is part of the key buffer
+            break;
+        case MABAIN_ASYNC_TYPE_BATCH:
+            delete static_cast<WriteBatch *>(node_ptr->data);
+            break;
+        default:
+            if(node_ptr->data != NULL)
+                free(node_ptr->data);
+            break;
+    }
+    node_ptr->data = NULL;
+    node_ptr->data_len = 0;
+    if(node_ptr->callback != NULL)
+    {
+        delete node_ptr->callback;
+        node_ptr->callback = NULL;
+    }
+
+    node_ptr->type = MABAIN_ASYNC_TYPE_NONE;
 }
 
-int AsyncWriter::PrepareSlot(AsyncNode *node_ptr) const
+int AsyncWriter::SetCallback(AsyncNode *node_ptr, const AsyncCallback *callback)
 {
-    node_ptr->in_use.store(true, std::memory_order_release);
-    pthread_cond_signal(&node_ptr->cond);
-    if(pthread_mutex_unlock(&node_ptr->mutex) != 0)
-        return MBError::MUTEX_ERROR;
+    if(callback == NULL || !*callback)
+        return MBError::SUCCESS;
+    node_ptr->callback = new (std::nothrow) AsyncCallback(*callback);
+    if(node_ptr->callback == NULL)
+        return MBError::NO_MEMORY;
     return MBError::SUCCESS;
 }
 
+// Writer only: pass the result of the task to the producer before the
+// task is seen as done by WaitForSeq.
+void AsyncWriter::RunCallback(AsyncNode *node_ptr, int rval)
+{
+    if(node_ptr->callback == NULL)
+        return;
+    try {
+        (*node_ptr->callback)(writer_index.load(std::memory_order_relaxed) + 1, rval);
+    } catch (...) {
+        Logger::Log(LOG_LEVEL_ERROR, "async callback throws exception");
+    }
+}
+
+// Wait until the writer has run the task with the sequence number. Returns
+// MBError::TRY_AGAIN on timeout.
+int AsyncWriter::WaitForSeq(uint64_t seq, int timeout_ms)
+{
+    if(seq > queue_index.load())
+        return MBError::INVALID_ARG;
+    if(writer_index.load(std::memory_order_acquire) >= seq)
+        return MBError::SUCCESS;
+
+    struct timespec deadline;
+    if(timeout_ms >= 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if(deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    int rval = MBError::SUCCESS;
+    num_seq_waiters.fetch_add(1);
+    while(true)
+    {
+        uint32_t release = release_seq.load();
+        if(writer_index.load() >= seq)
+            break;
+        if(timeout_ms < 0)
+        {
+            FutexWait(&release_seq, release, false);
+            continue;
+        }
+
+        struct timespec now, timeout;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        timeout.tv_sec = deadline.tv_sec - now.tv_sec;
+        timeout.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+        if(timeout.tv_nsec < 0)
+        {
+            timeout.tv_sec--;
+            timeout.tv_nsec += 1000000000L;
+        }
+        if(timeout.tv_sec < 0)
+        {
+            rval = MBError::TRY_AGAIN;
+            break;
+        }
+        FutexWait(&release_seq, release, false, &timeout);
+    }
+    num_seq_waiters.fetch_sub(1);
+    return rval;
+}
+
+// Writer only: return the next task if it is ready.
+AsyncNode* AsyncWriter::NextTask()
+{
+    uint64_t index = writer_index.load(std::memory_order_relaxed);
+    AsyncNode *node_ptr = &queue[index & queue_mask];
+    if(node_ptr->seq.load(std::memory_order_acquire) != static_cast<uint32_t>(index + 1))
+        return NULL;
+    return node_ptr;
+}
+
+// Writer only: free the slot of the task just run for the next round.
+void AsyncWriter::ReleaseSlot(AsyncNode *node_ptr)
+{
+    FreeSlot(node_ptr);
+    uint64_t index = writer_index.load(std::memory_order_relaxed);
+    node_ptr->seq.store(static_cast<uint32_t>(index + queue_mask + 1));
+    writer_index.store(index + 1, std::memory_order_release);
+}
+
+// Writer only: called after a batch of slots are released
+void AsyncWriter::WakeProducers()
+{
+    release_seq.fetch_add(1);
+    if(num_waiting_producers.load() > 0 || num_seq_waiters.load() > 0)
+        FutexWake(&release_seq, INT_MAX, false);
+}
+
+// Writer only: spin for a while and then sleep until a producer submits.
+void AsyncWriter::WaitForTask()
+{
+    for(int spin = 0; spin < spin_count; spin++)
+    {
+        if(NextTask() != NULL || stop_processing.load(std::memory_order_relaxed))
+            return;
+        if(shm_queue != NULL && shm_queue->NextTask() != NULL)
+            return;
+        CpuRelax();
+    }
+
+    writer_waiting->store(1);
+    uint32_t submit = submit_seq->load();
+    uint64_t index = writer_index.load(std::memory_order_relaxed);
+    if(queue[index & queue_mask].seq.load() != static_cast<uint32_t>(index + 1) &&
+       !stop_processing.load())
+    {
+        if(shm_queue == NULL)
+        {
+            FutexWait(submit_seq, submit, false);
+        }
+        else if(!shm_queue->HasTask())
+        {
+            // Wake up now and then to release what dead producers left.
+            struct timespec timeout;
+            timeout.tv_sec = 0;
+            timeout.tv_nsec = ASYNC_SHARED_WAIT_NS;
+            if(FutexWait(submit_seq, submit, true, &timeout) != 0 && errno == ETIMEDOUT)
+            {
+                shm_queue->RecoverSlot();
+                shm_queue->RecoverBlocks();
+            }
+        }
+    }
+    writer_waiting->store(0, std::memory_order_relaxed);
+}
+
+// Writer only: run the tasks submitted by other processes.
+int AsyncWriter::RunSharedTasks(int ntasks)
+{
+    if(shm_queue == NULL)
+        return 0;
+
+    ShmQueueSlot *slot;
+    MBData mbd;
+    int rval;
+    int count = 0;
+    while(count < ntasks && (slot = shm_queue->NextTask()) != NULL)
+    {
+        const char *key = shm_queue->GetKey(slot);
+        rval = MBError::SUCCESS;
+        try {
+            switch(slot->type)
+            {
+                case MABAIN_ASYNC_TYPE_ADD:
+                    mbd.buff = (uint8_t *) key + slot->key_len;
+                    mbd.data_len = slot->data_len;
+                    rval = dict->Add((const uint8_t *) key, slot->key_len, mbd,
+                                     slot->overwrite);
+                    break;
+                case MABAIN_ASYNC_TYPE_REMOVE:
+                    mbd.options = CONSTS::OPTION_FIND_AND_STORE_PARENT;
+                    rval = dict->Remove((const uint8_t *) key, slot->key_len, mbd);
+                    break;
+                case MABAIN_ASYNC_TYPE_NONE:
+                    break;
+                default:
+                    rval = MBError::INVALID_ARG;
+                    break;
+            }
+        } catch (int err) {
+            Logger::Log(LOG_LEVEL_ERROR, "shared async task throws error %s",
+                        MBError::get_error_str(err));
+            rval = err;
+        }
+
+        if(rval != MBError::SUCCESS)
+        {
+            Logger::Log(LOG_LEVEL_DEBUG, "failed to run shared update %d: %s",
+                        (int) slot->type, MBError::get_error_str(rval));
+        }
+        shm_queue->ReleaseSlot(slot);
+        mbd.buff = NULL;
+        mbd.options = 0;
+        mbd.Clear();
+        count++;
+    }
+
+    if(count > 0)
+        shm_queue->WakeProducers();
+    else if(shm_queue->Busy())
+        shm_queue->RecoverSlot();
+    return count;
+}
+
 int AsyncWriter::Add(const char *key, int key_len, const char *data,
-                     int data_len, bool overwrite)
+                     int data_len, bool overwrite, uint64_t *seq,
+                     const AsyncCallback *callback)
 {
-    if(stop_processing)
+    if(stop_processing.load(std::memory_order_relaxed))
         return MBError::DB_CLOSED;
 
-    AsyncNode *node_ptr = AcquireSlot();
-    if(node_ptr == NULL)
-        return MBError::MUTEX_ERROR;
-
-    node_ptr->key = (char *) malloc(key_len);
-    node_ptr->data = (char *) malloc(data_len);
-    if(node_ptr->key == NULL || node_ptr->data == NULL)
+    AsyncNode *node_ptr = AcquireSlot(seq);
+    int rval = CopyToSlot(node_ptr, key, key_len, data, data_len);
+    if(rval == MBError::SUCCESS)
+        rval = SetCallback(node_ptr, callback);
+    if(rval != MBError::SUCCESS)
     {
-        pthread_mutex_unlock(&node_ptr->mutex);
-        free_async_node(node_ptr);
-        return MBError::NO_MEMORY;
+        FreeSlot(node_ptr);
+        PrepareSlot(node_ptr);
+        return rval;
     }
-    memcpy(node_ptr->key, key, key_len);
-    memcpy(node_ptr->data, data, data_len);
-    node_ptr->key_len = key_len;
-    node_ptr->data_len = data_len;
     node_ptr->overwrite = overwrite;
-
     node_ptr->type = MABAIN_ASYNC_TYPE_ADD;
 
+    return PrepareSlot(node_ptr);
+}
+
+int AsyncWriter::Remove(const char *key, int len, uint64_t *seq,
+                        const AsyncCallback *callback)
+{
+    if(stop_processing.load(std::memory_order_relaxed))
+        return MBError::DB_CLOSED;
+
+    AsyncNode *node_ptr = AcquireSlot(seq);
+    int rval = CopyToSlot(node_ptr, key, len, NULL, 0);
+    if(rval == MBError::SUCCESS)
+        rval = SetCallback(node_ptr, callback);
+    if(rval != MBError::SUCCESS)
+    {
+        FreeSlot(node_ptr);
+        PrepareSlot(node_ptr);
+        return rval;
+    }
+    node_ptr->type = MABAIN_ASYNC_TYPE_REMOVE;
 
     return PrepareSlot(node_ptr);
 }
 
-int AsyncWriter::Remove(const char *key, int len)
+int AsyncWriter::RemovePrefix(const char *prefix, int len, uint64_t *seq)
 {
-    if(stop_processing)
+    if(stop_processing.load(std::memory_order_relaxed))
         return MBError::DB_CLOSED;
 
-    AsyncNode *node_ptr = AcquireSlot();
-    if(node_ptr == NULL)
-        return MBError::MUTEX_ERROR;
+    AsyncNode *node_ptr = AcquireSlot(seq);
+    int rval = CopyToSlot(node_ptr, prefix, len, NULL, 0);
+    if(rval != MBError::SUCCESS)
+    {
+        FreeSlot(node_ptr);
+        PrepareSlot(node_ptr);
+        return rval;
+    }
+    node_ptr->type = MABAIN_ASYNC_TYPE_REMOVE_PREFIX;
+
+    return PrepareSlot(node_ptr);
+}
 
-    node_ptr->key = (char *) malloc(len);
-    if(node_ptr->key == NULL)
+int AsyncWriter::Write(const WriteBatch &batch, uint64_t *seq)
+{
+    if(stop_processing.load(std::memory_order_relaxed))
+        return MBError::DB_CLOSED;
+
+    AsyncNode *node_ptr = AcquireSlot(seq);
+    node_ptr->data = new (std::nothrow) WriteBatch(batch);
+    if(node_ptr->data == NULL)
     {
-        pthread_mutex_unlock(&node_ptr->mutex);
-        free_async_node(node_ptr);
+        PrepareSlot(node_ptr);
         return MBError::NO_MEMORY;
     }
-    memcpy(node_ptr->key, key, len);
-    node_ptr->key_len = len;
-    node_ptr->type = MABAIN_ASYNC_TYPE_REMOVE;
+    node_ptr->type = MABAIN_ASYNC_TYPE_BATCH;
 
     return PrepareSlot(node_ptr);
 }
 
-int AsyncWriter::Backup(const char *backup_dir)
+int AsyncWriter::Backup(const char *backup_dir, uint64_t *seq)
 {
     if(backup_dir == NULL)
         return MBError::INVALID_ARG; 
     
-    if(stop_processing)
+    if(stop_processing.load(std::memory_order_relaxed))
         return MBError::DB_CLOSED;
 
-    AsyncNode *node_ptr = AcquireSlot();
-    if(node_ptr == NULL)
-        return MBError::MUTEX_ERROR;
-
+    AsyncNode *node_ptr = AcquireSlot(seq);
     node_ptr->data = (char *) strdup(backup_dir);
     if(node_ptr->data == NULL)
     {
-        pthread_mutex_unlock(&node_ptr->mutex);
-        free_async_node(node_ptr);
+        PrepareSlot(node_ptr);
         return MBError::NO_MEMORY;
     }
     node_ptr->type = MABAIN_ASYNC_TYPE_BACKUP;
     return PrepareSlot(node_ptr);
 }
 
-int AsyncWriter::RemoveAll()
+int AsyncWriter::RemoveAll(uint64_t *seq)
 {
-    if(stop_processing)
+    if(stop_processing.load(std::memory_order_relaxed))
         return MBError::DB_CLOSED;
 
-    AsyncNode *node_ptr = AcquireSlot();
-    if(node_ptr == NULL)
-        return MBError::MUTEX_ERROR;
-
+    AsyncNode *node_ptr = AcquireSlot(seq);
     node_ptr->type = MABAIN_ASYNC_TYPE_REMOVE_ALL;
 
     return PrepareSlot(node_ptr);
@@ -269,16 +585,16 @@ int AsyncWriter::RemoveAll()
 int  AsyncWriter::CollectResource(int64_t m_index_rc_size, int64_t m_data_rc_size,
                                   int64_t max_dbsz, int64_t max_dbcnt)
 {
-    if(stop_processing)
+    if(stop_processing.load(std::memory_order_relaxed))
         return MBError::DB_CLOSED;
 
     AsyncNode *node_ptr = AcquireSlot();
-    if(node_ptr == NULL)
-        return MBError::MUTEX_ERROR;
-
     int64_t *data_ptr = (int64_t *) calloc(4, sizeof(int64_t));
     if (data_ptr == NULL)
+    {
+        PrepareSlot(node_ptr);
         return MBError::NO_MEMORY;
+    }
 
     node_ptr->data = data_ptr;
     node_ptr->data_len = sizeof(int64_t)*4;
@@ -299,92 +615,87 @@ int AsyncWriter::ProcessTask(int ntasks, bool rc_mode)
     MBData mbd;
     int rval = MBError::SUCCESS;
     int count = 0;
+    int type;
 
     while(count < ntasks)
     {
-        node_ptr = &queue[writer_index % max_num_queue_node]; 
-        if(pthread_mutex_lock(&node_ptr->mutex) != 0)
-        {
-            Logger::Log(LOG_LEVEL_ERROR, "failed to lock mutex");
-            throw (int) MBError::MUTEX_ERROR;
-        }
+        node_ptr = NextTask();
+        if(node_ptr == NULL)
+            break;
 
-        if(node_ptr->in_use.load(std::memory_order_consume))
-        {
-            switch(node_ptr->type)
-            {
-                case MABAIN_ASYNC_TYPE_ADD:
-                    if(rc_mode)
-                        mbd.options = CONSTS::OPTION_RC_MODE;
-                    mbd.buff = (uint8_t *) node_ptr->data;
-                    mbd.data_len = node_ptr->data_len;
-                    rval = dict->Add((uint8_t *)node_ptr->key, node_ptr->key_len, mbd, node_ptr->overwrite);
-                    break;
-                case MABAIN_ASYNC_TYPE_REMOVE:
-                    if(rc_mode)
-                    {
-                        // FIXME
-                        rval = MBError::SUCCESS;
-                    } 
-                    else
-                    {
-                        mbd.options |= CONSTS::OPTION_FIND_AND_STORE_PARENT;
-                        rval = dict->Remove((uint8_t *)node_ptr->key, node_ptr->key_len, mbd);
-                    }
-                    break;
-                case MABAIN_ASYNC_TYPE_REMOVE_ALL:
-                    if(!rc_mode)
-                        rval = dict->RemoveAll();
-                    else
-                        rval = MBError::SUCCESS;
-                    break;
-                case MABAIN_ASYNC_TYPE_RC:
-                    // ignore rc task since it is running already.
-                    rval = MBError::RC_SKIPPED;
-                    break;
-                case MABAIN_ASYNC_TYPE_NONE:
-                    rval = MBError::SUCCESS;
-                    break;
-                case MABAIN_ASYNC_TYPE_BACKUP:
-                    // clean up existing backup dir varibale buffer.
-                    if (rc_backup_dir && node_ptr->data)
-                        free(rc_backup_dir);
-                    rc_backup_dir = (char *) node_ptr->data;
-                    node_ptr->data = NULL;
-                    rval = MBError::SUCCESS;
-                    break;
-                default:
-                    rval = MBError::INVALID_ARG;
-                    break;
-            }
+        type = node_ptr->type;
+        // Removals and batches cannot run in rc mode. They and the tasks
+        // queued after them wait for rc to finish.
+        if(rc_mode && (type == MABAIN_ASYNC_TYPE_REMOVE ||
+                       type == MABAIN_ASYNC_TYPE_REMOVE_PREFIX ||
+                       type == MABAIN_ASYNC_TYPE_REMOVE_ALL ||
+                       type == MABAIN_ASYNC_TYPE_BATCH))
+            break;
 
-            free_async_node(node_ptr);
-            node_ptr->in_use.store(false, std::memory_order_release);
-            pthread_cond_signal(&node_ptr->cond);
-            writer_index++;
-            mbd.Clear();
-            count++;
-        }
-        else
+        switch(type)
         {
-            // done processing
-            count = ntasks;
+            case MABAIN_ASYNC_TYPE_ADD:
+                if(rc_mode)
+                    mbd.options = CONSTS::OPTION_RC_MODE;
+                mbd.buff = (uint8_t *) node_ptr->data;
+                mbd.data_len = node_ptr->data_len;
+                rval = dict->Add((uint8_t *)node_ptr->key, node_ptr->key_len, mbd, node_ptr->overwrite);
+                break;
+            case MABAIN_ASYNC_TYPE_REMOVE:
+                mbd.options |= CONSTS::OPTION_FIND_AND_STORE_PARENT;
+                rval = dict->Remove((uint8_t *)node_ptr->key, node_ptr->key_len, mbd);
+                break;
+            case MABAIN_ASYNC_TYPE_REMOVE_PREFIX:
+                {
+                    int64_t count;
+                    rval = dict->RemovePrefix((uint8_t *)node_ptr->key, node_ptr->key_len,
+                                              count);
+                }
+                break;
+            case MABAIN_ASYNC_TYPE_BATCH:
+                rval = dict->Write(*static_cast<WriteBatch *>(node_ptr->data));
+                break;
+            case MABAIN_ASYNC_TYPE_REMOVE_ALL:
+                rval = dict->RemoveAll();
+                break;
+            case MABAIN_ASYNC_TYPE_RC:
+                // ignore rc task since it is running already.
+                rval = MBError::RC_SKIPPED;
+                break;
+            case MABAIN_ASYNC_TYPE_NONE:
+                rval = MBError::SUCCESS;
+                break;
+            case MABAIN_ASYNC_TYPE_BACKUP:
+                // clean up existing backup dir varibale buffer.
+                if (rc_backup_dir && node_ptr->data)
+                    free(rc_backup_dir);
+                rc_backup_dir = (char *) node_ptr->data;
+                node_ptr->data = NULL;
+                rval = MBError::SUCCESS;
+                break;
+            default:
+                rval = MBError::INVALID_ARG;
+                break;
         }
 
-        if(pthread_mutex_unlock(&node_ptr->mutex) != 0)
-        {
-            Logger::Log(LOG_LEVEL_ERROR, "failed to unlock mutex");
-            throw (int) MBError::MUTEX_ERROR;
-        }
+        RunCallback(node_ptr, rval);
+        ReleaseSlot(node_ptr);
+        mbd.Clear();
+        count++;
 
         if(rval != MBError::SUCCESS)
         {
             Logger::Log(LOG_LEVEL_DEBUG, "failed to run update %d: %s",
-                        (int)node_ptr->type, MBError::get_error_str(rval));
+                        type, MBError::get_error_str(rval));
         }
     }
+    if(count > 0)
+        WakeProducers();
+    // Shared tasks wait for rc to finish since they cannot be skipped.
+    if(!rc_mode && count < ntasks)
+        RunSharedTasks(ntasks - count);
 
-    if(stop_processing)
+    if(stop_processing.load(std::memory_order_relaxed))
         return MBError::RC_SKIPPED;
     return MBError::SUCCESS;
 }
@@ -398,32 +709,30 @@ void* AsyncWriter::async_writer_thread()
     int64_t min_data_size = 0;
     int64_t max_dbsize = MAX_6B_OFFSET;
     int64_t max_dbcount = MAX_6B_OFFSET;
+    int num_run = 0;
+    int type;
 
     Logger::Log(LOG_LEVEL_INFO, "async writer started");
     while(true)
     {
-        node_ptr = &queue[writer_index % max_num_queue_node];
-        if(pthread_mutex_lock(&node_ptr->mutex) != 0)
+        node_ptr = NextTask();
+        if(node_ptr == NULL)
         {
-            Logger::Log(LOG_LEVEL_ERROR, "failed to lock mutex");
-            throw (int) MBError::MUTEX_ERROR;
-        }
-
-        while(!node_ptr->in_use.load(std::memory_order_consume))
-        {
-            if(stop_processing)
+            if(num_run > 0)
+            {
+                WakeProducers();
+                num_run = 0;
+            }
+            if(stop_processing.load())
                 break;
-            pthread_cond_wait(&node_ptr->cond, &node_ptr->mutex);
-        }
-
-        if(stop_processing && !node_ptr->in_use.load(std::memory_order_consume))
-        {
-            pthread_mutex_unlock(&node_ptr->mutex);
-            break;
+            if(RunSharedTasks(ASYNC_BATCH_SIZE) == 0)
+                WaitForTask();
+            continue;
         }
 
         // process the node
-        switch(node_ptr->type)
+        type = node_ptr->type;
+        switch(type)
         {
             case MABAIN_ASYNC_TYPE_ADD:
                 mbd.buff = (uint8_t *) node_ptr->data;
@@ -448,6 +757,26 @@ void* AsyncWriter::async_writer_thread()
                 }
                 mbd.options &= ~CONSTS::OPTION_FIND_AND_STORE_PARENT;
                 break;
+            case MABAIN_ASYNC_TYPE_REMOVE_PREFIX:
+                try {
+                    int64_t count;
+                    rval = dict->RemovePrefix((uint8_t *)node_ptr->key, node_ptr->key_len,
+                                              count);
+                } catch (int err) {
+                    Logger::Log(LOG_LEVEL_ERROR, "dict->RemovePrefix throws error %s",
+                                MBError::get_error_str(err));
+                    rval = err;
+                }
+                break;
+            case MABAIN_ASYNC_TYPE_BATCH:
+                try {
+                    rval = dict->Write(*static_cast<WriteBatch *>(node_ptr->data));
+                } catch (int err) {
+                    Logger::Log(LOG_LEVEL_ERROR, "dict->Write throws error %s",
+                                MBError::get_error_str(err));
+                    rval = err;
+                }
+                break;
             case MABAIN_ASYNC_TYPE_REMOVE_ALL:
                 try {
                     rval = dict->RemoveAll();
@@ -484,26 +813,36 @@ void* AsyncWriter::async_writer_thread()
                 break;
         }
 
-        free_async_node(node_ptr);
-        node_ptr->in_use.store(false, std::memory_order_release);
-        pthread_cond_signal(&node_ptr->cond);
-        if(pthread_mutex_unlock(&node_ptr->mutex) != 0)
+        RunCallback(node_ptr, rval);
+        ReleaseSlot(node_ptr);
+        if(++num_run == ASYNC_BATCH_SIZE)
+        {
+            WakeProducers();
+            num_run = 0;
+            // Do not starve the other processes.
+            RunSharedTasks(ASYNC_BATCH_SIZE);
+        }
+        else if(num_seq_waiters.load(std::memory_order_relaxed) > 0)
         {
-            Logger::Log(LOG_LEVEL_ERROR, "failed to unlock mutex");
-            throw (int) MBError::MUTEX_ERROR;
+            // Do not keep WaitForSeq waiting for the whole batch.
+            WakeProducers();
         }
-        
+
         if(rval != MBError::SUCCESS)
         {
             Logger::Log(LOG_LEVEL_DEBUG, "failed to run update %d: %s",
-                        (int)node_ptr->type, MBError::get_error_str(rval));
+                        type, MBError::get_error_str(rval));
         }
 
-        writer_index++;
         mbd.Clear();
 
         if(is_rc_running)
         {
+            if(num_run > 0)
+            {
+                WakeProducers();
+                num_run = 0;
+            }
             rval = MBError::SUCCESS;
             try {
                 ResourceCollection rc = ResourceCollection(*db);
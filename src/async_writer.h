@@ -20,11 +20,14 @@
 #define __ASYNC_WRITER_H__
 
 #include <pthread.h>
+#include <atomic>
 
 #include "db.h"
 //#include "mb_rc.h"
 #include "dict.h"
 #include "mb_backup.h"
+#include "slab_pool.h"
+#include "shm_queue.h"
 
 namespace mabain {
 
@@ -34,60 +37,114 @@ namespace mabain {
 #define MABAIN_ASYNC_TYPE_REMOVE_ALL 3
 #define MABAIN_ASYNC_TYPE_RC         4
 #define MABAIN_ASYNC_TYPE_BACKUP     5
-    
+#define MABAIN_ASYNC_TYPE_REMOVE_PREFIX 6
+#define MABAIN_ASYNC_TYPE_BATCH      7
+
+#define MABAIN_ASYNC_QUEUE_SIZE_DEFAULT 2048
+// Keys and values up to this size in total are copied into the queue slot.
+// A slot takes two cache lines.
+#define MABAIN_ASYNC_INLINE_SIZE     80
+
 typedef struct _AsyncNode
 {
-    std::atomic<bool> in_use;
-    pthread_mutex_t   mutex;
-    pthread_cond_t    cond;
+    // Queue index the slot is ready for. It is the index itself when the
+    // slot is free for the producer and the index plus one when the task
+    // is ready for the writer.
+    std::atomic<uint32_t> seq;
+    char type;
+    bool overwrite;
+    int key_len;
+    int data_len;
+    // slab pool id of key if it is not inline_buff
+    int slab_id;
 
+    // For add, the value follows the key in the same buffer.
     char *key;
     void *data;
-    int key_len;
-    int data_len;
-    bool overwrite;
-    char type;
+    // set if the producer asked for the result
+    AsyncCallback *callback;
+    char inline_buff[MABAIN_ASYNC_INLINE_SIZE];
 } AsyncNode;
 
 class AsyncWriter
 {
 public:
 
-    AsyncWriter(DB *db_ptr);
+    AsyncWriter(DB *db_ptr, int queue_size = MABAIN_ASYNC_QUEUE_SIZE_DEFAULT,
+                ShmQueue *shm_queue_ptr = NULL);
     ~AsyncWriter();
 
     void UpdateNumUsers(int delta);
-    int  Add(const char *key, int key_len, const char *data, int data_len, bool overwrite);
-    int  Remove(const char *key, int len);
-    int  RemoveAll();
-    int  Backup(const char *backup_dir);
+    // seq is set to the sequence number of the task if not NULL.
+    int  Add(const char *key, int key_len, const char *data, int data_len, bool overwrite,
+             uint64_t *seq = NULL, const AsyncCallback *callback = NULL);
+    int  Remove(const char *key, int len, uint64_t *seq = NULL,
+                const AsyncCallback *callback = NULL);
+    int  RemoveAll(uint64_t *seq = NULL);
+    int  RemovePrefix(const char *prefix, int len, uint64_t *seq = NULL);
+    int  Write(const WriteBatch &batch, uint64_t *seq = NULL);
+    int  Backup(const char *backup_dir, uint64_t *seq = NULL);
     int  CollectResource(int64_t m_index_rc_size, int64_t m_data_rc_size, 
                          int64_t max_dbsz, int64_t max_dbcnt);
     int  StopAsyncThread();
     bool Busy() const;
+    // Wait until the task with the sequence number is run.
+    int  WaitForSeq(uint64_t seq, int timeout_ms);
     int  ProcessTask(int ntasks, bool rc_mode);
 
 private:
     static void *async_thread_wrapper(void *context);
-    AsyncNode* AcquireSlot();
-    int PrepareSlot(AsyncNode *node_ptr) const;
+    AsyncNode* AcquireSlot(uint64_t *seq = NULL);
+    int SetCallback(AsyncNode *node_ptr, const AsyncCallback *callback);
+    void RunCallback(AsyncNode *node_ptr, int rval);
+    int PrepareSlot(AsyncNode *node_ptr);
+    int CopyToSlot(AsyncNode *node_ptr, const char *key, int key_len,
+                   const char *data, int data_len);
+    void FreeSlot(AsyncNode *node_ptr);
+    AsyncNode* NextTask();
+    void ReleaseSlot(AsyncNode *node_ptr);
+    void WakeProducers();
+    void WaitForTask();
+    int  RunSharedTasks(int ntasks);
     void* async_writer_thread();
 
-    static const int max_num_queue_node;
-
     // db pointer
     DB *db;
     Dict *dict;
 
     std::atomic<int> num_users;
     AsyncNode *queue;
+    // queue size is a power of 2
+    uint32_t queue_mask;
+    // Buffers for tasks too big to be inlined in the queue slots
+    SlabPool slab_pool;
 
     // thread id
     pthread_t tid;
 
-    bool stop_processing;
-    std::atomic<uint32_t> queue_index;
-    uint32_t writer_index;
+    std::atomic<bool> stop_processing;
+    // Next index to be taken by producers. Sequence numbers of the tasks
+    // are their queue indices plus one.
+    std::atomic<uint64_t> queue_index;
+    // next index to be run by the writer
+    std::atomic<uint64_t> writer_index;
+
+    // Futex words. submit_seq is bumped to wake up the writer and
+    // release_seq to wake up producers waiting for a free slot. With the
+    // shared queue, the writer sleeps on the words in the queue header so
+    // that other processes can wake it up too.
+    std::atomic<uint32_t> *submit_seq;
+    std::atomic<uint32_t> *writer_waiting;
+    std::atomic<uint32_t> release_seq;
+    std::atomic<int>  num_waiting_producers;
+    // threads in WaitForSeq; writer wakes them up after every task
+    std::atomic<int>  num_seq_waiters;
+    std::atomic<uint32_t> local_submit_seq;
+    std::atomic<uint32_t> local_writer_waiting;
+    int spin_count;
+
+    // Tasks submitted by other processes
+    ShmQueue *shm_queue;
 
     bool is_rc_running;
     char *rc_backup_dir;
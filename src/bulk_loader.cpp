@@ -0,0 +1,226 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "bulk_loader.h"
+#include "error.h"
+#include "logger.h"
+
+namespace mabain {
+
+BulkLoader::BulkLoader(DB &db_ref)
+                      : db(db_ref),
+                        tail_depth(0),
+                        tail_leaf(true),
+                        tail_off(0),
+                        count(0),
+                        status(MBError::SUCCESS)
+{
+    if(!(db.GetDBOptions() & CONSTS::ACCESS_MODE_WRITER))
+        throw (int) MBError::NOT_ALLOWED;
+    dict = db.GetDictPtr();
+    if(dict == NULL || !db.is_open())
+        throw (int) MBError::NOT_INITIALIZED;
+    if(dict->Count() != 0)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "bulk load requires an empty DB");
+        throw (int) MBError::NOT_ALLOWED;
+    }
+    mm = dict->GetMM();
+    header = dict->GetHeaderPtr();
+
+    BulkNode root;
+    root.depth = 0;
+    root.match = false;
+    root.data_off = 0;
+    nodes.push_back(root);
+    memset(root_count, 0, sizeof(root_count));
+}
+
+BulkLoader::~BulkLoader()
+{
+}
+
+// The edge from the node to the end of the tail
+void BulkLoader::AddTailEdge(BulkNode &node)
+{
+    NodeEdge edge;
+    edge.label.assign(last_key, node.depth, tail_depth - node.depth);
+    edge.leaf = tail_leaf;
+    edge.offset = tail_off;
+    node.edges.push_back(edge);
+}
+
+// Write the deepest node on the path with the tail as its last edge. The
+// node becomes the new tail.
+void BulkLoader::CloseNode()
+{
+    BulkNode &node = nodes.back();
+    AddTailEdge(node);
+    tail_off = mm->AddNode(node.match, node.data_off, node.edges);
+    tail_depth = node.depth;
+    tail_leaf = false;
+    nodes.pop_back();
+}
+
+int BulkLoader::Add(const char *key, int len, const char *data, int data_len)
+{
+    if(status != MBError::SUCCESS)
+        return status;
+    if(key == NULL || len <= 0 || data_len < 0 || (data == NULL && data_len > 0))
+        return MBError::INVALID_ARG;
+    // The length of an edge is kept in one byte.
+    if(len >= CONSTS::MAX_KEY_LENGHTH || data_len > CONSTS::MAX_DATA_SIZE)
+        return MBError::OUT_OF_BOUND;
+
+    int lcp = 0;
+    if(count > 0)
+    {
+        int min_len = static_cast<int>(last_key.size());
+        if(min_len > len)
+            min_len = len;
+        while(lcp < min_len && last_key[lcp] == key[lcp])
+            lcp++;
+        if(lcp == len || (lcp < min_len &&
+           static_cast<uint8_t>(key[lcp]) < static_cast<uint8_t>(last_key[lcp])))
+        {
+            Logger::Log(LOG_LEVEL_WARN, "bulk load keys are not in increasing order");
+            return MBError::INVALID_ARG;
+        }
+    }
+
+    if(data == NULL)
+        data = "";
+
+    try {
+        size_t data_off;
+        dict->ReserveData(reinterpret_cast<const uint8_t*>(data), data_len, data_off);
+        header->num_update++;
+
+        if(count > 0)
+        {
+            if(lcp == tail_depth)
+            {
+                // The last key is a prefix of this key.
+                BulkNode node;
+                node.depth = lcp;
+                node.match = true;
+                node.data_off = tail_off;
+                nodes.push_back(node);
+            }
+            else
+            {
+                while(nodes.back().depth > lcp)
+                    CloseNode();
+                if(nodes.back().depth < lcp)
+                {
+                    BulkNode node;
+                    node.depth = lcp;
+                    node.match = false;
+                    node.data_off = 0;
+                    nodes.push_back(node);
+                }
+                AddTailEdge(nodes.back());
+            }
+        }
+
+        last_key.assign(key, len);
+        tail_depth = len;
+        tail_leaf = true;
+        tail_off = data_off;
+        count++;
+        root_count[static_cast<uint8_t>(key[0])]++;
+    } catch (int error) {
+        Logger::Log(LOG_LEVEL_ERROR, "bulk load failed: %s", MBError::get_error_str(error));
+        status = error;
+    }
+
+    return status;
+}
+
+int BulkLoader::Add(const std::string &key, const std::string &value)
+{
+    return Add(key.data(), key.size(), value.data(), value.size());
+}
+
+int BulkLoader::Finish()
+{
+    if(status != MBError::SUCCESS)
+        return status;
+    status = MBError::NOT_ALLOWED;
+    if(count == 0)
+        return MBError::SUCCESS;
+
+    int rval = MBError::SUCCESS;
+    // Root edges published and counted, and root edges to clear on error
+    size_t num_set = 0;
+    size_t num_clear = 0;
+    try {
+        while(nodes.size() > 1)
+            CloseNode();
+        AddTailEdge(nodes[0]);
+        // Each root edge links a complete subtree. The count is kept in
+        // line with the keys visible to readers.
+        for(; num_set < nodes[0].edges.size(); num_set++)
+        {
+            const NodeEdge &edge = nodes[0].edges[num_set];
+            // The edge may be partly written if SetRootEdge throws.
+            num_clear = num_set + 1;
+            rval = mm->SetRootEdge(edge);
+            if(rval != MBError::SUCCESS)
+            {
+                num_clear = num_set;
+                break;
+            }
+            header->count += root_count[static_cast<uint8_t>(edge.label[0])];
+        }
+    } catch (int error) {
+        rval = error;
+    }
+    if(rval != MBError::SUCCESS)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "bulk load failed: %s", MBError::get_error_str(rval));
+        // Unlink the subtrees already published. Their nodes and values are
+        // left to resource collection.
+        for(size_t i = 0; i < num_clear; i++)
+        {
+            uint8_t nt = static_cast<uint8_t>(nodes[0].edges[i].label[0]);
+            mm->ClearRootEdge(nt);
+            if(i < num_set)
+                header->count -= root_count[nt];
+        }
+        nodes.clear();
+        status = rval;
+        return rval;
+    }
+    nodes.clear();
+
+    Logger::Log(LOG_LEVEL_INFO, "bulk loaded %lld keys", (long long) count);
+
+    if(dict->GetKeyFilter() != NULL)
+        rval = dict->RebuildKeyFilter(db);
+    if(rval == MBError::SUCCESS && dict->GetHashIndex() != NULL)
+        rval = dict->RebuildHashIndex();
+    return rval;
+}
+
+int64_t BulkLoader::Count() const
+{
+    return count;
+}
+
+}
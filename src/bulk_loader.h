@@ -0,0 +1,91 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BULK_LOADER_H__
+#define __BULK_LOADER_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "db.h"
+#include "dict.h"
+#include "dict_mem.h"
+
+namespace mabain {
+
+// Node on the path of the last key added to BulkLoader. The node is written
+// once all keys below it have been added.
+typedef struct _BulkNode
+{
+    // length of the key at the node
+    int depth;
+    bool match;
+    size_t data_off;
+    std::vector<NodeEdge> edges;
+} BulkNode;
+
+// Build a new DB from key-value pairs sorted by key. Values are appended to
+// the data file as they are added. Every node is written bottom-up at its
+// final size after its last child, so that no node is moved or released
+// during the load. Until Finish readers see an empty DB. Finish publishes
+// the root edges one at a time in key order and adds the number of keys
+// below each edge to the count right after it, so readers running during
+// Finish may see the keys of the first bytes published so far. If Finish
+// fails, the root edges already published are cleared again.
+// The DB must be empty and must not be updated by anything else during the
+// load.
+class BulkLoader
+{
+public:
+    BulkLoader(DB &db_ref);
+    ~BulkLoader();
+
+    // Add the next key-value pair. Keys must be in increasing byte order.
+    int Add(const char *key, int len, const char *data, int data_len);
+    int Add(const std::string &key, const std::string &value);
+    // Write the remaining nodes and the root edges.
+    int Finish();
+    // Number of keys added
+    int64_t Count() const;
+
+private:
+    void AddTailEdge(BulkNode &node);
+    void CloseNode();
+
+    DB &db;
+    Dict *dict;
+    DictMem *mm;
+    IndexHeader *header;
+
+    // nodes on the path of the last key, root first
+    std::vector<BulkNode> nodes;
+    std::string last_key;
+    // The subtree below the deepest node on the path ends at key length
+    // tail_depth. It is a leaf edge or a written node at tail_off.
+    int tail_depth;
+    bool tail_leaf;
+    size_t tail_off;
+
+    int64_t count;
+    // number of keys below each root edge
+    int64_t root_count[NUM_ALPHABET];
+    int status;
+};
+
+}
+
+#endif
@@ -33,6 +33,7 @@
 #include "async_writer.h"
 #include "mb_backup.h"
 #include "resource_pool.h"
+#include "parallel_scan.h"
 
 namespace mabain {
 
@@ -56,6 +57,11 @@ int DB::Close()
         delete async_writer;
         async_writer = NULL;
     }
+    if(shm_queue != NULL)
+    {
+        delete shm_queue;
+        shm_queue = NULL;
+    }
 
     if(dict != NULL)
     {
@@ -152,6 +158,15 @@ int DB::ValidateConfig(MBConfig &config)
         return MBError::INVALID_ARG;
     }
 
+    if(config.async_queue_size == 0)
+        config.async_queue_size = MABAIN_ASYNC_QUEUE_SIZE_DEFAULT;
+    if(config.async_queue_size < 2 ||
+       (config.async_queue_size & (config.async_queue_size - 1)) != 0)
+    {
+        std::cerr << "async queue size must be a power of 2 greater than 1\n";
+        return MBError::INVALID_ARG;
+    }
+
     if(config.max_num_index_block == 0)
         config.max_num_index_block = 1024;
     if(config.max_num_data_block == 0)
@@ -160,10 +175,30 @@ int DB::ValidateConfig(MBConfig &config)
     return MBError::SUCCESS;
 }
 
+int DB::OpenShmQueue(const MBConfig &config)
+{
+    try {
+        shm_queue = new ShmQueue(mb_dir, config.options, config.async_queue_size);
+    } catch (int error) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to open shared async queue: %s",
+                    MBError::get_error_str(error));
+        return error;
+    }
+
+    if(!shm_queue->IsValid())
+    {
+        delete shm_queue;
+        shm_queue = NULL;
+        return MBError::NOT_INITIALIZED;
+    }
+    return MBError::SUCCESS;
+}
+
 void DB::InitDB(MBConfig &config)
 {
     dict = NULL;
     async_writer = NULL;
+    shm_queue = NULL;
 
     if(ValidateConfig(config) != MBError::SUCCESS)
         return;
@@ -231,7 +266,8 @@ void DB::InitDB(MBConfig &config)
                     config.memcap_index, config.memcap_data,
                     config.block_size_index, config.block_size_data,
                     config.max_num_index_block, config.max_num_data_block,
-                    config.num_entry_per_bucket);
+                    config.num_entry_per_bucket, config.key_filter_size,
+                    config.hash_index_size);
 
     if((config.options & CONSTS::ACCESS_MODE_WRITER) && init_header)
     {
@@ -260,8 +296,30 @@ void DB::InitDB(MBConfig &config)
 
     if(config.options & CONSTS::ACCESS_MODE_WRITER)
     {
+        // Populate the key filter and the hash index if they are new or were
+        // not completely built. Those left by a removed DB are also reset.
+        KeyFilter *filter = dict->GetKeyFilter();
+        if(filter != NULL && (init_header || !filter->IsReady()))
+            dict->RebuildKeyFilter(*this);
+        HashIndex *hash_index = dict->GetHashIndex();
+        if(hash_index != NULL && (init_header || !hash_index->IsReady()))
+            dict->RebuildHashIndex();
+
         if(config.options & CONSTS::ASYNC_WRITER_MODE)
-            async_writer = new AsyncWriter(this);
+        {
+            if(config.options & CONSTS::SHM_ASYNC_QUEUE)
+            {
+                status = OpenShmQueue(config);
+                if(status != MBError::SUCCESS)
+                    return;
+            }
+            async_writer = new AsyncWriter(this, config.async_queue_size, shm_queue);
+        }
+    }
+    else if(config.options & CONSTS::SHM_ASYNC_QUEUE)
+    {
+        // Readers use the queue only if a writer has created it.
+        OpenShmQueue(config);
     }
 
     Logger::Log(LOG_LEVEL_INFO, "connector %u successfully opened DB %s for %s",
@@ -304,6 +362,72 @@ int DB::Find(const std::string &key, MBData &mdata) const
     return Find(key.data(), key.size(), mdata);
 }
 
+int DB::Find(const char* key, int len, MBData &mdata, FindCursor &cursor) const
+{
+    if(key == NULL)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    // Writer in async mode cannot be used for lookup
+    if(options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+
+    return dict->Find(reinterpret_cast<const uint8_t*>(key), len, mdata, cursor);
+}
+
+int DB::Find(const std::string &key, MBData &mdata, FindCursor &cursor) const
+{
+    return Find(key.data(), key.size(), mdata, cursor);
+}
+
+int DB::FindView(const char* key, int len, MBData &mdata) const
+{
+    if(key == NULL)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    // Writer in async mode cannot be used for lookup
+    if(options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+
+    mdata.options |= CONSTS::OPTION_READ_VIEW;
+    int rval = dict->Find(reinterpret_cast<const uint8_t*>(key), len, mdata);
+    mdata.options &= ~CONSTS::OPTION_READ_VIEW;
+    return rval;
+}
+
+int DB::FindView(const std::string &key, MBData &mdata) const
+{
+    return FindView(key.data(), key.size(), mdata);
+}
+
+int DB::MultiFind(const char* const *keys, const int *lens, int num,
+                  MBData *mdata, int *rvals) const
+{
+    if(num < 0 || (num > 0 && (keys == NULL || lens == NULL || mdata == NULL || rvals == NULL)))
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    // Writer in async mode cannot be used for lookup
+    if(options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+
+    dict->MultiFind(reinterpret_cast<const uint8_t* const*>(keys), lens, num, mdata, rvals);
+    return MBError::SUCCESS;
+}
+
+int DB::MultiFind(const std::vector<std::string> &keys, MBData *mdata, int *rvals) const
+{
+    std::vector<const char*> key_ptrs(keys.size());
+    std::vector<int> lens(keys.size());
+    for(size_t i = 0; i < keys.size(); i++)
+    {
+        key_ptrs[i] = keys[i].data();
+        lens[i] = keys[i].size();
+    }
+    return MultiFind(key_ptrs.data(), lens.data(), keys.size(), mdata, rvals);
+}
+
 // Find all possible prefix matches. The caller needs to call this function
 // repeatedly if data.next is true.
 int DB::FindPrefix(const char* key, int len, MBData &data) const
@@ -347,6 +471,70 @@ int DB::FindLongestPrefix(const std::string &key, MBData &data) const
     return FindLongestPrefix(key.data(), key.size(), data);
 }
 
+int DB::FindAllPrefixes(const char* key, int len, std::vector<PrefixMatch> &matches) const
+{
+    if(key == NULL)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    // Writer in async mode cannot be used for lookup
+    if(options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+
+    return dict->FindAllPrefixes(reinterpret_cast<const uint8_t*>(key), len, matches);
+}
+
+int DB::FindAllPrefixes(const std::string &key, std::vector<PrefixMatch> &matches) const
+{
+    return FindAllPrefixes(key.data(), key.size(), matches);
+}
+
+int DB::FindFuzzy(const char* key, int len, int max_edits, int limit,
+                  std::vector<FuzzyMatch> &matches) const
+{
+    if(key == NULL)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    // Writer in async mode cannot be used for lookup
+    if(options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+
+    return dict->FindFuzzy(reinterpret_cast<const uint8_t*>(key), len, max_edits, limit,
+                           matches);
+}
+
+int DB::FindFuzzy(const std::string &key, int max_edits, int limit,
+                  std::vector<FuzzyMatch> &matches) const
+{
+    return FindFuzzy(key.data(), key.size(), max_edits, limit, matches);
+}
+
+int DB::FindMatching(const std::string &pattern, const MatchCallback &fn) const
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    // Writer in async mode cannot be used for lookup
+    if(options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+
+    GlobPattern glob;
+    int rval = glob.Compile(pattern);
+    if(rval != MBError::SUCCESS)
+        return rval;
+    return dict->FindMatching(glob, fn);
+}
+
+int DB::ReadValue(size_t data_offset, MBData &mdata) const
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    if(data_offset == 0)
+        return MBError::INVALID_ARG;
+
+    return dict->ReadValue(mdata, data_offset);
+}
+
 // Add a key-value pair
 int DB::Add(const char* key, int len, MBData &mbdata, bool overwrite)
 {
@@ -358,6 +546,9 @@ int DB::Add(const char* key, int len, MBData &mbdata, bool overwrite)
     if(async_writer != NULL)
         return async_writer->Add(key, len, reinterpret_cast<const char *>(mbdata.buff),
                                  mbdata.data_len, overwrite);
+    else if(shm_queue != NULL)
+        return shm_queue->Add(key, len, reinterpret_cast<const char *>(mbdata.buff),
+                              mbdata.data_len, overwrite);
 
     int rval;
     rval = dict->Add(reinterpret_cast<const uint8_t*>(key), len, mbdata, overwrite);
@@ -374,6 +565,8 @@ int DB::Add(const char* key, int len, const char* data, int data_len, bool overw
 
     if(async_writer != NULL)
         return async_writer->Add(key, len, data, data_len, overwrite);
+    else if(shm_queue != NULL)
+        return shm_queue->Add(key, len, data, data_len, overwrite);
 
     MBData mbdata;
     mbdata.data_len = data_len;
@@ -400,6 +593,8 @@ int DB::Remove(const char *key, int len)
 
     if(async_writer != NULL)
         return async_writer->Remove(key, len);
+    else if(shm_queue != NULL)
+        return shm_queue->Remove(key, len);
 
     int rval;
     rval = dict->Remove(reinterpret_cast<const uint8_t*>(key), len);
@@ -412,20 +607,58 @@ int DB::Remove(const std::string &key)
     return Remove(key.data(), key.size());
 }
 
-int DB::RemoveAll()
+int DB::RemovePrefix(const char *prefix, int len, uint64_t *seq)
+{
+    if(prefix == NULL || len <= 0)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    if(async_writer != NULL)
+        return async_writer->RemovePrefix(prefix, len, seq);
+    if(seq != NULL)
+        *seq = 0;
+
+    int64_t count;
+    return dict->RemovePrefix(reinterpret_cast<const uint8_t*>(prefix), len, count);
+}
+
+int DB::RemovePrefix(const std::string &prefix)
+{
+    return RemovePrefix(prefix.data(), prefix.size());
+}
+
+int DB::Write(WriteBatch &batch, uint64_t *seq)
 {
     if(status != MBError::SUCCESS)
         return MBError::NOT_INITIALIZED;
+    if(seq != NULL)
+        *seq = 0;
+    if(batch.Count() == 0)
+        return MBError::SUCCESS;
 
     if(async_writer != NULL)
-        return async_writer->RemoveAll();
+        return async_writer->Write(batch, seq);
+
+    return dict->Write(batch);
+}
+
+int DB::RemoveAll(uint64_t *seq)
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    if(async_writer != NULL)
+        return async_writer->RemoveAll(seq);
+    if(seq != NULL)
+        *seq = 0;
 
     int rval;
     rval = dict->RemoveAll();
     return rval;
 }
 
-int DB::Backup(const char *bk_dir)
+int DB::Backup(const char *bk_dir, uint64_t *seq)
 {
     if(bk_dir == NULL)
         return MBError::INVALID_ARG;
@@ -435,8 +668,10 @@ int DB::Backup(const char *bk_dir)
         return MBError::NOT_ALLOWED;
 
     if(async_writer != NULL)
-        return async_writer->Backup(bk_dir);
-        
+        return async_writer->Backup(bk_dir, seq);
+    if(seq != NULL)
+        *seq = 0;
+
     int rval;
     try {
         DBBackup bk(*this);
@@ -479,6 +714,47 @@ int DB::CollectResource(int64_t min_index_rc_size, int64_t min_data_rc_size,
     return MBError::SUCCESS;
 }
 
+int DB::MigrateIndexFormat(bool adaptive_node)
+{
+    if(status != MBError::SUCCESS)
+        return status;
+    if(!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+    // Async writer thread may be running updates at the same time.
+    if(async_writer != NULL)
+        return MBError::NOT_ALLOWED;
+
+    try {
+        ResourceCollection rc(*this);
+        rc.MigrateIndexFormat(adaptive_node ? INDEX_FORMAT_ADAPTIVE : 0);
+    } catch (int error) {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to migrate index format: %s",
+                    MBError::get_error_str(error));
+        return error;
+    }
+    return MBError::SUCCESS;
+}
+
+int DB::ParallelScan(int num_threads, const ScanCallback &fn) const
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    if(num_threads <= 0 || num_threads > SCAN_MAX_THREAD)
+        return MBError::INVALID_ARG;
+    // Writer in async mode cannot be used for lookup
+    if(options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+
+    try {
+        ParallelScanner scanner(*this, num_threads, fn);
+        return scanner.Run();
+    } catch (int error) {
+        Logger::Log(LOG_LEVEL_ERROR, "parallel scan failed: %s",
+                    MBError::get_error_str(error));
+        return error;
+    }
+}
+
 int64_t DB::Count() const
 {
     if(status != MBError::SUCCESS)
@@ -487,6 +763,30 @@ int64_t DB::Count() const
     return dict->Count();
 }
 
+int DB::CountPrefix(const char *prefix, int len, int64_t &count) const
+{
+    count = 0;
+    if(prefix == NULL)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+    // Writer in async mode cannot be used for lookup
+    if(options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+
+    if(len == 0)
+    {
+        count = dict->Count();
+        return MBError::SUCCESS;
+    }
+    return dict->CountPrefix(reinterpret_cast<const uint8_t*>(prefix), len, count);
+}
+
+int DB::CountPrefix(const std::string &prefix, int64_t &count) const
+{
+    return CountPrefix(prefix.data(), prefix.size(), count);
+}
+
 void DB::PrintStats(std::ostream &out_stream) const
 {
     if(status != MBError::SUCCESS)
@@ -614,9 +914,53 @@ bool DB::AsyncWriterBusy() const
 {
     if(async_writer != NULL)
         return async_writer->Busy();
+    if(shm_queue != NULL)
+        return shm_queue->Busy();
     return false;
 }
 
+int DB::AddAsync(const char *key, int len, const char *data, int data_len,
+                 bool overwrite, uint64_t &seq, const AsyncCallback &callback)
+{
+    if(key == NULL || data == NULL)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    if(async_writer != NULL)
+        return async_writer->Add(key, len, data, data_len, overwrite, &seq, &callback);
+    // The callback cannot be run in the writer process.
+    if(shm_queue != NULL && !callback)
+        return shm_queue->Add(key, len, data, data_len, overwrite, &seq);
+    return MBError::NOT_ALLOWED;
+}
+
+int DB::RemoveAsync(const char *key, int len, uint64_t &seq, const AsyncCallback &callback)
+{
+    if(key == NULL)
+        return MBError::INVALID_ARG;
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    if(async_writer != NULL)
+        return async_writer->Remove(key, len, &seq, &callback);
+    if(shm_queue != NULL && !callback)
+        return shm_queue->Remove(key, len, &seq);
+    return MBError::NOT_ALLOWED;
+}
+
+int DB::WaitForAsync(uint64_t seq, int timeout_ms)
+{
+    if(status != MBError::SUCCESS)
+        return MBError::NOT_INITIALIZED;
+
+    if(async_writer != NULL)
+        return async_writer->WaitForSeq(seq, timeout_ms);
+    if(shm_queue != NULL)
+        return shm_queue->WaitForSeq(seq, timeout_ms);
+    return MBError::NOT_ALLOWED;
+}
+
 void DB::SetLogFile(const std::string &log_file)
 {
     Logger::InitLogFile(log_file);
@@ -21,17 +21,21 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <functional>
 
 #include "mb_data.h"
+#include "write_batch.h"
+#include "find_cursor.h"
 #include "error.h"
 #include "lock.h"
 
 namespace mabain {
 
 class Dict;
-class MBlsq;
 class LockFree;
 class AsyncWriter;
+class ShmQueue;
 struct _DBTraverseNode;
 
 typedef struct _MBConfig
@@ -50,8 +54,60 @@ typedef struct _MBConfig
     // For automatic eviction
     // All entries in the oldest buckets will be pruned.
     int num_entry_per_bucket;
+
+    // Size of the key filter file created with CONSTS::KEY_FILTER
+    size_t key_filter_size;
+    // Size of the hash index file created with CONSTS::HASH_INDEX
+    size_t hash_index_size;
+    // Number of slots in the queue of CONSTS::ASYNC_WRITER_MODE. It must
+    // be a power of 2 greater than 1. The default is 2048.
+    int async_queue_size;
 } MBConfig;
 
+// Entry of the DB iterator. A node entry has a negative data_len. Keys and
+// values are kept in the arena of the iterator.
+typedef struct _IteratorEntry
+{
+    size_t   key_off;
+    size_t   value_off;
+    // Arena size after the entries loaded together with this entry
+    size_t   arena_end;
+    size_t   data_offset;
+    int      key_len;
+    int      data_len;
+    uint16_t bucket_index;
+} IteratorEntry;
+
+// A prefix of the key found by DB::FindAllPrefixes
+typedef struct _PrefixMatch
+{
+    // length of the prefix
+    int match_len;
+    std::string value;
+} PrefixMatch;
+
+// A key found by DB::FindFuzzy
+typedef struct _FuzzyMatch
+{
+    std::string key;
+    std::string value;
+    // edit distance to the search key
+    int distance;
+} FuzzyMatch;
+
+// Callback of DB::ParallelScan. It is called concurrently by the worker
+// threads. worker is the index of the calling thread. Returning false stops
+// the scan.
+typedef std::function<bool(int worker, const std::string &key, const MBData &value)>
+        ScanCallback;
+
+// Callback of DB::FindMatching. Returning false stops the search.
+typedef std::function<bool(const std::string &key, const MBData &value)> MatchCallback;
+
+// Callback of DB::AddAsync and DB::RemoveAsync. It is called by the async
+// writer thread with the sequence number and the result of the task.
+typedef std::function<void(uint64_t seq, int rval)> AsyncCallback;
+
 // Database handle class
 class DB
 {
@@ -60,6 +116,7 @@ public:
     class iterator
     {
     friend class DBTraverseBase;
+    friend class ParallelScanner;
 
     public:
         std::string key;
@@ -70,6 +127,8 @@ public:
         // Copy constructor
         iterator(const iterator &rhs);
         void init(bool check_async_mode = true);
+        // Initialize the iterator for the keys starting with the prefix
+        void init_prefix(const std::string &prefix);
         int init_no_next();
         ~iterator();
 
@@ -77,24 +136,76 @@ public:
         bool operator!=(const iterator &rhs);
         const iterator& operator++();
 
+        // Ordered iteration. The edges of each node are sorted while
+        // traversing, so the keys are returned in lexicographical order.
+        // Keys are limited to [lower_bound, upper_bound) if the bounds are
+        // not empty. These functions return SUCCESS if the iterator is
+        // positioned at a key and NOT_EXIST otherwise.
+        void SetRange(const std::string &lower, const std::string &upper);
+        // Move to the first key not less than the key
+        int  Seek(const std::string &key);
+        // Move to the last key not greater than the key
+        int  SeekForPrev(const std::string &key);
+        // Move to the first key greater than the key
+        int  SeekAfter(const std::string &key);
+        int  SeekToFirst();
+        int  SeekToLast();
+        int  Next();
+        int  Prev();
+
+        // Continuation token of the current position. Iteration can be
+        // resumed from the token by another iterator of the same DB after
+        // the current key. Returns NOT_EXIST if the iteration is done.
+        int  GetToken(std::string &token) const;
+        int  Resume(const std::string &token);
+
     private:
         int  get_node_offset(const std::string &node_key, size_t &parent_edge_off,
                  size_t &node_offset);
         int  load_node(const std::string &curr_node_key, size_t &parent_edge_off);
         int  load_kv_for_node(const std::string &curr_node_key);
-        int  load_kvs(const std::string &curr_node_key, MBlsq *chid_node_list);
+        int  load_kvs(const std::string &curr_node_key);
+        void add_entry(std::string &arena, std::vector<IteratorEntry> &entries,
+                       const std::string &key_prefix, const std::string &key_suffix,
+                       const MBData *data);
+        void init_node(const std::string &node_key);
+        void pop_node();
+        void set_key_value(const std::string &arena, const IteratorEntry &entry);
         void iter_obj_init();
         bool next_dbt_buffer(struct _DBTraverseNode *dbt_n);
         void add_node_offset(size_t node_offset);
         iterator* next();
+        iterator* next_ordered();
+        void reset_ordered(int iter_order);
+        int  compare_top(const std::string &seek_key) const;
+        bool is_top_prefix(const std::string &seek_key) const;
+        int  expand_top();
+        bool in_range() const;
+        int  resume_ordered(int iter_order, const std::string &last_key);
 
         const DB &db_ref;
         int state;
+        int order;
+        std::string lower_bound;
+        std::string upper_bound;
         EdgePtrs edge_ptrs;
         // temp buffer to hold the node
         uint8_t node_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
-        MBlsq *node_stack;
-        MBlsq *kv_per_node;
+        // Nodes to visit. In ordered mode, keys are kept on the stack too.
+        std::vector<IteratorEntry> node_stack;
+        std::string node_arena;
+        // Keys of the current node
+        std::vector<IteratorEntry> kv_per_node;
+        std::string kv_arena;
+        size_t kv_index;
+        // Size of the node stack before the children of the current node
+        // were added
+        size_t stack_base;
+        // Entries read from the current node
+        std::vector<IteratorEntry> child_list;
+        std::string node_key;
+        // Node offsets for DBTraverseBase
+        std::vector<size_t> node_offsets;
         LockFree *lfree;
     };
 
@@ -116,18 +227,62 @@ public:
     // Find an entry by exact match using a key
     int Find(const char* key, int len, MBData &mdata) const;
     int Find(const std::string &key, MBData &mdata) const;
+    // Find an entry by exact match, continuing from the path of the previous
+    // lookup of the cursor. This is faster for sorted or clustered keys.
+    int Find(const char* key, int len, MBData &mdata, FindCursor &cursor) const;
+    int Find(const std::string &key, MBData &mdata, FindCursor &cursor) const;
+    // Find an entry by exact match without copying the value if possible.
+    // On success, mdata.view points to the value of mdata.data_len bytes.
+    // The view is only valid until the writer reuses the data buffer; the
+    // caller should consume it right away.
+    int FindView(const char* key, int len, MBData &mdata) const;
+    int FindView(const std::string &key, MBData &mdata) const;
+    // Find a batch of keys by exact match. Lookups of different keys are
+    // interleaved so that their memory accesses overlap. The result of keys[i]
+    // is returned in rvals[i] and mdata[i]; mdata can be reused across calls.
+    int MultiFind(const char* const *keys, const int *lens, int num,
+                  MBData *mdata, int *rvals) const;
+    int MultiFind(const std::vector<std::string> &keys, MBData *mdata, int *rvals) const;
     // Find all possible prefix matches using a key
-    // This is not fully implemented yet.
+    // The caller needs to call this function repeatedly if data.next is true.
+    // FindAllPrefixes is faster.
     int FindPrefix(const char* key, int len, MBData &data) const;
     // Find the longest prefix match using a key
     int FindLongestPrefix(const char* key, int len, MBData &data) const;
     int FindLongestPrefix(const std::string &key, MBData &data) const;
+    // Find all prefix matches of a key in one pass. The matches are ordered
+    // by the prefix length.
+    int FindAllPrefixes(const char* key, int len, std::vector<PrefixMatch> &matches) const;
+    int FindAllPrefixes(const std::string &key, std::vector<PrefixMatch> &matches) const;
+    // Find the keys within max_edits insertions, deletions or substitutions
+    // of the key. At most limit matches are returned, ordered by the edit
+    // distance and then by the key.
+    int FindFuzzy(const char* key, int len, int max_edits, int limit,
+                  std::vector<FuzzyMatch> &matches) const;
+    int FindFuzzy(const std::string &key, int max_edits, int limit,
+                  std::vector<FuzzyMatch> &matches) const;
+    // Call fn for every key matching the glob pattern. See GlobPattern for
+    // the syntax. The keys are not in any order.
+    int FindMatching(const std::string &pattern, const MatchCallback &fn) const;
+    // Read the value at data_offset returned by a key-only iterator. The
+    // result is undefined if the key has been updated or removed since then.
+    int ReadValue(size_t data_offset, MBData &mdata) const;
     // Remove an entry using a key
     int Remove(const char *key, int len);
     int Remove(const std::string &key);
-    int RemoveAll();
+    // For RemoveAll, RemovePrefix, Write and Backup, seq is set to the
+    // sequence number of the task if not NULL and the call is queued to
+    // the async writer (see WaitForAsync). It is set to 0 otherwise.
+    int RemoveAll(uint64_t *seq = NULL);
+    // Remove all entries starting with the prefix. The subtree of the
+    // prefix is unlinked at once instead of removing the keys one by one.
+    int RemovePrefix(const char *prefix, int len, uint64_t *seq = NULL);
+    int RemovePrefix(const std::string &prefix);
+    // Apply the adds and removes in the batch. The entries are sorted by
+    // key. With the async writer, the batch is copied and applied later.
+    int Write(WriteBatch &batch, uint64_t *seq = NULL);
     // DB Backup
-    int Backup(const char *backup_dir);
+    int Backup(const char *backup_dir, uint64_t *seq = NULL);
 
     // Close the DB handle
     int  Close();
@@ -143,6 +298,9 @@ public:
     // less than 0xFFFFFFFFFFFF.
     int CollectResource(int64_t min_index_rc_size = 33554432 , int64_t min_data_rc_size = 33554432,
                         int64_t max_dbsiz = 0xFFFFFFFFFFFF, int64_t max_dbcnt = 0xFFFFFFFFFFFF);
+    // Convert an existing DB to or from the adaptive node index format
+    // (see CONSTS::ADAPTIVE_NODE_FORMAT). Writer only.
+    int MigrateIndexFormat(bool adaptive_node);
 
     // Multi-thread update using async thread
     // FOR THIS TO WORK, WRITER MUST BE THE LAST ONE TO CLOSE HANDLE.
@@ -150,6 +308,18 @@ public:
     int  UnsetAsyncWriterPtr(DB *db_writer);
     bool AsyncWriterEnabled() const;
     bool AsyncWriterBusy() const;
+    // Add or remove through the async writer or the shared async queue.
+    // seq is set to the sequence number of the task. Sequence numbers
+    // increase in the order the tasks are run. Callbacks are not allowed
+    // with the shared queue.
+    int  AddAsync(const char *key, int len, const char *data, int data_len,
+                  bool overwrite, uint64_t &seq,
+                  const AsyncCallback &callback = AsyncCallback());
+    int  RemoveAsync(const char *key, int len, uint64_t &seq,
+                     const AsyncCallback &callback = AsyncCallback());
+    // Wait until the async task with the sequence number is run. Returns
+    // MBError::TRY_AGAIN on timeout. A negative timeout waits forever.
+    int  WaitForAsync(uint64_t seq, int timeout_ms = -1);
 
     // multi-thread or multi-process locking for DB management
     int WrLock();
@@ -174,6 +344,9 @@ public:
     void PrintHeader(std::ostream &out_stream = std::cout) const;
     // current count of key-value pair
     int64_t Count() const;
+    // Count the keys starting with the prefix. Values are not read.
+    int CountPrefix(const char *prefix, int len, int64_t &count) const;
+    int CountPrefix(const std::string &prefix, int64_t &count) const;
     // DB status
     int Status() const;
     // DB status string
@@ -188,11 +361,30 @@ public:
     void GetDBConfig(MBConfig &config) const;
 
     //iterator
-    const iterator begin(bool check_async_mode = true, bool rc_mode = false) const;
+    // read_options can be CONSTS::OPTION_KEY_ONLY or CONSTS::OPTION_READ_HEADER
+    // to skip reading values. The value can be read later by ReadValue using
+    // iter.value.data_offset. Keys with empty values are only skipped if
+    // values are read.
+    const iterator begin(bool check_async_mode = true, bool rc_mode = false,
+                         int read_options = 0) const;
     const iterator end() const;
+    // Iterate only the keys starting with the prefix
+    const iterator begin_prefix(const std::string &prefix, int read_options = 0) const;
+    // Call fn for every key-value pair using num_threads threads. The keys
+    // are not in any order.
+    int ParallelScan(int num_threads, const ScanCallback &fn) const;
+    // Iterate the keys in [lower, upper) in lexicographical order. An empty
+    // bound is not checked.
+    const iterator begin_range(const std::string &lower, const std::string &upper,
+                               int read_options = 0) const;
+    // Iterate the keys greater than the key in lexicographical order
+    const iterator begin_after(const std::string &key, int read_options = 0) const;
+    // Resume the iteration from a token returned by iterator::GetToken
+    const iterator begin_token(const std::string &token, int read_options = 0) const;
 
 private:
     void InitDB(MBConfig &config);
+    int  OpenShmQueue(const MBConfig &config);
     static int ValidateConfig(MBConfig &config);
 
     // DB directory
@@ -209,6 +401,8 @@ private:
     MBConfig dbConfig;
 
     AsyncWriter *async_writer;
+    // Async queue shared with other processes
+    ShmQueue *shm_queue;
 };
 
 }
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <iostream>
 #include <errno.h>
+#include <algorithm>
 
 #include "mabain_consts.h"
 #include "db.h"
@@ -47,9 +48,12 @@ Dict::Dict(const std::string &mbdir, bool init_header, int datasize,
            int db_options, size_t memsize_index, size_t memsize_data,
            uint32_t block_sz_idx, uint32_t block_sz_data,
            int max_num_index_blk, int max_num_data_blk,
-           int64_t entry_per_bucket)
+           int64_t entry_per_bucket, size_t key_filter_size, size_t hash_index_size)
          : options(db_options),
-           mm(mbdir, init_header, memsize_index, db_options, block_sz_idx, max_num_index_blk)
+           mm(mbdir, init_header, memsize_index, db_options, block_sz_idx, max_num_index_blk),
+           hot_cache(NULL),
+           key_filter(NULL),
+           hash_index(NULL)
 {
     status = MBError::NOT_INITIALIZED;
 
@@ -75,9 +79,29 @@ Dict::Dict(const std::string &mbdir, bool init_header, int datasize,
         header->data_block_size = block_sz_data;
     }
 
+    // Writer always maintains the key filter if it exists.
+    key_filter = new KeyFilter(mbdir, db_options, key_filter_size);
+    if(!key_filter->IsValid())
+    {
+        delete key_filter;
+        key_filter = NULL;
+    }
+
     lfree.LockFreeInit(&header->lock_free, db_options);
     mm.InitLockFreePtr(&lfree);
 
+    // Writer always maintains the hash index if it exists.
+    hash_index = new HashIndex(mbdir, db_options, hash_index_size, &lfree);
+    if(!hash_index->IsValid())
+    {
+        delete hash_index;
+        hash_index = NULL;
+    }
+#ifdef __LOCK_FREE__
+    if((db_options & CONSTS::HOT_NODE_CACHE) && !(db_options & CONSTS::ACCESS_MODE_WRITER))
+        hot_cache = new HotNodeCache(&mm, &lfree);
+#endif
+
     // Open data file
     kv_file = new RollableFile(mbdir + "_mabain_d",
                                static_cast<size_t>(header->data_block_size),
@@ -183,6 +207,24 @@ void Dict::Destroy()
 
     mm.Destroy();
 
+    if(hot_cache != NULL)
+    {
+        delete hot_cache;
+        hot_cache = NULL;
+    }
+
+    if(key_filter != NULL)
+    {
+        delete key_filter;
+        key_filter = NULL;
+    }
+
+    if(hash_index != NULL)
+    {
+        delete hash_index;
+        hash_index = NULL;
+    }
+
     if(free_lists != NULL)
         delete free_lists;
 
@@ -205,15 +247,79 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
     if(len > CONSTS::MAX_KEY_LENGHTH || data.data_len > CONSTS::MAX_DATA_SIZE)
         return MBError::OUT_OF_BOUND;
 
+    bool inc_count;
+    size_t data_offset;
+    if(key_filter == NULL && hash_index == NULL)
+        return AddKey(key, len, data, overwrite, inc_count, data_offset);
+
+    // The key must be in the filter before readers can find it in the index.
+    if(key_filter != NULL)
+        key_filter->Add(key, len);
+    // Resource collection rebuilds the hash index after it is done.
+    bool update_hash = (hash_index != NULL && !(data.options & CONSTS::OPTION_RC_MODE));
+    // The old data buffer may be released by AddKey.
+    if(update_hash && overwrite)
+        hash_index->MarkPending(key, len);
+
+    int rval = AddKey(key, len, data, overwrite, inc_count, data_offset);
+    if(key_filter != NULL && (rval != MBError::SUCCESS || !inc_count))
+        key_filter->Remove(key, len);
+    if(update_hash)
+    {
+        if(rval == MBError::SUCCESS)
+            hash_index->Add(key, len, data_offset);
+        else if(overwrite)
+            hash_index->ClearPending(key, len);
+    }
+    return rval;
+}
+
+// inc_count is set to false if the key is already in DB.
+// data_offset is set to the offset of the new data buffer.
+int Dict::AddKey(const uint8_t *key, int len, MBData &data, bool overwrite, bool &inc_count,
+                 size_t &data_offset)
+{
     EdgePtrs edge_ptrs;
-    size_t data_offset = 0;
     int rval;
 
-    rval = mm.GetRootEdge_Writer(data.options & CONSTS::OPTION_RC_MODE, key[0], edge_ptrs);
-    if(rval != MBError::SUCCESS)
-        return rval;
+    data_offset = 0;
 
-    if(edge_ptrs.len_ptr[0] == 0)
+    inc_count = true;
+
+    // Sorted keys share long prefixes with the previous key. Continue from
+    // the deepest edge of the previous path on the common prefix if the trie
+    // has not been changed since.
+    int resume_depth = 0;
+#ifdef __LOCK_FREE__
+    if(!(data.options & CONSTS::OPTION_RC_MODE))
+    {
+        LockFreeData snapshot;
+        lfree.ReaderLockFreeStart(snapshot);
+        if(add_cursor.counter == snapshot.counter)
+            resume_depth = add_cursor.GetResumeDepth(key, len);
+    }
+#endif
+    // The key of the path is set again after the update is done.
+    add_cursor.key.clear();
+    add_cursor.depth = resume_depth;
+    if(resume_depth > 0)
+    {
+        rval = mm.GetEdge_Writer(add_cursor.edge_off[resume_depth-1], edge_ptrs);
+        if(rval != MBError::SUCCESS)
+            return rval;
+        add_cursor.num_resume++;
+        int match = add_cursor.match_len[resume_depth-1];
+        rval = AddNextEdges(edge_ptrs, key + match, len - match, data, overwrite,
+                            inc_count, data_offset);
+    }
+    else
+    {
+        rval = mm.GetRootEdge_Writer(data.options & CONSTS::OPTION_RC_MODE, key[0], edge_ptrs);
+        if(rval != MBError::SUCCESS)
+            return rval;
+    }
+
+    if(resume_depth == 0 && edge_ptrs.len_ptr[0] == 0)
     {
         ReserveData(data.buff, data.data_len, data_offset);
         // Add the first edge along this edge
@@ -231,24 +337,20 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
         return MBError::SUCCESS;
     }
 
-    bool inc_count = true;
     int i;
     const uint8_t *key_buff;
     uint8_t tmp_key_buff[NUM_ALPHABET];
     const uint8_t *p = key;
     int edge_len = edge_ptrs.len_ptr[0];
-    if(edge_len > LOCAL_EDGE_LEN)
-    {
-        if(mm.ReadData(tmp_key_buff, edge_len-1, Get5BInteger(edge_ptrs.ptr)) != edge_len-1)
-            return MBError::READ_ERROR;
-        key_buff = tmp_key_buff;
-    }
-    else
+    if(resume_depth > 0)
     {
-        key_buff = edge_ptrs.ptr;
+        // Already added from the previous path
     }
-    if(edge_len < len)
+    else if(edge_len < len)
     {
+        key_buff = mm.GetEdgeLabel(edge_ptrs.ptr, tmp_key_buff);
+        if(key_buff == NULL)
+            return MBError::READ_ERROR;
         for(i = 1; i < edge_len; i++)
         {
             if(key_buff[i-1] != key[i])
@@ -256,43 +358,9 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
         }
         if(i >= edge_len)
         {
-            int match_len;
-            bool next;
-            p += edge_len;
-            len -= edge_len;
-            while((next = mm.FindNext(p, len, match_len, edge_ptrs, tmp_key_buff)))
-            {
-                if(match_len < edge_ptrs.len_ptr[0])
-                    break;
-
-                p += match_len;
-                len -= match_len;
-                if(len <= 0)
-                    break;
-            }
-            if(!next)
-            {
-                ReserveData(data.buff, data.data_len, data_offset);
-                rval = mm.UpdateNode(edge_ptrs, p, len, data_offset);
-            }
-            else if(match_len < static_cast<int>(edge_ptrs.len_ptr[0]))
-            {
-                if(len > match_len)
-                {
-                    ReserveData(data.buff, data.data_len, data_offset);
-                    rval = mm.AddLink(edge_ptrs, match_len, p+match_len, len-match_len,
-                                      data_offset, data);
-                }
-                else if(len == match_len)
-                {
-                    ReserveData(data.buff, data.data_len, data_offset);
-                    rval = mm.InsertNode(edge_ptrs, match_len, data_offset, data);
-                }
-            }
-            else if(len == 0)
-            {
-                rval = UpdateDataBuffer(edge_ptrs, overwrite, data.buff, data.data_len, inc_count);
-            }
+            add_cursor.AddEdge(edge_ptrs.offset, edge_len);
+            rval = AddNextEdges(edge_ptrs, p + edge_len, len - edge_len, data, overwrite,
+                                inc_count, data_offset);
         }
         else
         {
@@ -302,6 +370,9 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
     }
     else
     {
+        key_buff = mm.GetEdgeLabel(edge_ptrs.ptr, tmp_key_buff);
+        if(key_buff == NULL)
+            return MBError::READ_ERROR;
         for(i = 1; i < len; i++)
         {
             if(key_buff[i-1] != key[i])
@@ -321,7 +392,8 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
             }
             else
             {
-                rval = UpdateDataBuffer(edge_ptrs, overwrite, data.buff, data.data_len, inc_count);
+                rval = UpdateDataBuffer(edge_ptrs, overwrite, data.buff, data.data_len, inc_count,
+                                        data_offset);
             }
         }
     }
@@ -338,6 +410,69 @@ int Dict::Add(const uint8_t *key, int len, MBData &data, bool overwrite)
         if(inc_count)
             header->count++;
     }
+
+#ifdef __LOCK_FREE__
+    // Edges on the path are not moved by the update. The path is valid until
+    // the trie is modified by anything else.
+    if(rval == MBError::SUCCESS || rval == MBError::IN_DICT)
+    {
+        LockFreeData snapshot;
+        lfree.ReaderLockFreeStart(snapshot);
+        add_cursor.counter = snapshot.counter;
+        add_cursor.SetKey(key);
+    }
+#endif
+    return rval;
+}
+
+// Add the rest of the key below edge_ptrs, which is fully matched.
+int Dict::AddNextEdges(EdgePtrs &edge_ptrs, const uint8_t *key, int len, MBData &data,
+                       bool overwrite, bool &inc_count, size_t &data_offset)
+{
+    if(len == 0)
+        return UpdateDataBuffer(edge_ptrs, overwrite, data.buff, data.data_len, inc_count,
+                                data_offset);
+
+    uint8_t tmp_key_buff[NUM_ALPHABET];
+    const uint8_t *p = key;
+    int rval = MBError::SUCCESS;
+    int match_len;
+    bool next;
+    while((next = mm.FindNext(p, len, match_len, edge_ptrs, tmp_key_buff)))
+    {
+        if(match_len < edge_ptrs.len_ptr[0])
+            break;
+
+        add_cursor.AddEdge(edge_ptrs.offset, match_len);
+        p += match_len;
+        len -= match_len;
+        if(len <= 0)
+            break;
+    }
+    if(!next)
+    {
+        ReserveData(data.buff, data.data_len, data_offset);
+        rval = mm.UpdateNode(edge_ptrs, p, len, data_offset);
+    }
+    else if(match_len < static_cast<int>(edge_ptrs.len_ptr[0]))
+    {
+        if(len > match_len)
+        {
+            ReserveData(data.buff, data.data_len, data_offset);
+            rval = mm.AddLink(edge_ptrs, match_len, p+match_len, len-match_len,
+                              data_offset, data);
+        }
+        else if(len == match_len)
+        {
+            ReserveData(data.buff, data.data_len, data_offset);
+            rval = mm.InsertNode(edge_ptrs, match_len, data_offset, data);
+        }
+    }
+    else if(len == 0)
+    {
+        rval = UpdateDataBuffer(edge_ptrs, overwrite, data.buff, data.data_len, inc_count,
+                                data_offset);
+    }
     return rval;
 }
 
@@ -351,32 +486,15 @@ int Dict::ReadDataFromEdge(MBData &data, const EdgePtrs &edge_ptrs) const
     else
     {
         uint8_t node_buff[NODE_EDGE_KEY_FIRST];
-        if(mm.ReadData(node_buff, NODE_EDGE_KEY_FIRST, Get6BInteger(edge_ptrs.offset_ptr))
-                      != NODE_EDGE_KEY_FIRST)
+        const uint8_t *node_hdr = mm.ReadPtr(node_buff, NODE_EDGE_KEY_FIRST,
+                                             Get6BInteger(edge_ptrs.offset_ptr));
+        if(node_hdr == NULL)
             return MBError::READ_ERROR;
-        if(!(node_buff[0] & FLAG_NODE_MATCH))
+        if(!(node_hdr[0] & FLAG_NODE_MATCH))
             return MBError::NOT_EXIST;
-        data_off = Get6BInteger(node_buff+2);
-    }
-    data.data_offset = data_off;
-
-    uint16_t data_len[2];
-    // Read data length first
-    if(ReadData(reinterpret_cast<uint8_t*>(&data_len[0]), DATA_HDR_BYTE, data_off)
-               != DATA_HDR_BYTE)
-        return MBError::READ_ERROR;
-    data_off += DATA_HDR_BYTE;
-    if(data.buff_len < data_len[0] + 1)
-    {
-        if(data.Resize(data_len[0]) != MBError::SUCCESS)
-            return MBError::NO_MEMORY;
+        data_off = Get6BInteger(node_hdr+2);
     }
-    if(ReadData(data.buff, data_len[0], data_off) != data_len[0])
-        return MBError::READ_ERROR;
-
-    data.data_len = data_len[0];
-    data.bucket_index = data_len[1];
-    return MBError::SUCCESS;
+    return ReadDataBuffer(data, data_off);
 }
 
 // Delete operations:
@@ -443,15 +561,49 @@ int Dict::ReadDataFromNode(MBData &data, const uint8_t *node_ptr) const
     if(data_off == 0)
         return MBError::NOT_EXIST;
 
+    return ReadDataBuffer(data, data_off);
+}
+
+// Read the data block at data_off. If OPTION_READ_VIEW is set and the block
+// is in a mapped region, data.view is pointed to the shared memory directly
+// without copying. The caller still validates the lock-free snapshot after
+// this call returns. Otherwise the value is copied to data.buff.
+int Dict::ReadDataBuffer(MBData &data, size_t data_off) const
+{
     data.data_offset = data_off;
+    if(data.options & CONSTS::OPTION_KEY_ONLY)
+    {
+        data.data_len = 0;
+        return MBError::SUCCESS;
+    }
 
-    // Read data length first
     uint16_t data_len[2];
-    if(ReadData(reinterpret_cast<uint8_t *>(&data_len[0]), DATA_HDR_BYTE, data_off)
+    if(data.options & CONSTS::OPTION_READ_VIEW)
+    {
+        // Data blocks never cross block boundaries, so the whole value is
+        // mapped if its header is mapped.
+        const uint8_t *ptr = GetMappedPtr(data_off);
+        if(ptr != NULL)
+        {
+            memcpy(&data_len[0], ptr, DATA_HDR_BYTE);
+            data.view = ptr + DATA_HDR_BYTE;
+            data.data_len = data_len[0];
+            data.bucket_index = data_len[1];
+            return MBError::SUCCESS;
+        }
+    }
+
+    // Read data length first
+    if(ReadData(reinterpret_cast<uint8_t*>(&data_len[0]), DATA_HDR_BYTE, data_off)
                != DATA_HDR_BYTE)
         return MBError::READ_ERROR;
+    if(data.options & CONSTS::OPTION_READ_HEADER)
+    {
+        data.data_len = data_len[0];
+        data.bucket_index = data_len[1];
+        return MBError::SUCCESS;
+    }
     data_off += DATA_HDR_BYTE;
-
     if(data.buff_len < data_len[0] + 1)
     {
         if(data.Resize(data_len[0]) != MBError::SUCCESS)
@@ -462,6 +614,7 @@ int Dict::ReadDataFromNode(MBData &data, const uint8_t *node_ptr) const
 
     data.data_len = data_len[0];
     data.bucket_index = data_len[1];
+    data.view = data.buff;
     return MBError::SUCCESS;
 }
 
@@ -535,21 +688,13 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBDa
     const uint8_t *p = key;
     int edge_len = edge_ptrs.len_ptr[0];
     int edge_len_m1 = edge_len - 1;
-    if(edge_len > LOCAL_EDGE_LEN)
+    key_buff = mm.GetEdgeLabel(edge_ptrs.ptr, node_buff);
+    if(key_buff == NULL)
     {
-        if(mm.ReadData(node_buff, edge_len_m1, Get5BInteger(edge_ptrs.ptr))
-                      != edge_len_m1)
-        {
 #ifdef __LOCK_FREE__
-            READER_LOCK_FREE_STOP(edge_ptrs.offset)
+        READER_LOCK_FREE_STOP(edge_ptrs.offset)
 #endif
-            return MBError::READ_ERROR;
-        }
-        key_buff = node_buff;
-    }
-    else
-    {
-        key_buff = edge_ptrs.ptr;
+        return MBError::READ_ERROR;
     }
 
     rval = MBError::NOT_EXIST;
@@ -613,19 +758,11 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBDa
             edge_len = edge_ptrs.len_ptr[0];
             edge_len_m1 = edge_len - 1;
             // match edge string
-            if(edge_len > LOCAL_EDGE_LEN)
-            {
-                if(mm.ReadData(node_buff, edge_len_m1, Get5BInteger(edge_ptrs.ptr))
-                              != edge_len_m1)
-                {
-                    rval = MBError::READ_ERROR;
-                    break;
-                }
-                key_buff = node_buff;
-            }
-            else
+            key_buff = mm.GetEdgeLabel(edge_ptrs.ptr, node_buff);
+            if(key_buff == NULL)
             {
-                key_buff = edge_ptrs.ptr;
+                rval = MBError::READ_ERROR;
+                break;
             }
 
             if((edge_len > 1 && memcmp(key_buff, p+1, edge_len_m1) != 0) || edge_len == 0)
@@ -665,163 +802,881 @@ int Dict::FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBDa
     return rval;
 }
 
-int Dict::Find(const uint8_t *key, int len, MBData &data)
+static bool PrefixMatchLess(const PrefixMatch &a, const PrefixMatch &b)
+{
+    return a.match_len < b.match_len;
+}
+
+static bool PrefixMatchEqual(const PrefixMatch &a, const PrefixMatch &b)
+{
+    return a.match_len == b.match_len;
+}
+
+int Dict::FindAllPrefixes(const uint8_t *key, int len, std::vector<PrefixMatch> &matches)
 {
     int rval;
+    matches.clear();
+    if(len <= 0)
+        return MBError::NOT_EXIST;
     size_t rc_root_offset = header->rc_root_offset.load(MEMORY_ORDER_READER);
     if(rc_root_offset != 0)
     {
-        rval = Find_Internal(rc_root_offset, key, len, data);
+        rval = FindAllPrefixes_Internal(rc_root_offset, key, len, matches);
 #ifdef __LOCK_FREE__
         while(rval == MBError::TRY_AGAIN)
         {
             nanosleep((const struct timespec[]){{0, 10L}}, NULL);
-            rval = Find_Internal(rc_root_offset, key, len, data);
+            matches.clear();
+            rval = FindAllPrefixes_Internal(rc_root_offset, key, len, matches);
         }
 #endif
-        if(rval == MBError::SUCCESS)
-        {
-            data.match_len = len;
-            return rval;
-        }
-        else if(rval != MBError::NOT_EXIST)
+        if(rval != MBError::SUCCESS)
             return rval;
-        data.options &= ~CONSTS::OPTION_RC_MODE;
     }
 
-    rval = Find_Internal(0, key, len, data);
+    size_t num_rc = matches.size();
+    rval = FindAllPrefixes_Internal(0, key, len, matches);
 #ifdef __LOCK_FREE__
     while(rval == MBError::TRY_AGAIN)
     {
         nanosleep((const struct timespec[]){{0, 10L}}, NULL);
-        rval = Find_Internal(0, key, len, data);
+        matches.resize(num_rc);
+        rval = FindAllPrefixes_Internal(0, key, len, matches);
     }
 #endif
-    if(rval == MBError::SUCCESS)
-        data.match_len = len;
+    if(rval != MBError::SUCCESS)
+        return rval;
 
-    return rval;
+    if(num_rc > 0)
+    {
+        // Prefixes found in the rc tree are newer.
+        std::stable_sort(matches.begin(), matches.end(), PrefixMatchLess);
+        matches.erase(std::unique(matches.begin(), matches.end(), PrefixMatchEqual),
+                      matches.end());
+    }
+    if(matches.empty())
+        return MBError::NOT_EXIST;
+    return MBError::SUCCESS;
 }
 
-int Dict::Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &data)
+// Walk the trie once along the key and append every prefix with data to
+// matches. The node header and data of each prefix are checked against the
+// edge pointing to the node.
+int Dict::FindAllPrefixes_Internal(size_t root_off, const uint8_t *key, int len,
+                                   std::vector<PrefixMatch> &matches)
 {
-    EdgePtrs &edge_ptrs = data.edge_ptrs;
+    EdgePtrs edge_ptrs;
+    uint8_t node_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
 #ifdef __LOCK_FREE__
     READER_LOCK_FREE_START
 #endif
-    int rval;
-    rval = mm.GetRootEdge(root_off, key[0], edge_ptrs);
 
+    int rval = mm.GetRootEdge(root_off, key[0], edge_ptrs);
     if(rval != MBError::SUCCESS)
         return MBError::READ_ERROR;
-    if(edge_ptrs.len_ptr[0] == 0)
-    {
-#ifdef __LOCK_FREE__
-        READER_LOCK_FREE_STOP(edge_ptrs.offset)
-#endif
-        return MBError::NOT_EXIST;
-    }
 
-    // Compare edge string
     const uint8_t *key_buff;
-    uint8_t *node_buff = data.node_buff;
     const uint8_t *p = key;
-    int edge_len = edge_ptrs.len_ptr[0];
-    int edge_len_m1 = edge_len - 1;
-
-    rval = MBError::NOT_EXIST;
-    if(edge_len > LOCAL_EDGE_LEN)
+    int edge_len;
+    int read_rval;
+    while(true)
     {
-        size_t edge_str_off_lf = Get5BInteger(edge_ptrs.ptr);
-        if(mm.ReadData(node_buff, edge_len_m1, edge_str_off_lf) != edge_len_m1)
+        edge_len = edge_ptrs.len_ptr[0];
+        if(edge_len == 0 || edge_len > len)
+            break;
+        key_buff = mm.GetEdgeLabel(edge_ptrs.ptr, node_buff);
+        if(key_buff == NULL)
         {
-#ifdef __LOCK_FREE__
-            READER_LOCK_FREE_STOP(edge_ptrs.offset)
-#endif
-            return MBError::READ_ERROR;
+            rval = MBError::READ_ERROR;
+            break;
         }
-        key_buff = node_buff;
-    }
-    else
-    {
-        key_buff = edge_ptrs.ptr;
-    }
+        if(edge_len > 1 && memcmp(key_buff, p+1, edge_len-1) != 0)
+            break;
 
-    if(edge_len < len)
-    {
-        if((edge_len > 1 && memcmp(key_buff, key+1, edge_len_m1) != 0) ||
-           (edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF))
+        p += edge_len;
+        len -= edge_len;
+        if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
         {
-#ifdef __LOCK_FREE__
-            READER_LOCK_FREE_STOP(edge_ptrs.offset)
-#endif
-            return MBError::NOT_EXIST;
+            matches.push_back(PrefixMatch());
+            matches.back().match_len = p - key;
+            rval = ReadDataBuffer(matches.back().value, Get6BInteger(edge_ptrs.offset_ptr));
+            break;
         }
 
-        len -= edge_len;
-        p += edge_len;
+        if(len == 0)
+        {
+            const uint8_t *node_hdr = mm.ReadPtr(node_buff, NODE_EDGE_KEY_FIRST,
+                                                 Get6BInteger(edge_ptrs.offset_ptr));
+            if(node_hdr == NULL)
+            {
+                rval = MBError::READ_ERROR;
+            }
+            else if(node_hdr[0] & FLAG_NODE_MATCH)
+            {
+                matches.push_back(PrefixMatch());
+                matches.back().match_len = p - key;
+                rval = ReadDataBuffer(matches.back().value, Get6BInteger(node_hdr+2));
+            }
+            break;
+        }
 
 #ifdef __LOCK_FREE__
         size_t edge_offset_prev = edge_ptrs.offset;
 #endif
-        while(true)
+        rval = mm.NextEdge(p, edge_ptrs, node_buff);
+        if(rval == MBError::READ_ERROR)
+            break;
+        read_rval = MBError::SUCCESS;
+        if(node_buff[0] & FLAG_NODE_MATCH)
         {
-            rval = mm.NextEdge(p, edge_ptrs, node_buff, data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT);
-            if(rval != MBError::SUCCESS)
-                break;
+            matches.push_back(PrefixMatch());
+            matches.back().match_len = p - key;
+            read_rval = ReadDataBuffer(matches.back().value, Get6BInteger(node_buff+2));
+        }
+#ifdef __LOCK_FREE__
+        READER_LOCK_FREE_STOP(edge_offset_prev)
+#endif
+        if(read_rval != MBError::SUCCESS)
+        {
+            rval = read_rval;
+            break;
+        }
+        if(rval != MBError::SUCCESS)
+        {
+            // No child edge for the rest of the key
+            rval = MBError::SUCCESS;
+            break;
+        }
+    }
 
 #ifdef __LOCK_FREE__
-            READER_LOCK_FREE_STOP(edge_offset_prev)
+    READER_LOCK_FREE_STOP(edge_ptrs.offset)
 #endif
-            edge_len = edge_ptrs.len_ptr[0];
-            edge_len_m1 = edge_len - 1;
-            // match edge string
-            if(edge_len > LOCAL_EDGE_LEN)
-            {
-                size_t edge_str_off_lf = Get5BInteger(edge_ptrs.ptr);
-                if(mm.ReadData(node_buff, edge_len_m1, edge_str_off_lf) != edge_len_m1)
-                {
-                    rval = MBError::READ_ERROR;
-                    break;
-                }
-                key_buff = node_buff;
+    return rval;
+}
+
+static bool FuzzyMatchKeyLess(const FuzzyMatch &a, const FuzzyMatch &b)
+{
+    return a.key < b.key;
+}
+
+static bool FuzzyMatchKeyEqual(const FuzzyMatch &a, const FuzzyMatch &b)
+{
+    return a.key == b.key;
+}
+
+static bool FuzzyMatchLess(const FuzzyMatch &a, const FuzzyMatch &b)
+{
+    if(a.distance != b.distance)
+        return a.distance < b.distance;
+    return a.key < b.key;
+}
+
+// Compute the edit distance row for the next character c on the path from
+// the row of the parent. Returns the minimum distance in the row, which is
+// a lower bound of the distance of any key below.
+static int FuzzyNextRow(const uint8_t *key, int len, const std::vector<int> &prev,
+                        uint8_t c, std::vector<int> &row)
+{
+    row.resize(len + 1);
+    row[0] = prev[0] + 1;
+    int min_dist = row[0];
+    for(int j = 1; j <= len; j++)
+    {
+        int dist = prev[j-1] + (key[j-1] != c);
+        if(prev[j] + 1 < dist)
+            dist = prev[j] + 1;
+        if(row[j-1] + 1 < dist)
+            dist = row[j-1] + 1;
+        row[j] = dist;
+        if(dist < min_dist)
+            min_dist = dist;
+    }
+    return min_dist;
+}
+
+int Dict::FindFuzzy(const uint8_t *key, int len, int max_edits, int limit,
+                    std::vector<FuzzyMatch> &matches)
+{
+    matches.clear();
+    if(len <= 0 || max_edits < 0 || limit <= 0)
+        return MBError::INVALID_ARG;
+
+    int rval = MBError::SUCCESS;
+    size_t rc_root_offset = header->rc_root_offset.load(MEMORY_ORDER_READER);
+    if(rc_root_offset != 0)
+        rval = FindFuzzy_Internal(rc_root_offset, key, len, max_edits, limit, matches);
+    if(rval == MBError::SUCCESS)
+        rval = FindFuzzy_Internal(mm.GetRootOffset(), key, len, max_edits, limit, matches);
+    if(rval != MBError::SUCCESS)
+    {
+        matches.clear();
+        return rval;
+    }
+
+    if(rc_root_offset != 0)
+    {
+        // Keys found in the rc tree are newer.
+        std::stable_sort(matches.begin(), matches.end(), FuzzyMatchKeyLess);
+        matches.erase(std::unique(matches.begin(), matches.end(), FuzzyMatchKeyEqual),
+                      matches.end());
+    }
+    std::sort(matches.begin(), matches.end(), FuzzyMatchLess);
+    if(matches.size() > static_cast<size_t>(limit))
+        matches.resize(limit);
+    if(matches.empty())
+        return MBError::NOT_EXIST;
+    return MBError::SUCCESS;
+}
+
+// Depth-first walk of the trie with one edit distance row per character
+// on the path. Subtrees are pruned if the minimum of the row exceeds the
+// bound. Once limit matches are found, the bound is lowered to the largest
+// distance of the best matches.
+int Dict::FindFuzzy_Internal(size_t root_off, const uint8_t *key, int len, int max_edits,
+                             int limit, std::vector<FuzzyMatch> &matches)
+{
+    size_t start = matches.size();
+    int bound = max_edits;
+    std::vector<FuzzyNode> nodes(1);
+    nodes[0].node_off = root_off;
+    nodes[0].parent_edge_off = 0;
+    for(int j = 0; j <= len; j++)
+        nodes[0].row.push_back(j);
+
+    FuzzyNode curr;
+    int rval;
+    while(!nodes.empty())
+    {
+        curr.node_off = nodes.back().node_off;
+        curr.parent_edge_off = nodes.back().parent_edge_off;
+        curr.key.swap(nodes.back().key);
+        curr.row.swap(nodes.back().row);
+        nodes.pop_back();
+
+        size_t num_matches = matches.size();
+        rval = FindFuzzyNode(key, len, bound, curr, nodes, matches);
+#ifdef __LOCK_FREE__
+        while(rval == MBError::TRY_AGAIN)
+        {
+            nanosleep((const struct timespec[]){{0, 10L}}, NULL);
+            rval = FindFuzzyNode(key, len, bound, curr, nodes, matches);
+        }
+#endif
+        if(rval != MBError::SUCCESS)
+            return rval;
+
+        if(matches.size() > num_matches && matches.size() - start >= static_cast<size_t>(limit))
+        {
+            std::sort(matches.begin() + start, matches.end(), FuzzyMatchLess);
+            matches.resize(start + limit);
+            bound = matches.back().distance;
+        }
+    }
+    return MBError::SUCCESS;
+}
+
+// Extend the rows along the edges of the node. Keys within the bound are
+// appended to matches and child nodes to visit are appended to nodes.
+// Nothing is added if TRY_AGAIN is returned.
+int Dict::FindFuzzyNode(const uint8_t *key, int len, int bound, const FuzzyNode &node,
+                        std::vector<FuzzyNode> &nodes, std::vector<FuzzyMatch> &matches)
+{
+    uint8_t node_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
+    uint8_t label_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
+    uint8_t hdr_buff[NODE_EDGE_KEY_FIRST];
+    EdgePtrs edge_ptrs;
+    MBData data;
+    std::string match_str;
+    std::vector<int> row;
+    std::vector<int> prev;
+    size_t child_off;
+    size_t edge_off;
+    size_t data_off;
+    int match;
+    int min_dist;
+    size_t num_nodes = nodes.size();
+    size_t num_matches = matches.size();
+#ifdef __LOCK_FREE__
+    LockFreeData snapshot;
+    lfree.ReaderLockFreeStart(snapshot);
+#endif
+
+    int rval = ReadNode(node.node_off, node_buff, edge_ptrs, match, data, false);
+    while(rval == MBError::SUCCESS)
+    {
+        edge_off = edge_ptrs.offset;
+        rval = ReadNextEdge(node_buff, edge_ptrs, match, data, match_str, child_off, false);
+        if(rval != MBError::SUCCESS)
+            break;
+        int edge_len = edge_ptrs.len_ptr[0];
+        if(edge_len == 0)
+            continue;
+        const uint8_t *label = mm.GetEdgeLabel(edge_ptrs.ptr, label_buff);
+        if(label == NULL)
+        {
+            rval = MBError::READ_ERROR;
+            break;
+        }
+
+        uint8_t first = node_buff[NODE_EDGE_KEY_FIRST+edge_ptrs.curr_nt-1];
+        min_dist = FuzzyNextRow(key, len, node.row, first, row);
+        for(int i = 0; i < edge_len - 1 && min_dist <= bound; i++)
+        {
+            prev.swap(row);
+            min_dist = FuzzyNextRow(key, len, prev, label[i], row);
+        }
+
+        data_off = 0;
+        if(min_dist <= bound && row[len] <= bound)
+        {
+            if(match != MATCH_NONE)
+            {
+                data_off = Get6BInteger(edge_ptrs.offset_ptr);
             }
             else
             {
-                key_buff = edge_ptrs.ptr;
+                const uint8_t *node_hdr = mm.ReadPtr(hdr_buff, NODE_EDGE_KEY_FIRST, child_off);
+                if(node_hdr == NULL)
+                {
+                    rval = MBError::READ_ERROR;
+                    break;
+                }
+                if(node_hdr[0] & FLAG_NODE_MATCH)
+                    data_off = Get6BInteger(node_hdr+2);
             }
+        }
+
+        if(data_off > 0)
+        {
+            matches.push_back(FuzzyMatch());
+            FuzzyMatch &fm = matches.back();
+            fm.key.reserve(node.key.size() + edge_len);
+            fm.key = node.key;
+            fm.key.push_back(first);
+            fm.key.append(reinterpret_cast<const char*>(label), edge_len - 1);
+            fm.distance = row[len];
+            rval = ReadDataBuffer(fm.value, data_off);
+            if(rval != MBError::SUCCESS)
+                break;
+        }
+#ifdef __LOCK_FREE__
+        if(lfree.ReaderLockFreeStop(snapshot, edge_off) == MBError::TRY_AGAIN)
+        {
+            rval = MBError::TRY_AGAIN;
+            break;
+        }
+#endif
+
+        if(child_off > 0 && min_dist <= bound)
+        {
+            nodes.push_back(FuzzyNode());
+            FuzzyNode &child = nodes.back();
+            child.node_off = child_off;
+            child.parent_edge_off = edge_off;
+            child.key = node.key;
+            child.key.push_back(first);
+            child.key.append(reinterpret_cast<const char*>(label), edge_len - 1);
+            child.row.swap(row);
+        }
+    }
+
+    if(rval == MBError::OUT_OF_BOUND)
+        rval = MBError::SUCCESS;
+#ifdef __LOCK_FREE__
+    if(rval == MBError::SUCCESS && node.parent_edge_off != 0 &&
+       lfree.ReaderLockFreeStop(snapshot, node.parent_edge_off) == MBError::TRY_AGAIN)
+        rval = MBError::TRY_AGAIN;
+#endif
+    if(rval != MBError::SUCCESS)
+    {
+        nodes.resize(num_nodes);
+        matches.resize(num_matches);
+    }
+    return rval;
+}
+
+// Depth-first walk of the trie that only descends the edges along which
+// the pattern can still match. The keys found in a node are passed to fn
+// after the node passes the lock-free check.
+int Dict::FindMatching(const GlobPattern &glob, const MatchCallback &fn)
+{
+    std::vector<GlobNode> nodes(1);
+    nodes[0].node_off = mm.GetRootOffset();
+    nodes[0].parent_edge_off = 0;
+    glob.Start(nodes[0].state);
+
+    GlobNode curr;
+    std::vector<std::pair<std::string, std::string> > kvs;
+    MBData mbd;
+    int rval;
+    while(!nodes.empty())
+    {
+        curr.node_off = nodes.back().node_off;
+        curr.parent_edge_off = nodes.back().parent_edge_off;
+        curr.key.swap(nodes.back().key);
+        curr.state.swap(nodes.back().state);
+        nodes.pop_back();
+
+        rval = MatchNode(glob, curr, nodes, kvs);
+#ifdef __LOCK_FREE__
+        while(rval == MBError::TRY_AGAIN)
+        {
+            nanosleep((const struct timespec[]){{0, 10L}}, NULL);
+            rval = MatchNode(glob, curr, nodes, kvs);
+        }
+#endif
+        if(rval != MBError::SUCCESS)
+            return rval;
+
+        for(size_t i = 0; i < kvs.size(); i++)
+        {
+            const std::string &value = kvs[i].second;
+            if(mbd.buff_len < static_cast<int>(value.size()) + 1 &&
+               mbd.Resize(value.size()) != MBError::SUCCESS)
+                return MBError::NO_MEMORY;
+            memcpy(mbd.buff, value.data(), value.size());
+            mbd.data_len = value.size();
+            if(!fn(kvs[i].first, mbd))
+                return MBError::SUCCESS;
+        }
+    }
+    return MBError::SUCCESS;
+}
+
+// Advance the pattern state along the edges of the node. The matching keys
+// are returned in kvs and the child nodes to visit are appended to nodes.
+// Nothing is added if TRY_AGAIN is returned.
+int Dict::MatchNode(const GlobPattern &glob, const GlobNode &node, std::vector<GlobNode> &nodes,
+                    std::vector<std::pair<std::string, std::string> > &kvs)
+{
+    uint8_t node_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
+    uint8_t label_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
+    uint8_t hdr_buff[NODE_EDGE_KEY_FIRST];
+    EdgePtrs edge_ptrs;
+    MBData data;
+    std::string match_str;
+    std::vector<uint8_t> state;
+    std::vector<uint8_t> prev;
+    size_t child_off;
+    size_t edge_off;
+    size_t data_off;
+    int match;
+    bool alive;
+    size_t num_nodes = nodes.size();
+    kvs.clear();
+#ifdef __LOCK_FREE__
+    LockFreeData snapshot;
+    lfree.ReaderLockFreeStart(snapshot);
+#endif
 
-            if((edge_len_m1 > 0 && memcmp(key_buff, p+1, edge_len_m1) != 0) || edge_len_m1 < 0)
+    int rval = ReadNode(node.node_off, node_buff, edge_ptrs, match, data, false);
+    while(rval == MBError::SUCCESS)
+    {
+        edge_off = edge_ptrs.offset;
+        rval = ReadNextEdge(node_buff, edge_ptrs, match, data, match_str, child_off, false);
+        if(rval != MBError::SUCCESS)
+            break;
+        int edge_len = edge_ptrs.len_ptr[0];
+        if(edge_len == 0)
+            continue;
+
+        uint8_t first = node_buff[NODE_EDGE_KEY_FIRST+edge_ptrs.curr_nt-1];
+        const uint8_t *label = NULL;
+        alive = glob.Next(node.state, first, state);
+        if(alive && edge_len > 1)
+        {
+            label = mm.GetEdgeLabel(edge_ptrs.ptr, label_buff);
+            if(label == NULL)
             {
-                rval = MBError::NOT_EXIST;
+                rval = MBError::READ_ERROR;
                 break;
             }
+            for(int i = 0; i < edge_len - 1 && alive; i++)
+            {
+                prev.swap(state);
+                alive = glob.Next(prev, label[i], state);
+            }
+        }
 
-            len -= edge_len;
-            if(len <= 0)
+        data_off = 0;
+        std::string key;
+        if(alive)
+        {
+            key = node.key;
+            key.push_back(first);
+            if(label != NULL)
+                key.append(reinterpret_cast<const char*>(label), edge_len - 1);
+        }
+        if(alive && glob.Accept(state))
+        {
+            if(match != MATCH_NONE)
             {
-                // If this is for remove operation, return IN_DICT to caller.
-                if(data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT)
-                    rval = MBError::IN_DICT;
-                else
-                    rval = ReadDataFromEdge(data, edge_ptrs);
-                break;
+                data_off = Get6BInteger(edge_ptrs.offset_ptr);
             }
             else
             {
-                if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
+                const uint8_t *node_hdr = mm.ReadPtr(hdr_buff, NODE_EDGE_KEY_FIRST, child_off);
+                if(node_hdr == NULL)
                 {
-                    // Reach a leaf node and no match found
-                    rval = MBError::NOT_EXIST;
+                    rval = MBError::READ_ERROR;
                     break;
                 }
+                if(node_hdr[0] & FLAG_NODE_MATCH)
+                    data_off = Get6BInteger(node_hdr+2);
             }
-            p += edge_len;
+        }
+
+        if(data_off > 0)
+        {
+            kvs.push_back(std::make_pair(key, std::string()));
+            rval = ReadDataBuffer(kvs.back().second, data_off);
+            if(rval != MBError::SUCCESS)
+                break;
+        }
 #ifdef __LOCK_FREE__
-            edge_offset_prev = edge_ptrs.offset;
+        if(lfree.ReaderLockFreeStop(snapshot, edge_off) == MBError::TRY_AGAIN)
+        {
+            rval = MBError::TRY_AGAIN;
+            break;
+        }
 #endif
+
+        if(alive && child_off > 0)
+        {
+            nodes.push_back(GlobNode());
+            GlobNode &child = nodes.back();
+            child.node_off = child_off;
+            child.parent_edge_off = edge_off;
+            child.key.swap(key);
+            child.state.swap(state);
         }
     }
+
+    if(rval == MBError::OUT_OF_BOUND)
+        rval = MBError::SUCCESS;
+#ifdef __LOCK_FREE__
+    if(rval == MBError::SUCCESS && node.parent_edge_off != 0 &&
+       lfree.ReaderLockFreeStop(snapshot, node.parent_edge_off) == MBError::TRY_AGAIN)
+        rval = MBError::TRY_AGAIN;
+#endif
+    if(rval != MBError::SUCCESS)
+    {
+        nodes.resize(num_nodes);
+        kvs.clear();
+    }
+    return rval;
+}
+
+int Dict::Find(const uint8_t *key, int len, MBData &data)
+{
+    int rval;
+    // Parent lookups of Remove are not on full keys.
+    bool filtered = false;
+    if(key_filter != NULL && !(data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT))
+    {
+        if(!key_filter->Contain(key, len))
+            return MBError::NOT_EXIST;
+        filtered = true;
+    }
+
+    size_t rc_root_offset = header->rc_root_offset.load(MEMORY_ORDER_READER);
+    if(hash_index != NULL && rc_root_offset == 0 &&
+       !(data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT))
+    {
+        if(FindHashIndex(key, len, data) == MBError::SUCCESS)
+            return MBError::SUCCESS;
+    }
+
+    if(rc_root_offset != 0)
+    {
+        rval = Find_Internal(rc_root_offset, key, len, data);
+#ifdef __LOCK_FREE__
+        while(rval == MBError::TRY_AGAIN)
+        {
+            nanosleep((const struct timespec[]){{0, 10L}}, NULL);
+            rval = Find_Internal(rc_root_offset, key, len, data);
+        }
+#endif
+        if(rval == MBError::SUCCESS)
+        {
+            data.match_len = len;
+            return rval;
+        }
+        else if(rval != MBError::NOT_EXIST)
+            return rval;
+        data.options &= ~CONSTS::OPTION_RC_MODE;
+    }
+
+    rval = Find_Internal(0, key, len, data);
+#ifdef __LOCK_FREE__
+    while(rval == MBError::TRY_AGAIN)
+    {
+        nanosleep((const struct timespec[]){{0, 10L}}, NULL);
+        rval = Find_Internal(0, key, len, data);
+    }
+#endif
+    if(rval == MBError::SUCCESS)
+        data.match_len = len;
+    else if(rval == MBError::NOT_EXIST && filtered && key_filter->IsReady())
+        key_filter->AddFalsePositive();
+
+    return rval;
+}
+
+// Same as Find, except that the lookup starts from the deepest edge on the
+// path of the previous lookup of the cursor that is shared with this key.
+// The cursor must only be used with one DB handle.
+int Dict::Find(const uint8_t *key, int len, MBData &data, FindCursor &cursor)
+{
+    if(hash_index != NULL || len <= 0 ||
+       (data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT) ||
+       header->rc_root_offset.load(MEMORY_ORDER_READER) != 0)
+    {
+        cursor.Reset();
+        return Find(key, len, data);
+    }
+
+    bool filtered = false;
+    if(key_filter != NULL)
+    {
+        if(!key_filter->Contain(key, len))
+            return MBError::NOT_EXIST;
+        filtered = true;
+    }
+
+    int rval = FindCursor_Internal(key, len, data, cursor);
+#ifdef __LOCK_FREE__
+    while(rval == MBError::TRY_AGAIN)
+    {
+        nanosleep((const struct timespec[]){{0, 10L}}, NULL);
+        rval = FindCursor_Internal(key, len, data, cursor);
+    }
+#endif
+    if(rval == MBError::SUCCESS)
+        data.match_len = len;
+    else if(rval == MBError::NOT_EXIST && filtered && key_filter->IsReady())
+        key_filter->AddFalsePositive();
+
+    return rval;
+}
+
+// The saved path is only used if the lock-free counter has not changed since
+// the previous lookup, i.e., writer has not modified the trie. The path is
+// valid for the next lookup only if this lookup completes.
+int Dict::FindCursor_Internal(const uint8_t *key, int len, MBData &data, FindCursor &cursor)
+{
+    EdgePtrs &edge_ptrs = data.edge_ptrs;
+    int resume_depth = 0;
+#ifdef __LOCK_FREE__
+    READER_LOCK_FREE_START
+    if(cursor.counter == snapshot.counter)
+        resume_depth = cursor.GetResumeDepth(key, len);
+#endif
+    cursor.key.clear();
+    cursor.depth = resume_depth;
+
+    int rval;
+    int match;
+    if(resume_depth > 0)
+    {
+        match = cursor.match_len[resume_depth-1];
+        edge_ptrs.offset = cursor.edge_off[resume_depth-1];
+        if(mm.ReadEdge(edge_ptrs.offset, edge_ptrs) != MBError::SUCCESS)
+            return MBError::READ_ERROR;
+        cursor.num_resume++;
+    }
+    else
+    {
+        rval = mm.GetRootEdge(0, key[0], edge_ptrs);
+        if(rval != MBError::SUCCESS)
+            return MBError::READ_ERROR;
+        match = edge_ptrs.len_ptr[0];
+        if(match == 0 || match > len)
+        {
+#ifdef __LOCK_FREE__
+            READER_LOCK_FREE_STOP(edge_ptrs.offset)
+#endif
+            return MBError::NOT_EXIST;
+        }
+        const uint8_t *key_buff = mm.GetEdgeLabel(edge_ptrs.ptr, data.node_buff);
+        if(key_buff == NULL)
+        {
+#ifdef __LOCK_FREE__
+            READER_LOCK_FREE_STOP(edge_ptrs.offset)
+#endif
+            return MBError::READ_ERROR;
+        }
+        if(match > 1 && memcmp(key_buff, key+1, match-1) != 0)
+        {
+#ifdef __LOCK_FREE__
+            READER_LOCK_FREE_STOP(edge_ptrs.offset)
+#endif
+            return MBError::NOT_EXIST;
+        }
+        cursor.AddEdge(edge_ptrs.offset, match);
+    }
+
+    if(match == len)
+        rval = ReadDataFromEdge(data, edge_ptrs);
+    else if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
+        rval = MBError::NOT_EXIST;
+#ifdef __LOCK_FREE__
+    else
+        rval = FindNextEdges(key + match, len - match, data, &snapshot, &cursor);
+
+    for(int i = 0; i < resume_depth; i++)
+    {
+        READER_LOCK_FREE_STOP(cursor.edge_off[i])
+    }
+    READER_LOCK_FREE_STOP(edge_ptrs.offset)
+    cursor.counter = snapshot.counter;
+#else
+    else
+        rval = FindNextEdges(key + match, len - match, data, NULL, &cursor);
+#endif
+    cursor.SetKey(key);
+    return rval;
+}
+
+// Read the value at a data offset obtained by a key-only or header-only
+// iteration. The options that skip the value are ignored.
+int Dict::ReadValue(MBData &data, size_t data_off) const
+{
+    int data_options = data.options;
+    data.options &= ~(CONSTS::OPTION_KEY_ONLY | CONSTS::OPTION_READ_HEADER |
+                      CONSTS::OPTION_READ_VIEW);
+    int rval = ReadDataBuffer(data, data_off);
+    data.options = data_options;
+    return rval;
+}
+
+int Dict::ReadDataBuffer(std::string &value, size_t data_off) const
+{
+    uint16_t data_len[2];
+    const uint8_t *ptr = GetMappedPtr(data_off);
+    if(ptr != NULL)
+    {
+        memcpy(&data_len[0], ptr, DATA_HDR_BYTE);
+        value.assign(reinterpret_cast<const char*>(ptr + DATA_HDR_BYTE), data_len[0]);
+        return MBError::SUCCESS;
+    }
+
+    if(ReadData(reinterpret_cast<uint8_t*>(&data_len[0]), DATA_HDR_BYTE, data_off)
+               != DATA_HDR_BYTE)
+        return MBError::READ_ERROR;
+    value.resize(data_len[0]);
+    if(data_len[0] > 0 &&
+       ReadData(reinterpret_cast<uint8_t*>(&value[0]), data_len[0], data_off + DATA_HDR_BYTE)
+               != data_len[0])
+        return MBError::READ_ERROR;
+    return MBError::SUCCESS;
+}
+
+// Look up the key in the hash index. Return NOT_EXIST if the key has to be
+// looked up in the trie.
+int Dict::FindHashIndex(const uint8_t *key, int len, MBData &data)
+{
+    size_t data_off;
+    size_t lf_offset;
+    uint32_t seq;
+#ifdef __LOCK_FREE__
+    LockFreeData snapshot;
+    lfree.ReaderLockFreeStart(snapshot);
+#endif
+    if(hash_index->Find(key, len, data_off, lf_offset, seq) != MBError::SUCCESS)
+        return MBError::NOT_EXIST;
+    if(ReadDataBuffer(data, data_off) != MBError::SUCCESS)
+        return MBError::NOT_EXIST;
+#ifdef __LOCK_FREE__
+    if(lfree.ReaderLockFreeStop(snapshot, lf_offset) != MBError::SUCCESS)
+        return MBError::NOT_EXIST;
+#endif
+    if(!hash_index->Check(seq))
+        return MBError::NOT_EXIST;
+
+    hash_index->AddHit();
+    data.match_len = len;
+    return MBError::SUCCESS;
+}
+
+int Dict::Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &data)
+{
+    EdgePtrs &edge_ptrs = data.edge_ptrs;
+#ifdef __LOCK_FREE__
+    READER_LOCK_FREE_START
+#endif
+    int rval;
+
+#ifdef __LOCK_FREE__
+    if(hot_cache != NULL && root_off == 0 &&
+       !(data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT))
+    {
+        int match_len;
+        rval = hot_cache->Find(snapshot, key, len, edge_ptrs, match_len);
+        if(rval == MBError::SUCCESS)
+        {
+            // Continue from the deepest cached edge
+            if(match_len == len)
+                rval = ReadDataFromEdge(data, edge_ptrs);
+            else
+                rval = FindNextEdges(key + match_len, len - match_len, data, &snapshot);
+            READER_LOCK_FREE_STOP(edge_ptrs.offset)
+            return rval;
+        }
+        else if(rval != MBError::NOT_INITIALIZED)
+        {
+            return rval;
+        }
+    }
+#endif
+
+    rval = mm.GetRootEdge(root_off, key[0], edge_ptrs,
+                          data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT);
+
+    if(rval != MBError::SUCCESS)
+        return MBError::READ_ERROR;
+    if(edge_ptrs.len_ptr[0] == 0)
+    {
+#ifdef __LOCK_FREE__
+        READER_LOCK_FREE_STOP(edge_ptrs.offset)
+#endif
+        return MBError::NOT_EXIST;
+    }
+
+    // Compare edge string
+    const uint8_t *key_buff;
+    uint8_t *node_buff = data.node_buff;
+    int edge_len = edge_ptrs.len_ptr[0];
+    int edge_len_m1 = edge_len - 1;
+
+    rval = MBError::NOT_EXIST;
+    key_buff = mm.GetEdgeLabel(edge_ptrs.ptr, node_buff);
+    if(key_buff == NULL)
+    {
+#ifdef __LOCK_FREE__
+        READER_LOCK_FREE_STOP(edge_ptrs.offset)
+#endif
+        return MBError::READ_ERROR;
+    }
+
+    if(edge_len < len)
+    {
+        if((edge_len > 1 && memcmp(key_buff, key+1, edge_len_m1) != 0) ||
+           (edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF))
+        {
+#ifdef __LOCK_FREE__
+            READER_LOCK_FREE_STOP(edge_ptrs.offset)
+#endif
+            return MBError::NOT_EXIST;
+        }
+
+#ifdef __LOCK_FREE__
+        rval = FindNextEdges(key + edge_len, len - edge_len, data, &snapshot);
+#else
+        rval = FindNextEdges(key + edge_len, len - edge_len, data, NULL);
+#endif
+    }
     else if(edge_len == len)
     {
         if(len > 1 && memcmp(key_buff, key+1, len-1) != 0)
@@ -839,17 +1694,316 @@ int Dict::Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &da
                 data.edge_ptrs.parent_offset = data.edge_ptrs.offset;
                 rval = MBError::IN_DICT;
             }
-            else
+            else
+            {
+                rval = ReadDataFromEdge(data, edge_ptrs);
+            }
+        }
+    }
+
+#ifdef __LOCK_FREE__
+    READER_LOCK_FREE_STOP(edge_ptrs.offset)
+#endif
+    return rval;
+}
+
+// Match the rest of the key starting from the child node of data.edge_ptrs.
+// The caller needs to check the lock-free status of the last edge.
+// Fully matched edges are appended to the cursor if it is not NULL.
+int Dict::FindNextEdges(const uint8_t *key, int len, MBData &data, LockFreeData *snapshot_ptr,
+                        FindCursor *cursor)
+{
+    EdgePtrs &edge_ptrs = data.edge_ptrs;
+    uint8_t *node_buff = data.node_buff;
+    const uint8_t *key_buff;
+    const uint8_t *p = key;
+    int edge_len;
+    int edge_len_m1;
+    int rval;
+#ifdef __LOCK_FREE__
+    LockFreeData &snapshot = *snapshot_ptr;
+    int lf_ret;
+    size_t edge_offset_prev = edge_ptrs.offset;
+#endif
+
+    while(true)
+    {
+        rval = mm.NextEdge(p, edge_ptrs, node_buff, data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT);
+        if(rval != MBError::SUCCESS)
+            break;
+
+#ifdef __LOCK_FREE__
+        READER_LOCK_FREE_STOP(edge_offset_prev)
+#endif
+        edge_len = edge_ptrs.len_ptr[0];
+        edge_len_m1 = edge_len - 1;
+        // match edge string
+        key_buff = mm.GetEdgeLabel(edge_ptrs.ptr, node_buff);
+        if(key_buff == NULL)
+        {
+            rval = MBError::READ_ERROR;
+            break;
+        }
+
+        // The key can be shorter than the edge.
+        if(edge_len > len || (edge_len_m1 > 0 && memcmp(key_buff, p+1, edge_len_m1) != 0) ||
+           edge_len_m1 < 0)
+        {
+            rval = MBError::NOT_EXIST;
+            break;
+        }
+
+        if(cursor != NULL)
+            cursor->AddEdge(edge_ptrs.offset, edge_len);
+        len -= edge_len;
+        if(len <= 0)
+        {
+            // If this is for remove operation, return IN_DICT to caller.
+            if(data.options & CONSTS::OPTION_FIND_AND_STORE_PARENT)
+                rval = MBError::IN_DICT;
+            else
+                rval = ReadDataFromEdge(data, edge_ptrs);
+            break;
+        }
+        else
+        {
+            if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
+            {
+                // Reach a leaf node and no match found
+                rval = MBError::NOT_EXIST;
+                break;
+            }
+        }
+        p += edge_len;
+#ifdef __LOCK_FREE__
+        edge_offset_prev = edge_ptrs.offset;
+#endif
+    }
+
+    return rval;
+}
+
+#define MULTI_FIND_GROUP_SIZE    16
+#define MULTI_FIND_STAGE_ROOT    0
+#define MULTI_FIND_STAGE_NODE    1
+#define MULTI_FIND_STAGE_EDGE    2
+#define MULTI_FIND_STAGE_LABEL   3
+#define MULTI_FIND_STAGE_DATA    4
+
+// Batched lookup. Up to MULTI_FIND_GROUP_SIZE lookups are in flight at a time.
+// Each round advances every lookup by one step and prefetches what its next step
+// reads, so that the cache misses of different lookups overlap.
+void Dict::MultiFind(const uint8_t *const *keys, const int *lens, int num,
+                     MBData *data, int *rvals)
+{
+    if(header->rc_root_offset.load(MEMORY_ORDER_READER) != 0)
+    {
+        // Lookups need to check both trees while resource collection is running.
+        for(int i = 0; i < num; i++)
+            rvals[i] = Find(keys[i], lens[i], data[i]);
+        return;
+    }
+
+    MultiFindState st[MULTI_FIND_GROUP_SIZE];
+    int slot_key[MULTI_FIND_GROUP_SIZE];
+    int next_key = 0;
+    int active = 0;
+    for(int i = 0; i < MULTI_FIND_GROUP_SIZE; i++)
+    {
+        slot_key[i] = -1;
+        if(next_key < num)
+        {
+            slot_key[i] = next_key++;
+            MultiFindStart(keys[slot_key[i]], lens[slot_key[i]], st[i]);
+            active++;
+        }
+    }
+
+    while(active > 0)
+    {
+        for(int i = 0; i < MULTI_FIND_GROUP_SIZE; i++)
+        {
+            int k = slot_key[i];
+            if(k < 0)
+                continue;
+            if(!MultiFindStep(st[i], data[k], rvals[k]))
+                continue;
+
+            if(rvals[k] == MBError::SUCCESS)
+                data[k].match_len = lens[k];
+            if(next_key < num)
+            {
+                slot_key[i] = next_key++;
+                MultiFindStart(keys[slot_key[i]], lens[slot_key[i]], st[i]);
+            }
+            else
+            {
+                slot_key[i] = -1;
+                active--;
+            }
+        }
+    }
+}
+
+void Dict::MultiFindStart(const uint8_t *key, int len, MultiFindState &st) const
+{
+    st.key_start = key;
+    st.len_start = len;
+    st.key = key;
+    st.len = len;
+    st.stage = MULTI_FIND_STAGE_ROOT;
+    if(len > 0)
+        mm.Prefetch(mm.GetRootOffset() + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + key[0]*mm.GetEdgeSize());
+}
+
+// Compare the current edge label with the key and move to the next stage.
+// Return true if the lookup is finished.
+bool Dict::MultiFindMatchEdge(MultiFindState &st, MBData &data, int &rval)
+{
+    EdgePtrs &edge_ptrs = data.edge_ptrs;
+    const uint8_t *key_buff;
+    int edge_len = edge_ptrs.len_ptr[0];
+    int edge_len_m1 = edge_len - 1;
+
+    key_buff = mm.GetEdgeLabel(edge_ptrs.ptr, data.node_buff);
+    if(key_buff == NULL)
+    {
+        rval = MBError::READ_ERROR;
+        return true;
+    }
+
+    if(edge_len == 0 || edge_len > st.len ||
+       (edge_len_m1 > 0 && memcmp(key_buff, st.key+1, edge_len_m1) != 0))
+    {
+        rval = MBError::NOT_EXIST;
+        return true;
+    }
+
+    st.key += edge_len;
+    st.len -= edge_len;
+    if(st.len == 0)
+    {
+        if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
+            Prefetch(Get6BInteger(edge_ptrs.offset_ptr));
+        else
+            mm.Prefetch(Get6BInteger(edge_ptrs.offset_ptr));
+        st.stage = MULTI_FIND_STAGE_DATA;
+        return false;
+    }
+
+    if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
+    {
+        // Reach a leaf node and no match found
+        rval = MBError::NOT_EXIST;
+        return true;
+    }
+
+    mm.Prefetch(Get6BInteger(edge_ptrs.offset_ptr));
+    st.stage = MULTI_FIND_STAGE_NODE;
+    return false;
+}
+
+// Run one step of a lookup. Return true if the lookup is finished and rval is set.
+bool Dict::MultiFindStep(MultiFindState &st, MBData &data, int &rval)
+{
+    EdgePtrs &edge_ptrs = data.edge_ptrs;
+#ifdef __LOCK_FREE__
+    int lf_ret;
+#endif
+
+    switch(st.stage)
+    {
+        case MULTI_FIND_STAGE_ROOT:
+            if(st.len <= 0)
+            {
+                rval = MBError::INVALID_ARG;
+                return true;
+            }
+            if(key_filter != NULL && !key_filter->Contain(st.key, st.len))
+            {
+                rval = MBError::NOT_EXIST;
+                return true;
+            }
+            if(hash_index != NULL && FindHashIndex(st.key, st.len, data) == MBError::SUCCESS)
+            {
+                rval = MBError::SUCCESS;
+                return true;
+            }
+#ifdef __LOCK_FREE__
+            lfree.ReaderLockFreeStart(st.snapshot);
+#endif
+            if(mm.GetRootEdge(0, st.key[0], edge_ptrs) != MBError::SUCCESS)
+            {
+                rval = MBError::READ_ERROR;
+                return true;
+            }
+            if(edge_ptrs.len_ptr[0] == 0)
+            {
+                rval = MBError::NOT_EXIST;
+                break;
+            }
+            st.edge_offset_prev = edge_ptrs.offset;
+            if(edge_ptrs.len_ptr[0] > mm.GetLocalEdgeLen())
+            {
+                mm.Prefetch(Get5BInteger(edge_ptrs.ptr));
+                st.stage = MULTI_FIND_STAGE_LABEL;
+                return false;
+            }
+            if(MultiFindMatchEdge(st, data, rval))
+                break;
+            return false;
+        case MULTI_FIND_STAGE_NODE:
+            rval = mm.FindEdgeOffset(st.key, edge_ptrs, data.node_buff, st.edge_off);
+            if(rval != MBError::SUCCESS)
+                break;
+            mm.Prefetch(st.edge_off);
+            st.stage = MULTI_FIND_STAGE_EDGE;
+            return false;
+        case MULTI_FIND_STAGE_EDGE:
+            if(mm.ReadEdge(st.edge_off, edge_ptrs) != MBError::SUCCESS)
+            {
+                rval = MBError::READ_ERROR;
+                break;
+            }
+            edge_ptrs.offset = st.edge_off;
+#ifdef __LOCK_FREE__
+            lf_ret = lfree.ReaderLockFreeStop(st.snapshot, st.edge_offset_prev);
+            if(lf_ret != MBError::SUCCESS)
+            {
+                MultiFindStart(st.key_start, st.len_start, st);
+                return false;
+            }
+#endif
+            st.edge_offset_prev = edge_ptrs.offset;
+            if(edge_ptrs.len_ptr[0] > mm.GetLocalEdgeLen())
             {
-                rval = ReadDataFromEdge(data, edge_ptrs);
+                mm.Prefetch(Get5BInteger(edge_ptrs.ptr));
+                st.stage = MULTI_FIND_STAGE_LABEL;
+                return false;
             }
-        }
+            if(MultiFindMatchEdge(st, data, rval))
+                break;
+            return false;
+        case MULTI_FIND_STAGE_LABEL:
+            if(MultiFindMatchEdge(st, data, rval))
+                break;
+            return false;
+        case MULTI_FIND_STAGE_DATA:
+        default:
+            rval = ReadDataFromEdge(data, edge_ptrs);
+            break;
     }
 
 #ifdef __LOCK_FREE__
-    READER_LOCK_FREE_STOP(edge_ptrs.offset)
+    lf_ret = lfree.ReaderLockFreeStop(st.snapshot, edge_ptrs.offset);
+    if(lf_ret != MBError::SUCCESS)
+    {
+        // Start over for this key.
+        MultiFindStart(st.key_start, st.len_start, st);
+        return false;
+    }
 #endif
-    return rval;
+    return true;
 }
 
 void Dict::PrintStats(std::ostream *out_stream) const
@@ -876,6 +2030,12 @@ void Dict::PrintStats(std::ostream &out_stream) const
     if(free_lists)
         out_stream << "\tTrackable Buffer Size: " << free_lists->GetTotSize() << std::endl;
     mm.PrintStats(out_stream);
+    if(key_filter != NULL)
+        key_filter->PrintStats(out_stream);
+    if(hash_index != NULL)
+        hash_index->PrintStats(out_stream);
+    if(options & CONSTS::ACCESS_MODE_WRITER)
+        out_stream << "\tNumber of resumed adds: " << add_cursor.num_resume << std::endl;
 
     kv_file->PrintStats(out_stream);
 }
@@ -889,6 +2049,7 @@ void Dict::PrintHeader(std::ostream &out_stream) const
     out_stream << "version: " << header->version[0] << "." <<
                                  header->version[1] << "." <<
                                  header->version[2] << std::endl;
+    out_stream << "index format: " << header->version[3] << std::endl;
     out_stream << "data size: " << header->data_size << std::endl;
     out_stream << "db count: " << header->count << std::endl;
     out_stream << "max data offset: " << header->m_data_offset << std::endl;
@@ -949,14 +2110,14 @@ int Dict::ReadNextEdge(const uint8_t *node_buff, EdgePtrs &edge_ptrs,
     if(edge_ptrs.curr_nt > static_cast<int>(node_buff[1]))
         return MBError::OUT_OF_BOUND;
 
-    if(mm.ReadData(edge_ptrs.edge_buff, EDGE_SIZE, edge_ptrs.offset) != EDGE_SIZE)
+    // The iterator keeps the edge across calls, so it is always copied.
+    if(mm.ReadEdge(edge_ptrs.offset, edge_ptrs, true) != MBError::SUCCESS)
         return MBError::READ_ERROR;
 
     node_off = 0;
-    match_str = "";
+    match_str.clear();
 
     int rval = MBError::SUCCESS;
-    InitTempEdgePtrs(edge_ptrs);
     if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
     {
         // match of leaf node
@@ -982,21 +2143,18 @@ int Dict::ReadNextEdge(const uint8_t *node_buff, EdgePtrs &edge_ptrs,
     if(edge_ptrs.len_ptr[0] > 0 && rd_kv)
     {
         int edge_len_m1 = edge_ptrs.len_ptr[0] - 1;
-        match_str = std::string(1, (const char)node_buff[NODE_EDGE_KEY_FIRST+edge_ptrs.curr_nt]);
-        if(edge_len_m1 > LOCAL_EDGE_LEN_M1)
+        match_str.assign(1, (const char)node_buff[NODE_EDGE_KEY_FIRST+edge_ptrs.curr_nt]);
+        if(edge_len_m1 > 0)
         {
-            if(mm.ReadData(data.node_buff, edge_len_m1, Get5BInteger(edge_ptrs.ptr)) != edge_len_m1)
+            const uint8_t *label = mm.GetEdgeLabel(edge_ptrs.ptr, data.node_buff);
+            if(label == NULL)
                 return MBError::READ_ERROR;
-            match_str += std::string(reinterpret_cast<char*>(data.node_buff), edge_len_m1);
-        }
-        else if(edge_len_m1 > 0)
-        {
-            match_str += std::string(reinterpret_cast<char*>(edge_ptrs.ptr), edge_len_m1);
+            match_str.append(reinterpret_cast<const char*>(label), edge_len_m1);
         }
     }
 
     edge_ptrs.curr_nt++;
-    edge_ptrs.offset += EDGE_SIZE;
+    edge_ptrs.offset += mm.GetEdgeSize();
     return rval;
 }
 
@@ -1038,7 +2196,7 @@ void Dict::ReadNodeHeader(size_t node_off, int &node_size, int &match,
     if(mm.ReadData(node_buff, NODE_EDGE_KEY_FIRST, node_off) != NODE_EDGE_KEY_FIRST)
         throw (int) MBError::READ_ERROR;
 
-    node_size = mm.GetNodeSizePtr()[ node_buff[1] ];
+    node_size = mm.GetNodeSize(node_buff[1], node_buff[0]);
     if(node_buff[0] & FLAG_NODE_MATCH)
     {
         match = MATCH_NODE;
@@ -1050,14 +2208,15 @@ void Dict::ReadNodeHeader(size_t node_off, int &node_size, int &match,
 int Dict::ReadNodeMatch(size_t node_off, int &match, MBData &data) const
 {
     uint8_t node_buff[NODE_EDGE_KEY_FIRST];
-    if(mm.ReadData(node_buff, NODE_EDGE_KEY_FIRST, node_off) != NODE_EDGE_KEY_FIRST)
+    const uint8_t *node_hdr = mm.ReadPtr(node_buff, NODE_EDGE_KEY_FIRST, node_off);
+    if(node_hdr == NULL)
         return MBError::READ_ERROR;
 
     int rval = MBError::SUCCESS;
-    if(node_buff[0] & FLAG_NODE_MATCH)
+    if(node_hdr[0] & FLAG_NODE_MATCH)
     {
         match = MATCH_NODE;
-        rval = ReadDataFromNode(data, node_buff);
+        rval = ReadDataFromNode(data, node_hdr);
         if(rval != MBError::SUCCESS)
             return rval;
     }
@@ -1082,6 +2241,188 @@ int Dict::ReadRootNode(uint8_t *node_buff, EdgePtrs &edge_ptrs, int &match,
     return ReadNode(root_off, node_buff, edge_ptrs, match, data);
 }
 
+int Dict::FindSubtree(const uint8_t *prefix, int len, std::string &root_key,
+                      size_t &node_off, size_t &edge_off)
+{
+    if(len <= 0)
+        return MBError::INVALID_ARG;
+
+    int rval = FindSubtree_Internal(prefix, len, root_key, node_off, edge_off);
+#ifdef __LOCK_FREE__
+    while(rval == MBError::TRY_AGAIN)
+    {
+        nanosleep((const struct timespec[]){{0, 10L}}, NULL);
+        rval = FindSubtree_Internal(prefix, len, root_key, node_off, edge_off);
+    }
+#endif
+    return rval;
+}
+
+// Walk down the trie along the prefix until an edge ends at or beyond the
+// end of the prefix. The prefix can end in the middle of the edge label.
+int Dict::FindSubtree_Internal(const uint8_t *prefix, int len, std::string &root_key,
+                               size_t &node_off, size_t &edge_off)
+{
+    EdgePtrs edge_ptrs;
+    uint8_t node_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
+#ifdef __LOCK_FREE__
+    READER_LOCK_FREE_START
+#endif
+
+    root_key.clear();
+    node_off = 0;
+    int rval = mm.GetRootEdge(0, prefix[0], edge_ptrs);
+    if(rval != MBError::SUCCESS)
+        return MBError::READ_ERROR;
+
+    const uint8_t *key_buff;
+    const uint8_t *p = prefix;
+    int edge_len;
+    int cmp_len;
+    while(true)
+    {
+        edge_len = edge_ptrs.len_ptr[0];
+        if(edge_len == 0)
+        {
+            rval = MBError::NOT_EXIST;
+            break;
+        }
+        key_buff = mm.GetEdgeLabel(edge_ptrs.ptr, node_buff);
+        if(key_buff == NULL)
+        {
+            rval = MBError::READ_ERROR;
+            break;
+        }
+        cmp_len = edge_len < len ? edge_len : len;
+        if(cmp_len > 1 && memcmp(key_buff, p+1, cmp_len-1) != 0)
+        {
+            rval = MBError::NOT_EXIST;
+            break;
+        }
+
+        root_key.append(reinterpret_cast<const char*>(p), 1);
+        root_key.append(reinterpret_cast<const char*>(key_buff), edge_len-1);
+        if(edge_len >= len)
+        {
+            if(!(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF))
+                node_off = Get6BInteger(edge_ptrs.offset_ptr);
+            edge_off = edge_ptrs.offset;
+            rval = MBError::SUCCESS;
+            break;
+        }
+        if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
+        {
+            rval = MBError::NOT_EXIST;
+            break;
+        }
+
+        p += edge_len;
+        len -= edge_len;
+#ifdef __LOCK_FREE__
+        size_t edge_offset_prev = edge_ptrs.offset;
+#endif
+        rval = mm.NextEdge(p, edge_ptrs, node_buff);
+        if(rval != MBError::SUCCESS)
+            break;
+#ifdef __LOCK_FREE__
+        READER_LOCK_FREE_STOP(edge_offset_prev)
+#endif
+    }
+
+#ifdef __LOCK_FREE__
+    READER_LOCK_FREE_STOP(edge_ptrs.offset)
+#endif
+    return rval;
+}
+
+int Dict::CountPrefix(const uint8_t *prefix, int len, int64_t &count)
+{
+    std::string root_key;
+    size_t node_off;
+    size_t edge_off;
+
+    count = 0;
+    int rval = FindSubtree(prefix, len, root_key, node_off, edge_off);
+    if(rval != MBError::SUCCESS)
+        return rval;
+    if(node_off == 0)
+    {
+        // The prefix ends in a leaf edge.
+        count = 1;
+        return MBError::SUCCESS;
+    }
+
+    // Depth-first walk of the subtree. The parent edge offset is kept with
+    // each node for the lock-free check.
+    std::vector<std::pair<size_t, size_t> > nodes;
+    nodes.push_back(std::make_pair(node_off, edge_off));
+    while(!nodes.empty())
+    {
+        std::pair<size_t, size_t> curr = nodes.back();
+        nodes.pop_back();
+        rval = CountNode(curr.first, curr.second, count, nodes);
+#ifdef __LOCK_FREE__
+        while(rval == MBError::TRY_AGAIN)
+        {
+            nanosleep((const struct timespec[]){{0, 10L}}, NULL);
+            rval = CountNode(curr.first, curr.second, count, nodes);
+        }
+#endif
+        if(rval != MBError::SUCCESS)
+            return rval;
+    }
+    return MBError::SUCCESS;
+}
+
+// Count the matches on the node and its edges. Child nodes are appended to
+// children. Nothing is changed if TRY_AGAIN is returned.
+int Dict::CountNode(size_t node_off, size_t parent_edge_off, int64_t &count,
+                    std::vector<std::pair<size_t, size_t> > &children)
+{
+    uint8_t node_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
+    EdgePtrs edge_ptrs;
+    MBData data;
+    std::string match_str;
+    size_t child_off;
+    size_t edge_off;
+    int match;
+    int64_t num = 0;
+    size_t num_children = children.size();
+#ifdef __LOCK_FREE__
+    LockFreeData snapshot;
+    lfree.ReaderLockFreeStart(snapshot);
+#endif
+
+    int rval = ReadNode(node_off, node_buff, edge_ptrs, match, data, false);
+    if(rval != MBError::SUCCESS)
+        return rval;
+    if(match != MATCH_NONE)
+        num++;
+    while(true)
+    {
+        edge_off = edge_ptrs.offset;
+        rval = ReadNextEdge(node_buff, edge_ptrs, match, data, match_str, child_off, false);
+        if(rval != MBError::SUCCESS)
+            break;
+        if(match != MATCH_NONE)
+            num++;
+        if(child_off > 0)
+            children.push_back(std::make_pair(child_off, edge_off));
+    }
+    if(rval != MBError::OUT_OF_BOUND)
+        return rval;
+
+#ifdef __LOCK_FREE__
+    if(lfree.ReaderLockFreeStop(snapshot, parent_edge_off) == MBError::TRY_AGAIN)
+    {
+        children.resize(num_children);
+        return MBError::TRY_AGAIN;
+    }
+#endif
+    count += num;
+    return MBError::SUCCESS;
+}
+
 int Dict::Remove(const uint8_t *key, int len)
 {
     MBData data(0, CONSTS::OPTION_FIND_AND_STORE_PARENT);
@@ -1103,9 +2444,13 @@ int Dict::Remove(const uint8_t *key, int len, MBData &data)
         return MBError::INVALID_ARG;
 
     int rval;
+    int key_len = len;
     rval = Find(key, len, data);
     if(rval == MBError::IN_DICT)
     {
+        // The data buffer is released by DeleteDataFromEdge.
+        if(hash_index != NULL)
+            hash_index->MarkPending(key, key_len);
         rval = DeleteDataFromEdge(data, data.edge_ptrs);
         while(rval == MBError::TRY_AGAIN)
         {
@@ -1124,16 +2469,246 @@ int Dict::Remove(const uint8_t *key, int len, MBData &data)
 
     if(rval == MBError::SUCCESS)
     {
+        if(key_filter != NULL)
+            key_filter->Remove(key, key_len);
+        if(hash_index != NULL)
+            hash_index->Remove(key, key_len);
         header->count--;
         if(header->count == 0)
         {
             RemoveAll();
         }
+        CheckHashIndex();
+    }
+
+    return rval;
+}
+
+// Remove all keys starting with the prefix. The edge covering the prefix
+// is unlinked from its parent node in the same way as removing a single
+// key. The nodes, edge labels and data buffers of the subtree are then
+// returned to the free lists without rewriting the subtree.
+int Dict::RemovePrefix(const uint8_t *prefix, int len, int64_t &count)
+{
+    count = 0;
+    if(!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+
+    std::string root_key;
+    size_t node_off;
+    size_t edge_off;
+    int rval = FindSubtree(prefix, len, root_key, node_off, edge_off);
+    if(rval != MBError::SUCCESS)
+        return rval;
+
+    SubtreeBuffers subtree;
+    rval = CollectSubtree(root_key, node_off, edge_off, subtree);
+    if(rval != MBError::SUCCESS)
+        return rval;
+    if(subtree.data_offs.empty())
+        return MBError::NOT_EXIST;
+
+    for(size_t i = 0; i < subtree.keys.size() && hash_index != NULL; i++)
+    {
+        hash_index->MarkPending(reinterpret_cast<const uint8_t*>(subtree.keys[i].data()),
+                                subtree.keys[i].size());
+    }
+
+    // Unlink the edge. Its parent node is removed too if it has no other
+    // edge and no match.
+    MBData data(0, CONSTS::OPTION_FIND_AND_STORE_PARENT);
+    const uint8_t *key = reinterpret_cast<const uint8_t*>(root_key.data());
+    len = root_key.size();
+    rval = Find(key, len, data);
+    if(rval == MBError::IN_DICT)
+        rval = mm.RemoveEdgeByIndex(data.edge_ptrs, data);
+    while(rval == MBError::TRY_AGAIN)
+    {
+        data.Clear();
+        len -= data.edge_ptrs.len_ptr[0];
+        rval = Find(key, len, data);
+        if(rval == MBError::IN_DICT)
+            rval = mm.RemoveEdgeByIndex(data.edge_ptrs, data);
+    }
+    if(rval != MBError::SUCCESS)
+    {
+        for(size_t i = 0; i < subtree.keys.size() && hash_index != NULL; i++)
+        {
+            hash_index->ClearPending(reinterpret_cast<const uint8_t*>(subtree.keys[i].data()),
+                                     subtree.keys[i].size());
+        }
+        return rval;
+    }
+
+    ReleaseSubtree(subtree);
+    for(size_t i = 0; i < subtree.keys.size(); i++)
+    {
+        key = reinterpret_cast<const uint8_t*>(subtree.keys[i].data());
+        if(key_filter != NULL)
+            key_filter->Remove(key, subtree.keys[i].size());
+        if(hash_index != NULL)
+            hash_index->Remove(key, subtree.keys[i].size());
+    }
+
+    count = subtree.data_offs.size();
+    header->count -= count;
+    if(header->count <= 0)
+        RemoveAll();
+    CheckHashIndex();
+    return MBError::SUCCESS;
+}
+
+// Apply the updates in the batch in key order. Each add continues from the
+// path of the previous add on the shared prefix. If SYNC_ON_WRITE is set,
+// the files are synced once after the batch instead of after every write.
+// Entries failing with IN_DICT or NOT_EXIST do not stop the batch.
+int Dict::Write(WriteBatch &batch)
+{
+    if(!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+
+    batch.Sort();
+    bool defer_sync = (options & CONSTS::SYNC_ON_WRITE);
+    if(defer_sync)
+    {
+        if(kv_file != NULL)
+            kv_file->SetSyncOnWrite(false);
+        mm.SetSyncOnWrite(false);
+    }
+
+    MBData data;
+    MBData rm_data(0, CONSTS::OPTION_FIND_AND_STORE_PARENT);
+    int rval = MBError::SUCCESS;
+    int num = batch.Count();
+    for(int i = 0; i < num; i++)
+    {
+        const WriteBatchEntry &entry = batch.GetEntry(i);
+        int rc;
+        if(entry.type == WRITE_BATCH_ADD)
+        {
+            data.options = 0;
+            data.buff = const_cast<uint8_t*>(batch.GetValue(entry));
+            data.data_len = entry.value_len;
+            rc = Add(batch.GetKey(entry), entry.key_len, data, entry.overwrite);
+        }
+        else
+        {
+            rc = Remove(batch.GetKey(entry), entry.key_len, rm_data);
+            rm_data.Clear();
+        }
+
+        if(rc == MBError::SUCCESS)
+            continue;
+        if(rval == MBError::SUCCESS)
+            rval = rc;
+        if(rc != MBError::IN_DICT && rc != MBError::NOT_EXIST)
+            break;
     }
+    data.buff = NULL;
 
+    if(defer_sync)
+    {
+        if(kv_file != NULL)
+            kv_file->SetSyncOnWrite(true);
+        mm.SetSyncOnWrite(true);
+        Flush();
+    }
     return rval;
 }
 
+// Collect the buffers under the edge at edge_off. The label of the edge
+// itself is released when the edge is removed.
+int Dict::CollectSubtree(const std::string &root_key, size_t node_off, size_t edge_off,
+                         SubtreeBuffers &subtree)
+{
+    bool rd_key = key_filter != NULL || hash_index != NULL;
+    EdgePtrs edge_ptrs;
+    subtree.num_edges = 0;
+    if(node_off == 0)
+    {
+        if(mm.ReadEdge(edge_off, edge_ptrs) != MBError::SUCCESS)
+            return MBError::READ_ERROR;
+        subtree.data_offs.push_back(Get6BInteger(edge_ptrs.offset_ptr));
+        if(rd_key)
+            subtree.keys.push_back(root_key);
+        return MBError::SUCCESS;
+    }
+
+    uint8_t node_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
+    MBData data;
+    std::string match_str;
+    std::string node_key;
+    size_t child_off;
+    int match;
+    int rval;
+    std::vector<std::pair<size_t, std::string> > nodes;
+    nodes.push_back(std::make_pair(node_off, root_key));
+    while(!nodes.empty())
+    {
+        node_off = nodes.back().first;
+        node_key.swap(nodes.back().second);
+        nodes.pop_back();
+
+        rval = ReadNode(node_off, node_buff, edge_ptrs, match, data, false);
+        if(rval != MBError::SUCCESS)
+            return rval;
+        subtree.node_offs.push_back(node_off);
+        if(match != MATCH_NONE)
+        {
+            subtree.data_offs.push_back(Get6BInteger(node_buff+2));
+            if(rd_key)
+                subtree.keys.push_back(node_key);
+        }
+
+        while((rval = ReadNextEdge(node_buff, edge_ptrs, match, data, match_str,
+                                   child_off, false)) == MBError::SUCCESS)
+        {
+            int edge_len = edge_ptrs.len_ptr[0];
+            if(edge_len == 0)
+                continue;
+            subtree.num_edges++;
+            if(edge_len > mm.GetLocalEdgeLen())
+                subtree.edge_strs.push_back(std::make_pair(Get5BInteger(edge_ptrs.ptr),
+                                                           edge_len - 1));
+
+            std::string child_key;
+            if(rd_key)
+            {
+                child_key = node_key;
+                child_key.push_back(node_buff[NODE_EDGE_KEY_FIRST+edge_ptrs.curr_nt-1]);
+                const uint8_t *label = mm.GetEdgeLabel(edge_ptrs.ptr, data.node_buff);
+                if(label == NULL)
+                    return MBError::READ_ERROR;
+                child_key.append(reinterpret_cast<const char*>(label), edge_len - 1);
+            }
+
+            if(match != MATCH_NONE)
+            {
+                subtree.data_offs.push_back(Get6BInteger(edge_ptrs.offset_ptr));
+                if(rd_key)
+                    subtree.keys.push_back(child_key);
+            }
+            if(child_off > 0)
+                nodes.push_back(std::make_pair(child_off, child_key));
+        }
+        if(rval != MBError::OUT_OF_BOUND)
+            return rval;
+    }
+    return MBError::SUCCESS;
+}
+
+void Dict::ReleaseSubtree(const SubtreeBuffers &subtree)
+{
+    for(size_t i = 0; i < subtree.data_offs.size(); i++)
+    {
+        if(ReleaseBuffer(subtree.data_offs[i]) != MBError::SUCCESS)
+            Logger::Log(LOG_LEVEL_WARN, "failed to release data buffer %llu",
+                        subtree.data_offs[i]);
+    }
+
+    mm.ReleaseSubtree(subtree.node_offs, subtree.edge_strs, subtree.num_edges);
+}
+
 int Dict::RemoveAll()
 {
     int rval = MBError::SUCCESS;;
@@ -1155,6 +2730,11 @@ int Dict::RemoveAll()
 
     header->eviction_bucket_index = 0;
     header->num_update = 0;
+
+    if(key_filter != NULL)
+        key_filter->Clear();
+    if(hash_index != NULL)
+        hash_index->Clear();
     return rval;
 }
 
@@ -1270,9 +2850,8 @@ int Dict::ReleaseBuffer(size_t offset)
 }
 
 int Dict::UpdateDataBuffer(EdgePtrs &edge_ptrs, bool overwrite, const uint8_t *buff,
-                           int len, bool &inc_count)
+                           int len, bool &inc_count, size_t &data_off)
 {
-    size_t data_off;
 
     if(edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
     {
@@ -1400,6 +2979,102 @@ void Dict::ResetSlidingWindow() const
         header->shm_data_sliding_start.store(0, std::memory_order_relaxed);
 }
 
+KeyFilter* Dict::GetKeyFilter() const
+{
+    return key_filter;
+}
+
+int Dict::RebuildKeyFilter(const DB &db)
+{
+    if(!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+    if(key_filter == NULL)
+        return MBError::NOT_INITIALIZED;
+
+    key_filter->RebuildStart();
+    for(DB::iterator iter = db.begin(false, false); iter != db.end(); ++iter)
+        key_filter->RebuildAdd(reinterpret_cast<const uint8_t*>(iter.key.data()),
+                               iter.key.size());
+    key_filter->RebuildFinish();
+    return MBError::SUCCESS;
+}
+
+HashIndex* Dict::GetHashIndex() const
+{
+    return hash_index;
+}
+
+// Walk the trie and add every key to the hash index.
+int Dict::RebuildHashIndex()
+{
+    if(!(options & CONSTS::ACCESS_MODE_WRITER))
+        return MBError::NOT_ALLOWED;
+    if(hash_index == NULL)
+        return MBError::NOT_INITIALIZED;
+
+    hash_index->RebuildStart();
+    uint8_t node_buff[NUM_ALPHABET+NODE_EDGE_KEY_FIRST];
+    EdgePtrs edge_ptrs;
+    MBData data;
+    std::string match_str;
+    std::string node_key;
+    size_t node_off;
+    size_t child_off;
+    int match;
+    int rval;
+    std::vector<std::pair<size_t, std::string> > nodes;
+    nodes.push_back(std::make_pair(mm.GetRootOffset(), std::string()));
+    while(!nodes.empty())
+    {
+        node_off = nodes.back().first;
+        node_key.swap(nodes.back().second);
+        nodes.pop_back();
+
+        rval = ReadNode(node_off, node_buff, edge_ptrs, match, data, false);
+        if(rval != MBError::SUCCESS)
+            return rval;
+        if(match != MATCH_NONE)
+            hash_index->Add(reinterpret_cast<const uint8_t*>(node_key.data()),
+                            node_key.size(), Get6BInteger(node_buff+2));
+
+        while((rval = ReadNextEdge(node_buff, edge_ptrs, match, data, match_str,
+                                   child_off, false)) == MBError::SUCCESS)
+        {
+            int edge_len = edge_ptrs.len_ptr[0];
+            if(edge_len == 0)
+                continue;
+
+            std::string child_key = node_key;
+            child_key.push_back(node_buff[NODE_EDGE_KEY_FIRST+edge_ptrs.curr_nt-1]);
+            const uint8_t *label = mm.GetEdgeLabel(edge_ptrs.ptr, data.node_buff);
+            if(label == NULL)
+                return MBError::READ_ERROR;
+            child_key.append(reinterpret_cast<const char*>(label), edge_len - 1);
+
+            if(match != MATCH_NONE)
+                hash_index->Add(reinterpret_cast<const uint8_t*>(child_key.data()),
+                                child_key.size(), Get6BInteger(edge_ptrs.offset_ptr));
+            if(child_off > 0)
+                nodes.push_back(std::make_pair(child_off, child_key));
+        }
+        if(rval != MBError::OUT_OF_BOUND)
+            return rval;
+    }
+    hash_index->RebuildFinish();
+    return MBError::SUCCESS;
+}
+
+// The hash index is disabled if it gets full. Rebuild it once enough keys
+// are removed.
+void Dict::CheckHashIndex()
+{
+    if(hash_index != NULL && hash_index->NeedRebuild(header->count))
+    {
+        Logger::Log(LOG_LEVEL_INFO, "rebuilding hash index");
+        RebuildHashIndex();
+    }
+}
+
 LockFree* Dict::GetLockFreePtr()
 {
     return &lfree;
@@ -1448,7 +3123,7 @@ int Dict::ExceptionRecovery()
 #ifdef __LOCK_FREE__
             lfree.WriterLockFreeStart(header->excep_lf_offset);
 #endif
-            mm.WriteData(header->excep_buff, EDGE_SIZE, header->excep_lf_offset);
+            mm.WriteData(mm.GetExcepEdgeBuff(), mm.GetEdgeSize(), header->excep_lf_offset);
             header->count++;
 	    break;
         case EXCEP_STATUS_ADD_DATA_OFF:
@@ -1478,7 +3153,7 @@ int Dict::ExceptionRecovery()
 #ifdef __LOCK_FREE__
             lfree.WriterLockFreeStart(header->excep_lf_offset);
 #endif
-            mm.WriteData(DictMem::empty_edge, EDGE_SIZE, header->excep_lf_offset);
+            mm.WriteData(DictMem::empty_edge, mm.GetEdgeSize(), header->excep_lf_offset);
             header->count--;
             break;
         case EXCEP_STATUS_RC_NODE:
@@ -21,15 +21,67 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include "drm_base.h"
 #include "dict_mem.h"
 #include "rollable_file.h"
 #include "mb_data.h"
 #include "lock_free.h"
+#include "hot_node_cache.h"
+#include "key_filter.h"
+#include "hash_index.h"
+#include "glob_pattern.h"
 
 namespace mabain {
 
+class DB;
+
+// Per-key lookup state for Dict::MultiFind
+typedef struct _MultiFindState
+{
+    const uint8_t *key_start;
+    int len_start;
+    const uint8_t *key;
+    int len;
+    int stage;
+    size_t edge_off;
+    size_t edge_offset_prev;
+    LockFreeData snapshot;
+} MultiFindState;
+
+// Buffers of a subtree released by Dict::RemovePrefix
+typedef struct _SubtreeBuffers
+{
+    std::vector<size_t> node_offs;
+    std::vector<size_t> data_offs;
+    // offsets and sizes of the edge labels not stored in the edges
+    std::vector<std::pair<size_t, int> > edge_strs;
+    int64_t num_edges;
+    // only collected if the key filter or the hash index is used
+    std::vector<std::string> keys;
+} SubtreeBuffers;
+
+// Node to visit in Dict::FindFuzzy. row is the edit distance row of the
+// key of the node against the search key.
+typedef struct _FuzzyNode
+{
+    size_t node_off;
+    size_t parent_edge_off;
+    std::string key;
+    std::vector<int> row;
+} FuzzyNode;
+
+// Node to visit in Dict::FindMatching. state is the pattern state after
+// reading the key of the node.
+typedef struct _GlobNode
+{
+    size_t node_off;
+    size_t parent_edge_off;
+    std::string key;
+    std::vector<uint8_t> state;
+} GlobNode;
+
 // dictionary class
 // This is the work horse class for basic db operations (add, find and remove).
 class Dict : public DRMBase
@@ -39,7 +91,8 @@ public:
          int db_options, size_t memsize_index, size_t memsize_data,
          uint32_t block_sz_index, uint32_t block_sz_data,
          int max_num_index_blk, int max_num_data_blk,
-         int64_t entry_per_bucket);
+         int64_t entry_per_bucket, size_t key_filter_size = 0,
+         size_t hash_index_size = 0);
     virtual ~Dict();
     void Destroy();
 
@@ -49,13 +102,32 @@ public:
     int Add(const uint8_t *key, int len, MBData &data, bool overwrite);
     // Find value by key
     int Find(const uint8_t *key, int len, MBData &data);
+    // Find value by key starting from the path of the previous lookup
+    int Find(const uint8_t *key, int len, MBData &data, FindCursor &cursor);
+    // Find values for a batch of keys
+    void MultiFind(const uint8_t *const *keys, const int *lens, int num,
+                   MBData *data, int *rvals);
     // Find value by key using prefix match
     int FindPrefix(const uint8_t *key, int len, MBData &data);
+    // Find all prefixes of key in DB ordered by the prefix length
+    int FindAllPrefixes(const uint8_t *key, int len, std::vector<PrefixMatch> &matches);
+    // Find the keys within max_edits edit distance of key. At most limit
+    // matches with the smallest distance are returned.
+    int FindFuzzy(const uint8_t *key, int len, int max_edits, int limit,
+                  std::vector<FuzzyMatch> &matches);
+    // Call fn for the keys matching the pattern
+    int FindMatching(const GlobPattern &glob, const MatchCallback &fn);
+    // Read the value at the data offset
+    int ReadValue(MBData &data, size_t data_off) const;
     // Delete entry by key
     int Remove(const uint8_t *key, int len);
     // Delete entry by key
     int Remove(const uint8_t *key, int len, MBData &data);
 
+    // Apply the updates in the batch
+    int Write(WriteBatch &batch);
+    // Delete all entries starting with the prefix
+    int RemovePrefix(const uint8_t *prefix, int len, int64_t &count);
     // Delete all entries
     int RemoveAll();
 
@@ -75,6 +147,13 @@ public:
 
     LockFree* GetLockFreePtr();
 
+    KeyFilter* GetKeyFilter() const;
+    // Repopulate the key filter with all keys in DB
+    int  RebuildKeyFilter(const DB &db);
+    HashIndex* GetHashIndex() const;
+    // Repopulate the hash index with all keys in DB
+    int  RebuildHashIndex();
+
     // Used for DB iterator
     int  ReadNextEdge(const uint8_t *node_buff, EdgePtrs &edge_ptrs, int &match,
                  MBData &data, std::string &match_str, size_t &node_off,
@@ -85,6 +164,12 @@ public:
                  size_t &data_offset, size_t &data_link_offset);
     int  ReadRootNode(uint8_t *node_buff, EdgePtrs &edge_ptrs, int &match,
                  MBData &data) const;
+    // Find the edge that covers the prefix. root_key is the key at the end
+    // of the edge. node_off is zero if the edge points to data.
+    int  FindSubtree(const uint8_t *prefix, int len, std::string &root_key,
+                 size_t &node_off, size_t &edge_off);
+    // Count the keys starting with the prefix without reading values
+    int  CountPrefix(const uint8_t *prefix, int len, int64_t &count);
 
     // Shared memory mutex
     int InitShmMutex();
@@ -98,13 +183,42 @@ public:
     int  ExceptionRecovery();
 
 private:
+    int AddKey(const uint8_t *key, int len, MBData &data, bool overwrite, bool &inc_count,
+               size_t &data_offset);
+    int AddNextEdges(EdgePtrs &edge_ptrs, const uint8_t *key, int len, MBData &data,
+                     bool overwrite, bool &inc_count, size_t &data_offset);
+    int FindHashIndex(const uint8_t *key, int len, MBData &data);
     int Find_Internal(size_t root_off, const uint8_t *key, int len, MBData &data);
     int FindPrefix_Internal(size_t root_off, const uint8_t *key, int len, MBData &data);
+    int FindAllPrefixes_Internal(size_t root_off, const uint8_t *key, int len,
+                                 std::vector<PrefixMatch> &matches);
+    int FindFuzzy_Internal(size_t root_off, const uint8_t *key, int len, int max_edits,
+                           int limit, std::vector<FuzzyMatch> &matches);
+    int FindFuzzyNode(const uint8_t *key, int len, int bound, const FuzzyNode &node,
+                      std::vector<FuzzyNode> &nodes, std::vector<FuzzyMatch> &matches);
+    int MatchNode(const GlobPattern &glob, const GlobNode &node, std::vector<GlobNode> &nodes,
+                  std::vector<std::pair<std::string, std::string> > &kvs);
+    int FindSubtree_Internal(const uint8_t *prefix, int len, std::string &root_key,
+                             size_t &node_off, size_t &edge_off);
+    int CountNode(size_t node_off, size_t parent_edge_off, int64_t &count,
+                  std::vector<std::pair<size_t, size_t> > &children);
+    int CollectSubtree(const std::string &root_key, size_t node_off, size_t edge_off,
+                       SubtreeBuffers &subtree);
+    void ReleaseSubtree(const SubtreeBuffers &subtree);
+    void CheckHashIndex();
+    int FindNextEdges(const uint8_t *key, int len, MBData &data, LockFreeData *snapshot_ptr,
+                      FindCursor *cursor = NULL);
+    int FindCursor_Internal(const uint8_t *key, int len, MBData &data, FindCursor &cursor);
+    void MultiFindStart(const uint8_t *key, int len, MultiFindState &st) const;
+    bool MultiFindStep(MultiFindState &st, MBData &data, int &rval);
+    bool MultiFindMatchEdge(MultiFindState &st, MBData &data, int &rval);
     int ReleaseBuffer(size_t offset);
     int UpdateDataBuffer(EdgePtrs &edge_ptrs, bool overwrite, const uint8_t *buff,
-                         int len, bool &inc_count);
+                         int len, bool &inc_count, size_t &data_off);
     int ReadDataFromEdge(MBData &data, const EdgePtrs &edge_ptrs) const;
     int ReadDataFromNode(MBData &data, const uint8_t *node_ptr) const;
+    int ReadDataBuffer(MBData &data, size_t data_off) const;
+    int ReadDataBuffer(std::string &value, size_t data_off) const;
     int DeleteDataFromEdge(MBData &data, EdgePtrs &edge_ptrs);
     int ReadNodeMatch(size_t node_off, int &match, MBData &data) const;
 
@@ -117,6 +231,15 @@ private:
     int status;
 
     LockFree lfree;
+
+    // Reader only cache of the top trie levels
+    HotNodeCache *hot_cache;
+    // Negative lookup filter shared by all handles
+    KeyFilter *key_filter;
+    // Exact-match index shared by all handles
+    HashIndex *hash_index;
+    // Writer only: path of the previous Add
+    FindCursor add_cursor;
 };
 
 }
@@ -27,11 +27,15 @@
 #include "integer_4b_5b.h"
 #include "version.h"
 #include "resource_pool.h"
+#include "mb_byte_scan.h"
 
 #define OFFSET_SIZE_P1             7
 
 #define MAX_BUFFER_RESERVE_SIZE    8192
 #define NUM_BUFFER_RESERVE         MAX_BUFFER_RESERVE_SIZE/BUFFER_ALIGNMENT
+// Nodes with many wide edges are bigger than MAX_BUFFER_RESERVE_SIZE.
+#define MAX_WIDE_BUFFER_RESERVE_SIZE 16384
+#define NUM_WIDE_BUFFER_RESERVE    MAX_WIDE_BUFFER_RESERVE_SIZE/BUFFER_ALIGNMENT
 
 namespace mabain {
 
@@ -48,14 +52,23 @@ namespace mabain {
 //                  flag (0x02) indicating this edge owns the allocated bufifer
 // *******X*****    leading byte of next node offset or data offset
 // ********xxxxX    next node offset of data offset
+// WIDE EDGE FORMAT (INDEX_FORMAT_WIDE_EDGE in version[3])
+// Edge size is 32 bytes. The first 13 bytes are the same as above. Labels up to
+// 25 bytes are inline; the rest of the label after the first five bytes is kept
+// in the last 19 bytes.
 /////////////////////////////////////////////////////////////////////////////////////
 // NODE MEMORY LAYOUT
-// Node size is 1 + 1 + 6 + NT + NT*13
+// Node size is 1 + 1 + 6 + NT + NT*EDGE_SIZE
 // X************   flags (0x01 bit indicating match found)
 // *X***********   nt-1, nt is the number of edges for this node.
 // **XXXXXX*****   data offset
 // NT bytes of first characters of each edge
 // NT edges        NT*13 bytes
+// ADAPTIVE INDEX FORMAT (INDEX_FORMAT_ADAPTIVE in version[3])
+// Nodes with less than 17 edges keep the layout above.
+// X************   flag (0x02) 256-byte child index after the edges; index[c]
+//                     is the edge index plus one for first character c.
+// X************   flag (0x04) node has 256 edges and edge i starts with i.
 // Since we use 6-byte to store both the index and data offset, the maximum size for
 // data and index is 281474976710655 bytes (or 255T).
 /////////////////////////////////////////////////////////////////////////////////////
@@ -70,6 +83,7 @@ DictMem::DictMem(const std::string &mbdir, bool init_header, size_t memsize,
     root_offset = 0;
     root_offset_rc = 0;
     node_ptr = NULL;
+    in_place_read = !(mode & CONSTS::ACCESS_MODE_WRITER);
 
     assert(sizeof(IndexHeader) <= (unsigned) RollableFile::page_size);
     bool map_hdr = true;
@@ -99,7 +113,13 @@ DictMem::DictMem(const std::string &mbdir, bool init_header, size_t memsize,
     {
         memset(header, 0, sizeof(IndexHeader));
         header->index_block_size = block_size;
+        header->version[3] = 0;
+        if(mode & CONSTS::ADAPTIVE_NODE_FORMAT)
+            header->version[3] |= INDEX_FORMAT_ADAPTIVE;
+        if(mode & CONSTS::WIDE_EDGE)
+            header->version[3] |= INDEX_FORMAT_WIDE_EDGE;
     }
+    InitEdgeFormat();
     kv_file = new RollableFile(mbdir + "_mabain_i",
                                static_cast<size_t>(header->index_block_size),
                                memsize, mode, max_num_blk);
@@ -122,11 +142,14 @@ DictMem::DictMem(const std::string &mbdir, bool init_header, size_t memsize,
     for(int i = 0; i < NUM_ALPHABET; i++)
     {
         int nt = i + 1;
-        node_size[i] = 1 + 1 + OFFSET_SIZE + nt + nt*EDGE_SIZE;
+        node_size[i] = 1 + 1 + OFFSET_SIZE + nt + nt*edge_size;
     }
 
-    node_ptr = new uint8_t[ node_size[NUM_ALPHABET-1] ];
-    free_lists = new FreeList(mbdir+"_ibfl", BUFFER_ALIGNMENT, NUM_BUFFER_RESERVE);
+    node_ptr = new uint8_t[ node_size[NUM_ALPHABET-1] + NUM_ALPHABET ];
+    if(edge_size == WIDE_EDGE_SIZE)
+        free_lists = new FreeList(mbdir+"_ibfl", BUFFER_ALIGNMENT, NUM_WIDE_BUFFER_RESERVE);
+    else
+        free_lists = new FreeList(mbdir+"_ibfl", BUFFER_ALIGNMENT, NUM_BUFFER_RESERVE);
 
     if(init_header)
     {
@@ -134,7 +157,6 @@ DictMem::DictMem(const std::string &mbdir, bool init_header, size_t memsize,
         header->version[0] = version[0];
         header->version[1] = version[1];
         header->version[2] = version[2];
-        header->version[3] = 0;
         // Cannot set is_valid to true.
         // More init to be dobe in InitRootNode.
     }
@@ -142,13 +164,54 @@ DictMem::DictMem(const std::string &mbdir, bool init_header, size_t memsize,
     {
         is_valid = true;
     }
-    Logger::Log(LOG_LEVEL_INFO, "set up mabain db version to %u.%u.%u",
-                header->version[0], header->version[1], header->version[2]);
+    Logger::Log(LOG_LEVEL_INFO, "set up mabain db version to %u.%u.%u index format %u",
+                header->version[0], header->version[1], header->version[2],
+                header->version[3]);
 }
 
 // The whole edge is initizlized to zero.
 const uint8_t DictMem::empty_edge[] = {0};
 
+// The edge format is fixed when the DB is created.
+void DictMem::InitEdgeFormat()
+{
+    if(header->version[3] & INDEX_FORMAT_WIDE_EDGE)
+    {
+        edge_size = WIDE_EDGE_SIZE;
+        local_edge_len = WIDE_LOCAL_EDGE_LEN;
+    }
+    else
+    {
+        edge_size = EDGE_SIZE;
+        local_edge_len = LOCAL_EDGE_LEN;
+    }
+}
+
+// Set the label of a new edge. label does not include the first character.
+// Return true if a buffer is reserved for the label.
+bool DictMem::SetEdgeLabel(uint8_t *edge, const uint8_t *label, int len,
+                           bool map_new_sliding)
+{
+    if(len > local_edge_len)
+    {
+        size_t edge_str_off;
+        ReserveData(label, len-1, edge_str_off, map_new_sliding);
+        Write5BInteger(edge, edge_str_off);
+        return true;
+    }
+
+    if(len > LOCAL_EDGE_LEN)
+    {
+        memcpy(edge, label, LOCAL_EDGE_LEN_M1);
+        memcpy(edge + EDGE_SIZE, label + LOCAL_EDGE_LEN_M1, len - LOCAL_EDGE_LEN);
+    }
+    else if(len > 1)
+    {
+        memcpy(edge, label, len-1);
+    }
+    return false;
+}
+
 void DictMem::InitRootNode()
 {
 #ifdef __DEBUG__
@@ -206,16 +269,7 @@ void DictMem::AddRootEdge(EdgePtrs &edge_ptrs, const uint8_t *key,
                          int len, size_t data_offset)
 {
     edge_ptrs.len_ptr[0] = len;
-    if(len > LOCAL_EDGE_LEN)
-    {
-        size_t edge_str_off;
-        ReserveData(key+1, len-1, edge_str_off);
-        Write5BInteger(edge_ptrs.ptr, edge_str_off);
-    }
-    else
-    {
-        memcpy(edge_ptrs.ptr, key+1, len-1);
-    }
+    SetEdgeLabel(edge_ptrs.ptr, key+1, len);
 
     edge_ptrs.flag_ptr[0] = EDGE_FLAG_DATA_OFF;
     Write6BInteger(edge_ptrs.offset_ptr, data_offset);
@@ -235,41 +289,13 @@ void DictMem::UpdateTailEdge(EdgePtrs &edge_ptrs, int match_len, MBData &data,
 {
     int edge_len = edge_ptrs.len_ptr[0] - match_len;
     tail_edge.len_ptr[0] = edge_len;
-    if(edge_len > LOCAL_EDGE_LEN)
-    {
-        // Old key len must be greater than LOCAL_EDGE_LEN too.
-        // Load the string with length edge_len.
-        size_t new_key_off;
-        size_t edge_str_off = Get5BInteger(edge_ptrs.ptr);
-        if(ReadData(data.node_buff, edge_len, edge_str_off + match_len - 1)
-                   != edge_len)
-            throw (int) MBError::READ_ERROR;          
-        new_key_first = data.node_buff[0];
-
-        // Reserve the key buffer
-        ReserveData(data.node_buff+1, edge_len-1, new_key_off, map_new_sliding);
+    // The tail of the old label becomes the label of the tail edge.
+    const uint8_t *label = GetEdgeLabel(edge_ptrs.ptr, data.node_buff);
+    if(label == NULL)
+        throw (int) MBError::READ_ERROR;
+    new_key_first = label[match_len - 1];
+    if(SetEdgeLabel(tail_edge.ptr, label + match_len, edge_len, map_new_sliding))
         map_new_sliding = false;
-        Write5BInteger(tail_edge.ptr, new_key_off);
-    }
-    else
-    {
-        if(edge_ptrs.len_ptr[0] > LOCAL_EDGE_LEN)
-        {
-            if(ReadData(data.node_buff, edge_len, Get5BInteger(edge_ptrs.ptr)+match_len-1)
-                       != edge_len)
-                throw (int) MBError::READ_ERROR;
-            new_key_first = data.node_buff[0];
-            if(edge_len > 1)
-                memcpy(tail_edge.ptr, data.node_buff+1, edge_len-1);
-        }
-        else
-        {
-            // Both new and old keys are local
-            new_key_first = edge_ptrs.ptr[match_len - 1];
-            if(edge_len > 1)
-                memcpy(tail_edge.ptr, edge_ptrs.ptr+match_len, edge_len-1);
-        }
-    }
 
     // 7 = 1 + OFFSET_SIZE
     memcpy(tail_edge.flag_ptr, edge_ptrs.flag_ptr, OFFSET_SIZE_P1);
@@ -280,33 +306,18 @@ void DictMem::UpdateHeadEdge(EdgePtrs &edge_ptrs, int match_len,
                              MBData &data, int &release_buffer_size,
                              size_t &edge_str_off, bool &map_new_sliding)
 {
-    int match_len_m1 = match_len - 1;
-    if(edge_ptrs.len_ptr[0] > LOCAL_EDGE_LEN)
+    // An inline label is truncated in place.
+    if(edge_ptrs.len_ptr[0] > local_edge_len)
     {
-        if(match_len <= LOCAL_EDGE_LEN)
-        {
-            edge_str_off = Get5BInteger(edge_ptrs.ptr);
-            release_buffer_size = edge_ptrs.len_ptr[0] - 1;
-            // Old key is remote but new key is local. Need to read the old key.
-            if(match_len_m1 > 0)
-            {
-                if(ReadData(edge_ptrs.ptr, match_len_m1, edge_str_off) != match_len_m1)
-                    throw (int) MBError::READ_ERROR;
-            }
-        }
-        else
-        {
-            edge_str_off = Get5BInteger(edge_ptrs.ptr);
-            release_buffer_size = edge_ptrs.len_ptr[0] - 1;
-            // Load the string with length edge_len - 1
-            if(ReadData(data.node_buff, match_len_m1, edge_str_off) != match_len_m1)
-                throw (int) MBError::READ_ERROR;
-            // Reserve the key buffer
-            size_t new_key_off;
-            ReserveData(data.node_buff, match_len_m1, new_key_off, map_new_sliding);
+        edge_str_off = Get5BInteger(edge_ptrs.ptr);
+        release_buffer_size = edge_ptrs.len_ptr[0] - 1;
+        // Load the head of the old label
+        int match_len_m1 = match_len - 1;
+        if(match_len_m1 > 0 &&
+           ReadData(data.node_buff, match_len_m1, edge_str_off) != match_len_m1)
+            throw (int) MBError::READ_ERROR;
+        if(SetEdgeLabel(edge_ptrs.ptr, data.node_buff, match_len, map_new_sliding))
             map_new_sliding = false;
-            Write5BInteger(edge_ptrs.ptr, new_key_off);
-        }
     }
 
     edge_ptrs.len_ptr[0] = match_len;
@@ -407,18 +418,7 @@ int DictMem::AddLink(EdgePtrs &edge_ptrs, int match_len, const uint8_t *key,
 
     // Update the new edge
     new_edge_ptrs[1].len_ptr[0] = key_len;
-    if(key_len > LOCAL_EDGE_LEN)
-    {
-        size_t new_key_off;
-        ReserveData(key+1, key_len-1, new_key_off, map_new_sliding);
-        Write5BInteger(new_edge_ptrs[1].ptr, new_key_off);
-    }
-    else
-    {
-        // edge key is local
-        if(key_len > 1)
-            memcpy(new_edge_ptrs[1].ptr, key+1, key_len-1);
-    }
+    SetEdgeLabel(new_edge_ptrs[1].ptr, key+1, key_len, map_new_sliding);
     // Indicate this new edge holds a data offset
     new_edge_ptrs[1].flag_ptr[0] = EDGE_FLAG_DATA_OFF;
     Write6BInteger(new_edge_ptrs[1].offset_ptr, data_off);
@@ -453,7 +453,8 @@ int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
     uint8_t* node;
     bool map_new_sliding = false;
 
-    node_move = ReserveNode(nt, node_ptrs.offset, node);
+    uint8_t layout_flags = NodeLayoutFlags(nt);
+    node_move = ReserveNode(nt, node_ptrs.offset, node, layout_flags);
     if(node_move)
         map_new_sliding = true;
     InitNodePtrs(node, nt, node_ptrs);
@@ -461,6 +462,7 @@ int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
     // Load the old node
     size_t old_node_off = Get6BInteger(edge_ptrs.offset_ptr);
     int release_node_index = -1;
+    uint8_t release_node_flags = FLAG_NODE_NONE;
     if(nt == 0)
     {
         // Change from empty node to node with one edge
@@ -482,13 +484,16 @@ int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
         int copy_size = NODE_EDGE_KEY_FIRST + nt;
         if(ReadData(node_ptrs.ptr, copy_size, old_node_off) != copy_size)
             return MBError::READ_ERROR;
-        if(ReadData(node_ptrs.ptr+copy_size+1, EDGE_SIZE*nt, old_node_off+copy_size) !=
-                    EDGE_SIZE*nt)
+        if(ReadData(node_ptrs.ptr+copy_size+1, edge_size*nt, old_node_off+copy_size) !=
+                    edge_size*nt)
             return MBError::READ_ERROR;
 
         release_node_index = nt - 1;
+        release_node_flags = node[0];
+        node[0] &= FLAG_NODE_MATCH;
     }
 
+    node[0] |= layout_flags;
     node[1] = static_cast<uint8_t>(nt);
 
     // Update the first edge key character for the new edge
@@ -500,28 +505,18 @@ int DictMem::UpdateNode(EdgePtrs &edge_ptrs, const uint8_t *key, int key_len,
     EdgePtrs new_edge_ptrs;
     InitEdgePtrs(node_ptrs, nt, new_edge_ptrs);
     new_edge_ptrs.len_ptr[0] = key_len;
-    if(key_len > LOCAL_EDGE_LEN)
-    {
-        size_t new_key_off;
-        ReserveData(key+1, key_len-1, new_key_off, map_new_sliding);
-        Write5BInteger(new_edge_ptrs.ptr, new_key_off);
-    }
-    else
-    {
-        // edge key is local
-        if(key_len > 1)
-            memcpy(new_edge_ptrs.ptr, key+1, key_len-1);
-    }
+    SetEdgeLabel(new_edge_ptrs.ptr, key+1, key_len, map_new_sliding);
 
     // Indicate this new edge holds a data offset
     new_edge_ptrs.flag_ptr[0] = EDGE_FLAG_DATA_OFF;
     Write6BInteger(new_edge_ptrs.offset_ptr, data_off);
 
+    BuildNodeIndex(node);
     if(node_move)
-        WriteData(node, node_size[nt], node_ptrs.offset);
+        WriteData(node, GetNodeSize(nt, layout_flags), node_ptrs.offset);
 
     if(release_node_index >= 0)
-        ReleaseNode(old_node_off, release_node_index);
+        ReleaseNode(old_node_off, release_node_index, release_node_flags);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStart(edge_ptrs.offset);
 #endif
@@ -547,47 +542,29 @@ bool DictMem::FindNext(const unsigned char *key, int keylen, int &match_len,
 #ifdef __DEBUG__
     assert(node_off != 0);
 #endif
-    if(ReadData(key_tmp, 1, node_off+1) != 1)
+    uint8_t node_hdr[2];
+    if(ReadData(node_hdr, 2, node_off) != 2)
         return false;
-    int nt = key_tmp[0];
+    int nt = node_hdr[1];
     edge_ptr.curr_nt = nt;
     nt++;
-    // Load edge key first
-    node_off += NODE_EDGE_KEY_FIRST;
-    if(ReadData(key_tmp, nt, node_off) != nt)
-        return false;
     int i;
-    for(i = 0; i < nt; i++)
-    {
-        if(key_tmp[i] == key[0])
-            break;
-    }
-
-    if(i >= nt)
+    if(FindEdgeIndex(node_off, node_hdr, key_tmp, key[0], i) != MBError::SUCCESS)
         return false;
+    node_off += NODE_EDGE_KEY_FIRST;
 
     match_len = 1;
 
     // Load the new edge
-    edge_ptr.offset = node_off + nt + i*EDGE_SIZE;
-    if(ReadData(header->excep_buff, EDGE_SIZE, edge_ptr.offset) != EDGE_SIZE)
+    edge_ptr.offset = node_off + nt + i*edge_size;
+    if(ReadData(GetExcepEdgeBuff(), edge_size, edge_ptr.offset) != edge_size)
         return false;
-    uint8_t *key_string_ptr;
     int len = edge_ptr.len_ptr[0] - 1;
-    if(len > LOCAL_EDGE_LEN_M1)
-    {
-        if(ReadData(key_tmp, len, Get5BInteger(edge_ptr.ptr)) != len)
-            return false;
-        key_string_ptr = key_tmp;
-    }
-    else if(len > 0)
-    {
-        key_string_ptr = header->excep_buff;
-    }
-    else
-    {
+    if(len <= 0)
         return true;
-    }
+    const uint8_t *key_string_ptr = GetEdgeLabel(GetExcepEdgeBuff(), key_tmp);
+    if(key_string_ptr == NULL)
+        return false;
 
     for(i = 1; i < keylen; i++)
     {
@@ -601,13 +578,13 @@ bool DictMem::FindNext(const unsigned char *key, int keylen, int &match_len,
 
 // Reserve buffer for a new node.
 // The allocated in-memory buffer must be initialized to zero.
-bool DictMem::ReserveNode(int nt, size_t &offset, uint8_t* &ptr)
+bool DictMem::ReserveNode(int nt, size_t &offset, uint8_t* &ptr, uint8_t flags)
 {
 #ifdef __DEBUG__
     assert(nt >= 0 && nt < 256);
 #endif
 
-    int buf_size = free_lists->GetAlignmentSize(node_size[nt]);
+    int buf_size = free_lists->GetAlignmentSize(GetNodeSize(nt, flags));
     int buf_index = free_lists->GetBufferIndex(buf_size);
 
     header->n_states++;
@@ -705,18 +682,183 @@ void DictMem::ReserveData(const uint8_t* key, int size, size_t &offset,
 }
 
 // Release node buffer
-void DictMem::ReleaseNode(size_t offset, int nt)
+void DictMem::ReleaseNode(size_t offset, int nt, uint8_t flags)
 {
     if(nt < 0)
         return;
 
-    int buf_index = free_lists->GetBufferIndex(node_size[nt]);
+    int size = GetNodeSize(nt, flags);
+    int buf_index = free_lists->GetBufferIndex(size);
     int rval = free_lists->AddBufferByIndex(buf_index, offset);
     if(rval == MBError::SUCCESS)
         header->n_states--;
     else
         Logger::Log(LOG_LEVEL_ERROR, "failed to release node buffer");
-    header->pending_index_buff_size += free_lists->GetAlignmentSize(node_size[nt]);
+    header->pending_index_buff_size += free_lists->GetAlignmentSize(size);
+}
+
+void DictMem::ReleaseSubtree(const std::vector<size_t> &node_offs,
+                             const std::vector<std::pair<size_t, int> > &edge_strs,
+                             int64_t num_edges)
+{
+    for(size_t i = 0; i < edge_strs.size(); i++)
+        ReleaseBuffer(edge_strs[i].first, edge_strs[i].second);
+
+    uint8_t node_hdr[NODE_EDGE_KEY_FIRST];
+    for(size_t i = 0; i < node_offs.size(); i++)
+    {
+        if(ReadData(node_hdr, NODE_EDGE_KEY_FIRST, node_offs[i]) != NODE_EDGE_KEY_FIRST)
+        {
+            Logger::Log(LOG_LEVEL_WARN, "failed to read node %llu", node_offs[i]);
+            continue;
+        }
+        ReleaseNode(node_offs[i], node_hdr[1], node_hdr[0]);
+    }
+    header->n_edges -= num_edges;
+}
+
+// The edge must be initialized to zero.
+void DictMem::InitNodeEdge(uint8_t *edge, const NodeEdge &node_edge)
+{
+    int len = static_cast<int>(node_edge.label.size());
+    edge[EDGE_LEN_POS] = static_cast<uint8_t>(len);
+    SetEdgeLabel(edge, reinterpret_cast<const uint8_t*>(node_edge.label.data()) + 1, len);
+    if(node_edge.leaf)
+        edge[EDGE_FLAG_POS] = EDGE_FLAG_DATA_OFF;
+    Write6BInteger(edge + EDGE_FLAG_POS + 1, node_edge.offset);
+}
+
+size_t DictMem::AddNode(bool match, size_t data_off, const std::vector<NodeEdge> &edges)
+{
+    int nt = static_cast<int>(edges.size()) - 1;
+#ifdef __DEBUG__
+    assert(nt >= 0 && nt < NUM_ALPHABET);
+#endif
+
+    // Edge labels are reserved before the node. Reserving a label may move
+    // the sliding window that the node is mapped in.
+    uint8_t edge_buff[NUM_ALPHABET*WIDE_EDGE_SIZE];
+    memset(edge_buff, 0, edges.size()*edge_size);
+    for(size_t i = 0; i < edges.size(); i++)
+        InitNodeEdge(edge_buff + i*edge_size, edges[i]);
+
+    NodePtrs node_ptrs;
+    uint8_t *node;
+    uint8_t layout_flags = NodeLayoutFlags(nt);
+    bool node_move = ReserveNode(nt, node_ptrs.offset, node, layout_flags);
+    InitNodePtrs(node, nt, node_ptrs);
+    node[0] = layout_flags;
+    if(match)
+    {
+        node[0] |= FLAG_NODE_MATCH;
+        Write6BInteger(node_ptrs.ptr+2, data_off);
+    }
+    node[1] = static_cast<uint8_t>(nt);
+    for(size_t i = 0; i < edges.size(); i++)
+        node_ptrs.edge_key_ptr[i] = static_cast<uint8_t>(edges[i].label[0]);
+    memcpy(node_ptrs.edge_ptr, edge_buff, edges.size()*edge_size);
+    BuildNodeIndex(node);
+    if(node_move)
+        WriteData(node, GetNodeSize(nt, layout_flags), node_ptrs.offset);
+
+    header->n_edges += edges.size();
+    return node_ptrs.offset;
+}
+
+int DictMem::SetRootEdge(const NodeEdge &node_edge)
+{
+    EdgePtrs edge_ptrs;
+    uint8_t nt = static_cast<uint8_t>(node_edge.label[0]);
+    int rval = GetRootEdge_Writer(false, nt, edge_ptrs);
+    if(rval != MBError::SUCCESS)
+        return rval;
+    if(edge_ptrs.len_ptr[0] != 0)
+        return MBError::IN_DICT;
+
+    memset(edge_ptrs.ptr, 0, edge_size);
+    InitNodeEdge(edge_ptrs.ptr, node_edge);
+#ifdef __LOCK_FREE__
+    lfree->WriterLockFreeStart(edge_ptrs.offset);
+#endif
+    WriteEdge(edge_ptrs);
+#ifdef __LOCK_FREE__
+    lfree->WriterLockFreeStop();
+#endif
+    return MBError::SUCCESS;
+}
+
+// Node layout flags for a new node with nt+1 edges. Only nodes with at
+// least ADAPTIVE_NODE_MIN_NT edges use the child index. A full node is
+// stored in the same direct layout as the root node.
+uint8_t DictMem::NodeLayoutFlags(int nt) const
+{
+    if(!(header->version[3] & INDEX_FORMAT_ADAPTIVE))
+        return FLAG_NODE_NONE;
+    if(nt == NUM_ALPHABET-1)
+        return FLAG_NODE_DIRECT;
+    if(nt + 1 >= ADAPTIVE_NODE_MIN_NT)
+        return FLAG_NODE_INDEX;
+    return FLAG_NODE_NONE;
+}
+
+// Build the child index or reorder the edges for the direct layout
+// based on node[0]. The first characters and edges must be populated.
+void DictMem::BuildNodeIndex(uint8_t *node) const
+{
+    int nt = node[1] + 1;
+    uint8_t *key_first = node + NODE_EDGE_KEY_FIRST;
+    uint8_t *edges = key_first + nt;
+
+    if(node[0] & FLAG_NODE_INDEX)
+    {
+        uint8_t *index = edges + nt*edge_size;
+        memset(index, 0, NUM_ALPHABET);
+        for(int i = 0; i < nt; i++)
+            index[key_first[i]] = static_cast<uint8_t>(i + 1);
+    }
+    else if(node[0] & FLAG_NODE_DIRECT)
+    {
+        uint8_t edge_tmp[NUM_ALPHABET*WIDE_EDGE_SIZE];
+        memcpy(edge_tmp, edges, NUM_ALPHABET*edge_size);
+        for(int i = 0; i < NUM_ALPHABET; i++)
+            memcpy(edges + key_first[i]*edge_size, edge_tmp + i*edge_size, edge_size);
+        for(int i = 0; i < NUM_ALPHABET; i++)
+            key_first[i] = static_cast<uint8_t>(i);
+    }
+}
+
+// Find the index of the edge starting with key in the node at node_off.
+// node_hdr must hold at least the first two bytes of the node. key_buff
+// is used for loading the first characters if the node has no child index.
+int DictMem::FindEdgeIndex(size_t node_off, const uint8_t *node_hdr,
+                           uint8_t *key_buff, uint8_t key, int &index) const
+{
+    int nt = node_hdr[1] + 1;
+
+    if(node_hdr[0] & FLAG_NODE_DIRECT)
+    {
+        index = key;
+        return MBError::SUCCESS;
+    }
+
+    if(node_hdr[0] & FLAG_NODE_INDEX)
+    {
+        const uint8_t *child = ReadPtr(key_buff, 1, node_off + NODE_EDGE_KEY_FIRST + nt + nt*edge_size + key);
+        if(child == NULL)
+            return MBError::READ_ERROR;
+        if(child[0] == 0)
+            return MBError::NOT_EXIST;
+        index = child[0] - 1;
+        return MBError::SUCCESS;
+    }
+
+    const uint8_t *key_first = ReadPtr(key_buff, nt, node_off + NODE_EDGE_KEY_FIRST);
+    if(key_first == NULL)
+        return MBError::READ_ERROR;
+    index = ByteScan(key_first, nt, key);
+    if(index < 0)
+        return MBError::NOT_EXIST;
+    return MBError::SUCCESS;
 }
 
 // Release edge string buffer
@@ -730,13 +872,32 @@ void DictMem::ReleaseBuffer(size_t offset, int size)
     header->pending_index_buff_size += free_lists->GetAlignmentSize(size);
 }
 
-int DictMem::GetRootEdge(size_t rc_off, int nt, EdgePtrs &edge_ptrs) const
+int DictMem::GetRootEdge(size_t rc_off, int nt, EdgePtrs &edge_ptrs, bool copy) const
 {
     if(rc_off != 0)
-        edge_ptrs.offset = rc_off + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*EDGE_SIZE;
+        edge_ptrs.offset = rc_off + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*edge_size;
     else
-        edge_ptrs.offset = root_offset + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*EDGE_SIZE;
-    if(ReadData(edge_ptrs.edge_buff, EDGE_SIZE, edge_ptrs.offset) != EDGE_SIZE)
+        edge_ptrs.offset = root_offset + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*edge_size;
+    return ReadEdge(edge_ptrs.offset, edge_ptrs, copy);
+}
+
+// Load the edge at offset into edge_ptrs. edge_ptrs.offset is not changed.
+// The writer always copies the edge to edge_buff since the edge may be modified
+// and written back. Readers copy it if copy is set, i.e., if the edge is still
+// used after the lock-free check.
+int DictMem::ReadEdge(size_t offset, EdgePtrs &edge_ptrs, bool copy) const
+{
+    if(in_place_read && !copy)
+    {
+        uint8_t *ptr = GetMappedPtr(offset);
+        if(ptr != NULL)
+        {
+            InitInPlaceEdgePtrs(edge_ptrs, ptr);
+            return MBError::SUCCESS;
+        }
+    }
+
+    if(ReadData(edge_ptrs.edge_buff, edge_size, offset) != edge_size)
         return MBError::READ_ERROR;
 
     InitTempEdgePtrs(edge_ptrs);
@@ -752,16 +913,24 @@ int DictMem::GetRootEdge_Writer(bool rc_mode, int nt, EdgePtrs &edge_ptrs) const
     {
         if(root_offset_rc == 0)
             throw (int) MBError::UNKNOWN_ERROR;
-        edge_ptrs.offset = root_offset_rc + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*EDGE_SIZE;
+        edge_ptrs.offset = root_offset_rc + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*edge_size;
     }
     else
     {
-        edge_ptrs.offset = root_offset + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*EDGE_SIZE;
+        edge_ptrs.offset = root_offset + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*edge_size;
     }
-    if(ReadData(header->excep_buff, EDGE_SIZE, edge_ptrs.offset) != EDGE_SIZE)
+    return GetEdge_Writer(edge_ptrs.offset, edge_ptrs);
+}
+
+// Load the edge at offset for update. The edge is kept in the header so that
+// it can be recovered if writer dies in the middle of the update.
+int DictMem::GetEdge_Writer(size_t offset, EdgePtrs &edge_ptrs) const
+{
+    if(ReadData(GetExcepEdgeBuff(), edge_size, offset) != edge_size)
         return MBError::READ_ERROR;
 
-    edge_ptrs.ptr = header->excep_buff;
+    edge_ptrs.offset = offset;
+    edge_ptrs.ptr = GetExcepEdgeBuff();
     edge_ptrs.len_ptr = edge_ptrs.ptr + EDGE_LEN_POS;
     edge_ptrs.flag_ptr = edge_ptrs.ptr + EDGE_FLAG_POS;
     edge_ptrs.offset_ptr = edge_ptrs.flag_ptr + 1;
@@ -795,11 +964,11 @@ size_t DictMem::InitRootNode_RC()
 // considering the full DB is deleted.
 int DictMem::ClearRootEdge(int nt) const
 {
-    size_t offset = root_offset + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*EDGE_SIZE;
+    size_t offset = root_offset + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + nt*edge_size;
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStart(offset);
 #endif
-    WriteData(DictMem::empty_edge, EDGE_SIZE, offset);
+    WriteData(DictMem::empty_edge, edge_size, offset);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
 #endif
@@ -815,11 +984,11 @@ int DictMem::ClearRootEdges_RC() const
     size_t offset;
     for(int i = 0; i < NUM_ALPHABET; i++)
     {
-        offset = root_offset_rc + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + i*EDGE_SIZE;
+        offset = root_offset_rc + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + i*edge_size;
 #ifdef __LOCK_FREE__
         lfree->WriterLockFreeStart(offset);
 #endif
-        DRMBase::WriteData(DictMem::empty_edge, EDGE_SIZE, offset);
+        DRMBase::WriteData(DictMem::empty_edge, edge_size, offset);
 #ifdef __LOCK_FREE__
         lfree->WriterLockFreeStop();
 #endif
@@ -845,58 +1014,66 @@ int DictMem::NextEdge(const uint8_t *key, EdgePtrs &edge_ptrs, uint8_t *node_buf
     size_t node_off;
     node_off = Get6BInteger(edge_ptrs.offset_ptr);
 
-    int byte_read;
-    byte_read = ReadData(node_buff, NODE_EDGE_KEY_FIRST, node_off);
-    if(byte_read != NODE_EDGE_KEY_FIRST)
+    const uint8_t *node_hdr = ReadPtr(node_buff, NODE_EDGE_KEY_FIRST, node_off);
+    if(node_hdr == NULL)
         return MBError::READ_ERROR;
+    // Callers check the node flags in node_buff.
+    if(node_hdr != node_buff)
+        memcpy(node_buff, node_hdr, NODE_EDGE_KEY_FIRST);
 
-    int nt = node_buff[1] + 1;
-    byte_read = ReadData(node_buff+NODE_EDGE_KEY_FIRST, nt, node_off+NODE_EDGE_KEY_FIRST);
-    if(byte_read != nt)
-        return MBError::READ_ERROR;
+    int nt = node_hdr[1] + 1;
+    int i;
+    int rval = FindEdgeIndex(node_off, node_hdr, node_buff+NODE_EDGE_KEY_FIRST, key[0], i);
+    if(rval != MBError::SUCCESS)
+        return rval;
 
-    int ret = MBError::NOT_EXIST;
-    for(int i = 0; i < nt; i++)
+    if(update_parent_info)
     {
-        if(node_buff[i+NODE_EDGE_KEY_FIRST] == key[0])
-        {
-            if(update_parent_info)
-            {
-                // update parent node/edge info for deletion
-                edge_ptrs.curr_nt = nt;
-                edge_ptrs.curr_edge_index = i;
-                edge_ptrs.parent_offset = edge_ptrs.offset;
-                edge_ptrs.curr_node_offset = node_off;
-            }
-            size_t offset_new = node_off + NODE_EDGE_KEY_FIRST + nt + i*EDGE_SIZE;
-            byte_read = ReadData(edge_ptrs.edge_buff, EDGE_SIZE, offset_new);
-            if(byte_read != EDGE_SIZE)
-            {
-                ret = MBError::READ_ERROR;
-                break;
-            }
-
-            edge_ptrs.offset = offset_new;
-            ret = MBError::SUCCESS;
-            break;
-        }
+        // update parent node/edge info for deletion
+        edge_ptrs.curr_nt = nt;
+        edge_ptrs.curr_edge_index = i;
+        edge_ptrs.parent_offset = edge_ptrs.offset;
+        edge_ptrs.curr_node_offset = node_off;
     }
+    size_t offset_new = node_off + NODE_EDGE_KEY_FIRST + nt + i*edge_size;
+    // The iterator reads the child node offset of the last edge afterwards.
+    if(ReadEdge(offset_new, edge_ptrs, update_parent_info) != MBError::SUCCESS)
+        return MBError::READ_ERROR;
 
-    return ret;
+    edge_ptrs.offset = offset_new;
+    return MBError::SUCCESS;
+}
+
+// Same as NextEdge, but only locate the child edge without reading it.
+int DictMem::FindEdgeOffset(const uint8_t *key, const EdgePtrs &edge_ptrs,
+                            uint8_t *node_buff, size_t &edge_off) const
+{
+    size_t node_off = Get6BInteger(edge_ptrs.offset_ptr);
+    const uint8_t *node_hdr = ReadPtr(node_buff, NODE_EDGE_KEY_FIRST, node_off);
+    if(node_hdr == NULL)
+        return MBError::READ_ERROR;
+
+    int i;
+    int rval = FindEdgeIndex(node_off, node_hdr, node_buff+NODE_EDGE_KEY_FIRST, key[0], i);
+    if(rval != MBError::SUCCESS)
+        return rval;
+
+    edge_off = node_off + NODE_EDGE_KEY_FIRST + node_hdr[1] + 1 + i*edge_size;
+    return MBError::SUCCESS;
 }
 
 void DictMem::RemoveRootEdge(const EdgePtrs &edge_ptrs)
 {
     // Clear the edge
     // Root node needs special handling.
-    if(edge_ptrs.len_ptr[0] > LOCAL_EDGE_LEN)
+    if(edge_ptrs.len_ptr[0] > local_edge_len)
         ReleaseBuffer(Get5BInteger(edge_ptrs.ptr), edge_ptrs.len_ptr[0]-1);
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStart(edge_ptrs.offset);
 #endif
     header->excep_lf_offset = edge_ptrs.offset;
     header->excep_updating_status = EXCEP_STATUS_CLEAR_EDGE;
-    WriteData(DictMem::empty_edge, EDGE_SIZE, edge_ptrs.offset);
+    WriteData(DictMem::empty_edge, edge_size, edge_ptrs.offset);
     header->excep_updating_status = 0;
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
@@ -917,25 +1094,27 @@ int DictMem::RemoveEdgeSizeN(const EdgePtrs &edge_ptrs,
     uint8_t *node;
 
     // Reserve for the new node
-    node_move = ReserveNode(nt-2, new_node_offset, node);
+    uint8_t layout_flags = NodeLayoutFlags(nt-2);
+    node_move = ReserveNode(nt-2, new_node_offset, node, layout_flags);
 
     // Copy data from old node
     uint8_t *first_key_ptr = node + NODE_EDGE_KEY_FIRST;
     uint8_t *edge_ptr = first_key_ptr + nt - 1;
-    uint8_t old_edge_buff[16];
+    uint8_t old_edge_buff[WIDE_EDGE_SIZE];
     size_t old_edge_offset = node_offset + NODE_EDGE_KEY_FIRST + nt;
     memcpy(node, old_node_buffer, NODE_EDGE_KEY_FIRST);
+    node[0] = (old_node_buffer[0] & FLAG_NODE_MATCH) | layout_flags;
     node[1] = nt - 2;
     for(int i = 0; i < nt; i++)
     {
         // load the edge
-        if(ReadData(old_edge_buff, EDGE_SIZE, old_edge_offset) != EDGE_SIZE)
+        if(ReadData(old_edge_buff, edge_size, old_edge_offset) != edge_size)
             return MBError::READ_ERROR;
 
         if(i == edge_ptrs.curr_edge_index)
         {
             // Need to release this edge string buffer
-            if(old_edge_buff[EDGE_LEN_POS] > LOCAL_EDGE_LEN)
+            if(old_edge_buff[EDGE_LEN_POS] > local_edge_len)
             {
                 str_off_rel = Get5BInteger(old_edge_buff);
                 str_size_rel = old_edge_buff[EDGE_LEN_POS]-1;
@@ -944,17 +1123,19 @@ int DictMem::RemoveEdgeSizeN(const EdgePtrs &edge_ptrs,
         else
         {
             first_key_ptr[0] = old_node_buffer[NODE_EDGE_KEY_FIRST+i];
-            memcpy(edge_ptr, old_edge_buff, EDGE_SIZE);
+            memcpy(edge_ptr, old_edge_buff, edge_size);
 
             first_key_ptr++;
-            edge_ptr += EDGE_SIZE;
+            edge_ptr += edge_size;
         }
-        old_edge_offset += EDGE_SIZE;
+        old_edge_offset += edge_size;
     }
 
+    BuildNodeIndex(node);
+
     // Write the new node before free
     if(node_move)
-        WriteData(node, node_size[nt-2], new_node_offset);
+        WriteData(node, GetNodeSize(nt-2, layout_flags), new_node_offset);
 
     // Update the link from parent edge to the new node offset
     Write6BInteger(header->excep_buff, new_node_offset);
@@ -999,11 +1180,11 @@ int DictMem::RemoveEdgeSizeOne(uint8_t *old_node_buffer,
         rval = MBError::TRY_AGAIN;
     }
 
-    uint8_t old_edge_buff[16];
+    uint8_t old_edge_buff[WIDE_EDGE_SIZE];
     size_t old_edge_offset = node_offset + NODE_EDGE_KEY_FIRST + nt;
-    if(ReadData(old_edge_buff, EDGE_SIZE, old_edge_offset) != EDGE_SIZE)
+    if(ReadData(old_edge_buff, edge_size, old_edge_offset) != edge_size)
         return MBError::READ_ERROR;
-    if(old_edge_buff[EDGE_LEN_POS] > LOCAL_EDGE_LEN)
+    if(old_edge_buff[EDGE_LEN_POS] > local_edge_len)
     {
         str_off_rel = Get5BInteger(old_edge_buff);
         str_size_rel = old_edge_buff[EDGE_LEN_POS]-1;
@@ -1050,7 +1231,7 @@ int DictMem::RemoveEdgeByIndex(const EdgePtrs &edge_ptrs, MBData &data)
     header->excep_updating_status = 0;
 
     header->n_edges--;
-    ReleaseNode(header->excep_offset, nt-1);
+    ReleaseNode(header->excep_offset, nt-1, old_node_buffer[0]);
     if(str_size_rel > 0)
         ReleaseBuffer(str_off_rel, str_size_rel);
 
@@ -1060,7 +1241,7 @@ int DictMem::RemoveEdgeByIndex(const EdgePtrs &edge_ptrs, MBData &data)
 #endif
     header->excep_lf_offset = edge_ptrs.offset;
     header->excep_updating_status = EXCEP_STATUS_CLEAR_EDGE;
-    WriteData(DictMem::empty_edge, EDGE_SIZE, edge_ptrs.offset);
+    WriteData(DictMem::empty_edge, edge_size, edge_ptrs.offset);
     header->excep_updating_status = 0;
 #ifdef __LOCK_FREE__
     lfree->WriterLockFreeStop();
@@ -1082,7 +1263,7 @@ void DictMem::PrintStats(std::ostream &out_stream) const
     out_stream << "\tNumber of edges: " << header->n_edges << std::endl;
     out_stream << "\tNumber of nodes: " << header->n_states << std::endl;
     out_stream << "\tEdge string size: " << header->edge_str_size << std::endl;
-    out_stream << "\tEdge size: " << header->n_edges*EDGE_SIZE << std::endl;
+    out_stream << "\tEdge size: " << header->n_edges*edge_size << std::endl;
     out_stream << "\tException flag: " << header->excep_updating_status << std::endl;
     out_stream << "\tPending Buffer Size: " << header->pending_index_buff_size << std::endl;
     if(free_lists != NULL)
@@ -1090,6 +1271,60 @@ void DictMem::PrintStats(std::ostream &out_stream) const
     kv_file->PrintStats(out_stream);
 }
 
+// The edge format cannot be changed by migration.
+void DictMem::SetIndexFormat(uint16_t format)
+{
+    header->version[3] = (format & ~INDEX_FORMAT_WIDE_EDGE) |
+                         (header->version[3] & INDEX_FORMAT_WIDE_EDGE);
+}
+
+// Rebuild the node at node_off in the layout of the current index format.
+// Used by ResourceCollection for migrating an existing DB. Returns true if
+// the node is moved, in which case node_off is set to the new node offset.
+bool DictMem::MigrateNode(size_t &node_off, size_t node_link_offset, size_t edge_offset)
+{
+    uint8_t node_hdr[NODE_EDGE_KEY_FIRST];
+    if(ReadData(node_hdr, NODE_EDGE_KEY_FIRST, node_off) != NODE_EDGE_KEY_FIRST)
+        throw (int) MBError::READ_ERROR;
+
+    int nt = node_hdr[1];
+    uint8_t old_flags = node_hdr[0];
+    uint8_t layout_flags = NodeLayoutFlags(nt);
+    if((old_flags & (FLAG_NODE_INDEX | FLAG_NODE_DIRECT)) == layout_flags)
+        return false;
+
+    size_t new_node_off;
+    uint8_t *node;
+    bool node_move = ReserveNode(nt, new_node_off, node, layout_flags);
+
+    // Copy the node header, first characters and edges.
+    int copy_size = NODE_EDGE_KEY_FIRST + (nt+1) + (nt+1)*edge_size;
+    if(ReadData(node, copy_size, node_off) != copy_size)
+        throw (int) MBError::READ_ERROR;
+    node[0] = (old_flags & FLAG_NODE_MATCH) | layout_flags;
+    BuildNodeIndex(node);
+    if(node_move)
+        WriteData(node, GetNodeSize(nt, layout_flags), new_node_off);
+
+    // Update the link from parent edge to the new node
+    Write6BInteger(header->excep_buff, new_node_off);
+#ifdef __LOCK_FREE__
+    lfree->WriterLockFreeStart(edge_offset);
+#endif
+    header->excep_lf_offset = edge_offset;
+    header->excep_offset = node_link_offset;
+    header->excep_updating_status = EXCEP_STATUS_RC_NODE;
+    WriteData(header->excep_buff, OFFSET_SIZE, node_link_offset);
+    header->excep_updating_status = EXCEP_STATUS_NONE;
+#ifdef __LOCK_FREE__
+    lfree->WriterLockFreeStop();
+#endif
+
+    ReleaseNode(node_off, nt, old_flags);
+    node_off = new_node_off;
+    return true;
+}
+
 const int* DictMem::GetNodeSizePtr() const
 {
     return node_size;
@@ -1115,6 +1350,12 @@ void DictMem::Flush() const
         header_file->Flush();
 }
 
+void DictMem::SetSyncOnWrite(bool sync) const
+{
+    if(kv_file != NULL)
+        kv_file->SetSyncOnWrite(sync);
+}
+
 void DictMem::WriteData(const uint8_t *buff, unsigned len, size_t offset) const
 {
     if(offset + len > header->m_index_offset)
@@ -21,6 +21,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include <stdint.h>
 #include <string.h>
 #include <pthread.h>
@@ -35,6 +36,7 @@
 #include "free_list.h"
 #include "lock_free.h"
 #include "error.h"
+#include "integer_4b_5b.h"
 
 namespace mabain {
 
@@ -47,6 +49,16 @@ typedef struct _NodePtrs
     uint8_t *edge_ptr;
 } NodePtrs;
 
+// Edge of a node written by DictMem::AddNode. The label includes the first
+// character. offset is the data offset of a leaf edge, otherwise the offset
+// of the child node.
+typedef struct _NodeEdge
+{
+    std::string label;
+    bool leaf;
+    size_t offset;
+} NodeEdge;
+
 // Memory management class for the dictionary
 class DictMem : public DRMBase
 {
@@ -72,13 +84,17 @@ public:
                   size_t data_off);
     bool FindNext(const unsigned char *key, int keylen, int &match_len,
                   EdgePtrs &edge_ptr, uint8_t *key_tmp) const;
-    int  GetRootEdge(size_t rc_off, int nt, EdgePtrs &edge_ptrs) const;
+    int  GetRootEdge(size_t rc_off, int nt, EdgePtrs &edge_ptrs, bool copy = false) const;
+    int  ReadEdge(size_t offset, EdgePtrs &edge_ptrs, bool copy = false) const;
     int  GetRootEdge_Writer(bool rc_mode, int nt, EdgePtrs &edge_ptrs) const;
+    int  GetEdge_Writer(size_t offset, EdgePtrs &edge_ptrs) const;
     int  ClearRootEdge(int nt) const;
     void ReserveData(const uint8_t* key, int size, size_t &offset,
                      bool map_new_sliding=true);
     int  NextEdge(const uint8_t *key, EdgePtrs &edge_ptrs,
                   uint8_t *tmp_buff, bool update_parent_info=false) const;
+    int  FindEdgeOffset(const uint8_t *key, const EdgePtrs &edge_ptrs,
+                  uint8_t *node_buff, size_t &edge_off) const;
     int  RemoveEdgeByIndex(const EdgePtrs &edge_ptrs, MBData &data);
     void InitRootNode();
     inline void WriteEdge(const EdgePtrs &edge_ptrs) const;
@@ -86,22 +102,49 @@ public:
     inline size_t GetRootOffset() const;
     void ClearMem() const;
     const int* GetNodeSizePtr() const;
+    inline int GetNodeSize(int nt, uint8_t flags) const;
+    bool MigrateNode(size_t &node_off, size_t node_link_offset, size_t edge_offset);
+    void SetIndexFormat(uint16_t format);
     void ResetSlidingWindow() const;
+    // Edge size and the longest inline edge label of the index format
+    inline int GetEdgeSize() const;
+    inline int GetLocalEdgeLen() const;
+    inline uint8_t* GetExcepEdgeBuff() const;
+    inline const uint8_t* GetEdgeLabel(const uint8_t *edge, uint8_t *buff) const;
 
     void InitLockFreePtr(LockFree *lf);
 
     void Flush() const;
+    void SetSyncOnWrite(bool sync) const;
 
     // Updates in RC mode
     size_t InitRootNode_RC();
     int    ClearRootEdges_RC() const;
+    // Release the nodes and edge labels of a subtree unlinked by writer
+    void   ReleaseSubtree(const std::vector<size_t> &node_offs,
+                          const std::vector<std::pair<size_t, int> > &edge_strs,
+                          int64_t num_edges);
+    // Write a new node with all its edges at its final size. The edges must
+    // be sorted by the first character. Used by BulkLoader.
+    size_t AddNode(bool match, size_t data_off, const std::vector<NodeEdge> &edges);
+    // Set an empty root edge
+    int    SetRootEdge(const NodeEdge &node_edge);
 
     // empty edge, used for clearing edges
-    static const uint8_t empty_edge[EDGE_SIZE];
+    static const uint8_t empty_edge[WIDE_EDGE_SIZE];
 
 private:
-    bool     ReserveNode(int nt, size_t &offset, uint8_t* &ptr);
-    void     ReleaseNode(size_t offset, int nt);
+    void     InitEdgeFormat();
+    bool     SetEdgeLabel(uint8_t *edge, const uint8_t *label, int len,
+                          bool map_new_sliding = true);
+    void     InitNodeEdge(uint8_t *edge, const NodeEdge &node_edge);
+    bool     ReserveNode(int nt, size_t &offset, uint8_t* &ptr,
+                         uint8_t flags = FLAG_NODE_NONE);
+    void     ReleaseNode(size_t offset, int nt, uint8_t flags = FLAG_NODE_NONE);
+    uint8_t  NodeLayoutFlags(int nt) const;
+    void     BuildNodeIndex(uint8_t *node) const;
+    int      FindEdgeIndex(size_t node_off, const uint8_t *node_hdr,
+                           uint8_t *key_buff, uint8_t key, int &index) const;
     void     ReleaseBuffer(size_t offset, int size);
     void     UpdateTailEdge(EdgePtrs &edge_ptrs, int match_len, MBData &data,
                             EdgePtrs &tail_edge, uint8_t &new_key_first,
@@ -119,6 +162,12 @@ private:
 
     int *node_size;
     bool is_valid;
+    // Readers access edges in the mapped blocks in place.
+    bool in_place_read;
+    // INDEX_FORMAT_WIDE_EDGE stores labels up to WIDE_LOCAL_EDGE_LEN in
+    // WIDE_EDGE_SIZE edges.
+    int edge_size;
+    int local_edge_len;
 
     size_t root_offset;
     uint8_t *node_ptr;
@@ -134,9 +183,9 @@ private:
 
 inline void DictMem::WriteEdge(const EdgePtrs &edge_ptrs) const
 {
-    if(edge_ptrs.offset + EDGE_SIZE > header->m_index_offset)
+    if(edge_ptrs.offset + edge_size > header->m_index_offset)
     {
-        std::cerr << "invalid edge write: " << edge_ptrs.offset << " " << EDGE_SIZE
+        std::cerr << "invalid edge write: " << edge_ptrs.offset << " " << edge_size
                   << " " << header->m_index_offset << "\n";
         throw (int) MBError::OUT_OF_BOUND;
     }
@@ -145,7 +194,7 @@ inline void DictMem::WriteEdge(const EdgePtrs &edge_ptrs) const
     header->excep_lf_offset = edge_ptrs.offset;
     header->excep_updating_status = EXCEP_STATUS_ADD_EDGE;
 
-    if(kv_file->RandomWrite(edge_ptrs.ptr, EDGE_SIZE, edge_ptrs.offset) != EDGE_SIZE)
+    if(kv_file->RandomWrite(edge_ptrs.ptr, edge_size, edge_ptrs.offset) != (unsigned) edge_size)
         throw (int) MBError::WRITE_ERROR;
 
     // unset the segault flag
@@ -157,11 +206,59 @@ inline size_t DictMem::GetRootOffset() const
     return root_offset;
 }
 
+inline int DictMem::GetEdgeSize() const
+{
+    return edge_size;
+}
+
+inline int DictMem::GetLocalEdgeLen() const
+{
+    return local_edge_len;
+}
+
+// Writer keeps the edge being updated in the header for exception recovery.
+inline uint8_t* DictMem::GetExcepEdgeBuff() const
+{
+    if(edge_size == WIDE_EDGE_SIZE)
+        return header->excep_edge_buff;
+    return header->excep_buff;
+}
+
+// Return the edge label without the first character, which is kept in the
+// node. Labels longer than LOCAL_EDGE_LEN are split between the first
+// LOCAL_EDGE_LEN_M1 bytes and the tail of a wide edge, and are copied to
+// buff. Labels longer than local_edge_len are stored out of line.
+inline const uint8_t* DictMem::GetEdgeLabel(const uint8_t *edge, uint8_t *buff) const
+{
+    int len_m1 = edge[EDGE_LEN_POS] - 1;
+    if(len_m1 <= LOCAL_EDGE_LEN_M1)
+        return edge;
+    if(len_m1 < local_edge_len)
+    {
+        memcpy(buff, edge, LOCAL_EDGE_LEN_M1);
+        memcpy(buff + LOCAL_EDGE_LEN_M1, edge + EDGE_SIZE, len_m1 - LOCAL_EDGE_LEN_M1);
+        return buff;
+    }
+    if(in_place_read)
+        return ReadPtr(buff, len_m1, Get5BInteger(edge));
+    if(ReadData(buff, len_m1, Get5BInteger(edge)) != len_m1)
+        return NULL;
+    return buff;
+}
+
+// nt is the number of edges minus one, same as the node_size index.
+inline int DictMem::GetNodeSize(int nt, uint8_t flags) const
+{
+    if(flags & FLAG_NODE_INDEX)
+        return node_size[nt] + NUM_ALPHABET;
+    return node_size[nt];
+}
+
 // update the edge pointers for fast access
 // node_ptrs.offset and node_ptrs.ptr[1] must already be populated before calling this function
 inline void DictMem::InitEdgePtrs(const NodePtrs &node_ptrs, int index, EdgePtrs &edge_ptrs)
 {
-    int edge_off = NODE_EDGE_KEY_FIRST + node_ptrs.ptr[1] + 1  + index*EDGE_SIZE;
+    int edge_off = NODE_EDGE_KEY_FIRST + node_ptrs.ptr[1] + 1  + index*edge_size;
     edge_ptrs.offset = node_ptrs.offset + edge_off;
     edge_ptrs.ptr = node_ptrs.ptr + edge_off;
     edge_ptrs.len_ptr = edge_ptrs.ptr + EDGE_LEN_POS;
@@ -177,6 +274,15 @@ inline void InitTempEdgePtrs(EdgePtrs &edge_ptrs)
     edge_ptrs.offset_ptr = edge_ptrs.flag_ptr + 1;
 }
 
+// Same as InitTempEdgePtrs, but the edge is read in place.
+inline void InitInPlaceEdgePtrs(EdgePtrs &edge_ptrs, uint8_t *ptr)
+{
+    edge_ptrs.ptr = ptr;
+    edge_ptrs.len_ptr = edge_ptrs.ptr + EDGE_LEN_POS;
+    edge_ptrs.flag_ptr = edge_ptrs.ptr + EDGE_FLAG_POS;
+    edge_ptrs.offset_ptr = edge_ptrs.flag_ptr + 1;
+}
+
 // node_ptrs.offset must be populated before caling this function
 inline void DictMem::InitNodePtrs(uint8_t *ptr, int nt, NodePtrs &node_ptrs)
 {
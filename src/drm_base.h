@@ -21,20 +21,26 @@
 
 #include "rollable_file.h"
 #include "free_list.h"
+#include "mb_data.h"
 
 #define DATA_BUFFER_ALIGNMENT      1
 #define DATA_SIZE_BYTE             2
 #define DATA_HDR_BYTE              4
 #define OFFSET_SIZE                6
-#define EDGE_SIZE                  13
 #define EDGE_LEN_POS               5
 #define EDGE_FLAG_POS              6
 #define EDGE_FLAG_DATA_OFF         0x01
 #define FLAG_NODE_MATCH            0x01
+#define FLAG_NODE_INDEX            0x02
+#define FLAG_NODE_DIRECT           0x04
 #define FLAG_NODE_NONE             0x0
+#define INDEX_FORMAT_ADAPTIVE      0x01
+#define INDEX_FORMAT_WIDE_EDGE     0x02
+#define ADAPTIVE_NODE_MIN_NT       17
 #define BUFFER_ALIGNMENT           1
 #define LOCAL_EDGE_LEN             6
 #define LOCAL_EDGE_LEN_M1          5
+#define WIDE_LOCAL_EDGE_LEN        (LOCAL_EDGE_LEN + WIDE_EDGE_SIZE - EDGE_SIZE)
 #define EDGE_NODE_LEADING_POS      7
 #define EXCEP_STATUS_NONE          0
 #define EXCEP_STATUS_ADD_EDGE      1
@@ -53,6 +59,7 @@ namespace mabain {
 // Mabain DB header
 typedef struct _IndexHeader
 {
+    // version[3] holds the index format (INDEX_FORMAT_*).
     uint16_t version[4];
     int      data_size;
     int64_t  count;
@@ -95,6 +102,9 @@ typedef struct _IndexHeader
     size_t               rc_m_data_off_pre;
     std::atomic<size_t>  rc_root_offset;
     int64_t              rc_count;
+
+    // edge buffer for abnormal writer terminations in the wide edge format
+    uint8_t excep_edge_buff[WIDE_EDGE_SIZE];
 } IndexHeader;
 
 // An abstract interface class for Dict and DictMem
@@ -115,8 +125,11 @@ public:
     inline virtual void WriteData(const uint8_t *buff, unsigned len, size_t offset) const = 0;
     inline int Reserve(size_t &offset, int size, uint8_t* &ptr);
     inline uint8_t* GetShmPtr(size_t offset, int size) const;
+    inline uint8_t* GetMappedPtr(size_t offset) const;
+    inline void Prefetch(size_t offset) const;
     inline size_t CheckAlignment(size_t offset, int size) const;
     inline int ReadData(uint8_t *buff, unsigned len, size_t offset) const;
+    inline const uint8_t* ReadPtr(uint8_t *buff, unsigned len, size_t offset) const;
     inline size_t GetResourceCollectionOffset() const;
 
     FreeList *GetFreeList() const
@@ -151,6 +164,19 @@ inline uint8_t* DRMBase::GetShmPtr(size_t offset, int size) const
     return kv_file->GetShmPtr(offset, size);
 }
 
+inline uint8_t* DRMBase::GetMappedPtr(size_t offset) const
+{
+    return kv_file->GetMappedPtr(offset);
+}
+
+// Prefetch the cache line at offset if it is in a mapped region.
+inline void DRMBase::Prefetch(size_t offset) const
+{
+    const uint8_t *ptr = kv_file->GetShmPtr(offset, 1);
+    if(ptr != NULL)
+        __builtin_prefetch(ptr);
+}
+
 inline size_t DRMBase::CheckAlignment(size_t offset, int size) const
 {
     return kv_file->CheckAlignment(offset, size);
@@ -161,6 +187,19 @@ inline int DRMBase::ReadData(uint8_t *buff, unsigned len, size_t offset) const
     return kv_file->RandomRead(buff, len, offset);
 }
 
+// Read-only access to len bytes at offset. If the block is mapped, the returned
+// pointer points to the shared memory directly. Otherwise the bytes are copied
+// to buff. Returns NULL if the read failed.
+inline const uint8_t* DRMBase::ReadPtr(uint8_t *buff, unsigned len, size_t offset) const
+{
+    const uint8_t *ptr = kv_file->GetMappedPtr(offset);
+    if(ptr != NULL)
+        return ptr;
+    if(kv_file->RandomRead(buff, len, offset) != len)
+        return NULL;
+    return buff;
+}
+
 inline size_t DRMBase::GetResourceCollectionOffset() const
 {
      return kv_file->GetResourceCollectionOffset();
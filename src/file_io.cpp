@@ -163,6 +163,11 @@ void FileIO::Flush()
         fsync(fd);
 }
 
+void FileIO::SetSyncOnWrite(bool sync)
+{
+    sync_on_write = sync;
+}
+
 const std::string& FileIO::GetFilePath() const
 {
     return path;
@@ -50,6 +50,7 @@ public:
     virtual size_t RandomWrite(const void *data, size_t size, off_t offset);
     virtual size_t RandomRead(void *buff, size_t size, off_t offset);
     virtual void   Flush();
+    void   SetSyncOnWrite(bool sync);
 
     const std::string& GetFilePath() const;
 
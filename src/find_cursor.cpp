@@ -0,0 +1,73 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "find_cursor.h"
+
+namespace mabain {
+
+FindCursor::FindCursor()
+{
+    Reset();
+    num_resume = 0;
+}
+
+void FindCursor::Reset()
+{
+    key.clear();
+    depth = 0;
+    counter = 0;
+}
+
+int FindCursor::GetResumeDepth(const uint8_t *new_key, int len) const
+{
+    if(depth == 0)
+        return 0;
+
+    int common = 0;
+    int max_common = static_cast<int>(key.size());
+    if(max_common > len)
+        max_common = len;
+    const uint8_t *prev = reinterpret_cast<const uint8_t*>(key.data());
+    while(common < max_common && prev[common] == new_key[common])
+        common++;
+
+    int resume_depth = depth;
+    while(resume_depth > 0 && match_len[resume_depth-1] > common)
+        resume_depth--;
+    return resume_depth;
+}
+
+// Edges below FIND_CURSOR_MAX_DEPTH are not recorded.
+void FindCursor::AddEdge(size_t offset, int edge_len)
+{
+    if(depth >= FIND_CURSOR_MAX_DEPTH)
+        return;
+    edge_off[depth] = offset;
+    match_len[depth] = edge_len;
+    if(depth > 0)
+        match_len[depth] += match_len[depth-1];
+    depth++;
+}
+
+void FindCursor::SetKey(const uint8_t *new_key)
+{
+    if(depth > 0)
+        key.assign(reinterpret_cast<const char*>(new_key), match_len[depth-1]);
+    else
+        key.clear();
+}
+
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FIND_CURSOR_H__
+#define __FIND_CURSOR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#define FIND_CURSOR_MAX_DEPTH      64
+
+namespace mabain {
+
+// Path of the previous lookup for finger search. Consecutive lookups of
+// sorted or clustered keys share long prefixes. A lookup with a cursor
+// restarts from the deepest edge on the common prefix of its key and the
+// previous key instead of the root edge. The path is only reused if writer
+// has not updated DB since it was recorded.
+// A cursor must only be used with the DB handle it was first used with.
+class FindCursor
+{
+public:
+    FindCursor();
+    // Drop the recorded path
+    void Reset();
+    // Number of recorded edges that can be reused for key.
+    int  GetResumeDepth(const uint8_t *key, int len) const;
+    // Record the next edge on the path
+    void AddEdge(size_t edge_off, int edge_len);
+    // Save the key up to the end of the last recorded edge
+    void SetKey(const uint8_t *key);
+
+    // key of the previous lookup up to the end of the last recorded edge
+    std::string key;
+    // offsets of the recorded edges from the root edge down
+    size_t edge_off[FIND_CURSOR_MAX_DEPTH];
+    // key length matched at the end of each recorded edge
+    int match_len[FIND_CURSOR_MAX_DEPTH];
+    int depth;
+    // lock-free counter when the path was recorded
+    uint32_t counter;
+
+    // number of lookups that reused the recorded path
+    int64_t num_resume;
+};
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "glob_pattern.h"
+#include "error.h"
+
+namespace mabain {
+
+static inline void set_byte(GlobToken &token, uint8_t c)
+{
+    token.set[c >> 6] |= 1ULL << (c & 63);
+}
+
+static inline bool has_byte(const GlobToken &token, uint8_t c)
+{
+    return token.set[c >> 6] & (1ULL << (c & 63));
+}
+
+GlobPattern::GlobPattern()
+{
+}
+
+int GlobPattern::Compile(const std::string &pattern)
+{
+    tokens.clear();
+    if(pattern.size() == 0)
+        return MBError::INVALID_ARG;
+
+    GlobToken token;
+    size_t pos = 0;
+    while(pos < pattern.size())
+    {
+        memset(&token, 0, sizeof(token));
+        char c = pattern[pos++];
+        if(c == '*')
+        {
+            // Consecutive stars are the same as one.
+            if(!tokens.empty() && tokens.back().star)
+                continue;
+            token.star = true;
+        }
+        else if(c == '?')
+        {
+            memset(token.set, 0xff, sizeof(token.set));
+        }
+        else if(c == '[')
+        {
+            if(ParseClass(pattern, pos, token) != MBError::SUCCESS)
+            {
+                tokens.clear();
+                return MBError::INVALID_ARG;
+            }
+        }
+        else
+        {
+            if(c == '\\')
+            {
+                if(pos == pattern.size())
+                {
+                    tokens.clear();
+                    return MBError::INVALID_ARG;
+                }
+                c = pattern[pos++];
+            }
+            set_byte(token, c);
+        }
+        tokens.push_back(token);
+    }
+    return MBError::SUCCESS;
+}
+
+// Parse the class after '['. pos is moved past the closing ']'.
+int GlobPattern::ParseClass(const std::string &pattern, size_t &pos, GlobToken &token) const
+{
+    bool negate = false;
+    if(pos < pattern.size() && (pattern[pos] == '!' || pattern[pos] == '^'))
+    {
+        negate = true;
+        pos++;
+    }
+
+    bool first = true;
+    while(true)
+    {
+        if(pos >= pattern.size())
+            return MBError::INVALID_ARG;
+        uint8_t c = pattern[pos++];
+        // ']' right after '[' is a member of the class.
+        if(c == ']' && !first)
+            break;
+        first = false;
+        if(c == '\\')
+        {
+            if(pos >= pattern.size())
+                return MBError::INVALID_ARG;
+            c = pattern[pos++];
+        }
+
+        uint8_t last = c;
+        if(pos + 1 < pattern.size() && pattern[pos] == '-' && pattern[pos+1] != ']')
+        {
+            last = pattern[pos+1];
+            pos += 2;
+            if(last == '\\')
+            {
+                if(pos >= pattern.size())
+                    return MBError::INVALID_ARG;
+                last = pattern[pos++];
+            }
+            if(last < c)
+                return MBError::INVALID_ARG;
+        }
+        for(int b = c; b <= last; b++)
+            set_byte(token, b);
+    }
+
+    if(negate)
+    {
+        for(int i = 0; i < 4; i++)
+            token.set[i] = ~token.set[i];
+    }
+    return MBError::SUCCESS;
+}
+
+// A star can match the empty sequence, so the position after it is
+// reached too.
+void GlobPattern::Closure(std::vector<uint8_t> &state) const
+{
+    for(size_t i = 0; i < tokens.size(); i++)
+    {
+        if(state[i] && tokens[i].star)
+            state[i+1] = 1;
+    }
+}
+
+void GlobPattern::Start(std::vector<uint8_t> &state) const
+{
+    state.assign(tokens.size() + 1, 0);
+    state[0] = 1;
+    Closure(state);
+}
+
+bool GlobPattern::Next(const std::vector<uint8_t> &state, uint8_t c,
+                       std::vector<uint8_t> &next) const
+{
+    next.assign(tokens.size() + 1, 0);
+    bool alive = false;
+    for(size_t i = 0; i < tokens.size(); i++)
+    {
+        if(!state[i])
+            continue;
+        if(tokens[i].star)
+        {
+            next[i] = 1;
+            alive = true;
+        }
+        else if(has_byte(tokens[i], c))
+        {
+            next[i+1] = 1;
+            alive = true;
+        }
+    }
+    if(alive)
+        Closure(next);
+    return alive;
+}
+
+bool GlobPattern::Accept(const std::vector<uint8_t> &state) const
+{
+    return state[tokens.size()] != 0;
+}
+
+}
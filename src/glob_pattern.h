@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GLOB_PATTERN_H__
+#define __GLOB_PATTERN_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace mabain {
+
+// A glob pattern token matches one byte in the set, or any number of bytes
+// if star is true.
+typedef struct _GlobToken
+{
+    bool     star;
+    uint64_t set[4];
+} GlobToken;
+
+// Glob pattern compiled to a non-deterministic automaton. A state is the
+// set of pattern positions reached by the bytes read so far. The trie
+// traversal keeps one state per node and prunes the subtree once the state
+// becomes empty.
+// Supported syntax: '*' matches any sequence of bytes, '?' matches any
+// byte, [abc], [a-z] and [!a-z] (or [^a-z]) match a byte in or not in the
+// class, and '\' escapes the next byte.
+class GlobPattern
+{
+public:
+    GlobPattern();
+
+    // Returns MBError::INVALID_ARG if the pattern is malformed.
+    int  Compile(const std::string &pattern);
+    void Start(std::vector<uint8_t> &state) const;
+    // Compute the state after reading byte c. Returns false if no key
+    // starting with the bytes read so far can match.
+    bool Next(const std::vector<uint8_t> &state, uint8_t c,
+              std::vector<uint8_t> &next) const;
+    bool Accept(const std::vector<uint8_t> &state) const;
+
+private:
+    int  ParseClass(const std::string &pattern, size_t &pos, GlobToken &token) const;
+    void Closure(std::vector<uint8_t> &state) const;
+
+    std::vector<GlobToken> tokens;
+};
+
+}
+
+#endif
@@ -0,0 +1,414 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "hash_index.h"
+#include "mabain_consts.h"
+#include "resource_pool.h"
+#include "integer_4b_5b.h"
+#include "logger.h"
+#include "error.h"
+#include "mb_hash.h"
+
+namespace mabain {
+
+HashIndex::HashIndex(const std::string &mbdir, int mode, size_t size, LockFree *lf)
+                   : header(NULL),
+                     entries(NULL),
+                     keys(NULL),
+                     lfree(lf),
+                     num_lookup(0),
+                     num_hit(0)
+{
+    assert(sizeof(HashIndexHeader) <= HASH_INDEX_HEADER_SIZE);
+    std::string fpath = mbdir + "_mabain_x";
+    bool writer = mode & CONSTS::ACCESS_MODE_WRITER;
+    bool exist;
+    size_t file_size = size;
+    if(mode & CONSTS::MEMORY_ONLY_MODE)
+    {
+        exist = ResourcePool::getInstance().CheckExistence(fpath);
+    }
+    else
+    {
+        struct stat st;
+        exist = (stat(fpath.c_str(), &st) == 0);
+        if(exist)
+            file_size = st.st_size;
+    }
+
+    // Only writer creates the index and only if it is asked for.
+    if(!exist && !(writer && (mode & CONSTS::HASH_INDEX)))
+        return;
+
+    if(file_size == 0)
+        file_size = HASH_INDEX_SIZE_DEFAULT;
+    if(file_size < 2*HASH_INDEX_HEADER_SIZE)
+        file_size = 2*HASH_INDEX_HEADER_SIZE;
+
+    bool map_file = true;
+    hash_file = ResourcePool::getInstance().OpenFile(fpath, mode, file_size,
+                                                     map_file, writer);
+    header = reinterpret_cast<HashIndexHeader*>(hash_file->GetMapAddr());
+    if(header == NULL || !map_file)
+    {
+        header = NULL;
+        Logger::Log(LOG_LEVEL_ERROR, "failed to map hash index %s", fpath.c_str());
+        throw (int) MBError::MMAP_FAILED;
+    }
+    entries = reinterpret_cast<HashIndexEntry*>(reinterpret_cast<uint8_t*>(header) +
+                                                HASH_INDEX_HEADER_SIZE);
+
+    if(!exist || header->version != HASH_INDEX_VERSION)
+    {
+        if(!writer)
+        {
+            Logger::Log(LOG_LEVEL_WARN, "hash index version %u not supported",
+                        header->version);
+            header = NULL;
+            return;
+        }
+
+        // The index will be populated by DB::InitDB.
+        header->seq.store(1, std::memory_order_release);
+        header->version = HASH_INDEX_VERSION;
+        header->num_slot = (file_size - HASH_INDEX_HEADER_SIZE) /
+                           (sizeof(HashIndexEntry) + HASH_INDEX_KEY_SPACE);
+        header->key_size = file_size - HASH_INDEX_HEADER_SIZE -
+                           header->num_slot * sizeof(HashIndexEntry);
+        header->key_used = 0;
+        Logger::Log(LOG_LEVEL_INFO, "hash index %s created with %llu slots",
+                    fpath.c_str(), header->num_slot);
+    }
+    keys = reinterpret_cast<uint8_t*>(entries + header->num_slot);
+}
+
+HashIndex::~HashIndex()
+{
+}
+
+bool HashIndex::IsValid() const
+{
+    return header != NULL;
+}
+
+bool HashIndex::IsReady() const
+{
+    return (header->seq.load(std::memory_order_acquire) & 1) == 0;
+}
+
+uint64_t HashIndex::GetFingerprint(const uint8_t *key, int len) const
+{
+    uint64_t fp = MBHash64(key, len, HASH_INDEX_SEED);
+    if(fp <= HASH_INDEX_FP_DELETED)
+        fp += HASH_INDEX_FP_DELETED + 1;
+    return fp;
+}
+
+// Return the slot of fingerprint fp or -1 if not found.
+int64_t HashIndex::FindSlot(uint64_t fp) const
+{
+    uint64_t slot = fp % header->num_slot;
+    for(uint64_t i = 0; i < header->num_slot; i++)
+    {
+        uint64_t entry_fp = entries[slot].fingerprint.load(MEMORY_ORDER_READER);
+        if(entry_fp == fp)
+            return slot;
+        if(entry_fp == HASH_INDEX_FP_EMPTY)
+            break;
+        if(++slot == header->num_slot)
+            slot = 0;
+    }
+    return -1;
+}
+
+// Check the entry at slot is the entry of the key.
+bool HashIndex::MatchKey(uint64_t slot, uint64_t value, const uint8_t *key, int len) const
+{
+    if(static_cast<int>((value >> HASH_INDEX_KEY_LEN_SHIFT) & 0x1FF) != len)
+        return false;
+    uint64_t key_off = entries[slot].key_off.load(MEMORY_ORDER_READER);
+    if(static_cast<uint64_t>(len) > header->key_size ||
+       key_off > header->key_size - len)
+        return false;
+    return memcmp(keys + key_off, key, len) == 0;
+}
+
+int HashIndex::Find(const uint8_t *key, int len, size_t &data_off, size_t &lf_offset,
+                    uint32_t &seq)
+{
+    seq = header->seq.load(std::memory_order_acquire);
+    if(seq & 1)
+        return MBError::NOT_EXIST;
+
+    num_lookup++;
+    int64_t slot = FindSlot(GetFingerprint(key, len));
+    if(slot < 0)
+        return MBError::NOT_EXIST;
+
+    uint64_t value = entries[slot].value.load(MEMORY_ORDER_READER);
+    if(value & (HASH_INDEX_FLAG_COLLISION | HASH_INDEX_FLAG_PENDING))
+        return MBError::NOT_EXIST;
+    if(!MatchKey(slot, value, key, len))
+        return MBError::NOT_EXIST;
+    data_off = value & MAX_6B_OFFSET;
+    lf_offset = HASH_INDEX_LF_OFFSET_BASE + slot;
+    return MBError::SUCCESS;
+}
+
+// Returns false if the index was cleared or rebuilt since Find.
+bool HashIndex::Check(uint32_t seq) const
+{
+    return header->seq.load(std::memory_order_acquire) == seq;
+}
+
+void HashIndex::AddHit()
+{
+    num_hit++;
+}
+
+// Readers do not use the index while it is being rebuilt. There is no need
+// for lock-free brackets then.
+void HashIndex::WriteEntry(uint64_t slot, uint64_t fp, uint64_t value)
+{
+#ifdef __LOCK_FREE__
+    bool lock_free = IsReady();
+    if(lock_free)
+        lfree->WriterLockFreeStart(HASH_INDEX_LF_OFFSET_BASE + slot);
+#endif
+    entries[slot].value.store(value, MEMORY_ORDER_WRITER);
+    entries[slot].fingerprint.store(fp, MEMORY_ORDER_WRITER);
+#ifdef __LOCK_FREE__
+    if(lock_free)
+        lfree->WriterLockFreeStop();
+#endif
+}
+
+void HashIndex::MarkPending(const uint8_t *key, int len)
+{
+    uint64_t fp = GetFingerprint(key, len);
+    int64_t slot = FindSlot(fp);
+    if(slot < 0)
+        return;
+    uint64_t value = entries[slot].value.load(std::memory_order_relaxed);
+    if(!(value & (HASH_INDEX_FLAG_COLLISION | HASH_INDEX_FLAG_PENDING)))
+        WriteEntry(slot, fp, value | HASH_INDEX_FLAG_PENDING);
+}
+
+void HashIndex::ClearPending(const uint8_t *key, int len)
+{
+    uint64_t fp = GetFingerprint(key, len);
+    int64_t slot = FindSlot(fp);
+    if(slot < 0)
+        return;
+    uint64_t value = entries[slot].value.load(std::memory_order_relaxed);
+    if((value & HASH_INDEX_FLAG_PENDING) && !(value & HASH_INDEX_FLAG_COLLISION))
+        WriteEntry(slot, fp, value & ~HASH_INDEX_FLAG_PENDING);
+}
+
+void HashIndex::Add(const uint8_t *key, int len, size_t data_off)
+{
+    uint64_t fp = GetFingerprint(key, len);
+    uint64_t value = data_off | (static_cast<uint64_t>(len) << HASH_INDEX_KEY_LEN_SHIFT);
+    int64_t slot = FindSlot(fp);
+    if(slot >= 0)
+    {
+        uint64_t entry_value = entries[slot].value.load(std::memory_order_relaxed);
+        if(entry_value & HASH_INDEX_FLAG_COLLISION)
+            return;
+        if(!MatchKey(slot, entry_value, key, len))
+        {
+            // Another key in DB has the same fingerprint. Both keys have
+            // to be looked up in the trie.
+            WriteEntry(slot, fp, entry_value | HASH_INDEX_FLAG_COLLISION);
+            header->num_collision++;
+        }
+        else
+        {
+            WriteEntry(slot, fp, value);
+        }
+        return;
+    }
+
+    if(!HasRoom(len) && !Compact(len))
+    {
+        // Every key must be in the index. Stop using it until it is
+        // rebuilt.
+        if(header->num_skipped == 0)
+            header->num_full = header->num_entry;
+        if(IsReady())
+        {
+            Logger::Log(LOG_LEVEL_WARN, "hash index is full, disabled until rebuilt");
+            header->seq.fetch_add(1, std::memory_order_acq_rel);
+        }
+        header->num_skipped++;
+        return;
+    }
+    InsertEntry(fp, value, key, len);
+}
+
+bool HashIndex::HasRoom(int len) const
+{
+    return static_cast<uint64_t>(header->num_entry + header->num_deleted + 1) * 100 <=
+               header->num_slot * HASH_INDEX_MAX_LOAD &&
+           header->key_used + len <= header->key_size;
+}
+
+// Store a new entry in the first unused slot from the home slot of fp.
+void HashIndex::InsertEntry(uint64_t fp, uint64_t value, const uint8_t *key, int len)
+{
+    uint64_t slot = fp % header->num_slot;
+    uint64_t entry_fp;
+    while((entry_fp = entries[slot].fingerprint.load(std::memory_order_relaxed)) >
+          HASH_INDEX_FP_DELETED)
+    {
+        if(++slot == header->num_slot)
+            slot = 0;
+    }
+    if(entry_fp == HASH_INDEX_FP_DELETED)
+        header->num_deleted--;
+
+    // The key copy is in place before the fingerprint is stored.
+    memcpy(keys + header->key_used, key, len);
+    entries[slot].key_off.store(header->key_used, MEMORY_ORDER_WRITER);
+    header->key_used += len;
+    WriteEntry(slot, fp, value);
+    header->num_entry++;
+}
+
+// Rebuild the index from its live entries to drop removed entries and the
+// key copies of removed keys. Readers use the trie until it is done. It is
+// not done unless at least 1/8 of the slots and of the key area are free
+// afterwards so that the cost is spread over many adds.
+bool HashIndex::Compact(int len)
+{
+    if(static_cast<uint64_t>(header->num_entry + 1) * 100 * 8 >
+           header->num_slot * HASH_INDEX_MAX_LOAD * 7 ||
+       (header->key_used - header->key_free + len) * 8 > header->key_size * 7)
+        return false;
+
+    std::vector<uint64_t> fps;
+    std::vector<uint64_t> values;
+    std::string key_buff;
+    key_buff.reserve(header->key_used - header->key_free);
+    for(uint64_t slot = 0; slot < header->num_slot; slot++)
+    {
+        uint64_t fp = entries[slot].fingerprint.load(std::memory_order_relaxed);
+        if(fp <= HASH_INDEX_FP_DELETED)
+            continue;
+        uint64_t value = entries[slot].value.load(std::memory_order_relaxed);
+        fps.push_back(fp);
+        values.push_back(value);
+        key_buff.append(reinterpret_cast<const char*>(keys) +
+                            entries[slot].key_off.load(std::memory_order_relaxed),
+                        (value >> HASH_INDEX_KEY_LEN_SHIFT) & 0x1FF);
+    }
+
+    bool ready = IsReady();
+    int64_t num_collision = header->num_collision;
+    int64_t num_skipped = header->num_skipped;
+    RebuildStart();
+    const uint8_t *key = reinterpret_cast<const uint8_t*>(key_buff.data());
+    for(size_t i = 0; i < fps.size(); i++)
+    {
+        int key_len = (values[i] >> HASH_INDEX_KEY_LEN_SHIFT) & 0x1FF;
+        InsertEntry(fps[i], values[i], key, key_len);
+        key += key_len;
+    }
+    header->num_collision = num_collision;
+    header->num_skipped = num_skipped;
+    if(ready)
+        header->seq.fetch_add(1, std::memory_order_acq_rel);
+    Logger::Log(LOG_LEVEL_DEBUG, "hash index compacted with %lld entries",
+                header->num_entry);
+    return true;
+}
+
+// Called after the key is removed from the trie.
+void HashIndex::Remove(const uint8_t *key, int len)
+{
+    int64_t slot = FindSlot(GetFingerprint(key, len));
+    if(slot < 0)
+        return;
+    uint64_t value = entries[slot].value.load(std::memory_order_relaxed);
+    if(value & HASH_INDEX_FLAG_COLLISION)
+        return; // Kept until the index is rebuilt.
+    if(!MatchKey(slot, value, key, len))
+        return;
+    WriteEntry(slot, HASH_INDEX_FP_DELETED, value);
+    header->num_entry--;
+    header->num_deleted++;
+    header->key_free += len;
+}
+
+void HashIndex::Clear()
+{
+    bool ready = IsReady();
+    RebuildStart();
+    if(ready)
+        RebuildFinish();
+}
+
+void HashIndex::RebuildStart()
+{
+    if(IsReady())
+        header->seq.fetch_add(1, std::memory_order_acq_rel);
+    memset(static_cast<void*>(entries), 0, header->num_slot*sizeof(HashIndexEntry));
+    header->num_entry = 0;
+    header->num_deleted = 0;
+    header->num_collision = 0;
+    header->num_skipped = 0;
+    header->key_used = 0;
+    header->key_free = 0;
+}
+
+void HashIndex::RebuildFinish()
+{
+    if(header->num_skipped > 0)
+    {
+        Logger::Log(LOG_LEVEL_WARN, "hash index is too small for %lld keys",
+                    header->num_entry + header->num_skipped);
+        return;
+    }
+    if(!IsReady())
+        header->seq.fetch_add(1, std::memory_order_acq_rel);
+}
+
+bool HashIndex::NeedRebuild(int64_t num_key) const
+{
+    return header->num_skipped > 0 && !IsReady() && num_key * 8 <= header->num_full * 7;
+}
+
+void HashIndex::PrintStats(std::ostream &out_stream) const
+{
+    out_stream << "Hash index stats:\n";
+    out_stream << "\tNumber of slots: " << header->num_slot << std::endl;
+    out_stream << "\tReady: " << (IsReady() ? "yes" : "no") << std::endl;
+    out_stream << "\tNumber of entries: " << header->num_entry << std::endl;
+    out_stream << "\tNumber of deleted entries: " << header->num_deleted << std::endl;
+    out_stream << "\tNumber of collisions: " << header->num_collision << std::endl;
+    out_stream << "\tNumber of skipped keys: " << header->num_skipped << std::endl;
+    out_stream << "\tKey area used: " << header->key_used << "/" << header->key_size << std::endl;
+    out_stream << "\tKey area freed: " << header->key_free << std::endl;
+    out_stream << "\tNumber of lookups: " << num_lookup << std::endl;
+    out_stream << "\tNumber of hits: " << num_hit << std::endl;
+}
+
+}
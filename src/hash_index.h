@@ -0,0 +1,147 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HASH_INDEX_H__
+#define __HASH_INDEX_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <iostream>
+
+#include "mmap_file.h"
+#include "lock_free.h"
+
+namespace mabain {
+
+#define HASH_INDEX_VERSION           3
+#define HASH_INDEX_HEADER_SIZE       128
+#define HASH_INDEX_MAX_LOAD          75
+#define HASH_INDEX_SIZE_DEFAULT      (64*1024*1024LL)
+#define HASH_INDEX_SEED              0x9E3779B97F4A7C15ULL
+// Bytes of the key area per slot. 64-byte keys fit at the maximum load.
+#define HASH_INDEX_KEY_SPACE         64
+// Reserved fingerprints
+#define HASH_INDEX_FP_EMPTY          0
+#define HASH_INDEX_FP_DELETED        1
+// Entry value: data offset in the lower 6 bytes, key length and flags above
+#define HASH_INDEX_KEY_LEN_SHIFT     48
+#define HASH_INDEX_FLAG_PENDING      (1ULL << 62)
+#define HASH_INDEX_FLAG_COLLISION    (1ULL << 63)
+// Lock-free offsets of the entries are above the index file offsets.
+#define HASH_INDEX_LF_OFFSET_BASE    (1ULL << 48)
+
+typedef struct _HashIndexHeader
+{
+    uint32_t version;
+    // Odd while the index is being cleared or rebuilt
+    std::atomic<uint32_t> seq;
+    uint64_t num_slot;
+    int64_t  num_entry;
+    int64_t  num_deleted;
+    int64_t  num_collision;
+    // keys not added since the index is full
+    int64_t  num_skipped;
+    // number of entries when the first key was skipped
+    int64_t  num_full;
+    // Size, used bytes and bytes of removed keys of the key area
+    uint64_t key_size;
+    uint64_t key_used;
+    uint64_t key_free;
+} HashIndexHeader;
+
+typedef struct _HashIndexEntry
+{
+    std::atomic<uint64_t> fingerprint;
+    std::atomic<uint64_t> value;
+    // Offset of the key copy in the key area
+    std::atomic<uint64_t> key_off;
+} HashIndexEntry;
+
+// Open-addressing hash table from key fingerprints to data offsets kept in
+// the shared memory file _mabain_x. Exact-match lookups use it to skip the
+// trie walk. While the index is ready, every key in DB has an entry. Keys
+// sharing a fingerprint are flagged by writer and looked up in the trie.
+// Each entry has a copy of its key in the key area after the entries. A
+// lookup compares the key with the copy so that a key not in DB never
+// matches the entry of another key with the same fingerprint.
+// When the slots or the key area run out, writer compacts the index from its
+// live entries to reclaim removed entries and key copies. If there is still
+// no room, the index is disabled and rebuilt from the trie once enough keys
+// are removed.
+// Writer modifies one entry at a time within a lock-free bracket on the
+// entry offset. An entry is marked pending before its data buffer is
+// released so that a stale data offset is never used, even if writer dies
+// in the middle of an update.
+class HashIndex
+{
+public:
+    HashIndex(const std::string &mbdir, int mode, size_t size, LockFree *lf);
+    ~HashIndex();
+
+    bool IsValid() const;
+    bool IsReady() const;
+    // Look up the data offset of the key. The caller must read the data and
+    // then check lock-free with lf_offset and the returned sequence number.
+    // Returns MBError::NOT_EXIST if the trie has to be used.
+    int  Find(const uint8_t *key, int len, size_t &data_off, size_t &lf_offset,
+              uint32_t &seq);
+    bool Check(uint32_t seq) const;
+    void AddHit();
+
+    // Called by writer only
+    // MarkPending is called before the data of the key is changed in the
+    // trie. It is followed by Add or Remove if the update is done, or by
+    // ClearPending otherwise.
+    void MarkPending(const uint8_t *key, int len);
+    void ClearPending(const uint8_t *key, int len);
+    void Add(const uint8_t *key, int len, size_t data_off);
+    void Remove(const uint8_t *key, int len);
+    void Clear();
+    // Entries added between RebuildStart and RebuildFinish are not visible
+    // to readers until RebuildFinish.
+    void RebuildStart();
+    void RebuildFinish();
+    // Returns true if the index was disabled since it was full and DB has
+    // few enough keys now.
+    bool NeedRebuild(int64_t num_key) const;
+
+    void PrintStats(std::ostream &out_stream) const;
+
+private:
+    uint64_t GetFingerprint(const uint8_t *key, int len) const;
+    int64_t  FindSlot(uint64_t fp) const;
+    bool MatchKey(uint64_t slot, uint64_t value, const uint8_t *key, int len) const;
+    void WriteEntry(uint64_t slot, uint64_t fp, uint64_t value);
+    bool HasRoom(int len) const;
+    void InsertEntry(uint64_t fp, uint64_t value, const uint8_t *key, int len);
+    bool Compact(int len);
+
+    std::shared_ptr<MmapFileIO> hash_file;
+    HashIndexHeader *header;
+    HashIndexEntry *entries;
+    uint8_t *keys;
+    LockFree *lfree;
+
+    // stats of this handle
+    int64_t num_lookup;
+    int64_t num_hit;
+};
+
+}
+
+#endif
@@ -0,0 +1,288 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hot_node_cache.h"
+#include "integer_4b_5b.h"
+#include "error.h"
+
+namespace mabain {
+
+HotNodeCache::HotNodeCache(const DictMem *dm, LockFree *lf, int num_level)
+                         : mm(dm),
+                           lfree(lf),
+                           max_level(num_level),
+                           nodes(NULL),
+                           edges(NULL),
+                           num_node(0),
+                           num_edge(0),
+                           counter(0),
+                           valid(false),
+                           num_lookup(HOT_CACHE_REBUILD_INTERVAL),
+                           rebuild_interval(HOT_CACHE_REBUILD_INTERVAL)
+{
+    if(max_level < 1)
+        max_level = 1;
+    else if(max_level > HOT_CACHE_MAX_LEVEL)
+        max_level = HOT_CACHE_MAX_LEVEL;
+
+    // Align to cache line
+    void *ptr;
+    if(posix_memalign(&ptr, 64, sizeof(HotCacheNode)*HOT_CACHE_MAX_NODE) != 0)
+        throw (int) MBError::NO_MEMORY;
+    nodes = static_cast<HotCacheNode*>(ptr);
+    if(posix_memalign(&ptr, 64, sizeof(HotCacheEdge)*HOT_CACHE_MAX_EDGE) != 0)
+    {
+        free(nodes);
+        throw (int) MBError::NO_MEMORY;
+    }
+    edges = static_cast<HotCacheEdge*>(ptr);
+}
+
+HotNodeCache::~HotNodeCache()
+{
+    free(nodes);
+    free(edges);
+}
+
+bool HotNodeCache::IsValid() const
+{
+    return valid;
+}
+
+int HotNodeCache::GetNumNode() const
+{
+    return num_node;
+}
+
+int HotNodeCache::GetNumEdge() const
+{
+    return num_edge;
+}
+
+// Decode the node at node_off and append it to the cache. All edges of
+// the node are cached so that a missing edge means no match.
+int HotNodeCache::AddNode(size_t node_off, bool root)
+{
+    uint8_t node_buff[NODE_EDGE_KEY_FIRST + NUM_ALPHABET + NUM_ALPHABET*WIDE_EDGE_SIZE];
+    uint8_t label_buff[NUM_ALPHABET];
+    int edge_size = mm->GetEdgeSize();
+    int nt;
+
+    if(root)
+    {
+        nt = NUM_ALPHABET;
+    }
+    else
+    {
+        if(mm->ReadData(node_buff, NODE_EDGE_KEY_FIRST, node_off) != NODE_EDGE_KEY_FIRST)
+            return MBError::READ_ERROR;
+        nt = node_buff[1] + 1;
+    }
+    if(num_node >= HOT_CACHE_MAX_NODE || num_edge + nt > HOT_CACHE_MAX_EDGE)
+        return MBError::NO_RESOURCE;
+
+    int size = NODE_EDGE_KEY_FIRST + nt + nt*edge_size;
+    if(mm->ReadData(node_buff, size, node_off) != size)
+        return MBError::READ_ERROR;
+
+    HotCacheNode &node = nodes[num_node];
+    memset(node.edge_index, 0, sizeof(node.edge_index));
+    const uint8_t *key_first = node_buff + NODE_EDGE_KEY_FIRST;
+    const uint8_t *edge_ptr = key_first + nt;
+    for(int i = 0; i < nt; i++, edge_ptr += edge_size)
+    {
+        int edge_len = edge_ptr[EDGE_LEN_POS];
+        // Empty root edge
+        if(edge_len == 0)
+            continue;
+
+        HotCacheEdge &edge = edges[num_edge];
+        memcpy(edge.edge, edge_ptr, EDGE_SIZE);
+        edge.child = -1;
+        edge.label_off = 0;
+        edge.offset = node_off + NODE_EDGE_KEY_FIRST + nt + i*edge_size;
+        if(edge_len > LOCAL_EDGE_LEN)
+        {
+            const uint8_t *label = mm->GetEdgeLabel(edge_ptr, label_buff);
+            if(label == NULL)
+                return MBError::READ_ERROR;
+            edge.label_off = labels.size();
+            labels.append(reinterpret_cast<const char*>(label), edge_len - 1);
+        }
+
+        // Root edges are indexed by the first byte.
+        node.edge_index[root ? i : key_first[i]] = static_cast<uint16_t>(num_edge + 1);
+        num_edge++;
+    }
+
+    num_node++;
+    return MBError::SUCCESS;
+}
+
+// Load the top levels of the trie breadth-first until the level or size
+// limit is reached.
+int HotNodeCache::Build()
+{
+    LockFreeData snapshot;
+    int level[HOT_CACHE_MAX_NODE];
+    int edge_end[HOT_CACHE_MAX_NODE];
+    int rval;
+
+    valid = false;
+    num_node = 0;
+    num_edge = 0;
+    num_lookup = 0;
+    labels.clear();
+
+    lfree->ReaderLockFreeStart(snapshot);
+    rval = AddNode(mm->GetRootOffset(), true);
+    if(rval != MBError::SUCCESS)
+        return rval;
+    level[0] = 1;
+    edge_end[0] = num_edge;
+
+    int curr = 0;
+    for(int i = 0; i < num_edge; i++)
+    {
+        while(i >= edge_end[curr])
+            curr++;
+
+        HotCacheEdge &edge = edges[i];
+        if(level[curr] >= max_level || (edge.edge[EDGE_FLAG_POS] & EDGE_FLAG_DATA_OFF))
+            continue;
+
+        rval = AddNode(Get6BInteger(edge.edge + EDGE_NODE_LEADING_POS), false);
+        if(rval == MBError::NO_RESOURCE)
+            continue; // Lookups will continue from the index file.
+        if(rval != MBError::SUCCESS)
+            return rval;
+
+        edge.child = num_node - 1;
+        level[num_node - 1] = level[curr] + 1;
+        edge_end[num_node - 1] = num_edge;
+    }
+
+    // Discard the cache if writer modified anything while it was being built.
+    rval = lfree->ReaderLockFreeCheck(snapshot);
+    if(rval != MBError::SUCCESS)
+        return rval;
+
+    counter = snapshot.counter;
+    valid = true;
+    return MBError::SUCCESS;
+}
+
+int HotNodeCache::Validate(const LockFreeData &snapshot, const size_t *path, int depth) const
+{
+    for(int i = 0; i < depth; i++)
+    {
+        int rval = lfree->ReaderLockFreeStop(snapshot, path[i]);
+        if(rval != MBError::SUCCESS)
+            return rval;
+    }
+    return MBError::SUCCESS;
+}
+
+int HotNodeCache::Find(const LockFreeData &snapshot, const uint8_t *key, int len,
+                       EdgePtrs &edge_ptrs, int &match_len)
+{
+    if(len <= 0)
+        return MBError::NOT_INITIALIZED;
+
+    num_lookup++;
+    if(valid && counter != snapshot.counter)
+    {
+        // Rebuild less often if writer keeps invalidating the cache.
+        if(num_lookup < rebuild_interval)
+        {
+            rebuild_interval *= 2;
+            if(rebuild_interval > HOT_CACHE_MAX_REBUILD_INTERVAL)
+                rebuild_interval = HOT_CACHE_MAX_REBUILD_INTERVAL;
+        }
+        else
+        {
+            rebuild_interval = HOT_CACHE_REBUILD_INTERVAL;
+        }
+        valid = false;
+    }
+    if(!valid)
+    {
+        if(num_lookup < rebuild_interval)
+            return MBError::NOT_INITIALIZED;
+        if(Build() != MBError::SUCCESS || counter != snapshot.counter)
+            return MBError::NOT_INITIALIZED;
+    }
+
+    // Offsets of the edges visited
+    size_t path[HOT_CACHE_MAX_LEVEL];
+    int depth = 0;
+    const HotCacheEdge *edge = NULL;
+    const uint8_t *p = key;
+    int remain = len;
+    int node = 0;
+    int rval = MBError::SUCCESS;
+
+    while(node >= 0 && remain > 0)
+    {
+        int index = nodes[node].edge_index[p[0]];
+        if(index == 0)
+        {
+            if(node == 0)
+                path[depth++] = mm->GetRootOffset() + NODE_EDGE_KEY_FIRST + NUM_ALPHABET + p[0]*mm->GetEdgeSize();
+            rval = MBError::NOT_EXIST;
+            break;
+        }
+
+        edge = &edges[index - 1];
+        path[depth++] = edge->offset;
+        int edge_len = edge->edge[EDGE_LEN_POS];
+        const uint8_t *label = edge->edge;
+        if(edge_len > LOCAL_EDGE_LEN)
+            label = reinterpret_cast<const uint8_t*>(labels.data()) + edge->label_off;
+        if(edge_len > remain || (edge_len > 1 && memcmp(label, p+1, edge_len-1) != 0))
+        {
+            rval = MBError::NOT_EXIST;
+            break;
+        }
+
+        p += edge_len;
+        remain -= edge_len;
+        if(remain > 0 && (edge->edge[EDGE_FLAG_POS] & EDGE_FLAG_DATA_OFF))
+        {
+            // Reach a leaf node and no match found
+            rval = MBError::NOT_EXIST;
+            break;
+        }
+        node = edge->child;
+    }
+
+    int lf_ret = Validate(snapshot, path, depth);
+    if(lf_ret != MBError::SUCCESS)
+        return lf_ret;
+    if(rval != MBError::SUCCESS)
+        return rval;
+
+    memcpy(edge_ptrs.edge_buff, edge->edge, EDGE_SIZE);
+    edge_ptrs.offset = edge->offset;
+    InitTempEdgePtrs(edge_ptrs);
+    match_len = len - remain;
+    return MBError::SUCCESS;
+}
+
+}
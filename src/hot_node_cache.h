@@ -0,0 +1,108 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOT_NODE_CACHE_H__
+#define __HOT_NODE_CACHE_H__
+
+#include <stdint.h>
+#include <string>
+
+#include "dict_mem.h"
+#include "lock_free.h"
+#include "mb_data.h"
+
+namespace mabain {
+
+#define HOT_CACHE_NUM_LEVEL             2
+#define HOT_CACHE_MAX_LEVEL             8
+#define HOT_CACHE_MAX_NODE              512
+#define HOT_CACHE_MAX_EDGE              8192
+#define HOT_CACHE_REBUILD_INTERVAL      1024
+#define HOT_CACHE_MAX_REBUILD_INTERVAL  1048576
+
+// A cached edge. The first EDGE_SIZE bytes are the same as the edge in the
+// index file so that they can be copied to EdgePtrs directly. Labels longer
+// than LOCAL_EDGE_LEN are kept in the label buffer. The struct is
+// 32 bytes so that two edges share a cache line.
+typedef struct _HotCacheEdge
+{
+    uint8_t  edge[EDGE_SIZE];
+    // index of the cached child node or -1 if the child node is not cached
+    int32_t  child;
+    // offset of the edge label in the label buffer if the label is not inline
+    uint32_t label_off;
+    // edge offset in the index file
+    size_t   offset;
+} HotCacheEdge;
+
+// A cached node. edge_index[c] is the index of the edge starting with
+// c in the edge array plus one, or 0 if there is no such edge.
+typedef struct _HotCacheNode
+{
+    uint16_t edge_index[NUM_ALPHABET];
+} HotCacheNode;
+
+// Process-local decoded copy of the top levels of the main trie. A reader
+// walks the cached levels without touching the index file and continues
+// the lookup from the deepest cached edge. The cache is tied to the
+// lock-free counter at the time it was built and is only used while no
+// writer update has completed since.
+// The cache belongs to a single DB handle and is not thread-safe.
+class HotNodeCache
+{
+public:
+    HotNodeCache(const DictMem *dm, LockFree *lf, int num_level = HOT_CACHE_NUM_LEVEL);
+    ~HotNodeCache();
+
+    // Walk the cached levels for key.
+    // Returns MBError::SUCCESS if match_len bytes of the key are matched in
+    // the cache; edge_ptrs holds the last matched edge. Returns
+    // MBError::NOT_EXIST if the key is not in DB and MBError::TRY_AGAIN if
+    // writer modified the cached edges on the path. Returns
+    // MBError::NOT_INITIALIZED if the cache cannot be used for the snapshot.
+    int Find(const LockFreeData &snapshot, const uint8_t *key, int len,
+             EdgePtrs &edge_ptrs, int &match_len);
+
+    int  Build();
+    bool IsValid() const;
+    int  GetNumNode() const;
+    int  GetNumEdge() const;
+
+private:
+    int  AddNode(size_t node_off, bool root);
+    int  Validate(const LockFreeData &snapshot, const size_t *path, int depth) const;
+
+    const DictMem *mm;
+    LockFree *lfree;
+    int max_level;
+
+    HotCacheNode *nodes;
+    HotCacheEdge *edges;
+    std::string labels;
+    int num_node;
+    int num_edge;
+
+    // lock-free counter when the cache was built
+    uint32_t counter;
+    bool valid;
+    // number of lookups since the last build
+    int64_t num_lookup;
+    int64_t rebuild_interval;
+};
+
+}
+
+#endif
@@ -16,6 +16,10 @@
 
 // @author Changxue Deng <chadeng@cisco.com>
 
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
 #include "db.h"
 #include "dict.h"
 #include "integer_4b_5b.h"
@@ -23,53 +27,38 @@
 
 namespace mabain {
 
-typedef struct _iterator_node
-{
-    std::string *key;
-    uint8_t     *data;
-    int          data_len;
-    uint16_t     bucket_index;
-} iterator_node;
-
-static void free_iterator_node(void *n)
+// Order of the entries in forward iteration. A key comes before the keys
+// in the subtree of its edge.
+class IteratorEntryLess
 {
-    if(n == NULL)
-        return;
-
-    iterator_node *inode = (iterator_node *) n;
-    if(inode->key != NULL)
-        delete inode->key;
-    if(inode->data != NULL)
-        free(inode->data);
-
-    free(inode);
-}
+public:
+    explicit IteratorEntryLess(const std::string &buff) : arena(buff) {
+    }
+    bool operator()(const IteratorEntry &a, const IteratorEntry &b) const {
+        int cmp = arena.compare(a.key_off, a.key_len, arena, b.key_off, b.key_len);
+        if(cmp != 0)
+            return cmp < 0;
+        return a.data_len >= 0 && b.data_len < 0;
+    }
+private:
+    const std::string &arena;
+};
 
-static iterator_node* new_iterator_node(const std::string &key, MBData *mbdata)
+// Order of the entries in reverse iteration
+class IteratorEntryGreater
 {
-    iterator_node *inode = (iterator_node *) malloc(sizeof(*inode));
-    if(inode == NULL)
-        throw (int) MBError::NO_MEMORY;
-
-    inode->key = new std::string(key);
-    if(mbdata != NULL)
-    {
-	inode->bucket_index = mbdata->bucket_index;
-        mbdata->TransferValueTo(inode->data, inode->data_len);
-        if(inode->data == NULL || inode->data_len <= 0)
-        {
-            free_iterator_node(inode);
-            inode = NULL;
-        }
+public:
+    explicit IteratorEntryGreater(const std::string &buff) : arena(buff) {
     }
-    else
-    {
-        inode->data = NULL;
-        inode->data_len = 0;
+    bool operator()(const IteratorEntry &a, const IteratorEntry &b) const {
+        int cmp = arena.compare(a.key_off, a.key_len, arena, b.key_off, b.key_len);
+        if(cmp != 0)
+            return cmp > 0;
+        return a.data_len < 0 && b.data_len >= 0;
     }
-
-    return inode;
-}
+private:
+    const std::string &arena;
+};
 
 /////////////////////////////////////////////////////////////////////
 // DB iterator
@@ -77,17 +66,78 @@ static iterator_node* new_iterator_node(const std::string &key, MBData *mbdata)
 // for(DB::iterator iter = db.begin(); iter != db.end(); ++iter) {
 //     std::cout << iter.key << "\n";
 // }
+// Keys and values are copied to the arenas of the iterator, which are
+// reused for the whole iteration. iter.key and iter.value.buff are only
+// valid until the iterator is incremented.
 /////////////////////////////////////////////////////////////////////
 
-const DB::iterator DB::begin(bool check_async_mode, bool rc_mode) const
+#define ITER_READ_OPTIONS (CONSTS::OPTION_KEY_ONLY | CONSTS::OPTION_READ_HEADER)
+
+const DB::iterator DB::begin(bool check_async_mode, bool rc_mode, int read_options) const
 {
     DB::iterator iter = iterator(*this, DB_ITER_STATE_INIT);
     if(rc_mode) iter.value.options |= CONSTS::OPTION_RC_MODE;
+    iter.value.options |= read_options & ITER_READ_OPTIONS;
     iter.init(check_async_mode);
 
     return iter;
 }
 
+// Example to iterate the keys starting with "tenant42/"
+// for(DB::iterator iter = db.begin_prefix("tenant42/"); iter != db.end(); ++iter) {
+//     std::cout << iter.key << "\n";
+// }
+const DB::iterator DB::begin_prefix(const std::string &prefix, int read_options) const
+{
+    DB::iterator iter = iterator(*this, DB_ITER_STATE_INIT);
+    iter.value.options |= read_options & ITER_READ_OPTIONS;
+    iter.init_prefix(prefix);
+
+    return iter;
+}
+
+// Example to iterate the keys in ["abc", "abd") in lexicographical order
+// DB::iterator iter = db.begin_range("abc", "abd");
+// for(; iter != db.end(); ++iter) {
+//     std::cout << iter.key << "\n";
+// }
+const DB::iterator DB::begin_range(const std::string &lower,
+                                   const std::string &upper, int read_options) const
+{
+    DB::iterator iter = iterator(*this, DB_ITER_STATE_INIT);
+    iter.value.options |= read_options & ITER_READ_OPTIONS;
+    iter.SetRange(lower, upper);
+    iter.SeekToFirst();
+
+    return iter;
+}
+
+// Example to page through the keys after "key100"
+// DB::iterator iter = db.begin_after("key100");
+// for(int i = 0; i < 100 && iter != db.end(); ++i, ++iter) {
+//     std::cout << iter.key << "\n";
+// }
+// iter.GetToken(token);
+const DB::iterator DB::begin_after(const std::string &key, int read_options) const
+{
+    DB::iterator iter = iterator(*this, DB_ITER_STATE_INIT);
+    iter.value.options |= read_options & ITER_READ_OPTIONS;
+    iter.SeekAfter(key);
+
+    return iter;
+}
+
+const DB::iterator DB::begin_token(const std::string &token, int read_options) const
+{
+    DB::iterator iter = iterator(*this, DB_ITER_STATE_INIT);
+    iter.value.options |= read_options & ITER_READ_OPTIONS;
+    int rval = iter.Resume(token);
+    if(rval != MBError::SUCCESS && rval != MBError::NOT_EXIST)
+        std::cerr << "failed to resume iterator: " << MBError::get_error_str(rval) << "\n";
+
+    return iter;
+}
+
 const DB::iterator DB::end() const
 {
     return iterator(*this, DB_ITER_STATE_DONE);
@@ -95,9 +145,10 @@ const DB::iterator DB::end() const
 
 void DB::iterator::iter_obj_init()
 {
-    node_stack = NULL;
-    kv_per_node = NULL;
     lfree = NULL;
+    order = DB_ITER_ORDER_NONE;
+    kv_index = 0;
+    stack_base = 0;
 
     if(!(db_ref.GetDBOptions() & CONSTS::ACCESS_MODE_WRITER))
     {
@@ -124,10 +175,6 @@ DB::iterator::iterator(const iterator &rhs)
 
 DB::iterator::~iterator()
 {
-    if(node_stack != NULL)
-        delete node_stack;
-    if(kv_per_node != NULL)
-        delete kv_per_node;
 }
 
 // Initialize the iterator, get the very first key-value pair.
@@ -140,20 +187,73 @@ void DB::iterator::init(bool check_async_mode)
         return;
     }
 
-    node_stack = new MBlsq(free_iterator_node);
-    kv_per_node = new MBlsq(free_iterator_node);
-
     load_kv_for_node("");
     if(next() == NULL)
         state = DB_ITER_STATE_DONE;
 }
 
+// Initialize the iterator starting from the edge that covers the prefix.
+// Only the subtree under the edge is traversed.
+void DB::iterator::init_prefix(const std::string &prefix)
+{
+    if(prefix.size() == 0)
+    {
+        init();
+        return;
+    }
+
+    // Writer in async mode cannot be used for lookup
+    if(db_ref.options & CONSTS::ASYNC_WRITER_MODE)
+    {
+        state = DB_ITER_STATE_DONE;
+        return;
+    }
+
+    std::string root_key;
+    size_t node_off;
+    size_t edge_off;
+    int rval = db_ref.dict->FindSubtree((const uint8_t *)prefix.data(), prefix.size(),
+                                        root_key, node_off, edge_off);
+    if(rval != MBError::SUCCESS)
+    {
+        if(rval != MBError::NOT_EXIST)
+            std::cerr << "failed to run iterator: " << MBError::get_error_str(rval) << "\n";
+        state = DB_ITER_STATE_DONE;
+        return;
+    }
+
+    // The key at the end of the edge is not reported by load_kvs.
+    MBData mbd(0, value.options & ITER_READ_OPTIONS);
+    if(db_ref.dict->Find((const uint8_t *)root_key.data(), root_key.size(), mbd) ==
+       MBError::SUCCESS)
+    {
+        add_entry(kv_arena, kv_per_node, root_key, "", &mbd);
+    }
+    if(node_off > 0)
+    {
+        add_entry(node_arena, node_stack, root_key, "", NULL);
+        node_stack.back().arena_end = node_arena.size();
+    }
+
+    if(next() == NULL)
+        state = DB_ITER_STATE_DONE;
+}
+
+// Initialize the iterator for the keys under the node. The key of the
+// node itself is not included.
+void DB::iterator::init_node(const std::string &node_key)
+{
+    add_entry(node_arena, node_stack, node_key, "", NULL);
+    node_stack.back().arena_end = node_arena.size();
+    if(next() == NULL)
+        state = DB_ITER_STATE_DONE;
+}
+
 // Initialize the iterator, but do not get the first key-value pair.
 // This is used for resource collection.
 int DB::iterator::init_no_next()
 {
-    node_stack = new MBlsq(NULL);
-    kv_per_node = NULL;
+    node_offsets.clear();
 
     int rval = db_ref.dict->ReadRootNode(node_buff, edge_ptrs, match, value);
     if(rval != MBError::SUCCESS)
@@ -175,6 +275,75 @@ bool DB::iterator::operator!=(const iterator &rhs)
     return state != rhs.state;
 }
 
+// Append the key and the value to the arena. Keys without value are not
+// added, which is the same as the other lookups. The caller needs to set
+// arena_end of the entry once all entries of the node are added.
+void DB::iterator::add_entry(std::string &arena, std::vector<IteratorEntry> &entries,
+                             const std::string &key_prefix,
+                             const std::string &key_suffix, const MBData *data)
+{
+    IteratorEntry entry;
+    if(data != NULL && (value.options & ITER_READ_OPTIONS))
+    {
+        // The value is not read.
+        entry.value_off = 0;
+        entry.data_len = data->data_len;
+        entry.bucket_index = data->bucket_index;
+        entry.data_offset = data->data_offset;
+    }
+    else if(data != NULL)
+    {
+        if(data->buff == NULL || data->data_len <= 0)
+            return;
+        entry.value_off = arena.size();
+        entry.data_len = data->data_len;
+        entry.bucket_index = data->bucket_index;
+        entry.data_offset = data->data_offset;
+        arena.append(reinterpret_cast<const char *>(data->buff), data->data_len);
+    }
+    else
+    {
+        entry.value_off = 0;
+        entry.data_len = -1;
+        entry.bucket_index = 0;
+        entry.data_offset = 0;
+    }
+
+    entry.key_off = arena.size();
+    entry.key_len = key_prefix.size() + key_suffix.size();
+    entry.arena_end = 0;
+    arena.append(key_prefix);
+    arena.append(key_suffix);
+    entries.push_back(entry);
+}
+
+// Remove the top of the node stack. The arena space is released when all
+// entries loaded with it are removed.
+void DB::iterator::pop_node()
+{
+    node_stack.pop_back();
+    if(node_stack.empty())
+        node_arena.clear();
+    else
+        node_arena.resize(node_stack.back().arena_end);
+}
+
+void DB::iterator::set_key_value(const std::string &arena, const IteratorEntry &entry)
+{
+    match = MATCH_NODE_OR_EDGE;
+    key.assign(arena, entry.key_off, entry.key_len);
+    value.data_len = entry.data_len;
+    value.bucket_index = entry.bucket_index;
+    value.data_offset = entry.data_offset;
+    if(value.options & ITER_READ_OPTIONS)
+        return;
+
+    if(value.buff_len < entry.data_len + 1 &&
+       value.Resize(entry.data_len) != MBError::SUCCESS)
+        throw (int) MBError::NO_MEMORY;
+    memcpy(value.buff, arena.data() + entry.value_off, entry.data_len);
+}
+
 int DB::iterator::get_node_offset(const std::string &node_key,
                                   size_t &parent_edge_off,
                                   size_t &node_offset)
@@ -194,6 +363,9 @@ int DB::iterator::get_node_offset(const std::string &node_key,
 
     if(rval == MBError::IN_DICT)
     {
+        // The node may have been removed by the writer.
+        if(value.edge_ptrs.flag_ptr[0] & EDGE_FLAG_DATA_OFF)
+            return MBError::NOT_EXIST;
         parent_edge_off = edge_ptrs.parent_offset;
         node_offset = Get6BInteger(value.edge_ptrs.offset_ptr);
         rval = MBError::SUCCESS;
@@ -201,13 +373,13 @@ int DB::iterator::get_node_offset(const std::string &node_key,
     return rval;
 }
 
-int DB::iterator::load_kvs(const std::string &curr_node_key,
-                           MBlsq *child_node_list)
+// Child nodes are added to child_list. Keys are added to kv_per_node, or to
+// child_list in ordered mode so that they are sorted with the nodes.
+int DB::iterator::load_kvs(const std::string &curr_node_key)
 {
     int rval;
     size_t child_node_off;
     std::string match_str;
-    iterator_node *inode;
 
     while(true)
     {
@@ -236,33 +408,15 @@ int DB::iterator::load_kvs(const std::string &curr_node_key,
         if(rval != MBError::SUCCESS)
             break;
 
-        match_str = curr_node_key + match_str;
         if(child_node_off > 0)
-        {
-            inode = new_iterator_node(match_str, NULL);
-            if(inode != NULL)
-            {
-                rval = child_node_list->AddToTail(inode);
-                if(rval != MBError::SUCCESS)
-                {
-                    free_iterator_node(inode);
-                    return rval;
-                }
-            }
-        }
+            add_entry(node_arena, child_list, curr_node_key, match_str, NULL);
 
         if(match != MATCH_NONE)
         {
-            inode = new_iterator_node(match_str, &value);
-            if(inode != NULL)
-            {
-                rval = kv_per_node->AddToTail(inode);
-                if(rval != MBError::SUCCESS)
-                {
-                    free_iterator_node(inode);
-                    return rval;
-                }
-            }
+            if(order == DB_ITER_ORDER_NONE)
+                add_entry(kv_arena, kv_per_node, curr_node_key, match_str, &value);
+            else
+                add_entry(node_arena, child_list, curr_node_key, match_str, &value);
         }
     }
 
@@ -296,14 +450,17 @@ int DB::iterator::load_node(const std::string &curr_node_key,
 int DB::iterator::load_kv_for_node(const std::string &curr_node_key)
 {
     int rval;
-    MBlsq child_node_list(free_iterator_node);
     size_t parent_edge_off;
+    size_t node_arena_size = node_arena.size();
+    size_t kv_arena_size = kv_arena.size();
+    size_t kv_count = kv_per_node.size();
 
+    child_list.clear();
     if(lfree == NULL)
     {
         rval = load_node(curr_node_key, parent_edge_off);
         if(rval == MBError::SUCCESS)
-            rval = load_kvs(curr_node_key, &child_node_list);
+            rval = load_kvs(curr_node_key);
     }
     else
     {
@@ -319,12 +476,14 @@ int DB::iterator::load_kv_for_node(const std::string &curr_node_key)
             rval = load_node(curr_node_key, parent_edge_off);
             if(rval == MBError::SUCCESS)
             {
-                rval = load_kvs(curr_node_key, &child_node_list);
+                rval = load_kvs(curr_node_key);
 #ifdef __LOCK_FREE__
                 if(rval == MBError::TRY_AGAIN)
                 {
-                    kv_per_node->Clear();
-                    child_node_list.Clear();
+                    kv_per_node.resize(kv_count);
+                    kv_arena.resize(kv_arena_size);
+                    child_list.clear();
+                    node_arena.resize(node_arena_size);
                     continue;
                 }
 #endif
@@ -333,8 +492,10 @@ int DB::iterator::load_kv_for_node(const std::string &curr_node_key)
             lf_ret = lfree->ReaderLockFreeStop(snapshot, parent_edge_off);
             if(lf_ret == MBError::TRY_AGAIN)
             {
-                kv_per_node->Clear();
-                child_node_list.Clear();
+                kv_per_node.resize(kv_count);
+                kv_arena.resize(kv_arena_size);
+                child_list.clear();
+                node_arena.resize(node_arena_size);
                 continue;
             }
 #endif
@@ -344,52 +505,472 @@ int DB::iterator::load_kv_for_node(const std::string &curr_node_key)
 
     if(rval == MBError::SUCCESS)
     {
-        iterator_node *inode;
-        while((inode = (iterator_node *) child_node_list.RemoveFromHead()))
+        for(size_t i = 0; i < child_list.size(); i++)
         {
-            node_stack->AddToHead(inode);
+            child_list[i].arena_end = node_arena.size();
         }
+        if(order == DB_ITER_ORDER_FORWARD)
+            std::sort(child_list.begin(), child_list.end(), IteratorEntryLess(node_arena));
+        else if(order == DB_ITER_ORDER_REVERSE)
+            std::sort(child_list.begin(), child_list.end(), IteratorEntryGreater(node_arena));
+
+        // The top of the stack is the last element.
+        if(order == DB_ITER_ORDER_NONE)
+            node_stack.insert(node_stack.end(), child_list.begin(), child_list.end());
+        else
+            node_stack.insert(node_stack.end(), child_list.rbegin(), child_list.rend());
     }
     else
     {
-        std::cerr << "failed to run ietrator: " << MBError::get_error_str(rval) << "\n";
-        kv_per_node->Clear();
-        child_node_list.Clear();
+        if(rval != MBError::NOT_EXIST)
+            std::cerr << "failed to run ietrator: " << MBError::get_error_str(rval) << "\n";
+        kv_per_node.resize(kv_count);
+        kv_arena.resize(kv_arena_size);
+        node_arena.resize(node_arena_size);
     }
+    child_list.clear();
     return rval;
 }
 
 // Find next iterator match
 DB::iterator* DB::iterator::next()
 {
-    iterator_node *inode;
+    if(order != DB_ITER_ORDER_NONE)
+        return next_ordered();
 
-    while(kv_per_node->Count() == 0)
+    while(kv_index >= kv_per_node.size())
     {
-        inode = (iterator_node *) node_stack->RemoveFromHead();
-        if(inode == NULL)
+        // All keys of the previous node are consumed.
+        kv_per_node.clear();
+        kv_arena.clear();
+        kv_index = 0;
+        if(node_stack.empty())
             return NULL;
 
-        int rval = load_kv_for_node(*inode->key);
-        free_iterator_node(inode);
+        const IteratorEntry &entry = node_stack.back();
+        node_key.assign(node_arena, entry.key_off, entry.key_len);
+        pop_node();
+        stack_base = node_stack.size();
+        // Nodes removed by the writer have no keys left.
+        int rval = load_kv_for_node(node_key);
+        if(rval == MBError::NOT_EXIST)
+            continue;
         if(rval != MBError::SUCCESS)
             return NULL;
     }
 
-    if(kv_per_node->Count() > 0)
+    set_key_value(kv_arena, kv_per_node[kv_index]);
+    kv_index++;
+    return this;
+}
+
+// Find next iterator match in ordered iteration. The node stack holds both
+// keys and nodes in the iteration order.
+DB::iterator* DB::iterator::next_ordered()
+{
+    while(!node_stack.empty())
     {
-        inode = (iterator_node *) kv_per_node->RemoveFromHead();
-        match = MATCH_NODE_OR_EDGE;
-        key = *inode->key;
-        value.TransferValueFrom(inode->data, inode->data_len);
-	value.bucket_index = inode->bucket_index;
-        free_iterator_node(inode);
+        const IteratorEntry &entry = node_stack.back();
+        if(entry.data_len < 0)
+        {
+            node_key.assign(node_arena, entry.key_off, entry.key_len);
+            pop_node();
+            int rval = load_kv_for_node(node_key);
+            if(rval != MBError::SUCCESS && rval != MBError::NOT_EXIST)
+                return NULL;
+            continue;
+        }
+
+        set_key_value(node_arena, entry);
+        pop_node();
+        if(!in_range())
+            return NULL;
         return this;
     }
 
     return NULL;
 }
 
+bool DB::iterator::in_range() const
+{
+    if(order == DB_ITER_ORDER_FORWARD)
+        return upper_bound.size() == 0 || key < upper_bound;
+    return lower_bound.size() == 0 || key >= lower_bound;
+}
+
+void DB::iterator::SetRange(const std::string &lower, const std::string &upper)
+{
+    lower_bound = lower;
+    upper_bound = upper;
+}
+
+// Start ordered iteration from the root node
+void DB::iterator::reset_ordered(int iter_order)
+{
+    order = iter_order;
+    state = DB_ITER_STATE_MORE;
+    node_stack.clear();
+    node_arena.clear();
+    kv_per_node.clear();
+    kv_arena.clear();
+    kv_index = 0;
+
+    add_entry(node_arena, node_stack, "", "", NULL);
+    node_stack.back().arena_end = node_arena.size();
+}
+
+// Compare the key of the entry on the top of the node stack
+int DB::iterator::compare_top(const std::string &seek_key) const
+{
+    const IteratorEntry &entry = node_stack.back();
+    return node_arena.compare(entry.key_off, entry.key_len, seek_key);
+}
+
+// Check if the key of the entry on the top of the node stack is a prefix
+// of seek_key
+bool DB::iterator::is_top_prefix(const std::string &seek_key) const
+{
+    const IteratorEntry &entry = node_stack.back();
+    return seek_key.size() >= static_cast<size_t>(entry.key_len) &&
+           seek_key.compare(0, entry.key_len, node_arena, entry.key_off, entry.key_len) == 0;
+}
+
+// Expand the node on the top of the stack
+int DB::iterator::expand_top()
+{
+    const IteratorEntry &entry = node_stack.back();
+    node_key.assign(node_arena, entry.key_off, entry.key_len);
+    pop_node();
+    return load_kv_for_node(node_key);
+}
+
+// Nodes on the stack are sorted. Drop the keys and subtrees before the key
+// and expand the nodes on the path of the key.
+int DB::iterator::Seek(const std::string &seek_key)
+{
+    // Writer in async mode cannot be used for lookup
+    if(db_ref.options & CONSTS::ASYNC_WRITER_MODE)
+    {
+        state = DB_ITER_STATE_DONE;
+        return MBError::NOT_ALLOWED;
+    }
+
+    if(seek_key < lower_bound)
+        return Seek(lower_bound);
+
+    reset_ordered(DB_ITER_ORDER_FORWARD);
+    while(!node_stack.empty())
+    {
+        if(compare_top(seek_key) >= 0)
+            break;
+
+        if(node_stack.back().data_len < 0 && is_top_prefix(seek_key))
+        {
+            if(expand_top() != MBError::SUCCESS)
+                node_stack.clear();
+        }
+        else
+        {
+            pop_node();
+        }
+    }
+
+    if(next() == NULL)
+    {
+        state = DB_ITER_STATE_DONE;
+        return MBError::NOT_EXIST;
+    }
+    return MBError::SUCCESS;
+}
+
+int DB::iterator::SeekForPrev(const std::string &seek_key)
+{
+    // Writer in async mode cannot be used for lookup
+    if(db_ref.options & CONSTS::ASYNC_WRITER_MODE)
+    {
+        state = DB_ITER_STATE_DONE;
+        return MBError::NOT_ALLOWED;
+    }
+
+    // The upper bound is exclusive.
+    bool exclusive = upper_bound.size() > 0 && seek_key >= upper_bound;
+    const std::string &target = exclusive ? upper_bound : seek_key;
+    reset_ordered(DB_ITER_ORDER_REVERSE);
+    int cmp;
+    while(!node_stack.empty())
+    {
+        cmp = compare_top(target);
+        bool is_node = node_stack.back().data_len < 0;
+        if(cmp < 0 && is_node && is_top_prefix(target))
+        {
+            if(expand_top() != MBError::SUCCESS)
+                node_stack.clear();
+        }
+        else if(cmp < 0 || (cmp == 0 && !is_node && !exclusive))
+        {
+            break;
+        }
+        else
+        {
+            pop_node();
+        }
+    }
+
+    if(next() == NULL)
+    {
+        state = DB_ITER_STATE_DONE;
+        return MBError::NOT_EXIST;
+    }
+    return MBError::SUCCESS;
+}
+
+int DB::iterator::SeekToFirst()
+{
+    return Seek(lower_bound);
+}
+
+int DB::iterator::SeekToLast()
+{
+    if(db_ref.options & CONSTS::ASYNC_WRITER_MODE)
+    {
+        state = DB_ITER_STATE_DONE;
+        return MBError::NOT_ALLOWED;
+    }
+
+    if(upper_bound.size() > 0)
+        return SeekForPrev(upper_bound);
+
+    reset_ordered(DB_ITER_ORDER_REVERSE);
+    if(next() == NULL)
+    {
+        state = DB_ITER_STATE_DONE;
+        return MBError::NOT_EXIST;
+    }
+    return MBError::SUCCESS;
+}
+
+int DB::iterator::Next()
+{
+    if(state != DB_ITER_STATE_MORE)
+        return MBError::NOT_EXIST;
+
+    if(order == DB_ITER_ORDER_REVERSE)
+    {
+        // Change direction
+        std::string curr_key = key;
+        int rval = Seek(curr_key);
+        if(rval != MBError::SUCCESS || key != curr_key)
+            return rval;
+    }
+
+    if(next() == NULL)
+    {
+        state = DB_ITER_STATE_DONE;
+        return MBError::NOT_EXIST;
+    }
+    return MBError::SUCCESS;
+}
+
+int DB::iterator::Prev()
+{
+    if(state != DB_ITER_STATE_MORE)
+        return MBError::NOT_EXIST;
+    if(order == DB_ITER_ORDER_NONE)
+        return MBError::NOT_ALLOWED;
+
+    if(order == DB_ITER_ORDER_FORWARD)
+    {
+        // Change direction
+        std::string curr_key = key;
+        int rval = SeekForPrev(curr_key);
+        if(rval != MBError::SUCCESS || key != curr_key)
+            return rval;
+    }
+
+    if(next() == NULL)
+    {
+        state = DB_ITER_STATE_DONE;
+        return MBError::NOT_EXIST;
+    }
+    return MBError::SUCCESS;
+}
+
+/////////////////////////////////////////////////////////////////////
+// Continuation token
+// The token has the iteration order, the range, the current key and, for
+// unordered iteration, the keys of the nodes still to be visited. The
+// node being consumed is reloaded when resuming, and the keys already
+// returned from it are skipped. Nodes removed by the writer in the
+// meantime are skipped.
+/////////////////////////////////////////////////////////////////////
+
+#define ITER_TOKEN_VERSION 1
+
+static void append_token_int(std::string &token, uint32_t num)
+{
+    token.append(reinterpret_cast<const char *>(&num), sizeof(num));
+}
+
+static void append_token_str(std::string &token, const std::string &str)
+{
+    append_token_int(token, str.size());
+    token.append(str);
+}
+
+static bool read_token_int(const std::string &token, size_t &pos, uint32_t &num)
+{
+    if(pos + sizeof(num) > token.size())
+        return false;
+    memcpy(&num, token.data() + pos, sizeof(num));
+    pos += sizeof(num);
+    return true;
+}
+
+static bool read_token_str(const std::string &token, size_t &pos, std::string &str)
+{
+    uint32_t len;
+    if(!read_token_int(token, pos, len) || len > token.size() - pos)
+        return false;
+    str.assign(token, pos, len);
+    pos += len;
+    return true;
+}
+
+int DB::iterator::GetToken(std::string &token) const
+{
+    if(state != DB_ITER_STATE_MORE)
+        return MBError::NOT_EXIST;
+
+    token.clear();
+    token.push_back(ITER_TOKEN_VERSION);
+    token.push_back(static_cast<char>(order));
+    append_token_str(token, lower_bound);
+    append_token_str(token, upper_bound);
+    append_token_str(token, key);
+    if(order != DB_ITER_ORDER_NONE)
+        return MBError::SUCCESS;
+
+    // The children of the current node are added again when the node
+    // is reloaded. The edges of a node start with different bytes, so the
+    // keys already returned are identified by the first edge byte.
+    bool has_node = kv_index < kv_per_node.size();
+    size_t num_nodes = has_node ? std::min(stack_base, node_stack.size()) : node_stack.size();
+    std::string consumed;
+    if(has_node)
+    {
+        for(size_t i = 0; i < kv_index; i++)
+            consumed.push_back(kv_arena[kv_per_node[i].key_off + node_key.size()]);
+    }
+    token.push_back(has_node ? 1 : 0);
+    append_token_str(token, node_key);
+    append_token_str(token, consumed);
+    append_token_int(token, num_nodes);
+    for(size_t i = 0; i < num_nodes; i++)
+    {
+        const IteratorEntry &entry = node_stack[i];
+        append_token_int(token, entry.key_len);
+        token.append(node_arena, entry.key_off, entry.key_len);
+    }
+    return MBError::SUCCESS;
+}
+
+// Move to the first key after last_key in the iteration order
+int DB::iterator::resume_ordered(int iter_order, const std::string &last_key)
+{
+    int rval;
+    if(iter_order == DB_ITER_ORDER_FORWARD)
+        rval = Seek(last_key);
+    else
+        rval = SeekForPrev(last_key);
+    if(rval != MBError::SUCCESS || key != last_key)
+        return rval;
+
+    if(next() == NULL)
+    {
+        state = DB_ITER_STATE_DONE;
+        return MBError::NOT_EXIST;
+    }
+    return MBError::SUCCESS;
+}
+
+int DB::iterator::SeekAfter(const std::string &seek_key)
+{
+    return resume_ordered(DB_ITER_ORDER_FORWARD, seek_key);
+}
+
+int DB::iterator::Resume(const std::string &token)
+{
+    state = DB_ITER_STATE_DONE;
+    if(db_ref.options & CONSTS::ASYNC_WRITER_MODE)
+        return MBError::NOT_ALLOWED;
+
+    size_t pos = 2;
+    std::string last_key;
+    if(token.size() < pos || token[0] != ITER_TOKEN_VERSION ||
+       !read_token_str(token, pos, lower_bound) ||
+       !read_token_str(token, pos, upper_bound) ||
+       !read_token_str(token, pos, last_key))
+        return MBError::INVALID_ARG;
+
+    int iter_order = token[1];
+    if(iter_order == DB_ITER_ORDER_FORWARD || iter_order == DB_ITER_ORDER_REVERSE)
+        return resume_ordered(iter_order, last_key);
+    if(iter_order != DB_ITER_ORDER_NONE || pos >= token.size())
+        return MBError::INVALID_ARG;
+
+    bool has_node = token[pos++] != 0;
+    uint32_t num_nodes;
+    std::string curr_node_key;
+    std::string consumed;
+    if(!read_token_str(token, pos, curr_node_key) ||
+       !read_token_str(token, pos, consumed) ||
+       !read_token_int(token, pos, num_nodes))
+        return MBError::INVALID_ARG;
+
+    order = DB_ITER_ORDER_NONE;
+    node_stack.clear();
+    node_arena.clear();
+    kv_per_node.clear();
+    kv_arena.clear();
+    kv_index = 0;
+    for(uint32_t i = 0; i < num_nodes; i++)
+    {
+        if(!read_token_str(token, pos, node_key))
+            return MBError::INVALID_ARG;
+        add_entry(node_arena, node_stack, node_key, "", NULL);
+        node_stack.back().arena_end = node_arena.size();
+    }
+
+    state = DB_ITER_STATE_MORE;
+    if(has_node)
+    {
+        node_key = curr_node_key;
+        stack_base = node_stack.size();
+        int rval = load_kv_for_node(node_key);
+        if(rval != MBError::SUCCESS && rval != MBError::NOT_EXIST)
+        {
+            state = DB_ITER_STATE_DONE;
+            return rval;
+        }
+
+        // Move the keys already returned to the front.
+        size_t prefix_len = node_key.size();
+        for(size_t i = 0; i < kv_per_node.size(); i++)
+        {
+            const IteratorEntry &entry = kv_per_node[i];
+            if(consumed.find(kv_arena[entry.key_off + prefix_len]) != std::string::npos)
+                std::swap(kv_per_node[kv_index++], kv_per_node[i]);
+        }
+    }
+
+    if(next() == NULL)
+    {
+        state = DB_ITER_STATE_DONE;
+        return MBError::NOT_EXIST;
+    }
+    return MBError::SUCCESS;
+}
+
 // There is no need to perform lock-free check in next_dbt_buffer
 // since it can only be called by writer.
 bool DB::iterator::next_dbt_buffer(struct _DBTraverseNode *dbt_n)
@@ -405,7 +986,7 @@ bool DB::iterator::next_dbt_buffer(struct _DBTraverseNode *dbt_n)
         while((rval = db_ref.dict->ReadNextEdge(node_buff, edge_ptrs, match,
                       value, match_str, node_off, false)) == MBError::SUCCESS)
         {
-            if(edge_ptrs.len_ptr[0] > LOCAL_EDGE_LEN)
+            if(edge_ptrs.len_ptr[0] > db_ref.dict->GetMM()->GetLocalEdgeLen())
             {
                 dbt_n->edgestr_offset       = Get5BInteger(edge_ptrs.ptr);
                 dbt_n->edgestr_size         = edge_ptrs.len_ptr[0] - 1;
@@ -441,9 +1022,10 @@ bool DB::iterator::next_dbt_buffer(struct _DBTraverseNode *dbt_n)
 
         if(rval == MBError::OUT_OF_BOUND)
         {
-            node_off = (size_t ) node_stack->RemoveIntFromHead();
-            if(node_off == 0)
+            if(node_offsets.empty())
                 break;
+            node_off = node_offsets.back();
+            node_offsets.pop_back();
             rval = db_ref.dict->ReadNode(node_off, node_buff, edge_ptrs, match,
                                          value, false);
             if(rval != MBError::SUCCESS)
@@ -461,9 +1043,7 @@ bool DB::iterator::next_dbt_buffer(struct _DBTraverseNode *dbt_n)
 // Add an node offset to the iterator queue
 void DB::iterator::add_node_offset(size_t node_offset)
 {
-    int rval = node_stack->AddIntToHead(node_offset);
-    if(rval != MBError::SUCCESS)
-        throw rval; 
+    node_offsets.push_back(node_offset);
 }
 
 }
@@ -0,0 +1,268 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include "key_filter.h"
+#include "mabain_consts.h"
+#include "resource_pool.h"
+#include "logger.h"
+#include "error.h"
+#include "mb_hash.h"
+
+namespace mabain {
+
+// Counter positions of the key in its block. h2 is odd so that the probes
+// are distinct.
+#define KEY_FILTER_PROBE_POS(hash, i) \
+    (((hash) + (i) * (((hash) >> 16) | 1)) & (KEY_FILTER_BLOCK_SIZE*2 - 1))
+
+static inline int GetCounter(const uint8_t *block, int pos)
+{
+    return (block[pos >> 1] >> ((pos & 1) << 2)) & KEY_FILTER_COUNTER_MAX;
+}
+
+static inline void IncCounter(uint8_t *block, int pos)
+{
+    if(GetCounter(block, pos) < KEY_FILTER_COUNTER_MAX)
+        block[pos >> 1] += 1 << ((pos & 1) << 2);
+}
+
+static inline void DecCounter(uint8_t *block, int pos)
+{
+    int cnt = GetCounter(block, pos);
+    if(cnt > 0 && cnt < KEY_FILTER_COUNTER_MAX)
+        block[pos >> 1] -= 1 << ((pos & 1) << 2);
+}
+
+KeyFilter::KeyFilter(const std::string &mbdir, int mode, size_t size)
+                   : header(NULL),
+                     counters(NULL),
+                     rebuild_counters(NULL),
+                     rebuild_num_key(0),
+                     num_lookup(0),
+                     num_reject(0),
+                     num_false_positive(0)
+{
+    std::string fpath = mbdir + "_mabain_f";
+    bool writer = mode & CONSTS::ACCESS_MODE_WRITER;
+    bool exist;
+    size_t file_size = size;
+    if(mode & CONSTS::MEMORY_ONLY_MODE)
+    {
+        exist = ResourcePool::getInstance().CheckExistence(fpath);
+    }
+    else
+    {
+        struct stat st;
+        exist = (stat(fpath.c_str(), &st) == 0);
+        if(exist)
+            file_size = st.st_size;
+    }
+
+    // Only writer creates the filter and only if it is asked for.
+    if(!exist && !(writer && (mode & CONSTS::KEY_FILTER)))
+        return;
+
+    if(file_size == 0)
+        file_size = KEY_FILTER_SIZE_DEFAULT;
+    file_size -= file_size % KEY_FILTER_BLOCK_SIZE;
+    if(file_size < 2*KEY_FILTER_BLOCK_SIZE)
+        file_size = 2*KEY_FILTER_BLOCK_SIZE;
+
+    bool map_file = true;
+    filter_file = ResourcePool::getInstance().OpenFile(fpath, mode, file_size,
+                                                       map_file, writer);
+    header = reinterpret_cast<KeyFilterHeader*>(filter_file->GetMapAddr());
+    if(header == NULL || !map_file)
+    {
+        header = NULL;
+        Logger::Log(LOG_LEVEL_ERROR, "failed to map key filter %s", fpath.c_str());
+        throw (int) MBError::MMAP_FAILED;
+    }
+    counters = reinterpret_cast<uint8_t*>(header) + KEY_FILTER_BLOCK_SIZE;
+
+    if(!exist || header->version != KEY_FILTER_VERSION)
+    {
+        if(!writer)
+        {
+            Logger::Log(LOG_LEVEL_WARN, "key filter version %u not supported",
+                        header->version);
+            header = NULL;
+            return;
+        }
+
+        // The filter will be populated by DB::RebuildKeyFilter.
+        header->ready.store(0, std::memory_order_release);
+        header->version = KEY_FILTER_VERSION;
+        header->num_probe = KEY_FILTER_NUM_PROBE;
+        header->num_block = file_size/KEY_FILTER_BLOCK_SIZE - 1;
+        header->num_key = 0;
+        memset(counters, 0, header->num_block*KEY_FILTER_BLOCK_SIZE);
+        Logger::Log(LOG_LEVEL_INFO, "key filter %s created with %llu blocks",
+                    fpath.c_str(), header->num_block);
+    }
+}
+
+KeyFilter::~KeyFilter()
+{
+    if(rebuild_counters != NULL)
+        delete [] rebuild_counters;
+}
+
+bool KeyFilter::IsValid() const
+{
+    return header != NULL;
+}
+
+bool KeyFilter::IsReady() const
+{
+    return header->ready.load(std::memory_order_acquire) != 0;
+}
+
+uint8_t* KeyFilter::GetBlock(uint8_t *cnt_buff, uint64_t hash) const
+{
+    return cnt_buff + ((hash >> 32) % header->num_block) * KEY_FILTER_BLOCK_SIZE;
+}
+
+bool KeyFilter::Contain(const uint8_t *key, int len)
+{
+    if(!IsReady())
+        return true;
+
+    num_lookup++;
+    uint64_t hash = MBHash64(key, len);
+    const uint8_t *block = GetBlock(counters, hash);
+    for(uint32_t i = 0; i < KEY_FILTER_NUM_PROBE; i++)
+    {
+        if(GetCounter(block, KEY_FILTER_PROBE_POS(hash, i)) == 0)
+        {
+            num_reject++;
+            return false;
+        }
+    }
+    return true;
+}
+
+void KeyFilter::AddFalsePositive()
+{
+    num_false_positive++;
+}
+
+void KeyFilter::Add(const uint8_t *key, int len)
+{
+    uint64_t hash = MBHash64(key, len);
+    uint8_t *block = GetBlock(counters, hash);
+    for(uint32_t i = 0; i < KEY_FILTER_NUM_PROBE; i++)
+        IncCounter(block, KEY_FILTER_PROBE_POS(hash, i));
+    header->num_key++;
+}
+
+void KeyFilter::Remove(const uint8_t *key, int len)
+{
+    uint64_t hash = MBHash64(key, len);
+    uint8_t *block = GetBlock(counters, hash);
+    for(uint32_t i = 0; i < KEY_FILTER_NUM_PROBE; i++)
+        DecCounter(block, KEY_FILTER_PROBE_POS(hash, i));
+    header->num_key--;
+}
+
+// Only called after all keys are removed from DB.
+void KeyFilter::Clear()
+{
+    memset(counters, 0, header->num_block*KEY_FILTER_BLOCK_SIZE);
+    header->num_key = 0;
+}
+
+void KeyFilter::RebuildStart()
+{
+    if(rebuild_counters == NULL)
+        rebuild_counters = new uint8_t[header->num_block*KEY_FILTER_BLOCK_SIZE];
+    memset(rebuild_counters, 0, header->num_block*KEY_FILTER_BLOCK_SIZE);
+    rebuild_num_key = 0;
+}
+
+void KeyFilter::RebuildAdd(const uint8_t *key, int len)
+{
+    uint64_t hash = MBHash64(key, len);
+    uint8_t *block = GetBlock(rebuild_counters, hash);
+    for(uint32_t i = 0; i < KEY_FILTER_NUM_PROBE; i++)
+        IncCounter(block, KEY_FILTER_PROBE_POS(hash, i));
+    rebuild_num_key++;
+}
+
+// Counters of existing keys are non-zero in both the old and the new filter.
+// Readers can keep using the filter while it is being overwritten.
+void KeyFilter::RebuildFinish()
+{
+    memcpy(counters, rebuild_counters, header->num_block*KEY_FILTER_BLOCK_SIZE);
+    header->num_key = rebuild_num_key;
+    header->ready.store(1, std::memory_order_release);
+
+    delete [] rebuild_counters;
+    rebuild_counters = NULL;
+}
+
+// Saturated counters and counters of keys added twice by resource collection
+// are never cleared. The false positive rate is estimated from the ratio of
+// non-zero counters in a sample of the blocks and compared with the rate of
+// a filter holding only num_key keys.
+bool KeyFilter::NeedRebuild(int64_t num_key) const
+{
+    if(!IsReady())
+        return true;
+
+    uint64_t step = header->num_block / KEY_FILTER_SAMPLE_BLOCKS + 1;
+    int64_t num_set = 0;
+    int64_t num_counter = 0;
+    for(uint64_t i = 0; i < header->num_block; i += step)
+    {
+        const uint8_t *block = counters + i * KEY_FILTER_BLOCK_SIZE;
+        for(int pos = 0; pos < KEY_FILTER_BLOCK_SIZE*2; pos++)
+        {
+            if(GetCounter(block, pos) != 0)
+                num_set++;
+        }
+        num_counter += KEY_FILTER_BLOCK_SIZE*2;
+    }
+
+    double fp_rate = pow(static_cast<double>(num_set) / num_counter, KEY_FILTER_NUM_PROBE);
+    double fill = 1.0 - exp(-static_cast<double>(KEY_FILTER_NUM_PROBE) * num_key /
+                            (header->num_block * KEY_FILTER_BLOCK_SIZE * 2));
+    double min_fp_rate = pow(fill, KEY_FILTER_NUM_PROBE);
+    return fp_rate >= KEY_FILTER_REBUILD_FP_RATE &&
+           fp_rate >= KEY_FILTER_REBUILD_RATIO * min_fp_rate;
+}
+
+void KeyFilter::PrintStats(std::ostream &out_stream) const
+{
+    out_stream << "Key filter stats:\n";
+    out_stream << "\tFilter size: " << (header->num_block + 1) * KEY_FILTER_BLOCK_SIZE
+               << std::endl;
+    out_stream << "\tReady: " << (IsReady() ? "yes" : "no") << std::endl;
+    out_stream << "\tNumber of keys: " << header->num_key << std::endl;
+    out_stream << "\tNumber of lookups: " << num_lookup << std::endl;
+    out_stream << "\tNumber of rejected lookups: " << num_reject << std::endl;
+    // Ratio of lookups of non-existent keys not rejected by the filter
+    double fp_rate = 0.0;
+    if(num_reject + num_false_positive > 0)
+        fp_rate = static_cast<double>(num_false_positive) / (num_reject + num_false_positive);
+    out_stream << "\tFalse positive rate: " << fp_rate << std::endl;
+}
+
+}
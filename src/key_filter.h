@@ -0,0 +1,102 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __KEY_FILTER_H__
+#define __KEY_FILTER_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <iostream>
+
+#include "mmap_file.h"
+
+namespace mabain {
+
+#define KEY_FILTER_VERSION           1
+#define KEY_FILTER_BLOCK_SIZE        64
+#define KEY_FILTER_NUM_PROBE         8
+#define KEY_FILTER_COUNTER_MAX       0xF
+#define KEY_FILTER_SIZE_DEFAULT      (16*1024*1024LL)
+// Blocks sampled to estimate the false positive rate
+#define KEY_FILTER_SAMPLE_BLOCKS     4096
+// Rebuild if the estimated false positive rate is at least this much and
+// this many times the rate after a rebuild.
+#define KEY_FILTER_REBUILD_FP_RATE   0.01
+#define KEY_FILTER_REBUILD_RATIO     2
+
+typedef struct _KeyFilterHeader
+{
+    uint32_t version;
+    uint32_t num_probe;
+    uint64_t num_block;
+    // Readers can only use the filter after it is fully populated.
+    std::atomic<int> ready;
+    int64_t  num_key;
+} KeyFilterHeader;
+
+// Counting blocked Bloom filter for rejecting lookups of keys that are not
+// in DB. All probes of a key fall in one 64-byte block. Each block holds
+// 128 4-bit counters so that writer can remove keys. Saturated counters are
+// never decremented; they are reset when the filter is rebuilt.
+// The filter is kept in the shared memory file _mabain_f. Writer adds a key
+// before the key is visible in the index and removes it after the key is
+// deleted from the index so that readers never get false negatives.
+class KeyFilter
+{
+public:
+    KeyFilter(const std::string &mbdir, int mode, size_t size);
+    ~KeyFilter();
+
+    bool IsValid() const;
+    bool IsReady() const;
+    // Return false if the key is definitely not in DB.
+    bool Contain(const uint8_t *key, int len);
+    void AddFalsePositive();
+
+    // Called by writer only
+    void Add(const uint8_t *key, int len);
+    void Remove(const uint8_t *key, int len);
+    void Clear();
+    void RebuildStart();
+    void RebuildAdd(const uint8_t *key, int len);
+    void RebuildFinish();
+    // Check if stale counters make the filter worth rebuilding for num_key
+    // keys in DB.
+    bool NeedRebuild(int64_t num_key) const;
+
+    void PrintStats(std::ostream &out_stream) const;
+
+private:
+    uint8_t* GetBlock(uint8_t *counters, uint64_t hash) const;
+
+    std::shared_ptr<MmapFileIO> filter_file;
+    KeyFilterHeader *header;
+    uint8_t *counters;
+    // process-local counters for the rebuild
+    uint8_t *rebuild_counters;
+    int64_t rebuild_num_key;
+
+    // stats of this handle
+    int64_t num_lookup;
+    int64_t num_reject;
+    int64_t num_false_positive;
+};
+
+}
+
+#endif
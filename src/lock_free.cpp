@@ -92,4 +92,13 @@ int LockFree::ReaderLockFreeStop(const LockFreeData &snapshot, size_t reader_off
     return MBError::SUCCESS;
 }
 
+int LockFree::ReaderLockFreeCheck(const LockFreeData &snapshot) const
+{
+    if(shm_data_ptr->offset.load(MEMORY_ORDER_READER) != MAX_6B_OFFSET)
+        return MBError::TRY_AGAIN;
+    if(shm_data_ptr->counter.load(MEMORY_ORDER_READER) != snapshot.counter)
+        return MBError::TRY_AGAIN;
+    return MBError::SUCCESS;
+}
+
 }
@@ -58,6 +58,9 @@ public:
     inline void ReaderLockFreeStart(LockFreeData &snapshot);
     // If there was race condition, this function returns MBError::TRY_AGAIN.
     int  ReaderLockFreeStop(const LockFreeData &snapshot, size_t reader_offset);
+    // Returns MBError::TRY_AGAIN if writer was updating or has updated anything
+    // since the snapshot.
+    int  ReaderLockFreeCheck(const LockFreeData &snapshot) const;
 
 private:
     LockFreeShmData *shm_data_ptr;
@@ -27,10 +27,19 @@ const int CONSTS::SYNC_ON_WRITE                = 0x4;
 const int CONSTS::USE_SLIDING_WINDOW           = 0x8;
 const int CONSTS::NO_RUNNING_WRITER_CHECK      = 0x10;
 const int CONSTS::MEMORY_ONLY_MODE             = 0x20;
+const int CONSTS::ADAPTIVE_NODE_FORMAT         = 0x40;
+const int CONSTS::HOT_NODE_CACHE               = 0x80;
+const int CONSTS::KEY_FILTER                   = 0x100;
+const int CONSTS::HASH_INDEX                   = 0x200;
+const int CONSTS::WIDE_EDGE                    = 0x400;
+const int CONSTS::SHM_ASYNC_QUEUE              = 0x800;
 
 const int CONSTS::OPTION_ALL_PREFIX            = 0x1;
 const int CONSTS::OPTION_FIND_AND_STORE_PARENT = 0x2;
 const int CONSTS::OPTION_RC_MODE               = 0x4;
+const int CONSTS::OPTION_READ_VIEW             = 0x8;
+const int CONSTS::OPTION_KEY_ONLY              = 0x10;
+const int CONSTS::OPTION_READ_HEADER           = 0x20;
 
 const int CONSTS::MAX_KEY_LENGHTH              = 256;
 const int CONSTS::MAX_DATA_SIZE                = 0x7FFF;
@@ -31,9 +31,18 @@ public:
     static const int USE_SLIDING_WINDOW;
     static const int NO_RUNNING_WRITER_CHECK;
     static const int MEMORY_ONLY_MODE;
+    static const int ADAPTIVE_NODE_FORMAT;
+    static const int HOT_NODE_CACHE;
+    static const int KEY_FILTER;
+    static const int HASH_INDEX;
+    static const int WIDE_EDGE;
+    static const int SHM_ASYNC_QUEUE;
     static const int OPTION_ALL_PREFIX;
     static const int OPTION_FIND_AND_STORE_PARENT;
     static const int OPTION_RC_MODE;
+    static const int OPTION_READ_VIEW;
+    static const int OPTION_KEY_ONLY;
+    static const int OPTION_READ_HEADER;
     // not init shared memory ptr, not update db counter
     static const int MAX_KEY_LENGHTH;
     static const int MAX_DATA_SIZE;
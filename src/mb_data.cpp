@@ -28,6 +28,7 @@ MBData::MBData()
     data_len = 0;
     buff_len = 0;
     buff = NULL;
+    view = NULL;
 
     match_len = 0;
     next = false;
@@ -53,6 +54,7 @@ MBData::MBData(int size, int match_options)
     }
 
     data_len = 0;
+    view = NULL;
     match_len = 0;
     next = false;
     options = match_options;
@@ -116,6 +118,7 @@ void MBData::Clear()
 {
     match_len = 0;
     data_len = 0;
+    view = NULL;
     next = false;
 }
 
@@ -26,9 +26,14 @@
 
 #define NUM_ALPHABET               256
 #define NODE_EDGE_KEY_FIRST        8
+#define EDGE_SIZE                  13
+#define WIDE_EDGE_SIZE             32
 #define DB_ITER_STATE_INIT         0x00
 #define DB_ITER_STATE_MORE         0x01
 #define DB_ITER_STATE_DONE         0x02
+#define DB_ITER_ORDER_NONE         0x00
+#define DB_ITER_ORDER_FORWARD      0x01
+#define DB_ITER_ORDER_REVERSE      0x02
 #define DATA_BLOCK_SIZE_DEFAULT    64LLU*1024*1024     // 64M
 #define INDEX_BLOCK_SIZE_DEFAULT   64LLU*1024*1024     // 64M
 #define BLOCK_SIZE_ALIGN           4*1024*1024         // 4K
@@ -52,8 +57,8 @@ typedef struct _EdgePtrs
     uint8_t *flag_ptr;
     uint8_t *offset_ptr;
 
-    // temp buffer for edge, must be bigger than EDGE_SIZE.
-    uint8_t edge_buff[16];
+    // temp buffer for edge, at least WIDE_EDGE_SIZE.
+    uint8_t edge_buff[WIDE_EDGE_SIZE];
     // temp usage for calling UpdateNode or entry removing
     int curr_nt;
     // temp usage for entry removing
@@ -85,12 +90,18 @@ public:
     uint8_t *buff;
     // buffer length
     int buff_len;
+    // Value pointer set by DB::FindView. It points into the mapped data
+    // file if possible; otherwise the value is copied to buff and view
+    // points to buff.
+    const uint8_t *view;
 
     // data offset
     size_t data_offset;
     uint16_t bucket_index;
 
     // Search options
+    // With OPTION_KEY_ONLY, only data_offset is set. With OPTION_READ_HEADER,
+    // data_len and bucket_index are also set, but the value is not copied.
     int options;
 
     // temp data for multiple common prefix search
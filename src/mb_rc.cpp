@@ -68,7 +68,9 @@ int ResourceCollection::LRUEviction()
     if(prune_diff == 0)
         prune_diff = 1;
 
-    for(DB::iterator iter = db_ref.begin(false); iter != db_ref.end(); ++iter)
+    // Only bucket_index is needed from the data header.
+    for(DB::iterator iter = db_ref.begin(false, false, CONSTS::OPTION_READ_HEADER);
+        iter != db_ref.end(); ++iter)
     {
         if(CIRCULAR_PRUNE_DIFF(iter.value.bucket_index, header->eviction_bucket_index) < prune_diff)
         {
@@ -151,6 +153,10 @@ void ResourceCollection::ReclaimResource(int64_t min_index_size,
     if(min_index_size > 0 || min_data_size > 0)
     {
         Prepare(min_index_size, min_data_size);
+        // Data buffers will be moved. Readers cannot use the hash index
+        // until it is rebuilt.
+        if(dict->GetHashIndex() != NULL)
+            dict->GetHashIndex()->RebuildStart();
         Logger::Log(LOG_LEVEL_INFO, "defragmentation started for [index - %s] [data - %s]",
                 rc_type & RESOURCE_COLLECTION_TYPE_INDEX ? "yes":"no",
                 rc_type & RESOURCE_COLLECTION_TYPE_DATA ? " yes":"no");
@@ -159,6 +165,8 @@ void ResourceCollection::ReclaimResource(int64_t min_index_size,
         ReorderBuffers();
         CollectBuffers();
         Finish();
+        if(dict->GetHashIndex() != NULL)
+            dict->RebuildHashIndex();
 
         gettimeofday(&stop, NULL);
         async_writer_ptr = NULL;
@@ -174,6 +182,31 @@ void ResourceCollection::ReclaimResource(int64_t min_index_size,
                     timediff/1000.);
         }
     }
+
+    // Evicted keys with saturated counters and keys moved from the rc tree
+    // leave stale counters in the key filter. Rebuild it once at the end
+    // if they raise its false positive rate.
+    KeyFilter *key_filter = dict->GetKeyFilter();
+    if(key_filter != NULL && key_filter->NeedRebuild(header->count))
+    {
+        Logger::Log(LOG_LEVEL_INFO, "rebuilding key filter");
+        dict->RebuildKeyFilter(db_ref);
+    }
+}
+
+void ResourceCollection::MigrateIndexFormat(uint16_t format)
+{
+    if(!db_ref.is_open())
+        throw db_ref.Status();
+
+    Logger::Log(LOG_LEVEL_INFO, "migrating index format from %u to %u",
+                header->version[3], format);
+    index_reorder_cnt = 0;
+    dmm->SetIndexFormat(format);
+    dmm->ResetSlidingWindow();
+    TraverseDB(RESOURCE_COLLECTION_PHASE_MIGRATE);
+    Logger::Log(LOG_LEVEL_INFO, "index format migration done, %lld nodes moved",
+                index_reorder_cnt);
 }
 
 /////////////////////////////////////////////////////////
@@ -391,6 +424,17 @@ bool ResourceCollection::MoveDataBuffer(int phase, size_t &offset_src, int size)
 
 void ResourceCollection::DoTask(int phase, DBTraverseNode &dbt_node)
 {
+    if(phase == RESOURCE_COLLECTION_PHASE_MIGRATE)
+    {
+        if(dbt_node.buffer_type & BUFFER_TYPE_NODE)
+        {
+            if(dmm->MigrateNode(dbt_node.node_offset, dbt_node.node_link_offset,
+                                dbt_node.edge_offset))
+                index_reorder_cnt++;
+        }
+        return;
+    }
+
     header->excep_lf_offset = dbt_node.edge_offset;
     if(rc_type & RESOURCE_COLLECTION_TYPE_INDEX)
     {
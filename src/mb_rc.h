@@ -29,6 +29,7 @@
 
 #define RESOURCE_COLLECTION_PHASE_REORDER         0x01
 #define RESOURCE_COLLECTION_PHASE_COLLECT         0x02
+#define RESOURCE_COLLECTION_PHASE_MIGRATE         0x03
 
 namespace mabain {
 
@@ -44,6 +45,8 @@ public:
     void ReclaimResource(int64_t min_index_size, int64_t min_data_size,
                          int64_t max_dbsz, int64_t max_dbcnt,
                          AsyncWriter *awr = NULL);
+    // Convert all nodes to the layout of the given index format.
+    void MigrateIndexFormat(uint16_t format);
 
 private:
     void DoTask(int phase, DBTraverseNode &dbt_node);
@@ -0,0 +1,277 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parallel_scan.h"
+#include "error.h"
+#include "logger.h"
+#include "mabain_consts.h"
+
+namespace mabain {
+
+ParallelScanner::ParallelScanner(const DB &db, int nthreads, const ScanCallback &fn)
+                               : db_ref(db),
+                                 num_threads(nthreads),
+                                 callback(fn),
+                                 num_idle(0),
+                                 done(false),
+                                 stop(false),
+                                 status(MBError::SUCCESS),
+                                 next_worker(0)
+{
+    if(pthread_mutex_init(&mutex, NULL) != 0)
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to init mutex");
+        throw (int) MBError::MUTEX_ERROR;
+    }
+    if(pthread_cond_init(&cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&mutex);
+        Logger::Log(LOG_LEVEL_ERROR, "failed to init conditional variable");
+        throw (int) MBError::MUTEX_ERROR;
+    }
+}
+
+ParallelScanner::~ParallelScanner()
+{
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+}
+
+int ParallelScanner::Run()
+{
+    int rval = Partition();
+    if(rval != MBError::SUCCESS)
+        return rval;
+    if(queue.empty())
+        return MBError::SUCCESS;
+
+    std::vector<pthread_t> tids;
+    for(int i = 0; i < num_threads; i++)
+    {
+        pthread_t tid;
+        if(pthread_create(&tid, NULL, scan_thread_wrapper, this) != 0)
+        {
+            Logger::Log(LOG_LEVEL_ERROR, "failed to create scan thread");
+            status = MBError::THREAD_FAILED;
+            break;
+        }
+        tids.push_back(tid);
+    }
+
+    if(tids.size() < static_cast<size_t>(num_threads))
+    {
+        // Let the started workers finish the queue.
+        pthread_mutex_lock(&mutex);
+        num_threads = tids.size();
+        if(num_threads > 0 && num_idle == num_threads)
+            done = true;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&mutex);
+        if(num_threads == 0)
+            return MBError::THREAD_FAILED;
+    }
+
+    for(size_t i = 0; i < tids.size(); i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+    return status;
+}
+
+// Split the top levels of the trie until there are enough subtrees for the
+// workers. Keys found on the way are added as single key partitions.
+int ParallelScanner::Partition()
+{
+    DB::iterator iter(db_ref, DB_ITER_STATE_INIT);
+    std::vector<std::string> nodes(1, "");
+    std::vector<std::string> next_nodes;
+    size_t num_partition = num_threads * SCAN_PARTITION_PER_THREAD;
+    ScanPartition part;
+    int rval;
+
+    for(int depth = 0; depth < SCAN_MAX_SPLIT_DEPTH; depth++)
+    {
+        if(nodes.empty() || nodes.size() >= num_partition)
+            break;
+
+        next_nodes.clear();
+        for(size_t i = 0; i < nodes.size(); i++)
+        {
+            rval = iter.load_kv_for_node(nodes[i]);
+            if(rval != MBError::SUCCESS)
+                return rval;
+
+            part.is_node = false;
+            for(size_t k = 0; k < iter.kv_per_node.size(); k++)
+            {
+                const IteratorEntry &entry = iter.kv_per_node[k];
+                part.key.assign(iter.kv_arena, entry.key_off, entry.key_len);
+                queue.push_back(part);
+            }
+            for(size_t k = 0; k < iter.node_stack.size(); k++)
+            {
+                const IteratorEntry &entry = iter.node_stack[k];
+                next_nodes.push_back(std::string(iter.node_arena, entry.key_off,
+                                                 entry.key_len));
+            }
+            iter.kv_per_node.clear();
+            iter.kv_arena.clear();
+            iter.node_stack.clear();
+            iter.node_arena.clear();
+        }
+        nodes.swap(next_nodes);
+    }
+
+    part.is_node = true;
+    for(size_t i = 0; i < nodes.size(); i++)
+    {
+        part.key = nodes[i];
+        queue.push_back(part);
+    }
+    return MBError::SUCCESS;
+}
+
+void *ParallelScanner::scan_thread_wrapper(void *context)
+{
+    ParallelScanner *scanner = static_cast<ParallelScanner *>(context);
+    scanner->ScanThread(scanner->next_worker.fetch_add(1));
+    return NULL;
+}
+
+void ParallelScanner::ScanThread(int worker)
+{
+    MBConfig config;
+    db_ref.GetDBConfig(config);
+    config.mbdir = db_ref.GetDBDir().c_str();
+    config.options &= ~(CONSTS::ACCESS_MODE_WRITER | CONSTS::ASYNC_WRITER_MODE |
+                        CONSTS::SYNC_ON_WRITE);
+    config.connect_id = 0;
+    DB db(config);
+    if(!db.is_open())
+    {
+        Logger::Log(LOG_LEVEL_ERROR, "failed to open db for scan: %s",
+                    db.StatusStr());
+        status = db.Status();
+        stop = true;
+    }
+
+    ScanPartition part;
+    pthread_mutex_lock(&mutex);
+    while(!done)
+    {
+        if(!stop && !queue.empty())
+        {
+            part = queue.back();
+            queue.pop_back();
+            pthread_mutex_unlock(&mutex);
+
+            int rval;
+            try {
+                rval = ProcessPartition(db, worker, part);
+            } catch (int error) {
+                rval = error;
+            }
+            if(rval != MBError::SUCCESS)
+            {
+                status = rval;
+                stop = true;
+            }
+
+            pthread_mutex_lock(&mutex);
+            continue;
+        }
+
+        // No worker can add to the queue if all others are idle.
+        if(stop || num_idle == num_threads - 1)
+        {
+            done = true;
+            pthread_cond_broadcast(&cond);
+            break;
+        }
+
+        num_idle++;
+        pthread_cond_wait(&cond, &mutex);
+        num_idle--;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    db.Close();
+}
+
+int ParallelScanner::ProcessPartition(DB &db, int worker, const ScanPartition &part)
+{
+    if(!part.is_node)
+    {
+        MBData mbd;
+        int rval = db.Find(part.key, mbd);
+        if(rval == MBError::SUCCESS)
+        {
+            if(!callback(worker, part.key, mbd))
+                stop = true;
+        }
+        else if(rval != MBError::NOT_EXIST)
+        {
+            return rval;
+        }
+        return MBError::SUCCESS;
+    }
+
+    DB::iterator iter(db, DB_ITER_STATE_INIT);
+    int count = 0;
+    for(iter.init_node(part.key); iter != db.end(); ++iter)
+    {
+        if(!callback(worker, iter.key, iter.value))
+        {
+            stop = true;
+            break;
+        }
+        if(++count % SCAN_DONATE_INTERVAL == 0)
+        {
+            if(stop)
+                break;
+            if(num_idle > 0)
+                DonateNodes(iter);
+        }
+    }
+    return MBError::SUCCESS;
+}
+
+// Move the bottom half of the node stack to the queue. The bottom entries
+// are the shallowest nodes, which tend to have the largest subtrees. Their
+// arena space is reclaimed when the stack becomes empty.
+void ParallelScanner::DonateNodes(DB::iterator &iter)
+{
+    size_t num = iter.node_stack.size() / 2;
+    if(num == 0)
+        return;
+
+    ScanPartition part;
+    part.is_node = true;
+    pthread_mutex_lock(&mutex);
+    for(size_t i = 0; i < num; i++)
+    {
+        const IteratorEntry &entry = iter.node_stack[i];
+        part.key.assign(iter.node_arena, entry.key_off, entry.key_len);
+        queue.push_back(part);
+    }
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+
+    iter.node_stack.erase(iter.node_stack.begin(), iter.node_stack.begin() + num);
+    iter.stack_base = iter.stack_base > num ? iter.stack_base - num : 0;
+}
+
+}
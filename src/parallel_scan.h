@@ -0,0 +1,80 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PARALLEL_SCAN_H__
+#define __PARALLEL_SCAN_H__
+
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "db.h"
+
+namespace mabain {
+
+// Number of partitions per thread created before the scan starts
+#define SCAN_PARTITION_PER_THREAD   8
+// Maximum trie depth that is split before the scan starts
+#define SCAN_MAX_SPLIT_DEPTH        4
+// Number of keys between checks for idle workers
+#define SCAN_DONATE_INTERVAL        256
+#define SCAN_MAX_THREAD             256
+
+// A subtree under a node or a single key
+typedef struct _ScanPartition
+{
+    std::string key;
+    bool is_node;
+} ScanPartition;
+
+// Scan the DB with multiple threads. The trie is split into subtrees that
+// are kept in a shared queue. A worker that finds idle workers moves the
+// bottom half of its iterator node stack, i.e., its largest pending
+// subtrees, to the queue. Each worker opens its own reader handle since DB
+// handles are not thread-safe.
+class ParallelScanner
+{
+public:
+    ParallelScanner(const DB &db, int nthreads, const ScanCallback &fn);
+    ~ParallelScanner();
+
+    int Run();
+
+private:
+    static void *scan_thread_wrapper(void *context);
+    int  Partition();
+    void ScanThread(int worker);
+    int  ProcessPartition(DB &db, int worker, const ScanPartition &part);
+    void DonateNodes(DB::iterator &iter);
+
+    const DB &db_ref;
+    int num_threads;
+    const ScanCallback &callback;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    std::vector<ScanPartition> queue;
+    std::atomic<int> num_idle;
+    bool done;
+    std::atomic<bool> stop;
+    std::atomic<int> status;
+    std::atomic<int> next_worker;
+};
+
+}
+
+#endif
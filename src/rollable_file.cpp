@@ -222,6 +222,21 @@ uint8_t* RollableFile::GetShmPtr(size_t offset, int size)
     return NULL;
 }
 
+// Same as GetShmPtr, but only for blocks that are mapped as a whole.
+// Sliding window addresses are not returned since the window can be
+// remapped by the next read in this process.
+uint8_t* RollableFile::GetMappedPtr(size_t offset)
+{
+    int order = offset / block_size;
+    if(CheckAndOpenFile(order, false) != MBError::SUCCESS)
+        return NULL;
+
+    if(files[order]->IsMapped())
+        return files[order]->GetMapAddr() + (offset % block_size);
+
+    return NULL;
+}
+
 int RollableFile::Reserve(size_t &offset, int size, uint8_t* &ptr, bool map_new_sliding)
 {
     int rval;
@@ -429,6 +444,30 @@ void RollableFile::Flush()
     }
 }
 
+// Writes to the sliding map are not synced while SYNC_ON_WRITE is off. The
+// map is synced when it is turned on again. The block files are synced by
+// Flush.
+void RollableFile::SetSyncOnWrite(bool sync)
+{
+    if(sync)
+    {
+        mode |= CONSTS::SYNC_ON_WRITE;
+        if(sliding_addr != NULL && msync(sliding_addr, sliding_size, MS_SYNC) == -1)
+            Logger::Log(LOG_LEVEL_WARN, "failed to sync sliding map of " + path);
+    }
+    else
+    {
+        mode &= ~CONSTS::SYNC_ON_WRITE;
+    }
+
+    for (std::vector<std::shared_ptr<MmapFileIO>>::iterator it = files.begin();
+         it != files.end(); ++it)
+    {
+        if(*it != NULL)
+            (*it)->SetSyncOnWrite(sync);
+    }
+}
+
 size_t RollableFile::GetResourceCollectionOffset() const
 {
     return int((rc_offset_percentage / 100.0f) * max_num_block) * block_size;
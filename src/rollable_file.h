@@ -44,12 +44,15 @@ public:
     void     InitShmSlidingAddr(std::atomic<size_t> *shm_sliding_addr);
     int      Reserve(size_t &offset, int size, uint8_t* &ptr, bool map_new_sliding=true);
     uint8_t* GetShmPtr(size_t offset, int size);
+    uint8_t* GetMappedPtr(size_t offset);
     size_t   CheckAlignment(size_t offset, int size);
     void     PrintStats(std::ostream &out_stream = std::cout) const;
     void     Close();
     void     ResetSlidingWindow();
 
     void     Flush();
+    // Turn SYNC_ON_WRITE on or off for the writes that follow
+    void     SetSyncOnWrite(bool sync);
     size_t   GetResourceCollectionOffset() const;
 
     static const long page_size;
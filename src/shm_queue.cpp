@@ -0,0 +1,479 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "shm_queue.h"
+#include "async_writer.h"
+#include "error.h"
+#include "logger.h"
+#include "mabain_consts.h"
+#include "resource_pool.h"
+#include "mb_futex.h"
+
+namespace mabain {
+
+static_assert(sizeof(ShmQueueHeader) <= SHM_QUEUE_HEADER_SIZE, "header too big");
+static_assert(sizeof(ShmQueueSlot) == SHM_QUEUE_SLOT_SIZE, "wrong slot size");
+
+static uint32_t queue_block_count(uint32_t queue_size)
+{
+    return queue_size >= 64 ? queue_size / 16 : 4;
+}
+
+static size_t queue_file_size(uint32_t queue_size, uint32_t num_block)
+{
+    size_t owner_size = (num_block * sizeof(uint64_t) + 63) & ~63ULL;
+    return SHM_QUEUE_HEADER_SIZE + queue_size * SHM_QUEUE_SLOT_SIZE + owner_size +
+           num_block * (size_t) SHM_QUEUE_BLOCK_SIZE;
+}
+
+static int64_t elapsed_ms(const struct timespec &start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) * 1000LL + (now.tv_nsec - start.tv_nsec) / 1000000;
+}
+
+static bool process_alive(pid_t pid)
+{
+    return pid != 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+ShmQueue::ShmQueue(const std::string &mbdir, int mode, int queue_size)
+                 : header(NULL),
+                   slots(NULL),
+                   block_owners(NULL),
+                   blocks(NULL),
+                   queue_mask(0),
+                   writer(mode & CONSTS::ACCESS_MODE_WRITER)
+{
+    std::string fpath = mbdir + "_mabain_q";
+    bool exist;
+    size_t file_size = 0;
+    if(mode & CONSTS::MEMORY_ONLY_MODE)
+    {
+        exist = ResourcePool::getInstance().CheckExistence(fpath);
+    }
+    else
+    {
+        struct stat st;
+        exist = (stat(fpath.c_str(), &st) == 0);
+        if(exist)
+            file_size = st.st_size;
+    }
+
+    // Only writer creates the queue.
+    if(!exist && !writer)
+        return;
+
+    if(queue_size < 2 || (queue_size & (queue_size - 1)) != 0)
+        throw (int) MBError::INVALID_ARG;
+    if(file_size < SHM_QUEUE_HEADER_SIZE)
+        file_size = queue_file_size(queue_size, queue_block_count(queue_size));
+
+    bool map_file = true;
+    queue_file = ResourcePool::getInstance().OpenFile(fpath, mode, file_size,
+                                                      map_file, writer);
+    header = reinterpret_cast<ShmQueueHeader*>(queue_file->GetMapAddr());
+    if(header == NULL || !map_file)
+    {
+        header = NULL;
+        Logger::Log(LOG_LEVEL_ERROR, "failed to map async queue %s", fpath.c_str());
+        throw (int) MBError::MMAP_FAILED;
+    }
+
+    if(!exist || header->version != SHM_QUEUE_VERSION ||
+       file_size < queue_file_size(header->queue_size, header->num_block))
+    {
+        if(!writer || file_size != queue_file_size(queue_size, queue_block_count(queue_size)))
+        {
+            Logger::Log(LOG_LEVEL_WARN, "async queue %s not supported", fpath.c_str());
+            header = NULL;
+            return;
+        }
+
+        header->version = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+        header->queue_size = queue_size;
+        header->num_block = queue_block_count(queue_size);
+        header->writer_pid.store(0, std::memory_order_relaxed);
+        header->queue_index.store(0, std::memory_order_relaxed);
+        header->writer_index.store(0, std::memory_order_relaxed);
+        header->submit_seq.store(0, std::memory_order_relaxed);
+        header->writer_waiting.store(0, std::memory_order_relaxed);
+        header->release_seq.store(0, std::memory_order_relaxed);
+        header->num_waiting_producers.store(0, std::memory_order_relaxed);
+    }
+
+    uint8_t *ptr = reinterpret_cast<uint8_t*>(header) + SHM_QUEUE_HEADER_SIZE;
+    slots = reinterpret_cast<ShmQueueSlot*>(ptr);
+    ptr += header->queue_size * SHM_QUEUE_SLOT_SIZE;
+    block_owners = reinterpret_cast<std::atomic<uint64_t>*>(ptr);
+    ptr += (header->num_block * sizeof(uint64_t) + 63) & ~63ULL;
+    blocks = reinterpret_cast<char*>(ptr);
+    queue_mask = header->queue_size - 1;
+
+    if(header->version != SHM_QUEUE_VERSION)
+    {
+        for(uint32_t i = 0; i < header->queue_size; i++)
+        {
+            slots[i].state.store(i, std::memory_order_relaxed);
+            slots[i].type = MABAIN_ASYNC_TYPE_NONE;
+            slots[i].block = -1;
+        }
+        for(uint32_t i = 0; i < header->num_block; i++)
+            block_owners[i].store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->version = SHM_QUEUE_VERSION;
+        Logger::Log(LOG_LEVEL_INFO, "async queue %s created with %u slots",
+                    fpath.c_str(), header->queue_size);
+    }
+
+    if(writer)
+    {
+        // Tasks left by the last writer are run by this one.
+        if(header->queue_index.load() != header->writer_index.load())
+            Logger::Log(LOG_LEVEL_INFO, "%llu pending tasks in async queue",
+                        (unsigned long long) (header->queue_index.load() -
+                                              header->writer_index.load()));
+        header->writer_pid.store(getpid());
+    }
+}
+
+ShmQueue::~ShmQueue()
+{
+    if(header != NULL && writer)
+        header->writer_pid.store(0);
+}
+
+bool ShmQueue::IsValid() const
+{
+    return header != NULL;
+}
+
+bool ShmQueue::Busy() const
+{
+    return header->queue_index.load(std::memory_order_consume) !=
+           header->writer_index.load(std::memory_order_consume);
+}
+
+int ShmQueue::Add(const char *key, int key_len, const char *data, int data_len,
+                  bool overwrite, uint64_t *seq)
+{
+    return Submit(MABAIN_ASYNC_TYPE_ADD, key, key_len, data, data_len, overwrite, seq);
+}
+
+int ShmQueue::Remove(const char *key, int len, uint64_t *seq)
+{
+    return Submit(MABAIN_ASYNC_TYPE_REMOVE, key, len, NULL, 0, false, seq);
+}
+
+// Wait until writer runs the task with the sequence number. Returns
+// MBError::TRY_AGAIN on timeout or if there is no writer.
+int ShmQueue::WaitForSeq(uint64_t seq, int timeout_ms)
+{
+    if(header == NULL)
+        return MBError::NOT_INITIALIZED;
+    if(seq > header->queue_index.load())
+        return MBError::INVALID_ARG;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int rval = MBError::SUCCESS;
+    header->num_waiting_producers.fetch_add(1);
+    while(true)
+    {
+        uint32_t release = header->release_seq.load();
+        if(header->writer_index.load() >= seq)
+            break;
+        int64_t wait_ns = SHM_QUEUE_WAIT_NS;
+        if(timeout_ms >= 0)
+        {
+            int64_t remain = timeout_ms - elapsed_ms(start);
+            if(remain <= 0)
+            {
+                rval = MBError::TRY_AGAIN;
+                break;
+            }
+            if(remain * 1000000 < wait_ns)
+                wait_ns = remain * 1000000;
+        }
+        rval = WaitForRelease(release, wait_ns);
+        if(rval != MBError::SUCCESS)
+            break;
+    }
+    header->num_waiting_producers.fetch_sub(1);
+    return rval;
+}
+
+// Sleep until writer releases a slot or a block. Returns MBError::TRY_AGAIN
+// if there is no writer to do so.
+int ShmQueue::WaitForRelease(uint32_t release, int64_t wait_ns)
+{
+    if(!process_alive(header->writer_pid.load()))
+        return MBError::TRY_AGAIN;
+
+    struct timespec timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = wait_ns;
+    FutexWait(&header->release_seq, release, true, &timeout);
+    return MBError::SUCCESS;
+}
+
+int ShmQueue::AcquireBlock(uint64_t pid, int &block)
+{
+    uint32_t num_block = header->num_block;
+    uint64_t owner = SHM_QUEUE_BLOCK_PRODUCER | pid;
+    uint32_t start = static_cast<uint32_t>(pid) % num_block;
+    int rval = MBError::SUCCESS;
+
+    while(rval == MBError::SUCCESS)
+    {
+        for(uint32_t i = 0; i < num_block; i++)
+        {
+            uint32_t index = (start + i) % num_block;
+            uint64_t expected = 0;
+            if(block_owners[index].load(std::memory_order_relaxed) == 0 &&
+               block_owners[index].compare_exchange_strong(expected, owner,
+                                                           std::memory_order_acquire))
+            {
+                block = index;
+                return MBError::SUCCESS;
+            }
+        }
+
+        header->num_waiting_producers.fetch_add(1);
+        uint32_t release = header->release_seq.load();
+        bool full = true;
+        for(uint32_t i = 0; i < num_block && full; i++)
+            full = (block_owners[i].load() != 0);
+        if(full)
+            rval = WaitForRelease(release);
+        header->num_waiting_producers.fetch_sub(1);
+    }
+
+    return rval;
+}
+
+// Claim the slot of the next queue index. Producers help each other to move
+// the queue index past claimed slots so that a producer dying right after
+// the claim does not block the others.
+int ShmQueue::AcquireSlot(uint64_t pid, uint64_t &index)
+{
+    int rval;
+    while(true)
+    {
+        index = header->queue_index.load(std::memory_order_acquire);
+        ShmQueueSlot *slot = &slots[index & queue_mask];
+        uint64_t state = slot->state.load(std::memory_order_acquire);
+        int32_t diff = static_cast<int32_t>(static_cast<uint32_t>(state) -
+                                            static_cast<uint32_t>(index));
+
+        if(diff == 0 && (state >> 32) == 0)
+        {
+            if(slot->state.compare_exchange_weak(state, (pid << 32) | static_cast<uint32_t>(index)))
+            {
+                header->queue_index.compare_exchange_strong(index, index + 1);
+                return MBError::SUCCESS;
+            }
+        }
+        else if(diff >= 0)
+        {
+            // The slot has been claimed.
+            uint64_t curr = index;
+            header->queue_index.compare_exchange_strong(curr, index + 1);
+        }
+        else
+        {
+            // The slot is still used by the last round.
+            header->num_waiting_producers.fetch_add(1);
+            uint32_t release = header->release_seq.load();
+            rval = MBError::SUCCESS;
+            if(slot->state.load() == state)
+                rval = WaitForRelease(release);
+            header->num_waiting_producers.fetch_sub(1);
+            if(rval != MBError::SUCCESS)
+                return rval;
+        }
+    }
+}
+
+int ShmQueue::Submit(int type, const char *key, int key_len, const char *data,
+                     int data_len, bool overwrite, uint64_t *seq)
+{
+    if(header == NULL)
+        return MBError::NOT_INITIALIZED;
+    if(key_len <= 0 || data_len < 0)
+        return MBError::INVALID_ARG;
+    if(key_len > CONSTS::MAX_KEY_LENGHTH || data_len > CONSTS::MAX_DATA_SIZE)
+        return MBError::OUT_OF_BOUND;
+
+    uint64_t pid = getpid();
+    int block = -1;
+    int rval;
+    // The block is taken before the slot since writer cannot move past the
+    // slot until the task is ready.
+    if(key_len + data_len > static_cast<int>(sizeof(slots[0].buff)))
+    {
+        rval = AcquireBlock(pid, block);
+        if(rval != MBError::SUCCESS)
+            return rval;
+    }
+
+    uint64_t index;
+    rval = AcquireSlot(pid, index);
+    if(rval != MBError::SUCCESS)
+    {
+        if(block >= 0)
+            block_owners[block].store(0, std::memory_order_release);
+        return rval;
+    }
+
+    ShmQueueSlot *slot = &slots[index & queue_mask];
+    char *buff = slot->buff;
+    if(block >= 0)
+    {
+        buff = blocks + block * (size_t) SHM_QUEUE_BLOCK_SIZE;
+        slot->block = block;
+        block_owners[block].store(SHM_QUEUE_BLOCK_QUEUED | static_cast<uint32_t>(index),
+                                  std::memory_order_relaxed);
+    }
+    memcpy(buff, key, key_len);
+    if(data_len > 0)
+        memcpy(buff + key_len, data, data_len);
+    slot->key_len = key_len;
+    slot->data_len = data_len;
+    slot->overwrite = overwrite;
+    slot->type = type;
+
+    // Hand the task over to writer.
+    if(seq != NULL)
+        *seq = index + 1;
+    slot->state.store(static_cast<uint32_t>(index + 1));
+    if(header->writer_waiting.load())
+    {
+        header->submit_seq.fetch_add(1);
+        FutexWake(&header->submit_seq, 1, true);
+    }
+    return MBError::SUCCESS;
+}
+
+ShmQueueSlot* ShmQueue::NextTask()
+{
+    uint64_t index = header->writer_index.load(std::memory_order_relaxed);
+    ShmQueueSlot *slot = &slots[index & queue_mask];
+    if(slot->state.load(std::memory_order_acquire) != static_cast<uint32_t>(index + 1))
+        return NULL;
+    return slot;
+}
+
+bool ShmQueue::HasTask() const
+{
+    uint64_t index = header->writer_index.load(std::memory_order_relaxed);
+    return slots[index & queue_mask].state.load() == static_cast<uint32_t>(index + 1);
+}
+
+const char* ShmQueue::GetKey(const ShmQueueSlot *slot) const
+{
+    if(slot->block >= 0)
+        return blocks + slot->block * (size_t) SHM_QUEUE_BLOCK_SIZE;
+    return slot->buff;
+}
+
+void ShmQueue::ReleaseSlot(ShmQueueSlot *slot)
+{
+    if(slot->block >= 0)
+    {
+        block_owners[slot->block].store(0, std::memory_order_release);
+        slot->block = -1;
+    }
+    slot->type = MABAIN_ASYNC_TYPE_NONE;
+
+    uint64_t index = header->writer_index.load(std::memory_order_relaxed);
+    slot->state.store(static_cast<uint32_t>(index + queue_mask + 1));
+    header->writer_index.store(index + 1, std::memory_order_release);
+}
+
+void ShmQueue::WakeProducers()
+{
+    header->release_seq.fetch_add(1);
+    if(header->num_waiting_producers.load() > 0)
+        FutexWake(&header->release_seq, INT_MAX, true);
+}
+
+// If the producer of the next task died before the task is ready, the task
+// is dropped.
+void ShmQueue::RecoverSlot()
+{
+    uint64_t index = header->writer_index.load(std::memory_order_relaxed);
+    ShmQueueSlot *slot = &slots[index & queue_mask];
+    uint64_t state = slot->state.load(std::memory_order_acquire);
+    pid_t pid = static_cast<pid_t>(state >> 32);
+    if(static_cast<uint32_t>(state) != static_cast<uint32_t>(index) || pid == 0 ||
+       process_alive(pid))
+        return;
+
+    Logger::Log(LOG_LEVEL_WARN, "producer %d died while submitting async task %llu",
+                pid, (unsigned long long) index);
+    if(slot->block >= 0)
+    {
+        // The block may have been released by RecoverBlocks and taken by
+        // another producer already.
+        uint64_t owner = block_owners[slot->block].load();
+        if(owner == (SHM_QUEUE_BLOCK_QUEUED | static_cast<uint32_t>(index)) ||
+           owner == (SHM_QUEUE_BLOCK_PRODUCER | static_cast<uint64_t>(pid)))
+            block_owners[slot->block].compare_exchange_strong(owner, 0);
+        slot->block = -1;
+    }
+    slot->type = MABAIN_ASYNC_TYPE_NONE;
+    slot->state.store(static_cast<uint32_t>(index + 1));
+}
+
+void ShmQueue::RecoverBlocks()
+{
+    for(uint32_t i = 0; i < header->num_block; i++)
+    {
+        uint64_t owner = block_owners[i].load(std::memory_order_relaxed);
+        if(!(owner & SHM_QUEUE_BLOCK_PRODUCER))
+            continue;
+        pid_t pid = static_cast<pid_t>(owner & 0xFFFFFFFF);
+        if(!process_alive(pid))
+        {
+            Logger::Log(LOG_LEVEL_WARN, "releasing async queue block %u of producer %d",
+                        i, pid);
+            block_owners[i].compare_exchange_strong(owner, 0);
+        }
+    }
+}
+
+std::atomic<uint32_t>* ShmQueue::GetSubmitSeq() const
+{
+    return &header->submit_seq;
+}
+
+std::atomic<uint32_t>* ShmQueue::GetWriterWaiting() const
+{
+    return &header->writer_waiting;
+}
+
+}
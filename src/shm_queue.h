@@ -0,0 +1,140 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SHM_QUEUE_H__
+#define __SHM_QUEUE_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "mmap_file.h"
+
+namespace mabain {
+
+#define SHM_QUEUE_VERSION            2
+#define SHM_QUEUE_HEADER_SIZE        512
+#define SHM_QUEUE_SLOT_SIZE          256
+// Payloads not fitting in the slot go to a block big enough for any key
+// and value.
+#define SHM_QUEUE_BLOCK_SIZE         (33*1024)
+// Producers waiting for writer check if it is still running at this
+// interval.
+#define SHM_QUEUE_WAIT_NS            (100*1000*1000)
+// Owners of a block: a producer filling it (flag and pid) or the task
+// in the queue it was submitted with (flag and queue index).
+#define SHM_QUEUE_BLOCK_PRODUCER     (1ULL << 32)
+#define SHM_QUEUE_BLOCK_QUEUED       (1ULL << 33)
+
+// Fields written by producers, by writer and by both are kept in
+// different cache lines.
+typedef struct _ShmQueueHeader
+{
+    uint32_t version;
+    uint32_t queue_size;
+    uint32_t num_block;
+    // pid of the writer draining the queue, 0 if there is none
+    std::atomic<int32_t> writer_pid;
+
+    // next index to be taken by producers
+    alignas(64) std::atomic<uint64_t> queue_index;
+
+    // next index to be run by writer
+    alignas(64) std::atomic<uint64_t> writer_index;
+
+    // Futex words. submit_seq is bumped to wake up writer and release_seq
+    // to wake up producers waiting for a free slot or block.
+    alignas(64) std::atomic<uint32_t> submit_seq;
+    std::atomic<uint32_t> writer_waiting;
+    alignas(64) std::atomic<uint32_t> release_seq;
+    std::atomic<uint32_t> num_waiting_producers;
+} ShmQueueHeader;
+
+typedef struct _ShmQueueSlot
+{
+    // Low 32 bits of the queue index in the low half. The slot is free for the index if
+    // the high 32 bits are zero and being filled by the process with the
+    // pid in the high 32 bits otherwise. The task is ready for writer when
+    // the index is one above the queue index of the slot.
+    std::atomic<uint64_t> state;
+    uint8_t  type;
+    bool     overwrite;
+    uint16_t key_len;
+    int32_t  data_len;
+    // block holding key and value; -1 if they are in buff
+    int32_t  block;
+    int32_t  reserved;
+    char     buff[SHM_QUEUE_SLOT_SIZE - 24];
+} ShmQueueSlot;
+
+// Async write queue in the shared memory file _mabain_q. Any process
+// opening DB with CONSTS::SHM_ASYNC_QUEUE can submit adds and removes
+// to the async thread of the writer opened with the same option. Tasks
+// submitted while there is no writer are run when a writer starts.
+// A producer claims a slot by storing its pid in the slot state. Writer
+// skips the slot if the producer dies before the task is ready. Blocks
+// are taken before the slot, also with the pid of the producer, so that
+// the blocks of dead producers can be released too.
+class ShmQueue
+{
+public:
+    ShmQueue(const std::string &mbdir, int mode, int queue_size);
+    ~ShmQueue();
+
+    bool IsValid() const;
+    bool Busy() const;
+
+    // Called by producers
+    // seq is set to the sequence number of the task if not NULL.
+    int  Add(const char *key, int key_len, const char *data, int data_len,
+             bool overwrite, uint64_t *seq = NULL);
+    int  Remove(const char *key, int len, uint64_t *seq = NULL);
+    int  WaitForSeq(uint64_t seq, int timeout_ms);
+
+    // Called by writer only
+    // Return the next task if it is ready.
+    ShmQueueSlot* NextTask();
+    // Same as NextTask but ordered with writer_waiting for sleeping.
+    bool HasTask() const;
+    const char* GetKey(const ShmQueueSlot *slot) const;
+    void ReleaseSlot(ShmQueueSlot *slot);
+    void WakeProducers();
+    // Release the slot and blocks held by dead producers
+    void RecoverSlot();
+    void RecoverBlocks();
+    std::atomic<uint32_t>* GetSubmitSeq() const;
+    std::atomic<uint32_t>* GetWriterWaiting() const;
+
+private:
+    int  Submit(int type, const char *key, int key_len, const char *data,
+                int data_len, bool overwrite, uint64_t *seq);
+    int  AcquireSlot(uint64_t pid, uint64_t &index);
+    int  AcquireBlock(uint64_t pid, int &block);
+    int  WaitForRelease(uint32_t release, int64_t wait_ns = SHM_QUEUE_WAIT_NS);
+
+    std::shared_ptr<MmapFileIO> queue_file;
+    ShmQueueHeader *header;
+    ShmQueueSlot *slots;
+    std::atomic<uint64_t> *block_owners;
+    char *blocks;
+    uint32_t queue_mask;
+    bool writer;
+};
+
+}
+
+#endif
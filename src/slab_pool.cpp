@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "slab_pool.h"
+
+namespace mabain {
+
+SlabPool::SlabPool(int num_buff_per_class) : num_buff(num_buff_per_class)
+{
+    int buff_size = SLAB_MIN_BUFFER_SIZE;
+    for(int i = 0; i < SLAB_NUM_CLASS; i++)
+    {
+        slabs[i].buff_size = buff_size;
+        slabs[i].next = new std::atomic<uint32_t>[num_buff];
+        slabs[i].buffs = new char*[num_buff];
+        // All buffers are free: buffer j sits on top of buffer j+1.
+        for(int j = 0; j < num_buff; j++)
+        {
+            slabs[i].next[j].store(j + 2 <= num_buff ? j + 2 : 0, std::memory_order_relaxed);
+            slabs[i].buffs[j] = NULL;
+        }
+        slabs[i].head.store(num_buff > 0 ? 1 : 0, std::memory_order_release);
+        buff_size *= 4;
+    }
+}
+
+SlabPool::~SlabPool()
+{
+    for(int i = 0; i < SLAB_NUM_CLASS; i++)
+    {
+        for(int j = 0; j < num_buff; j++)
+        {
+            if(slabs[i].buffs[j] != NULL)
+                free(slabs[i].buffs[j]);
+        }
+        delete [] slabs[i].buffs;
+        delete [] slabs[i].next;
+    }
+}
+
+char* SlabPool::Pop(int class_index, int &id)
+{
+    SlabClass &slab = slabs[class_index];
+    uint64_t head = slab.head.load(std::memory_order_acquire);
+    uint32_t top;
+    uint64_t new_head;
+    do {
+        top = static_cast<uint32_t>(head);
+        if(top == 0)
+            return NULL;
+        // The tag makes the swap fail if the top was taken in the meantime,
+        // even if it has been freed again since.
+        new_head = (((head >> 32) + 1) << 32) |
+                   slab.next[top - 1].load(std::memory_order_relaxed);
+    } while(!slab.head.compare_exchange_weak(head, new_head, std::memory_order_acquire,
+                                             std::memory_order_acquire));
+
+    int buff_index = top - 1;
+    if(slab.buffs[buff_index] == NULL)
+    {
+        slab.buffs[buff_index] = (char *) malloc(slab.buff_size);
+        if(slab.buffs[buff_index] == NULL)
+        {
+            Push(class_index, buff_index);
+            return NULL;
+        }
+    }
+    id = class_index * num_buff + buff_index;
+    return slab.buffs[buff_index];
+}
+
+void SlabPool::Push(int class_index, int buff_index)
+{
+    SlabClass &slab = slabs[class_index];
+    uint64_t head = slab.head.load(std::memory_order_relaxed);
+    uint64_t new_head;
+    do {
+        slab.next[buff_index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        new_head = (((head >> 32) + 1) << 32) | static_cast<uint32_t>(buff_index + 1);
+    } while(!slab.head.compare_exchange_weak(head, new_head, std::memory_order_release,
+                                             std::memory_order_relaxed));
+}
+
+char* SlabPool::Alloc(int size, int &id)
+{
+    for(int i = 0; i < SLAB_NUM_CLASS; i++)
+    {
+        if(size <= slabs[i].buff_size)
+        {
+            char *buff = Pop(i, id);
+            if(buff != NULL)
+                return buff;
+            break;
+        }
+    }
+
+    id = -1;
+    return (char *) malloc(size > 0 ? size : 1);
+}
+
+void SlabPool::Free(char *buff, int id)
+{
+    if(id < 0)
+        free(buff);
+    else
+        Push(id / num_buff, id % num_buff);
+}
+
+}
@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SLAB_POOL_H__
+#define __SLAB_POOL_H__
+
+#include <stdint.h>
+#include <atomic>
+
+// Buffer sizes are SLAB_MIN_BUFFER_SIZE times powers of 4.
+#define SLAB_NUM_CLASS           5
+#define SLAB_MIN_BUFFER_SIZE     256
+
+namespace mabain {
+
+typedef struct _SlabClass
+{
+    int buff_size;
+    // Top of the free stack. The high 32 bits are a tag bumped by every
+    // update so that a stale head cannot be swapped back in (ABA).
+    std::atomic<uint64_t> head;
+    // next[i] is the index plus one of the buffer below buffer i
+    std::atomic<uint32_t> *next;
+    // Buffers are allocated when first handed out.
+    char **buffs;
+} SlabClass;
+
+// Pool of fixed size buffers shared by multiple threads. Each size class
+// keeps its free buffers in a lock-free stack. Requests larger than the
+// biggest class or made when the class is exhausted fall back to malloc.
+class SlabPool
+{
+public:
+    SlabPool(int num_buff_per_class);
+    ~SlabPool();
+
+    // Get a buffer of at least size bytes. id must be passed to Free.
+    char* Alloc(int size, int &id);
+    void  Free(char *buff, int id);
+
+private:
+    char* Pop(int class_index, int &id);
+    void  Push(int class_index, int buff_index);
+
+    int num_buff;
+    SlabClass slabs[SLAB_NUM_CLASS];
+};
+
+}
+
+#endif
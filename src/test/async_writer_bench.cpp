@@ -0,0 +1,129 @@
+// Micro benchmark for the async writer queue. Producer threads add keys
+// through reader handles attached to an async writer. The time to submit
+// all keys and the time until the writer has applied them are reported.
+// Usage: async_writer_bench [num_keys] [num_threads] [value_size] [mabain_dir]
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include "../db.h"
+
+#include "./test_key.h"
+
+using namespace mabain;
+
+static int64_t num = 1000000;
+static int value_size = 0;
+static std::string mbdir = "/var/tmp/mabain_test/";
+static std::atomic<int64_t> key_index;
+static std::atomic<int64_t> num_failed;
+
+static double get_time_ns(const struct timespec &start, const struct timespec &end)
+{
+    return (end.tv_sec - start.tv_sec) * 1.0e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static void* producer_thread(void *arg)
+{
+    DB db_r(mbdir.c_str(), CONSTS::ReaderOptions());
+    if(!db_r.is_open() || db_r.SetAsyncWriterPtr((DB *) arg) != MBError::SUCCESS)
+    {
+        std::cerr << "failed to attach reader to async writer\n";
+        abort();
+    }
+
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::string key;
+    std::string value;
+    int64_t i;
+    while((i = key_index.fetch_add(1, std::memory_order_relaxed)) < num)
+    {
+        key = tkey.get_key(i);
+        if(value_size > 0)
+            value.assign(value_size, 'a' + i % 26);
+        else
+            value = key;
+        if(db_r.Add(key, value) != MBError::SUCCESS)
+            num_failed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    db_r.UnsetAsyncWriterPtr((DB *) arg);
+    db_r.Close();
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int nthread = 16;
+    if(argc > 1)
+        num = atoll(argv[1]);
+    if(argc > 2)
+        nthread = atoi(argv[2]);
+    if(argc > 3)
+        value_size = atoi(argv[3]);
+    if(argc > 4)
+        mbdir = argv[4];
+    if(nthread <= 0 || nthread > 256)
+    {
+        std::cerr << "number of threads must be between 1 and 256\n";
+        return 1;
+    }
+
+    std::string cmd = std::string("mkdir -p ") + mbdir;
+    if(system(cmd.c_str()) != 0) {
+    }
+    cmd = std::string("rm -f ") + mbdir + "/_mabain_*";
+    if(system(cmd.c_str()) != 0) {
+    }
+
+    size_t memcap = 1024*1024*1024LL;
+    DB *db = new DB(mbdir.c_str(), CONSTS::WriterOptions() | CONSTS::ASYNC_WRITER_MODE,
+                    memcap, memcap);
+    if(!db->is_open())
+    {
+        std::cerr << "failed to open writer " << db->StatusStr() << "\n";
+        return 1;
+    }
+
+    key_index.store(0, std::memory_order_relaxed);
+    num_failed.store(0, std::memory_order_relaxed);
+
+    struct timespec start, submitted, end;
+    pthread_t tid[256];
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < nthread; i++)
+    {
+        if(pthread_create(&tid[i], NULL, producer_thread, db) != 0)
+        {
+            std::cerr << "failed to create thread\n";
+            abort();
+        }
+    }
+    for(int i = 0; i < nthread; i++)
+        pthread_join(tid[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &submitted);
+    while(db->AsyncWriterBusy())
+        usleep(100);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    int64_t count = db->Count();
+    db->Close();
+    delete db;
+
+    std::cout << nthread << " threads, " << num << " keys, value size "
+              << (value_size > 0 ? value_size : 64) << "\n";
+    std::cout << std::fixed << std::setprecision(1)
+              << std::setw(12) << std::left << "submit" << std::right
+              << get_time_ns(start, submitted) / num << " ns/op\n"
+              << std::setw(12) << std::left << "applied" << std::right
+              << get_time_ns(start, end) / num << " ns/op\n"
+              << "count " << count << " failed " << num_failed.load() << "\n";
+    return (count == num && num_failed.load() == 0) ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+// Micro benchmark comparing the default and the wide edge formats. For each
+// key set, populate a DB in each format and time Find through a reader handle.
+// Usage: edge_format_bench [num_keys] [mabain_dir]
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../resource_pool.h"
+
+#include "./test_key.h"
+
+using namespace mabain;
+
+static double get_time_ns(const struct timespec &start, const struct timespec &end)
+{
+    return (end.tv_sec - start.tv_sec) * 1.0e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+// URL-like keys sharing host and path prefixes of various lengths
+static std::string get_url_key(int64_t i)
+{
+    char buff[256];
+    snprintf(buff, sizeof(buff), "https://www.site%lld.example.com/category%lld/item-%lld.html",
+             (long long) (i % 1000), (long long) (i % 37), (long long) i);
+    return std::string(buff);
+}
+
+static void run_bench(const std::string &mbdir, const char *name, int options,
+                      const std::vector<std::string> &keys)
+{
+    std::string cmd = std::string("rm -f ") + mbdir + "/_mabain_*";
+    if(system(cmd.c_str()) != 0) {
+    }
+
+    size_t memcap = 1024*1024*1024LL;
+    DB db(mbdir.c_str(), CONSTS::WriterOptions() | options, memcap, memcap);
+    if(!db.is_open())
+    {
+        std::cerr << "failed to open writer " << db.StatusStr() << "\n";
+        exit(1);
+    }
+    for(size_t i = 0; i < keys.size(); i++)
+        db.Add(keys[i], keys[i]);
+
+    DB db_r(mbdir.c_str(), CONSTS::ReaderOptions(), memcap, memcap);
+    if(!db_r.is_open())
+    {
+        std::cerr << "failed to open reader " << db_r.StatusStr() << "\n";
+        exit(1);
+    }
+
+    struct timespec start, end;
+    MBData mbd;
+    int64_t found = 0;
+    int64_t nkeys = keys.size();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int64_t i = 0; i < nkeys; i++)
+    {
+        if(db_r.Find(keys[i], mbd) == MBError::SUCCESS)
+            found++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    IndexHeader *header = db.GetDictPtr()->GetHeaderPtr();
+    std::cout << std::setw(20) << std::left << name
+              << std::setw(10) << std::right << std::fixed << std::setprecision(1)
+              << get_time_ns(start, end) / nkeys << " ns/op"
+              << "  found " << found << "/" << nkeys
+              << "  index size " << header->m_index_offset
+              << "  edge string size " << header->edge_str_size << "\n";
+
+    db_r.Close();
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t num = 1000000;
+    std::string mbdir = "/var/tmp/mabain_test/";
+    if(argc > 1)
+        num = atoll(argv[1]);
+    if(argc > 2)
+        mbdir = argv[2];
+
+    std::string cmd = std::string("mkdir -p ") + mbdir;
+    if(system(cmd.c_str()) != 0) {
+    }
+
+    TestKey tkey_sha(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::vector<std::string> sha_keys;
+    std::vector<std::string> url_keys;
+    sha_keys.reserve(num);
+    url_keys.reserve(num);
+    for(int64_t i = 0; i < num; i++)
+    {
+        sha_keys.push_back(tkey_sha.get_key(i));
+        url_keys.push_back(get_url_key(i));
+    }
+    // Look up in random order.
+    for(int64_t i = num - 1; i > 0; i--)
+    {
+        sha_keys[i].swap(sha_keys[rand() % (i + 1)]);
+        url_keys[i].swap(url_keys[rand() % (i + 1)]);
+    }
+
+    run_bench(mbdir, "SHA-256", 0, sha_keys);
+    run_bench(mbdir, "SHA-256 wide edge", CONSTS::WIDE_EDGE, sha_keys);
+    run_bench(mbdir, "URL", 0, url_keys);
+    run_bench(mbdir, "URL wide edge", CONSTS::WIDE_EDGE, url_keys);
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Micro benchmark for the node first-byte scan used by DictMem::NextEdge
+// and DictMem::FindNext. Sweep the node fanout from 1 to 256 and compare
+// the scalar loop with the vectorized scan.
+// Build with -mavx2 to include the AVX2 path.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <iostream>
+#include <iomanip>
+
+#include "../util/mb_byte_scan.h"
+
+using namespace mabain;
+
+#define NUM_LOOKUP   2000000
+
+static uint8_t edge_keys[256];
+static uint8_t lookup_keys[NUM_LOOKUP];
+
+static double get_time_ns(const struct timespec &start, const struct timespec &end)
+{
+    return (end.tv_sec - start.tv_sec) * 1.0e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+// Fill the node with nt distinct bytes in random order.
+static void init_node(int nt)
+{
+    uint8_t all[256];
+    for(int i = 0; i < 256; i++)
+        all[i] = static_cast<uint8_t>(i);
+    for(int i = 255; i > 0; i--)
+    {
+        int j = rand() % (i + 1);
+        uint8_t tmp = all[i];
+        all[i] = all[j];
+        all[j] = tmp;
+    }
+    memcpy(edge_keys, all, nt);
+
+    // Lookups always hit as it is for DB::Find on existing keys.
+    for(int i = 0; i < NUM_LOOKUP; i++)
+        lookup_keys[i] = edge_keys[rand() % nt];
+}
+
+template <typename F>
+static double run_scan(F scan, int nt, int64_t &checksum)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < NUM_LOOKUP; i++)
+        checksum += scan(edge_keys, nt, lookup_keys[i]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return get_time_ns(start, end) / NUM_LOOKUP;
+}
+
+int main(int argc, char *argv[])
+{
+    srand(time(NULL));
+    int64_t checksum = 0;
+
+#if defined(__AVX2__)
+    std::cout << "vector scan: AVX2+SSE2\n";
+#elif defined(__SSE2__)
+    std::cout << "vector scan: SSE2\n";
+#else
+    std::cout << "vector scan: scalar only\n";
+#endif
+    std::cout << std::setw(8) << "fanout" << std::setw(14) << "scalar(ns)"
+              << std::setw(14) << "vector(ns)" << std::setw(10) << "speedup\n";
+
+    for(int nt = 1; nt <= 256; nt = (nt < 16 ? nt + 1 : nt * 2))
+    {
+        init_node(nt);
+        double t_scalar = run_scan(ScalarByteScan, nt, checksum);
+        double t_vector = run_scan(ByteScan, nt, checksum);
+        std::cout << std::setw(8) << nt << std::fixed << std::setprecision(2)
+                  << std::setw(14) << t_scalar << std::setw(14) << t_vector
+                  << std::setw(9) << t_scalar / t_vector << "\n";
+    }
+
+    // Print the checksum so that the compiler cannot drop the scans.
+    std::cout << "checksum: " << checksum << "\n";
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Benchmark of DB::FindFuzzy against a brute-force scan with DB::iterator
+// that computes the edit distance of every key.
+// Usage: fuzzy_bench [num_keys] [max_edits] [mabain_dir]
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "../db.h"
+#include "../resource_pool.h"
+
+using namespace mabain;
+
+#define NUM_QUERY 100
+
+static double get_time_ns(const struct timespec &start, const struct timespec &end)
+{
+    return (end.tv_sec - start.tv_sec) * 1.0e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static void print_result(const char *name, double ns, int64_t num, int64_t found)
+{
+    std::cout << std::setw(20) << std::left << name
+              << std::setw(14) << std::right << std::fixed << std::setprecision(1)
+              << ns / num / 1000 << " us/op" << "  found " << found << "\n";
+}
+
+static int edit_distance(const std::string &a, const std::string &b,
+                         std::vector<int> &prev, std::vector<int> &row)
+{
+    prev.resize(b.size() + 1);
+    row.resize(b.size() + 1);
+    for(size_t j = 0; j <= b.size(); j++)
+        prev[j] = j;
+    for(size_t i = 1; i <= a.size(); i++)
+    {
+        row[0] = i;
+        for(size_t j = 1; j <= b.size(); j++)
+        {
+            int dist = prev[j-1] + (a[i-1] != b[j-1]);
+            if(prev[j] + 1 < dist)
+                dist = prev[j] + 1;
+            if(row[j-1] + 1 < dist)
+                dist = row[j-1] + 1;
+            row[j] = dist;
+        }
+        prev.swap(row);
+    }
+    return prev[b.size()];
+}
+
+// Device identifier with a vendor prefix
+static std::string get_key(int64_t i)
+{
+    char buff[64];
+    snprintf(buff, sizeof(buff), "vendor%02d-%010llx", (int)(i % 37),
+             (unsigned long long)((i * 2654435761ULL) & 0xffffffffffULL));
+    return buff;
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t num = 1000000;
+    int max_edits = 2;
+    std::string mbdir = "/var/tmp/mabain_test/";
+    if(argc > 1)
+        num = atoll(argv[1]);
+    if(argc > 2)
+        max_edits = atoi(argv[2]);
+    if(argc > 3)
+        mbdir = argv[3];
+
+    std::string cmd = std::string("mkdir -p ") + mbdir;
+    if(system(cmd.c_str()) != 0) {
+    }
+    cmd = std::string("rm -f ") + mbdir + "/_mabain_*";
+    if(system(cmd.c_str()) != 0) {
+    }
+
+    size_t memcap = 1024*1024*1024LL;
+    DB db(mbdir.c_str(), CONSTS::WriterOptions(), memcap, memcap);
+    if(!db.is_open())
+    {
+        std::cerr << "failed to open writer " << db.StatusStr() << "\n";
+        return 1;
+    }
+    for(int64_t i = 0; i < num; i++)
+        db.Add(get_key(i), get_key(i));
+
+    DB db_r(mbdir.c_str(), CONSTS::ReaderOptions(), memcap, memcap);
+    if(!db_r.is_open())
+    {
+        std::cerr << "failed to open reader " << db_r.StatusStr() << "\n";
+        return 1;
+    }
+
+    // Queries are existing keys with one or two characters changed.
+    std::vector<std::string> queries;
+    for(int i = 0; i < NUM_QUERY; i++)
+    {
+        std::string key = get_key(rand() % num);
+        key[key.size() - 1 - rand() % 8] = 'x';
+        if(i % 2 == 0)
+            key.erase(key.size() - 1 - rand() % 8, 1);
+        queries.push_back(key);
+    }
+
+    struct timespec start, end;
+    int64_t found = 0;
+    std::vector<FuzzyMatch> matches;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < NUM_QUERY; i++)
+    {
+        if(db_r.FindFuzzy(queries[i], max_edits, 100, matches) == MBError::SUCCESS)
+            found += matches.size();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    print_result("FindFuzzy", get_time_ns(start, end), NUM_QUERY, found);
+
+    // The brute-force scan is slow. Only run a few queries.
+    int num_scan = NUM_QUERY / 10;
+    std::vector<int> prev, row;
+    found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < num_scan; i++)
+    {
+        for(DB::iterator iter = db_r.begin(); iter != db_r.end(); ++iter)
+        {
+            if(edit_distance(queries[i], iter.key, prev, row) <= max_edits)
+                found++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    print_result("Iterator scan", get_time_ns(start, end), num_scan, found);
+
+    db_r.Close();
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Micro benchmark for reader lookups. Populate the DB with a writer and
+// time Find, FindLongestPrefix and iteration through a reader handle.
+// Usage: lookup_bench [num_keys] [mabain_dir]
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "../db.h"
+#include "../resource_pool.h"
+
+#include "./test_key.h"
+
+using namespace mabain;
+
+static double get_time_ns(const struct timespec &start, const struct timespec &end)
+{
+    return (end.tv_sec - start.tv_sec) * 1.0e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+static void print_result(const char *name, double ns, int64_t num, int64_t found)
+{
+    std::cout << std::setw(20) << std::left << name
+              << std::setw(10) << std::right << std::fixed << std::setprecision(1)
+              << ns / num << " ns/op" << "  found " << found << "/" << num << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t num = 1000000;
+    std::string mbdir = "/var/tmp/mabain_test/";
+    if(argc > 1)
+        num = atoll(argv[1]);
+    if(argc > 2)
+        mbdir = argv[2];
+
+    std::string cmd = std::string("mkdir -p ") + mbdir;
+    if(system(cmd.c_str()) != 0) {
+    }
+    cmd = std::string("rm -f ") + mbdir + "/_mabain_*";
+    if(system(cmd.c_str()) != 0) {
+    }
+
+    size_t memcap = 1024*1024*1024LL;
+    DB db(mbdir.c_str(), CONSTS::WriterOptions(), memcap, memcap);
+    if(!db.is_open())
+    {
+        std::cerr << "failed to open writer " << db.StatusStr() << "\n";
+        return 1;
+    }
+
+    TestKey tkey_int(MABAIN_TEST_KEY_TYPE_INT);
+    TestKey tkey_sha(MABAIN_TEST_KEY_TYPE_SHA_256);
+    std::vector<std::string> keys;
+    keys.reserve(2*num);
+    for(int64_t i = 0; i < num; i++)
+    {
+        keys.push_back(tkey_int.get_key(i));
+        keys.push_back(tkey_sha.get_key(i));
+    }
+    for(size_t i = 0; i < keys.size(); i++)
+        db.Add(keys[i], keys[i]);
+    // Look up in random order.
+    for(size_t i = keys.size() - 1; i > 0; i--)
+        keys[i].swap(keys[rand() % (i + 1)]);
+
+    DB db_r(mbdir.c_str(), CONSTS::ReaderOptions(), memcap, memcap);
+    if(!db_r.is_open())
+    {
+        std::cerr << "failed to open reader " << db_r.StatusStr() << "\n";
+        return 1;
+    }
+
+    struct timespec start, end;
+    MBData mbd;
+    int64_t found = 0;
+    int64_t nkeys = keys.size();
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int64_t i = 0; i < nkeys; i++)
+    {
+        if(db_r.Find(keys[i], mbd) == MBError::SUCCESS)
+            found++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    print_result("Find", get_time_ns(start, end), nkeys, found);
+
+    for(int64_t i = 0; i < nkeys; i++)
+        keys[i] += "-suffix";
+    found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int64_t i = 0; i < nkeys; i++)
+    {
+        if(db_r.FindLongestPrefix(keys[i], mbd) == MBError::SUCCESS)
+            found++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    print_result("FindLongestPrefix", get_time_ns(start, end), nkeys, found);
+
+    found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(DB::iterator iter = db_r.begin(); iter != db_r.end(); ++iter)
+        found++;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    print_result("Iterator", get_time_ns(start, end), nkeys, found);
+
+    db_r.Close();
+    db.Close();
+    ResourcePool::getInstance().RemoveAll();
+    return 0;
+}
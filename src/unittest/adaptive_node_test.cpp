@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class AdaptiveNodeTest : public TestDBFixture
+{
+public:
+    // Reopen the DB with the writer options.
+    void OpenDB(int opts) {
+        CloseDB();
+        config.options = opts;
+        config.memcap_index = 128ULL*1024*1024;
+        config.memcap_data = 128ULL*1024*1024;
+        TestDBFixture::OpenDB();
+    }
+
+    // Binary keys so that nodes can have up to 256 edges:
+    // "k" + low byte + high byte + suffix
+    std::string GetKey(int i) {
+        std::string key = "k";
+        key += static_cast<char>(i & 0xFF);
+        key += static_cast<char>((i >> 8) & 0xFF);
+        key += "-suffix";
+        return key;
+    }
+
+    void Populate(int num) {
+        for(int i = 0; i < num; i++) {
+            std::string key = GetKey(i);
+            EXPECT_EQ(MBError::SUCCESS, db->Add(key, key, true));
+        }
+    }
+
+    void Verify(int num, int step_removed) {
+        MBData mbd;
+        for(int i = 0; i < num; i++) {
+            std::string key = GetKey(i);
+            int rval = db->Find(key, mbd);
+            if(step_removed > 0 && i % step_removed == 0) {
+                EXPECT_EQ(MBError::NOT_EXIST, rval);
+            } else {
+                EXPECT_EQ(MBError::SUCCESS, rval);
+                EXPECT_EQ(key, std::string((const char *)mbd.buff, mbd.data_len));
+            }
+        }
+    }
+
+    int IndexFormat() {
+        return db->GetDictPtr()->GetHeaderPtr()->version[3];
+    }
+};
+
+TEST_F(AdaptiveNodeTest, add_find_remove_test)
+{
+    OpenDB(CONSTS::WriterOptions() | CONSTS::ADAPTIVE_NODE_FORMAT);
+    EXPECT_EQ(INDEX_FORMAT_ADAPTIVE, IndexFormat());
+
+    // The node after "k" is full and each child node has 40 edges.
+    int num = 256*40;
+    Populate(num);
+    Verify(num, 0);
+    EXPECT_EQ(num, db->Count());
+
+    // Shrink the full node and the indexed nodes.
+    for(int i = 0; i < num; i += 3) {
+        std::string key = GetKey(i);
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(key));
+    }
+    Verify(num, 3);
+
+    int count = 0;
+    for(DB::iterator iter = db->begin(); iter != db->end(); ++iter)
+        count++;
+    EXPECT_EQ(db->Count(), count);
+
+    // Grow them back
+    Populate(num);
+    Verify(num, 0);
+}
+
+TEST_F(AdaptiveNodeTest, migrate_test)
+{
+    OpenDB(CONSTS::WriterOptions());
+    EXPECT_EQ(0, IndexFormat());
+
+    int num = 256*20 + 77;
+    Populate(num);
+    EXPECT_EQ(MBError::SUCCESS, db->MigrateIndexFormat(true));
+    EXPECT_EQ(INDEX_FORMAT_ADAPTIVE, IndexFormat());
+    Verify(num, 0);
+
+    for(int i = 0; i < num; i += 5) {
+        std::string key = GetKey(i);
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(key));
+    }
+    Verify(num, 5);
+
+    // The format is kept after reopening the DB.
+    OpenDB(CONSTS::WriterOptions());
+    EXPECT_EQ(INDEX_FORMAT_ADAPTIVE, IndexFormat());
+    Verify(num, 5);
+
+    // Migrate back to the original format.
+    EXPECT_EQ(MBError::SUCCESS, db->MigrateIndexFormat(false));
+    EXPECT_EQ(0, IndexFormat());
+    Verify(num, 5);
+    Populate(num);
+    Verify(num, 0);
+}
+
+}
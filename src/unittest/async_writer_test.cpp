@@ -0,0 +1,345 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+
+#define DB_DIR "/var/tmp/mabain_test/"
+#define NUM_THREAD      8
+#define NUM_KEY_PER_THREAD 1000
+
+using namespace mabain;
+
+namespace {
+
+// Value sizes cover inline slots, all slab classes and malloc.
+static int value_size(int i)
+{
+    static const int sizes[] = { 1, 60, 200, 900, 3000, 12000, 30000 };
+    return sizes[i % 7];
+}
+
+static std::string make_key(int thread_id, int i)
+{
+    char buff[64];
+    snprintf(buff, sizeof(buff), "async/%d/%d", thread_id, i);
+    return buff;
+}
+
+static std::string make_value(int i)
+{
+    return std::string(value_size(i), 'a' + i % 26);
+}
+
+typedef struct _ProducerArg
+{
+    DB *db;
+    int thread_id;
+    bool remove;
+} ProducerArg;
+
+static void* producer_thread(void *arg)
+{
+    ProducerArg *parg = static_cast<ProducerArg *>(arg);
+    DB db_r(DB_DIR, CONSTS::ReaderOptions());
+    if(!db_r.is_open() || db_r.SetAsyncWriterPtr(parg->db) != MBError::SUCCESS)
+        return NULL;
+
+    for(int i = 0; i < NUM_KEY_PER_THREAD; i++)
+    {
+        std::string key = make_key(parg->thread_id, i);
+        std::string value = make_value(i);
+        if(db_r.Add(key, value) != MBError::SUCCESS)
+            break;
+        // Remove every third key right after it is added.
+        if(parg->remove && i % 3 == 0 && db_r.Remove(key) != MBError::SUCCESS)
+            break;
+    }
+
+    db_r.UnsetAsyncWriterPtr(parg->db);
+    db_r.Close();
+    return NULL;
+}
+
+class AsyncWriterTest : public ::testing::Test
+{
+public:
+    AsyncWriterTest() : db(NULL) {
+    }
+    virtual ~AsyncWriterTest() {
+    }
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + DB_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm ") + DB_DIR + "_mabain_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+    virtual void TearDown() {
+        if(db != NULL) {
+            db->Close();
+            delete db;
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void OpenDB(int queue_size) {
+        MBConfig config;
+        memset(&config, 0, sizeof(config));
+        config.mbdir = DB_DIR;
+        config.options = CONSTS::WriterOptions() | CONSTS::ASYNC_WRITER_MODE;
+        config.memcap_index = 64*1024*1024LL;
+        config.memcap_data = 64*1024*1024LL;
+        config.async_queue_size = queue_size;
+        db = new DB(config);
+    }
+
+    void RunProducers(bool remove) {
+        pthread_t tid[NUM_THREAD];
+        ProducerArg args[NUM_THREAD];
+        for(int i = 0; i < NUM_THREAD; i++) {
+            args[i].db = db;
+            args[i].thread_id = i;
+            args[i].remove = remove;
+            ASSERT_EQ(0, pthread_create(&tid[i], NULL, producer_thread, &args[i]));
+        }
+        for(int i = 0; i < NUM_THREAD; i++)
+            pthread_join(tid[i], NULL);
+        while(db->AsyncWriterBusy())
+            usleep(100);
+    }
+
+    void CheckKeys(bool remove) {
+        DB db_r(DB_DIR, CONSTS::ReaderOptions());
+        ASSERT_TRUE(db_r.is_open());
+        MBData mbd;
+        int64_t count = 0;
+        for(int t = 0; t < NUM_THREAD; t++) {
+            for(int i = 0; i < NUM_KEY_PER_THREAD; i++) {
+                std::string key = make_key(t, i);
+                if(remove && i % 3 == 0) {
+                    EXPECT_EQ(MBError::NOT_EXIST, db_r.Find(key, mbd)) << key;
+                    continue;
+                }
+                ASSERT_EQ(MBError::SUCCESS, db_r.Find(key, mbd)) << key;
+                EXPECT_EQ(make_value(i), std::string((const char *)mbd.buff, mbd.data_len));
+                count++;
+            }
+        }
+        EXPECT_EQ(count, db->Count());
+        db_r.Close();
+    }
+
+protected:
+    DB *db;
+};
+
+TEST_F(AsyncWriterTest, add_test)
+{
+    OpenDB(0);
+    ASSERT_TRUE(db->is_open());
+    RunProducers(false);
+    CheckKeys(false);
+}
+
+TEST_F(AsyncWriterTest, small_queue_test)
+{
+    // Producers keep wrapping around and waiting for free slots.
+    OpenDB(16);
+    ASSERT_TRUE(db->is_open());
+    RunProducers(true);
+    CheckKeys(true);
+}
+
+TEST_F(AsyncWriterTest, two_slot_test)
+{
+    OpenDB(2);
+    ASSERT_TRUE(db->is_open());
+    RunProducers(true);
+    CheckKeys(true);
+}
+
+TEST_F(AsyncWriterTest, seq_test)
+{
+    OpenDB(16);
+    ASSERT_TRUE(db->is_open());
+
+    std::vector<int> results(NUM_KEY_PER_THREAD, -1);
+    std::vector<uint64_t> seqs(NUM_KEY_PER_THREAD, 0);
+    std::atomic<int> num_done(0);
+    uint64_t seq = 0;
+    for(int i = 0; i < NUM_KEY_PER_THREAD; i++) {
+        std::string key = make_key(0, i);
+        std::string value = make_value(i);
+        AsyncCallback callback = [&, i](uint64_t task_seq, int rval) {
+            EXPECT_EQ(seqs[i], task_seq);
+            results[i] = rval;
+            num_done.fetch_add(1);
+        };
+        ASSERT_EQ(MBError::SUCCESS, db->AddAsync(key.data(), key.size(), value.data(),
+                                                 value.size(), false, seqs[i], callback));
+        EXPECT_GT(seqs[i], seq);
+        seq = seqs[i];
+    }
+    EXPECT_EQ(MBError::SUCCESS, db->WaitForAsync(seq));
+    EXPECT_EQ(NUM_KEY_PER_THREAD, num_done.load());
+    for(int i = 0; i < NUM_KEY_PER_THREAD; i++)
+        EXPECT_EQ(MBError::SUCCESS, results[i]);
+    EXPECT_EQ(MBError::SUCCESS, db->WaitForAsync(seqs[0], 0));
+    EXPECT_EQ(MBError::INVALID_ARG, db->WaitForAsync(seq + 1000, 0));
+
+    // Writer errors are passed to the callback.
+    int rval = -1;
+    std::string key = make_key(0, 0);
+    ASSERT_EQ(MBError::SUCCESS, db->AddAsync(key.data(), key.size(), "x", 1, false, seq,
+                                             [&](uint64_t, int err) { rval = err; }));
+    EXPECT_EQ(MBError::SUCCESS, db->WaitForAsync(seq, 10000));
+    EXPECT_EQ(MBError::IN_DICT, rval);
+    key = make_key(1, 0);
+    ASSERT_EQ(MBError::SUCCESS, db->RemoveAsync(key.data(), key.size(), seq,
+                                                [&](uint64_t, int err) { rval = err; }));
+    EXPECT_EQ(MBError::SUCCESS, db->WaitForAsync(seq, 10000));
+    EXPECT_EQ(MBError::NOT_EXIST, rval);
+
+    // Adds are visible once they are waited for.
+    DB db_r(DB_DIR, CONSTS::ReaderOptions());
+    ASSERT_TRUE(db_r.is_open());
+    MBData mbd;
+    for(int i = 0; i < NUM_KEY_PER_THREAD; i++) {
+        ASSERT_EQ(MBError::SUCCESS, db_r.Find(make_key(0, i), mbd));
+        EXPECT_EQ(make_value(i), std::string((const char *)mbd.buff, mbd.data_len));
+    }
+    db_r.Close();
+}
+
+TEST_F(AsyncWriterTest, rc_remove_test)
+{
+    // Removals queued while rc is running are applied after rc. Keys are
+    // not found once their removals are waited for.
+    OpenDB(1024);
+    ASSERT_TRUE(db->is_open());
+    int num = 20000;
+    uint64_t seq = 0;
+    for(int i = 0; i < num; i++) {
+        std::string key = make_key(0, i);
+        ASSERT_EQ(MBError::SUCCESS, db->AddAsync(key.data(), key.size(), key.data(),
+                                                 key.size(), false, seq));
+    }
+    for(int i = 1; i < num; i += 2) {
+        std::string key = make_key(0, i);
+        ASSERT_EQ(MBError::SUCCESS, db->RemoveAsync(key.data(), key.size(), seq));
+    }
+    ASSERT_EQ(MBError::SUCCESS, db->WaitForAsync(seq));
+
+    ASSERT_EQ(MBError::SUCCESS, db->CollectResource(1, 1));
+    std::vector<int> results(num, -1);
+    for(int i = 0; i < num; i += 4) {
+        std::string key = make_key(0, i);
+        ASSERT_EQ(MBError::SUCCESS, db->RemoveAsync(key.data(), key.size(), seq,
+                                                    [&results, i](uint64_t, int rval) {
+                                                        results[i] = rval;
+                                                    }));
+    }
+    ASSERT_EQ(MBError::SUCCESS, db->WaitForAsync(seq));
+
+    DB db_r(DB_DIR, CONSTS::ReaderOptions());
+    ASSERT_TRUE(db_r.is_open());
+    MBData mbd;
+    for(int i = 0; i < num; i += 2) {
+        std::string key = make_key(0, i);
+        if(i % 4 == 0) {
+            EXPECT_EQ(MBError::SUCCESS, results[i]) << key;
+            EXPECT_EQ(MBError::NOT_EXIST, db_r.Find(key, mbd)) << key;
+        } else {
+            EXPECT_EQ(MBError::SUCCESS, db_r.Find(key, mbd)) << key;
+        }
+    }
+    EXPECT_EQ(num/4, db->Count());
+    db_r.Close();
+}
+
+TEST_F(AsyncWriterTest, task_seq_test)
+{
+    // Prefix removes, batches and remove-all also return sequence numbers.
+    OpenDB(16);
+    ASSERT_TRUE(db->is_open());
+    uint64_t seq = 0;
+    uint64_t last_seq = 0;
+    for(int i = 0; i < NUM_KEY_PER_THREAD; i++) {
+        std::string key = make_key(i % 2, i);
+        ASSERT_EQ(MBError::SUCCESS, db->AddAsync(key.data(), key.size(), key.data(),
+                                                 key.size(), false, last_seq));
+    }
+    std::string prefix = "async/0/";
+    ASSERT_EQ(MBError::SUCCESS, db->RemovePrefix(prefix.data(), prefix.size(), &seq));
+    EXPECT_EQ(last_seq + 1, seq);
+    ASSERT_EQ(MBError::SUCCESS, db->WaitForAsync(seq));
+    EXPECT_EQ(NUM_KEY_PER_THREAD/2, db->Count());
+
+    WriteBatch batch;
+    batch.Add(make_key(2, 0), "x");
+    batch.Remove(make_key(1, 1));
+    last_seq = seq;
+    ASSERT_EQ(MBError::SUCCESS, db->Write(batch, &seq));
+    EXPECT_EQ(last_seq + 1, seq);
+    ASSERT_EQ(MBError::SUCCESS, db->WaitForAsync(seq));
+    EXPECT_EQ(NUM_KEY_PER_THREAD/2, db->Count());
+    DB db_r(DB_DIR, CONSTS::ReaderOptions());
+    ASSERT_TRUE(db_r.is_open());
+    MBData mbd;
+    EXPECT_EQ(MBError::SUCCESS, db_r.Find(make_key(2, 0), mbd));
+    EXPECT_EQ(MBError::NOT_EXIST, db_r.Find(make_key(1, 1), mbd));
+    db_r.Close();
+
+    last_seq = seq;
+    ASSERT_EQ(MBError::SUCCESS, db->RemoveAll(&seq));
+    EXPECT_EQ(last_seq + 1, seq);
+    ASSERT_EQ(MBError::SUCCESS, db->WaitForAsync(seq));
+    EXPECT_EQ(0, db->Count());
+}
+
+TEST_F(AsyncWriterTest, queue_size_test)
+{
+    OpenDB(1000);
+    EXPECT_FALSE(db->is_open());
+    delete db;
+    db = NULL;
+    OpenDB(1);
+    EXPECT_FALSE(db->is_open());
+    delete db;
+    db = NULL;
+    OpenDB(-2);
+    EXPECT_FALSE(db->is_open());
+    delete db;
+    db = NULL;
+}
+
+}
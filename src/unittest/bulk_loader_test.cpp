@@ -0,0 +1,179 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <map>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../bulk_loader.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class BulkLoaderTest : public TestDBFixture
+{
+public:
+    void OpenDB(int options = 0, size_t filter_size = 0) {
+        config.options |= options;
+        config.key_filter_size = filter_size;
+        TestDBFixture::OpenDB();
+    }
+
+    // Keys with shared prefixes, keys that are prefixes of other keys, long
+    // edge labels and nodes with many edges
+    void MakeKeys(int num) {
+        char buff[256];
+        for(int i = 0; i < num; i++) {
+            snprintf(buff, sizeof(buff), "tenant%d/%d", i % 7, i);
+            kvs[buff] = std::string("v") + buff;
+            snprintf(buff, sizeof(buff), "tenant%d", i % 7);
+            kvs[buff] = buff;
+            snprintf(buff, sizeof(buff), "%c%c/a_long_path_to_the_item/%d",
+                     (char) (i % 256), (char) ((i * 7) % 256), i);
+            kvs[std::string(buff, 2) + std::string(buff + 2)] = "x";
+        }
+        kvs[std::string(200, 'z')] = "long";
+        kvs[std::string(255, 'z')] = "longest";
+    }
+
+    void Load() {
+        BulkLoader loader(*db);
+        for(std::map<std::string, std::string>::iterator it = kvs.begin();
+            it != kvs.end(); ++it) {
+            ASSERT_EQ(MBError::SUCCESS, loader.Add(it->first, it->second)) << it->first;
+        }
+        EXPECT_EQ((int64_t) kvs.size(), loader.Count());
+        // Nothing is visible before the load is finished.
+        EXPECT_EQ(0, db_r->Count());
+        MBData mbd;
+        EXPECT_EQ(MBError::NOT_EXIST, db_r->Find(kvs.begin()->first, mbd));
+        EXPECT_EQ(MBError::SUCCESS, loader.Finish());
+        EXPECT_EQ(MBError::NOT_ALLOWED, loader.Add("zzzz", "1"));
+    }
+
+    void CheckKeys() {
+        MBData mbd;
+        for(std::map<std::string, std::string>::iterator it = kvs.begin();
+            it != kvs.end(); ++it) {
+            ASSERT_EQ(MBError::SUCCESS, db_r->Find(it->first, mbd)) << it->first;
+            EXPECT_EQ(it->second, std::string((const char *)mbd.buff, mbd.data_len));
+        }
+        EXPECT_EQ((int64_t) kvs.size(), db_r->Count());
+
+        std::map<std::string, std::string>::iterator it = kvs.begin();
+        for(DB::iterator iter = db_r->begin_range("", "", CONSTS::OPTION_KEY_ONLY);
+            iter != db_r->end(); ++iter) {
+            ASSERT_TRUE(it != kvs.end());
+            EXPECT_EQ(it->first, iter.key);
+            ++it;
+        }
+        EXPECT_TRUE(it == kvs.end());
+    }
+
+protected:
+    std::map<std::string, std::string> kvs;
+};
+
+TEST_F(BulkLoaderTest, load_test)
+{
+    OpenDB();
+    MakeKeys(5000);
+    Load();
+    CheckKeys();
+
+    // No node or label is released during the load.
+    IndexHeader *header = db->GetDictPtr()->GetHeaderPtr();
+    EXPECT_EQ(0, header->pending_index_buff_size);
+    EXPECT_EQ(0, header->pending_data_buff_size);
+
+    // The DB is updated as usual after the load.
+    EXPECT_EQ(MBError::SUCCESS, db->Add("tenant3/new", "1"));
+    kvs["tenant3/new"] = "1";
+    EXPECT_EQ(MBError::SUCCESS, db->Remove("tenant2"));
+    kvs.erase("tenant2");
+    EXPECT_EQ(MBError::SUCCESS, db->Add("tenant1/1", "2", true));
+    kvs["tenant1/1"] = "2";
+    CheckKeys();
+}
+
+TEST_F(BulkLoaderTest, format_test)
+{
+    OpenDB(CONSTS::ADAPTIVE_NODE_FORMAT | CONSTS::WIDE_EDGE, 1024*1024);
+    MakeKeys(3000);
+    Load();
+    CheckKeys();
+}
+
+TEST_F(BulkLoaderTest, invalid_arg_test)
+{
+    OpenDB();
+    {
+        BulkLoader loader(*db);
+        EXPECT_EQ(MBError::SUCCESS, loader.Add("b", "1"));
+        EXPECT_EQ(MBError::INVALID_ARG, loader.Add("b", "1"));
+        EXPECT_EQ(MBError::INVALID_ARG, loader.Add("a", "1"));
+        EXPECT_EQ(MBError::INVALID_ARG, loader.Add("", "1"));
+        EXPECT_EQ(MBError::OUT_OF_BOUND, loader.Add(std::string(256, 'c'), "1"));
+        EXPECT_EQ(MBError::SUCCESS, loader.Add("ba", ""));
+        EXPECT_EQ(MBError::SUCCESS, loader.Finish());
+        EXPECT_EQ(MBError::NOT_ALLOWED, loader.Finish());
+    }
+    kvs["b"] = "1";
+    kvs["ba"] = "";
+    CheckKeys();
+
+    // The DB must be empty.
+    int error = MBError::SUCCESS;
+    try {
+        BulkLoader loader(*db);
+    } catch (int err) {
+        error = err;
+    }
+    EXPECT_EQ(MBError::NOT_ALLOWED, error);
+}
+
+TEST_F(BulkLoaderTest, rollback_test)
+{
+    OpenDB();
+    BulkLoader loader(*db);
+    EXPECT_EQ(MBError::SUCCESS, loader.Add("a1", "1"));
+    EXPECT_EQ(MBError::SUCCESS, loader.Add("a2", "2"));
+    EXPECT_EQ(MBError::SUCCESS, loader.Add("b1", "3"));
+    EXPECT_EQ(MBError::SUCCESS, loader.Add("c1", "4"));
+    // The root edge of "c" is taken when Finish gets to it. The root
+    // edges already published are cleared again.
+    EXPECT_EQ(MBError::SUCCESS, db->Add("c9", "5"));
+    EXPECT_EQ(MBError::IN_DICT, loader.Finish());
+    EXPECT_EQ(MBError::IN_DICT, loader.Finish());
+
+    kvs["c9"] = "5";
+    CheckKeys();
+    MBData mbd;
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find("a1", mbd));
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find("b1", mbd));
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find("c1", mbd));
+}
+
+}
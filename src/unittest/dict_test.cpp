@@ -218,6 +218,34 @@ TEST_F(DictTest, Find_test)
     EXPECT_EQ(memcmp(mbd.buff, FAKE_DATA, mbd.data_len), 0);
 }
 
+TEST_F(DictTest, FindView_test)
+{
+    InitDict(true, CONSTS::ACCESS_MODE_WRITER, 4*ONE_MEGA, 10);
+    MBData mbd(0, CONSTS::OPTION_READ_VIEW);
+    int rval;
+
+    rval = AddKV(10, 32, false);
+    EXPECT_EQ(rval, MBError::SUCCESS);
+    rval = AddKV(15, 20, false);
+    EXPECT_EQ(rval, MBError::SUCCESS);
+    dict->Flush();
+
+    // Value from a leaf edge
+    rval = dict->Find((const uint8_t*)FAKE_KEY, 15, mbd);
+    EXPECT_EQ(rval, MBError::SUCCESS);
+    EXPECT_EQ(mbd.data_len, 20);
+    EXPECT_EQ(mbd.buff == NULL, true);
+    EXPECT_EQ(mbd.view == dict->GetShmPtr(mbd.data_offset, 1) + DATA_HDR_BYTE, true);
+    EXPECT_EQ(memcmp(mbd.view, FAKE_DATA, mbd.data_len), 0);
+
+    // Value from a node
+    rval = dict->Find((const uint8_t*)FAKE_KEY, 10, mbd);
+    EXPECT_EQ(rval, MBError::SUCCESS);
+    EXPECT_EQ(mbd.data_len, 32);
+    EXPECT_EQ(mbd.buff == NULL, true);
+    EXPECT_EQ(memcmp(mbd.view, FAKE_DATA, mbd.data_len), 0);
+}
+
 TEST_F(DictTest, FindPrefix_test)
 {
     InitDict(true, CONSTS::ACCESS_MODE_WRITER, 4*ONE_MEGA, 10);
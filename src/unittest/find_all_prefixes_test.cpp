@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class FindAllPrefixesTest : public TestDBFixture
+{
+public:
+    virtual void SetUp() {
+        TestDBFixture::SetUp();
+        OpenDB();
+    }
+
+    // Routing-table style prefixes: "10", "10.1", "10.1.2", ...
+    std::string GetPrefix(int i, int depth) {
+        char buff[64];
+        int len = snprintf(buff, sizeof(buff), "%d", 10 + i % 20);
+        for(int d = 1; d <= depth; d++)
+            len += snprintf(buff + len, sizeof(buff) - len, ".%d", (i / d) % 256);
+        return std::string(buff, len);
+    }
+
+    // Look up every prefix of the key separately.
+    void FindEachPrefix(const std::string &key, std::vector<PrefixMatch> &matches) {
+        MBData mbd;
+        matches.clear();
+        for(size_t len = 1; len <= key.size(); len++) {
+            if(db_r->Find(key.data(), len, mbd) == MBError::SUCCESS) {
+                PrefixMatch m;
+                m.match_len = len;
+                m.value = std::string((const char *)mbd.buff, mbd.data_len);
+                matches.push_back(m);
+            }
+        }
+    }
+
+    void Verify(const std::string &key) {
+        std::vector<PrefixMatch> matches;
+        int rval = db_r->FindAllPrefixes(key, matches);
+        std::vector<PrefixMatch> expected;
+        FindEachPrefix(key, expected);
+        EXPECT_EQ(expected.size(), matches.size()) << key;
+        EXPECT_EQ(expected.empty() ? MBError::NOT_EXIST : MBError::SUCCESS, rval);
+        for(size_t i = 0; i < matches.size() && i < expected.size(); i++) {
+            EXPECT_EQ(expected[i].match_len, matches[i].match_len);
+            EXPECT_EQ(expected[i].value, matches[i].value);
+            EXPECT_EQ(key.substr(0, matches[i].match_len), matches[i].value);
+        }
+    }
+};
+
+TEST_F(FindAllPrefixesTest, routing_table_test)
+{
+    int num = 2000;
+    for(int i = 0; i < num; i++) {
+        for(int depth = 0; depth < 4; depth++) {
+            if((i + depth) % 3 == 0)
+                continue;
+            std::string key = GetPrefix(i, depth);
+            db->Add(key, key, true);
+        }
+    }
+
+    std::vector<PrefixMatch> matches;
+    for(int i = 0; i < num; i++) {
+        Verify(GetPrefix(i, 3));
+        Verify(GetPrefix(i, 3) + ".1");
+        Verify(GetPrefix(i, 2));
+    }
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->FindAllPrefixes("9", matches));
+    EXPECT_TRUE(matches.empty());
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->FindAllPrefixes("", matches));
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->FindAllPrefixes(NULL, 1, matches));
+
+    // Every prefix of the key is found with its own value.
+    std::string key = "192.168.1.100";
+    for(size_t len = 1; len <= key.size(); len++) {
+        EXPECT_EQ(MBError::SUCCESS, db->Add(key.substr(0, len), key.substr(0, len), true));
+    }
+    EXPECT_EQ(MBError::SUCCESS, db_r->FindAllPrefixes(key + "/24", matches));
+    ASSERT_EQ(key.size(), matches.size());
+    for(size_t i = 0; i < matches.size(); i++) {
+        EXPECT_EQ((int) i + 1, matches[i].match_len);
+        EXPECT_EQ(key.substr(0, i + 1), matches[i].value);
+    }
+    Verify(key);
+
+    for(int i = 0; i < num; i += 2) {
+        db->Remove(GetPrefix(i, 1));
+    }
+    EXPECT_EQ(MBError::SUCCESS, db->CollectResource(0, 0));
+    for(int i = 0; i < num; i++) {
+        Verify(GetPrefix(i, 3));
+    }
+}
+
+}
@@ -0,0 +1,177 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class FindCursorTest : public TestDBFixture
+{
+public:
+    // Reopen the DB with the writer options.
+    void OpenDB(int opts) {
+        CloseDB();
+        config.options = opts;
+        config.memcap_index = 128ULL*1024*1024;
+        config.memcap_data = 128ULL*1024*1024;
+        TestDBFixture::OpenDB();
+    }
+
+    // Sorted keys with long shared prefixes. Some keys are prefixes of
+    // others.
+    std::string GetKey(int i) {
+        char buff[128];
+        if(i % 100 == 0)
+            snprintf(buff, sizeof(buff), "sensor/%03d/reading", i / 100);
+        else
+            snprintf(buff, sizeof(buff), "sensor/%03d/reading/%08d", i / 100, i);
+        return std::string(buff);
+    }
+
+    void Populate(int num, const std::string &suffix = "", bool overwrite = false) {
+        for(int i = 0; i < num; i++) {
+            std::string key = GetKey(i);
+            EXPECT_EQ(MBError::SUCCESS, db->Add(key, key + suffix, overwrite));
+        }
+    }
+
+    void Verify(DB *dbh, FindCursor &cursor, int num, int step_removed,
+                const std::string &suffix = "") {
+        MBData mbd;
+        for(int i = 0; i < num; i++) {
+            std::string key = GetKey(i);
+            int rval = dbh->Find(key, mbd, cursor);
+            if(step_removed > 0 && i % step_removed == 0) {
+                EXPECT_EQ(MBError::NOT_EXIST, rval);
+            } else {
+                EXPECT_EQ(MBError::SUCCESS, rval);
+                EXPECT_EQ(key + suffix, std::string((const char *)mbd.buff, mbd.data_len));
+                EXPECT_EQ((int) key.size(), mbd.match_len);
+            }
+        }
+    }
+
+    int64_t GetWriterStat(const std::string &name) {
+        std::ostringstream out;
+        db->PrintStats(out);
+        size_t pos = out.str().find(name + ": ");
+        if(pos == std::string::npos)
+            return -1;
+        return atoll(out.str().c_str() + pos + name.size() + 2);
+    }
+};
+
+TEST_F(FindCursorTest, sorted_find_test)
+{
+    OpenDB(CONSTS::WriterOptions());
+    int num = 5000;
+    Populate(num);
+#ifdef __LOCK_FREE__
+    EXPECT_GT(GetWriterStat("Number of resumed adds"), 0);
+#endif
+
+    FindCursor cursor;
+    Verify(db_r, cursor, num, 0);
+#ifdef __LOCK_FREE__
+    EXPECT_GT(cursor.num_resume, num / 2);
+#endif
+
+    // Keys not in DB
+    MBData mbd;
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find("sensor/000/readin", mbd, cursor));
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find("sensor/000/reading/", mbd, cursor));
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find("sensor/000/reading/00000001x", mbd, cursor));
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find("sensor/999/reading", mbd, cursor));
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find("x", mbd, cursor));
+    EXPECT_EQ(MBError::SUCCESS, db_r->Find(GetKey(1), mbd, cursor));
+
+    // Random order still works.
+    for(int i = 0; i < num; i++) {
+        int n = (i * 7919) % num;
+        std::string key = GetKey(n);
+        EXPECT_EQ(MBError::SUCCESS, db_r->Find(key, mbd, cursor));
+        EXPECT_EQ(key, std::string((const char *)mbd.buff, mbd.data_len));
+    }
+}
+
+TEST_F(FindCursorTest, update_between_find_test)
+{
+    OpenDB(CONSTS::WriterOptions());
+    int num = 3000;
+    Populate(num);
+
+    // The path of the cursor is not reused after writer modifies DB.
+    FindCursor cursor;
+    MBData mbd;
+    for(int i = 0; i < num; i++) {
+        std::string key = GetKey(i);
+        EXPECT_EQ(MBError::SUCCESS, db_r->Find(key, mbd, cursor));
+        EXPECT_EQ(key, std::string((const char *)mbd.buff, mbd.data_len));
+        if(i % 3 == 0) {
+            EXPECT_EQ(MBError::SUCCESS, db->Remove(key));
+        }
+        if(i % 5 == 0) {
+            EXPECT_EQ(MBError::SUCCESS, db->Add(key + "/new", key));
+        }
+    }
+    Verify(db_r, cursor, num, 3);
+    for(int i = 0; i < num; i += 5) {
+        std::string key = GetKey(i) + "/new";
+        EXPECT_EQ(MBError::SUCCESS, db_r->Find(key, mbd, cursor));
+    }
+
+    // Sorted adds and overwrites on the writer
+    Populate(num, "_new", true);
+    Verify(db_r, cursor, num, 0, "_new");
+    EXPECT_EQ(num + (num + 4) / 5, db->Count());
+
+    EXPECT_EQ(MBError::SUCCESS, db->RemoveAll());
+    Verify(db_r, cursor, num, 1);
+    Populate(num);
+    Verify(db_r, cursor, num, 0);
+}
+
+TEST_F(FindCursorTest, collect_resource_test)
+{
+    OpenDB(CONSTS::WriterOptions());
+    int num = 3000;
+    Populate(num);
+    for(int i = 0; i < num; i += 2) {
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(GetKey(i)));
+    }
+
+    FindCursor cursor;
+    Verify(db_r, cursor, num, 2);
+    EXPECT_EQ(MBError::SUCCESS, db->CollectResource(0, 0));
+    Verify(db_r, cursor, num, 2);
+    Populate(num, "", true);
+    FindCursor cursor_w;
+    Verify(db, cursor_w, num, 0);
+}
+
+}
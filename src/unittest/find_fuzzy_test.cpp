@@ -0,0 +1,158 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class FindFuzzyTest : public TestDBFixture
+{
+public:
+    virtual void SetUp() {
+        TestDBFixture::SetUp();
+        OpenDB();
+    }
+
+    // Device identifiers. Long keys have edge labels stored out of line.
+    void AddKeys(int num) {
+        char buff[128];
+        for(int i = 0; i < num; i++) {
+            unsigned h = (i * 2654435761U) >> 8;
+            if(i % 7 == 0)
+                snprintf(buff, sizeof(buff), "device-%06x-rack-%02d-long-identifier", h, i % 13);
+            else
+                snprintf(buff, sizeof(buff), "dev%05x", h & 0xfffff);
+            if(db->Add(buff, std::string(buff) + "-value") == MBError::SUCCESS)
+                keys.insert(buff);
+        }
+    }
+
+    static int EditDistance(const std::string &a, const std::string &b) {
+        std::vector<int> prev(b.size() + 1);
+        std::vector<int> row(b.size() + 1);
+        for(size_t j = 0; j <= b.size(); j++)
+            prev[j] = j;
+        for(size_t i = 1; i <= a.size(); i++) {
+            row[0] = i;
+            for(size_t j = 1; j <= b.size(); j++) {
+                row[j] = std::min(std::min(prev[j] + 1, row[j-1] + 1),
+                                  prev[j-1] + (a[i-1] != b[j-1] ? 1 : 0));
+            }
+            prev.swap(row);
+        }
+        return prev[b.size()];
+    }
+
+    // Brute-force result ordered by distance and key
+    void BruteForce(const std::string &key, int max_edits, int limit,
+                    std::vector<std::pair<int, std::string> > &result) {
+        result.clear();
+        for(std::set<std::string>::iterator it = keys.begin(); it != keys.end(); ++it) {
+            int dist = EditDistance(key, *it);
+            if(dist <= max_edits)
+                result.push_back(std::make_pair(dist, *it));
+        }
+        std::sort(result.begin(), result.end());
+        if(result.size() > (size_t) limit)
+            result.resize(limit);
+    }
+
+    void Check(const std::string &key, int max_edits, int limit) {
+        std::vector<std::pair<int, std::string> > expected;
+        BruteForce(key, max_edits, limit, expected);
+        std::vector<FuzzyMatch> matches;
+        int rval = db_r->FindFuzzy(key, max_edits, limit, matches);
+        if(expected.empty()) {
+            EXPECT_EQ(MBError::NOT_EXIST, rval) << key;
+            return;
+        }
+        ASSERT_EQ(MBError::SUCCESS, rval) << key;
+        ASSERT_EQ(expected.size(), matches.size()) << key << " " << max_edits;
+        for(size_t i = 0; i < matches.size(); i++) {
+            EXPECT_EQ(expected[i].first, matches[i].distance);
+            EXPECT_EQ(expected[i].second, matches[i].key);
+            EXPECT_EQ(matches[i].key + "-value", matches[i].value);
+        }
+    }
+
+protected:
+    std::set<std::string> keys;
+};
+
+TEST_F(FindFuzzyTest, exact_test)
+{
+    AddKeys(2000);
+    std::set<std::string>::iterator it = keys.begin();
+    for(int i = 0; i < 50 && it != keys.end(); i++, ++it) {
+        std::vector<FuzzyMatch> matches;
+        ASSERT_EQ(MBError::SUCCESS, db_r->FindFuzzy(*it, 0, 10, matches));
+        ASSERT_EQ(1, (int) matches.size());
+        EXPECT_EQ(*it, matches[0].key);
+        EXPECT_EQ(0, matches[0].distance);
+    }
+}
+
+TEST_F(FindFuzzyTest, brute_force_test)
+{
+    AddKeys(3000);
+    const char *targets[] = {"dev", "dev1234", "dev0000", "deva1b2c", "ev12345",
+                             "device-000000-rack-00-long-identifier",
+                             "device-1a2b3c-rack-05-long-identifer", "x", "dve1f0a0"};
+    for(size_t i = 0; i < sizeof(targets)/sizeof(targets[0]); i++) {
+        for(int max_edits = 0; max_edits <= 3; max_edits++) {
+            Check(targets[i], max_edits, 1000000);
+            Check(targets[i], max_edits, 5);
+        }
+    }
+
+    // Keys close to existing keys
+    std::set<std::string>::iterator it = keys.begin();
+    for(int i = 0; i < 100 && it != keys.end(); i++, ++it) {
+        std::string key = *it;
+        if(i % 3 == 0)
+            key[key.size() / 2] = 'z';
+        else if(i % 3 == 1)
+            key.erase(1, 1);
+        else
+            key.insert(key.size() - 1, "q");
+        Check(key, 2, 3);
+    }
+}
+
+TEST_F(FindFuzzyTest, invalid_arg_test)
+{
+    AddKeys(10);
+    std::vector<FuzzyMatch> matches;
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->FindFuzzy("dev", -1, 10, matches));
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->FindFuzzy("dev", 1, 0, matches));
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->FindFuzzy("", 1, 10, matches));
+}
+
+}
@@ -0,0 +1,167 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class FindMatchingTest : public TestDBFixture
+{
+public:
+    virtual void SetUp() {
+        TestDBFixture::SetUp();
+        OpenDB();
+    }
+
+    void AddKeys() {
+        char buff[128];
+        const char *services[] = {"web", "db", "cache", "queue", "auth"};
+        const char *params[] = {"timeout", "retries", "timeout_ms", "host", "port"};
+        for(int s = 0; s < 5; s++) {
+            for(int i = 0; i < 40; i++) {
+                for(int p = 0; p < 5; p++) {
+                    snprintf(buff, sizeof(buff), "cfg/%s%d/%s", services[s], i, params[p]);
+                    Add(buff);
+                }
+            }
+        }
+        for(int i = 0; i < 500; i++) {
+            snprintf(buff, sizeof(buff), "log/%05d/message-with-a-long-suffix", i * 17);
+            Add(buff);
+        }
+        Add("cfg");
+        Add("cfg/");
+        Add("c*g/[x]");
+    }
+
+    void Add(const std::string &key) {
+        EXPECT_EQ(MBError::SUCCESS, db->Add(key, key + "=v"));
+        keys.insert(key);
+    }
+
+    // Reference implementation of the glob syntax
+    static bool GlobMatch(const char *p, const char *k) {
+        if(*p == '\0')
+            return *k == '\0';
+        if(*p == '*') {
+            for(const char *s = k; ; s++) {
+                if(GlobMatch(p + 1, s))
+                    return true;
+                if(*s == '\0')
+                    return false;
+            }
+        }
+        if(*k == '\0')
+            return false;
+        if(*p == '?')
+            return GlobMatch(p + 1, k + 1);
+        if(*p == '[') {
+            const char *q = p + 1;
+            bool negate = *q == '!' || *q == '^';
+            if(negate)
+                q++;
+            bool found = false;
+            bool first = true;
+            while(*q != ']' || first) {
+                first = false;
+                char lo = *q++;
+                char hi = lo;
+                if(*q == '-' && q[1] != ']') {
+                    hi = q[1];
+                    q += 2;
+                }
+                if(*k >= lo && *k <= hi)
+                    found = true;
+            }
+            if(found == negate)
+                return false;
+            return GlobMatch(q + 1, k + 1);
+        }
+        if(*p == '\\')
+            p++;
+        return *p == *k && GlobMatch(p + 1, k + 1);
+    }
+
+    void Check(const std::string &pattern) {
+        std::set<std::string> expected;
+        for(std::set<std::string>::iterator it = keys.begin(); it != keys.end(); ++it) {
+            if(GlobMatch(pattern.c_str(), it->c_str()))
+                expected.insert(*it);
+        }
+
+        std::set<std::string> found;
+        int rval = db_r->FindMatching(pattern,
+            [&](const std::string &key, const MBData &value) {
+                EXPECT_TRUE(found.insert(key).second) << key;
+                EXPECT_EQ(key + "=v", std::string((const char *)value.buff, value.data_len));
+                return true;
+            });
+        EXPECT_EQ(MBError::SUCCESS, rval) << pattern;
+        EXPECT_EQ(expected, found) << pattern;
+    }
+
+protected:
+    std::set<std::string> keys;
+};
+
+TEST_F(FindMatchingTest, match_test)
+{
+    AddKeys();
+    const char *patterns[] = {"cfg/*/timeout", "cfg/web1?/port", "cfg/[wd]*/timeout*",
+                              "cfg/[!a-c]*3/host", "cfg/[^w]b?/retries", "*timeout",
+                              "*", "cfg", "cfg/", "cfg*", "c\\*g/\\[x]", "log/0??00/*",
+                              "log/*-long-suffix", "*/*/*", "nothing*", "?", "**cache**port",
+                              "cfg/web[]1]/host", "cfg/auth[0-2]/p*"};
+    for(size_t i = 0; i < sizeof(patterns)/sizeof(patterns[0]); i++) {
+        Check(patterns[i]);
+    }
+}
+
+TEST_F(FindMatchingTest, stop_test)
+{
+    AddKeys();
+    int count = 0;
+    EXPECT_EQ(MBError::SUCCESS, db_r->FindMatching("cfg/*",
+        [&](const std::string &key, const MBData &value) {
+            return ++count < 10;
+        }));
+    EXPECT_EQ(10, count);
+}
+
+TEST_F(FindMatchingTest, invalid_pattern_test)
+{
+    AddKeys();
+    MatchCallback fn = [](const std::string &key, const MBData &value) { return true; };
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->FindMatching("", fn));
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->FindMatching("cfg/[abc", fn));
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->FindMatching("cfg\\", fn));
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->FindMatching("cfg/[z-a]", fn));
+}
+
+}
@@ -0,0 +1,246 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../hash_index.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../util/mb_hash.h"
+#include "./test_key.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class HashIndexTest : public TestDBFixture
+{
+public:
+    void OpenDB(int opts, size_t index_size = 2*1024*1024) {
+        config.options = opts;
+        config.hash_index_size = index_size;
+        TestDBFixture::OpenDB();
+    }
+
+    // Integer keys are prefixes of each other so that data is stored in
+    // both leaf edges and nodes.
+    void Populate(int start, int end, const std::string &suffix = "", bool overwrite = false) {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        for(int i = start; i < end; i++) {
+            std::string key = tkey.get_key(i);
+            EXPECT_EQ(MBError::SUCCESS, db->Add(key, key + suffix, overwrite));
+        }
+    }
+
+    // Return the number of keys found
+    int Lookup(int start, int end, const std::string &suffix = "") {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        MBData mbd;
+        int found = 0;
+        for(int i = start; i < end; i++) {
+            std::string key = tkey.get_key(i);
+            int rval = db_r->Find(key, mbd);
+            if(rval == MBError::SUCCESS) {
+                EXPECT_EQ(key + suffix, std::string((const char *)mbd.buff, mbd.data_len));
+                EXPECT_EQ((int) key.size(), mbd.match_len);
+                found++;
+            } else {
+                EXPECT_EQ(MBError::NOT_EXIST, rval);
+            }
+        }
+        return found;
+    }
+
+    int64_t GetReaderStat(const std::string &name) {
+        std::ostringstream out;
+        db_r->PrintStats(out);
+        size_t pos = out.str().find(name + ": ");
+        if(pos == std::string::npos)
+            return -1;
+        return atoll(out.str().c_str() + pos + name.size() + 2);
+    }
+
+    HashIndex* GetHashIndex() {
+        return db->GetDictPtr()->GetHashIndex();
+    }
+};
+
+TEST_F(HashIndexTest, find_test)
+{
+    OpenDB(CONSTS::WriterOptions() | CONSTS::HASH_INDEX);
+    ASSERT_TRUE(GetHashIndex() != NULL);
+    EXPECT_TRUE(GetHashIndex()->IsReady());
+
+    int num = 10000;
+    Populate(0, num);
+    EXPECT_EQ(num, Lookup(0, num));
+    EXPECT_EQ(0, Lookup(num, 2*num));
+    EXPECT_EQ(num, GetReaderStat("Number of hits"));
+
+    // Overwritten keys are found with the new data.
+    EXPECT_EQ(MBError::IN_DICT, db->Add(TestKey(MABAIN_TEST_KEY_TYPE_INT).get_key(0), "abc"));
+    Populate(0, num, "_new", true);
+    EXPECT_EQ(num, Lookup(0, num, "_new"));
+    EXPECT_EQ(2*num, GetReaderStat("Number of hits"));
+
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    for(int i = 0; i < num; i += 2) {
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(tkey.get_key(i)));
+    }
+    EXPECT_EQ(num/2, Lookup(0, num, "_new"));
+    // Removed keys can be added back.
+    Populate(0, num/2, "_new", true);
+    EXPECT_EQ(num/2 + num/4, Lookup(0, num, "_new"));
+
+    std::ostringstream out;
+    db->PrintStats(out);
+    EXPECT_NE(std::string::npos, out.str().find("Ready: yes"));
+
+    EXPECT_EQ(MBError::SUCCESS, db->RemoveAll());
+    EXPECT_EQ(0, Lookup(0, num));
+    Populate(0, 100);
+    EXPECT_EQ(100, Lookup(0, num));
+}
+
+TEST_F(HashIndexTest, full_test)
+{
+    // The index is disabled when it is full. Lookups use the trie.
+    int num = 5000;
+    OpenDB(CONSTS::WriterOptions() | CONSTS::HASH_INDEX, 32*1024);
+    ASSERT_TRUE(GetHashIndex() != NULL);
+    Populate(0, num);
+    EXPECT_FALSE(GetHashIndex()->IsReady());
+    EXPECT_EQ(num, Lookup(0, 2*num));
+
+    // Rebuild does not help since the index is too small.
+    EXPECT_EQ(MBError::SUCCESS, db->GetDictPtr()->RebuildHashIndex());
+    EXPECT_FALSE(GetHashIndex()->IsReady());
+
+    // The index is rebuilt once enough keys are removed.
+    for(int i = 0; i < num - 100; i++) {
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(TestKey(MABAIN_TEST_KEY_TYPE_INT).get_key(i)));
+    }
+    EXPECT_TRUE(GetHashIndex()->IsReady());
+    EXPECT_EQ(100, Lookup(0, num));
+    EXPECT_EQ(100, GetReaderStat("Number of hits"));
+}
+
+TEST_F(HashIndexTest, churn_test)
+{
+    // Space of removed keys is reclaimed. Adding and removing keys many
+    // times the size of the index does not disable it.
+    OpenDB(CONSTS::WriterOptions() | CONSTS::HASH_INDEX, 64*1024);
+    ASSERT_TRUE(GetHashIndex() != NULL);
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    int window = 400;
+    int num = 10000;
+    for(int i = 0; i < num; i++) {
+        std::string key = tkey.get_key(i);
+        EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+        if(i >= window) {
+            EXPECT_EQ(MBError::SUCCESS, db->Remove(tkey.get_key(i - window)));
+        }
+    }
+    EXPECT_TRUE(GetHashIndex()->IsReady());
+
+    MBData mbd;
+    for(int i = 0; i < num; i++) {
+        std::string key = tkey.get_key(i);
+        if(i < num - window) {
+            EXPECT_EQ(MBError::NOT_EXIST, db_r->Find(key, mbd));
+        } else {
+            EXPECT_EQ(MBError::SUCCESS, db_r->Find(key, mbd));
+            EXPECT_EQ(key, std::string((const char *)mbd.buff, mbd.data_len));
+        }
+    }
+    EXPECT_EQ(window, GetReaderStat("Number of hits"));
+    EXPECT_EQ(0, GetReaderStat("Number of skipped keys"));
+}
+
+TEST_F(HashIndexTest, rebuild_test)
+{
+    int num = 5000;
+    OpenDB(CONSTS::WriterOptions());
+    EXPECT_TRUE(GetHashIndex() == NULL);
+    Populate(0, num);
+    CloseDB();
+
+    // The index is populated with existing keys when it is created.
+    OpenDB(CONSTS::WriterOptions() | CONSTS::HASH_INDEX);
+    ASSERT_TRUE(GetHashIndex() != NULL);
+    EXPECT_TRUE(GetHashIndex()->IsReady());
+    EXPECT_EQ(num, Lookup(0, 2*num));
+    EXPECT_EQ(num, GetReaderStat("Number of hits"));
+    CloseDB();
+
+    // Writer keeps updating the index once it exists.
+    OpenDB(CONSTS::WriterOptions());
+    ASSERT_TRUE(GetHashIndex() != NULL);
+    Populate(num, 2*num);
+    EXPECT_EQ(2*num, Lookup(0, 3*num));
+    EXPECT_EQ(2*num, GetReaderStat("Number of hits"));
+}
+
+TEST_F(HashIndexTest, collision_test)
+{
+    // Keys of the same length with the same fingerprint
+    const std::string key0("key/8asp/m4G7VmSUfOoD6V1v");
+    const std::string key1("key/8asp/l\x12\xbb\x15)ii\xd2\xe9M|\xf8" "0)\xd5r", 25);
+    ASSERT_EQ(key0.size(), key1.size());
+    ASSERT_EQ(MBHash64((const uint8_t *)key0.data(), key0.size(), HASH_INDEX_SEED),
+              MBHash64((const uint8_t *)key1.data(), key1.size(), HASH_INDEX_SEED));
+
+    OpenDB(CONSTS::WriterOptions() | CONSTS::HASH_INDEX);
+    ASSERT_TRUE(GetHashIndex() != NULL);
+    EXPECT_EQ(MBError::SUCCESS, db->Add(key0, "v0"));
+
+    // A key not in DB does not match the entry of another key.
+    MBData mbd;
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find(key1, mbd));
+    EXPECT_EQ(MBError::SUCCESS, db_r->Find(key0, mbd));
+    EXPECT_EQ("v0", std::string((const char *)mbd.buff, mbd.data_len));
+    EXPECT_EQ(1, GetReaderStat("Number of hits"));
+
+    // Both keys are looked up in the trie once they are in DB.
+    EXPECT_EQ(MBError::SUCCESS, db->Add(key1, "v1"));
+    EXPECT_EQ(MBError::SUCCESS, db_r->Find(key1, mbd));
+    EXPECT_EQ("v1", std::string((const char *)mbd.buff, mbd.data_len));
+    EXPECT_EQ(MBError::SUCCESS, db_r->Find(key0, mbd));
+    EXPECT_EQ("v0", std::string((const char *)mbd.buff, mbd.data_len));
+    EXPECT_EQ(1, GetReaderStat("Number of hits"));
+
+    EXPECT_EQ(MBError::SUCCESS, db->Remove(key0));
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find(key0, mbd));
+    EXPECT_EQ(MBError::SUCCESS, db_r->Find(key1, mbd));
+    EXPECT_EQ("v1", std::string((const char *)mbd.buff, mbd.data_len));
+
+    // The entry of the removed key is kept in the index.
+    EXPECT_EQ(MBError::SUCCESS, db->Remove(key1));
+    EXPECT_EQ(MBError::SUCCESS, db->Add(key0, "v2"));
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find(key1, mbd));
+    EXPECT_EQ(MBError::SUCCESS, db_r->Find(key0, mbd));
+    EXPECT_EQ("v2", std::string((const char *)mbd.buff, mbd.data_len));
+}
+
+}
@@ -0,0 +1,163 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../hot_node_cache.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+#define MB_DIR "/var/tmp/mabain_test/"
+
+using namespace mabain;
+
+namespace {
+
+class HotNodeCacheTest : public ::testing::Test
+{
+public:
+    HotNodeCacheTest() : db(NULL), db_r(NULL), tkey(MABAIN_TEST_KEY_TYPE_SHA_128) {
+    }
+    virtual ~HotNodeCacheTest() {
+    }
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm ") + MB_DIR + "_mabain_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        ResourcePool::getInstance().RemoveAll();
+        db = new DB(MB_DIR, CONSTS::WriterOptions());
+        ASSERT_TRUE(db->is_open());
+        db_r = new DB(MB_DIR, CONSTS::ReaderOptions() | CONSTS::HOT_NODE_CACHE);
+        ASSERT_TRUE(db_r->is_open());
+    }
+    virtual void TearDown() {
+        db_r->Close();
+        delete db_r;
+        db->Close();
+        delete db;
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void Verify(int start, int end, int expected) {
+        MBData mbd;
+        for(int i = start; i < end; i++) {
+            std::string key = tkey.get_key(i);
+            int rval = db_r->Find(key, mbd);
+            EXPECT_EQ(expected, rval);
+            if(rval == MBError::SUCCESS) {
+                EXPECT_EQ(key, std::string((const char *)mbd.buff, mbd.data_len));
+            }
+        }
+    }
+
+protected:
+    DB *db;
+    DB *db_r;
+    TestKey tkey;
+};
+
+TEST_F(HotNodeCacheTest, find_test)
+{
+    int num = 5000;
+    for(int i = 0; i < num; i++) {
+        std::string key = tkey.get_key(i);
+        EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+    }
+    Verify(0, num, MBError::SUCCESS);
+    Verify(num, num + 1000, MBError::NOT_EXIST);
+
+    // Writer updates invalidate the cache.
+    for(int i = num; i < num + 1000; i++) {
+        std::string key = tkey.get_key(i);
+        EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+    }
+    for(int i = 0; i < num; i += 2) {
+        std::string key = tkey.get_key(i);
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(key));
+    }
+    MBData mbd;
+    for(int i = 0; i < num + 1000; i++) {
+        std::string key = tkey.get_key(i);
+        int rval = db_r->Find(key, mbd);
+        if(i < num && i % 2 == 0) {
+            EXPECT_EQ(MBError::NOT_EXIST, rval);
+        } else {
+            EXPECT_EQ(MBError::SUCCESS, rval);
+        }
+    }
+}
+
+TEST_F(HotNodeCacheTest, cache_walk_test)
+{
+    int num = 2000;
+    for(int i = 0; i < num; i++) {
+        std::string key = tkey.get_key(i);
+        EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+    }
+
+    // The writer handle shares the index and lock-free data with readers.
+    Dict *dict = db->GetDictPtr();
+    HotNodeCache cache(dict->GetMM(), dict->GetLockFreePtr());
+    EXPECT_EQ(MBError::SUCCESS, cache.Build());
+    EXPECT_TRUE(cache.IsValid());
+    EXPECT_GT(cache.GetNumNode(), 1);
+
+    LockFreeData snapshot;
+    EdgePtrs edge_ptrs;
+    int match_len;
+    for(int i = 0; i < num; i++) {
+        std::string key = tkey.get_key(i);
+        dict->GetLockFreePtr()->ReaderLockFreeStart(snapshot);
+        EXPECT_EQ(MBError::SUCCESS, cache.Find(snapshot, (const uint8_t *)key.data(),
+                  key.size(), edge_ptrs, match_len));
+        // The first two levels are always consumed for these keys.
+        EXPECT_GT(match_len, 1);
+    }
+
+    std::string key = "not-exist";
+    dict->GetLockFreePtr()->ReaderLockFreeStart(snapshot);
+    EXPECT_EQ(MBError::NOT_EXIST, cache.Find(snapshot, (const uint8_t *)key.data(),
+              key.size(), edge_ptrs, match_len));
+
+    // The cache is rebuilt after writer modified the DB if it has been
+    // used for enough lookups.
+    key = tkey.get_key(num);
+    EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+    dict->GetLockFreePtr()->ReaderLockFreeStart(snapshot);
+    EXPECT_EQ(MBError::SUCCESS, cache.Find(snapshot, (const uint8_t *)key.data(),
+              key.size(), edge_ptrs, match_len));
+    EXPECT_TRUE(cache.IsValid());
+
+    // Otherwise it is not used until the rebuild interval has passed.
+    key = tkey.get_key(num + 1);
+    EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+    dict->GetLockFreePtr()->ReaderLockFreeStart(snapshot);
+    EXPECT_EQ(MBError::NOT_INITIALIZED, cache.Find(snapshot, (const uint8_t *)key.data(),
+              key.size(), edge_ptrs, match_len));
+    EXPECT_FALSE(cache.IsValid());
+}
+
+}
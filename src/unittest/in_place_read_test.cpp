@@ -0,0 +1,140 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "./test_key.h"
+
+#define MB_DIR "/var/tmp/mabain_test/"
+
+using namespace mabain;
+
+namespace {
+
+class InPlaceReadTest : public ::testing::Test
+{
+public:
+    InPlaceReadTest() : db(NULL), db_r(NULL) {
+    }
+    virtual ~InPlaceReadTest() {
+    }
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm ") + MB_DIR + "_mabain_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        ResourcePool::getInstance().RemoveAll();
+        db = new DB(MB_DIR, CONSTS::WriterOptions());
+        ASSERT_TRUE(db->is_open());
+    }
+    virtual void TearDown() {
+        if(db_r != NULL) {
+            db_r->Close();
+            delete db_r;
+        }
+        db->Close();
+        delete db;
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void OpenReader(size_t memcap) {
+        db_r = new DB(MB_DIR, CONSTS::ReaderOptions(), memcap, memcap);
+        ASSERT_TRUE(db_r->is_open());
+    }
+
+    void Populate(int num) {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        TestKey tkey1(MABAIN_TEST_KEY_TYPE_SHA_256);
+        for(int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+            key = tkey1.get_key(i);
+            EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+        }
+    }
+
+    void Verify(int num) {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+        TestKey tkey1(MABAIN_TEST_KEY_TYPE_SHA_256);
+        MBData mbd;
+        for(int i = 0; i < num; i++) {
+            std::string key = tkey.get_key(i);
+            EXPECT_EQ(MBError::SUCCESS, db_r->Find(key, mbd));
+            EXPECT_EQ(key, std::string((const char *)mbd.buff, mbd.data_len));
+            // Longest prefix match on a node
+            EXPECT_EQ(MBError::SUCCESS, db_r->FindLongestPrefix(key + "xyz", mbd));
+            EXPECT_EQ(key, std::string((const char *)mbd.buff, mbd.data_len));
+            key = tkey1.get_key(i);
+            EXPECT_EQ(MBError::SUCCESS, db_r->Find(key, mbd));
+            EXPECT_EQ(key, std::string((const char *)mbd.buff, mbd.data_len));
+
+            // Longest prefix match with long edge labels
+            EXPECT_EQ(MBError::SUCCESS, db_r->FindLongestPrefix(key + "xyz", mbd));
+            EXPECT_EQ(key, std::string((const char *)mbd.buff, mbd.data_len));
+            EXPECT_EQ(MBError::NOT_EXIST, db_r->Find(key.substr(0, 40), mbd));
+        }
+
+        int count = 0;
+        for(DB::iterator iter = db_r->begin(); iter != db_r->end(); ++iter) {
+            EXPECT_EQ(iter.key, std::string((const char *)iter.value.buff,
+                                            iter.value.data_len));
+            count++;
+        }
+        EXPECT_EQ(2*num, count);
+    }
+
+protected:
+    DB *db;
+    DB *db_r;
+};
+
+TEST_F(InPlaceReadTest, mapped_test)
+{
+    int num = 3000;
+    Populate(num);
+    OpenReader(64*1024*1024LL);
+    Verify(num);
+
+    // Edges are read in place by readers.
+    MBData mbd;
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    EXPECT_EQ(MBError::SUCCESS, db_r->Find(tkey.get_key(0), mbd));
+    EXPECT_TRUE(mbd.edge_ptrs.ptr != mbd.edge_ptrs.edge_buff);
+    // The iterator uses the edge after the lookup, so it is copied.
+    MBData mbd_parent(0, CONSTS::OPTION_FIND_AND_STORE_PARENT);
+    EXPECT_EQ(MBError::IN_DICT, db_r->Find(tkey.get_key(0), mbd_parent));
+    EXPECT_TRUE(mbd_parent.edge_ptrs.ptr == mbd_parent.edge_ptrs.edge_buff);
+}
+
+TEST_F(InPlaceReadTest, not_mapped_test)
+{
+    int num = 3000;
+    Populate(num);
+    // Reader falls back to copying where blocks are not mapped.
+    OpenReader(0);
+    Verify(num);
+}
+
+}
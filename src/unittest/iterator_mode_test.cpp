@@ -0,0 +1,132 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class IteratorModeTest : public TestDBFixture
+{
+public:
+    virtual void SetUp() {
+        TestDBFixture::SetUp();
+        OpenDB();
+    }
+
+    void AddKeys(int num) {
+        char key[64];
+        for(int i = 0; i < num; i++) {
+            snprintf(key, sizeof(key), "key-%d", (i * 7919) % 100003);
+            std::string value(i % 50 + 1, 'a' + i % 26);
+            db->Add(key, value, true);
+            kvs[key] = value;
+        }
+    }
+
+protected:
+    std::map<std::string, std::string> kvs;
+};
+
+TEST_F(IteratorModeTest, key_only_test)
+{
+    AddKeys(5000);
+    std::map<std::string, std::string> found;
+    MBData mbd;
+    for(DB::iterator iter = db_r->begin(true, false, CONSTS::OPTION_KEY_ONLY);
+        iter != db_r->end(); ++iter) {
+        EXPECT_EQ(0, iter.value.data_len);
+        EXPECT_GT(iter.value.data_offset, 0u);
+        EXPECT_EQ(MBError::SUCCESS, db_r->ReadValue(iter.value.data_offset, mbd));
+        found[iter.key] = std::string((const char *)mbd.buff, mbd.data_len);
+    }
+    EXPECT_EQ(kvs, found);
+
+    // Ordered and prefix iterators
+    std::map<std::string, std::string>::iterator it = kvs.begin();
+    for(DB::iterator iter = db_r->begin_range("", "", CONSTS::OPTION_KEY_ONLY);
+        iter != db_r->end(); ++iter) {
+        ASSERT_TRUE(it != kvs.end());
+        EXPECT_EQ(it->first, iter.key);
+        ++it;
+    }
+    EXPECT_TRUE(it == kvs.end());
+
+    int count = 0;
+    for(DB::iterator iter = db_r->begin_prefix("key-1", CONSTS::OPTION_KEY_ONLY);
+        iter != db_r->end(); ++iter) {
+        EXPECT_EQ(0, iter.key.compare(0, 5, "key-1"));
+        EXPECT_EQ(0, iter.value.data_len);
+        count++;
+    }
+    int64_t expected;
+    EXPECT_EQ(MBError::SUCCESS, db_r->CountPrefix("key-1", expected));
+    EXPECT_EQ(expected, count);
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->ReadValue(0, mbd));
+}
+
+TEST_F(IteratorModeTest, read_header_test)
+{
+    AddKeys(5000);
+    std::map<std::string, uint16_t> buckets;
+    for(DB::iterator iter = db_r->begin(); iter != db_r->end(); ++iter)
+        buckets[iter.key] = iter.value.bucket_index;
+
+    int count = 0;
+    for(DB::iterator iter = db_r->begin(true, false, CONSTS::OPTION_READ_HEADER);
+        iter != db_r->end(); ++iter) {
+        EXPECT_EQ((int) kvs[iter.key].size(), iter.value.data_len);
+        EXPECT_EQ(buckets[iter.key], iter.value.bucket_index);
+        count++;
+    }
+    EXPECT_EQ((int) kvs.size(), count);
+}
+
+TEST_F(IteratorModeTest, empty_value_test)
+{
+    AddKeys(100);
+    db->Add("empty", "", true);
+    int count = 0;
+    for(DB::iterator iter = db_r->begin(); iter != db_r->end(); ++iter)
+        count++;
+    EXPECT_EQ((int) kvs.size(), count);
+
+    // Keys with empty values are found without reading values.
+    bool found = false;
+    count = 0;
+    for(DB::iterator iter = db_r->begin(true, false, CONSTS::OPTION_KEY_ONLY);
+        iter != db_r->end(); ++iter) {
+        if(iter.key == "empty")
+            found = true;
+        count++;
+    }
+    EXPECT_TRUE(found);
+    EXPECT_EQ((int) kvs.size() + 1, count);
+}
+
+}
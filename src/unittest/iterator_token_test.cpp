@@ -0,0 +1,236 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class IteratorTokenTest : public TestDBFixture
+{
+public:
+    virtual void SetUp() {
+        TestDBFixture::SetUp();
+        OpenDB();
+    }
+
+    void AddKeys(int num) {
+        char buff[64];
+        for(int i = 0; i < num; i++) {
+            int len = snprintf(buff, sizeof(buff), "%x", (i * 7919) % 100003);
+            // Include bytes above 0x7f to check unsigned ordering.
+            if(i % 5 == 0)
+                buff[len++] = (char) 0xf0;
+            std::string key(buff, len);
+            db->Add(key, key, true);
+            keys.insert(key);
+        }
+    }
+
+protected:
+    std::set<std::string> keys;
+};
+
+// Read up to page_size keys after the token. The token is cleared when
+// the iteration is done.
+static void ReadPage(DB *db, std::string &token, int page_size,
+                     std::vector<std::string> &page)
+{
+    page.clear();
+    DB::iterator iter = db->begin_token(token);
+    for(; iter != db->end(); ++iter) {
+        page.push_back(iter.key);
+        if((int) page.size() == page_size)
+            break;
+    }
+    // The iteration is resumed after the last key of the page.
+    token.clear();
+    if(iter != db->end()) {
+        EXPECT_EQ(MBError::SUCCESS, iter.GetToken(token));
+    }
+}
+
+TEST_F(IteratorTokenTest, unordered_test)
+{
+    AddKeys(5000);
+    DB::iterator iter = db_r->begin();
+    std::string token;
+    ASSERT_EQ(MBError::SUCCESS, iter.GetToken(token));
+
+    // The first key is already read.
+    std::set<std::string> found;
+    found.insert(iter.key);
+    std::vector<std::string> page;
+    int num_pages = 0;
+    while(!token.empty()) {
+        ReadPage(db_r, token, 97, page);
+        for(size_t i = 0; i < page.size(); i++) {
+            EXPECT_TRUE(found.insert(page[i]).second) << page[i];
+        }
+        num_pages++;
+    }
+    EXPECT_EQ(keys, found);
+    EXPECT_GT(num_pages, 1);
+}
+
+TEST_F(IteratorTokenTest, prefix_test)
+{
+    AddKeys(5000);
+    std::set<std::string> found;
+    DB::iterator iter = db_r->begin_prefix("1");
+    std::string token;
+    for(int i = 0; i < 10; i++) {
+        ASSERT_TRUE(iter != db_r->end());
+        found.insert(iter.key);
+        if(i < 9)
+            ++iter;
+    }
+    ASSERT_EQ(MBError::SUCCESS, iter.GetToken(token));
+
+    std::vector<std::string> page;
+    while(!token.empty()) {
+        ReadPage(db_r, token, 33, page);
+        found.insert(page.begin(), page.end());
+    }
+
+    std::set<std::string> expected;
+    for(std::set<std::string>::iterator it = keys.begin(); it != keys.end(); ++it) {
+        if(it->compare(0, 1, "1") == 0)
+            expected.insert(*it);
+    }
+    EXPECT_EQ(expected, found);
+}
+
+TEST_F(IteratorTokenTest, ordered_test)
+{
+    AddKeys(3000);
+    DB::iterator iter = db_r->begin_range("2", "9");
+    std::string token;
+    ASSERT_EQ(MBError::SUCCESS, iter.GetToken(token));
+
+    std::vector<std::string> result;
+    result.push_back(iter.key);
+    std::vector<std::string> page;
+    while(!token.empty()) {
+        ReadPage(db_r, token, 50, page);
+        result.insert(result.end(), page.begin(), page.end());
+    }
+
+    std::vector<std::string> expected(keys.lower_bound("2"), keys.lower_bound("9"));
+    EXPECT_EQ(expected, result);
+
+    // Reverse iteration
+    iter.SeekToLast();
+    ASSERT_EQ(MBError::SUCCESS, iter.Prev());
+    ASSERT_EQ(MBError::SUCCESS, iter.GetToken(token));
+    DB::iterator iter_r = db_r->begin_token(token);
+    ASSERT_TRUE(iter_r != db_r->end());
+    EXPECT_EQ(expected[expected.size() - 3], iter_r.key);
+    EXPECT_EQ(MBError::SUCCESS, iter_r.Prev());
+    EXPECT_EQ(expected[expected.size() - 4], iter_r.key);
+}
+
+TEST_F(IteratorTokenTest, begin_after_test)
+{
+    AddKeys(3000);
+    const char *targets[] = {"", "0", "1", "1a2", "7fff", "b", "c3", "ff", "\xff"};
+    for(size_t i = 0; i < sizeof(targets)/sizeof(targets[0]); i++) {
+        std::string target = targets[i];
+        std::set<std::string>::iterator it = keys.upper_bound(target);
+        DB::iterator iter = db_r->begin_after(target);
+        if(it == keys.end()) {
+            EXPECT_FALSE(iter != db_r->end());
+        } else {
+            ASSERT_TRUE(iter != db_r->end());
+            EXPECT_EQ(*it, iter.key);
+        }
+    }
+
+    // Keys are returned after an existing key.
+    std::set<std::string>::iterator it = keys.begin();
+    std::advance(it, 100);
+    std::string target = *it;
+    ++it;
+    DB::iterator iter = db_r->begin_after(target);
+    for(int i = 0; i < 10 && iter != db_r->end(); i++, ++iter, ++it) {
+        EXPECT_EQ(*it, iter.key);
+    }
+}
+
+TEST_F(IteratorTokenTest, update_test)
+{
+    AddKeys(5000);
+    std::set<std::string> found;
+    std::set<std::string> removed;
+    std::string token;
+    DB::iterator iter = db_r->begin();
+    found.insert(iter.key);
+    ASSERT_EQ(MBError::SUCCESS, iter.GetToken(token));
+
+    std::vector<std::string> page;
+    int count = 0;
+    while(!token.empty()) {
+        ReadPage(db_r, token, 41, page);
+        for(size_t i = 0; i < page.size(); i++) {
+            EXPECT_TRUE(found.insert(page[i]).second) << page[i];
+        }
+
+        // Remove some keys and add new ones between the pages.
+        for(std::set<std::string>::iterator it = keys.begin(); it != keys.end(); ++it) {
+            if(++count % 23 == 0 && removed.size() < 1000) {
+                if(db->Remove(*it) == MBError::SUCCESS)
+                    removed.insert(*it);
+            }
+        }
+        char buff[32];
+        snprintf(buff, sizeof(buff), "new%d", count);
+        db->Add(buff, buff);
+    }
+
+    // Keys not removed are found exactly once.
+    for(std::set<std::string>::iterator it = keys.begin(); it != keys.end(); ++it) {
+        if(removed.find(*it) == removed.end()) {
+            EXPECT_TRUE(found.find(*it) != found.end()) << *it;
+        }
+    }
+}
+
+TEST_F(IteratorTokenTest, invalid_token_test)
+{
+    AddKeys(100);
+    DB::iterator iter = db_r->begin();
+    EXPECT_EQ(MBError::INVALID_ARG, iter.Resume(""));
+    EXPECT_EQ(MBError::INVALID_ARG, iter.Resume("garbage"));
+    EXPECT_FALSE(iter != db_r->end());
+
+    DB::iterator iter_end = db_r->end();
+    std::string token;
+    EXPECT_EQ(MBError::NOT_EXIST, iter_end.GetToken(token));
+}
+
+}
@@ -0,0 +1,161 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../key_filter.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_key.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class KeyFilterTest : public TestDBFixture
+{
+public:
+    void OpenDB(int opts, size_t filter_size = 1024*1024) {
+        config.options = opts;
+        config.key_filter_size = filter_size;
+        TestDBFixture::OpenDB();
+    }
+
+    void Populate(int start, int end) {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+        for(int i = start; i < end; i++) {
+            std::string key = tkey.get_key(i);
+            EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+        }
+    }
+
+    // Return the number of keys found
+    int Lookup(int start, int end) {
+        TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+        MBData mbd;
+        int found = 0;
+        for(int i = start; i < end; i++) {
+            std::string key = tkey.get_key(i);
+            int rval = db_r->Find(key, mbd);
+            if(rval == MBError::SUCCESS) {
+                EXPECT_EQ(key, std::string((const char *)mbd.buff, mbd.data_len));
+                found++;
+            } else {
+                EXPECT_EQ(MBError::NOT_EXIST, rval);
+            }
+        }
+        return found;
+    }
+
+    KeyFilter* GetKeyFilter() {
+        return db->GetDictPtr()->GetKeyFilter();
+    }
+};
+
+TEST_F(KeyFilterTest, find_test)
+{
+    OpenDB(CONSTS::WriterOptions() | CONSTS::KEY_FILTER);
+    ASSERT_TRUE(GetKeyFilter() != NULL);
+    EXPECT_TRUE(GetKeyFilter()->IsReady());
+
+    int num = 10000;
+    Populate(0, num);
+    EXPECT_EQ(num, Lookup(0, num));
+    EXPECT_EQ(0, Lookup(num, 2*num));
+
+    // Overwriting and adding existing keys do not change the filter.
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    EXPECT_EQ(MBError::IN_DICT, db->Add(tkey.get_key(0), "abc"));
+    EXPECT_EQ(MBError::SUCCESS, db->Add(tkey.get_key(1), tkey.get_key(1), true));
+    std::ostringstream out;
+    db->PrintStats(out);
+    EXPECT_NE(std::string::npos, out.str().find("Number of keys: 10000"));
+
+    for(int i = 0; i < num; i += 2) {
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(tkey.get_key(i)));
+    }
+    EXPECT_EQ(num/2, Lookup(0, num));
+
+    // Most misses are rejected by the filter.
+    std::ostringstream out_r;
+    db_r->PrintStats(out_r);
+    EXPECT_NE(std::string::npos, out_r.str().find("False positive rate"));
+    size_t pos = out_r.str().find("Number of rejected lookups: ");
+    ASSERT_NE(std::string::npos, pos);
+    int64_t num_reject = atoll(out_r.str().c_str() + pos + strlen("Number of rejected lookups: "));
+    EXPECT_GT(num_reject, 14000);
+
+    EXPECT_EQ(MBError::SUCCESS, db->RemoveAll());
+    EXPECT_EQ(0, Lookup(0, num));
+    Populate(0, 100);
+    EXPECT_EQ(100, Lookup(0, num));
+}
+
+TEST_F(KeyFilterTest, rebuild_test)
+{
+    int num = 5000;
+    OpenDB(CONSTS::WriterOptions());
+    EXPECT_TRUE(GetKeyFilter() == NULL);
+    Populate(0, num);
+    CloseDB();
+
+    // The filter is populated with existing keys when it is created.
+    OpenDB(CONSTS::WriterOptions() | CONSTS::KEY_FILTER);
+    ASSERT_TRUE(GetKeyFilter() != NULL);
+    EXPECT_TRUE(GetKeyFilter()->IsReady());
+    EXPECT_EQ(num, Lookup(0, 2*num));
+    CloseDB();
+
+    // Writer keeps updating the filter once it exists.
+    OpenDB(CONSTS::WriterOptions());
+    ASSERT_TRUE(GetKeyFilter() != NULL);
+    Populate(num, 2*num);
+    EXPECT_EQ(2*num, Lookup(0, 3*num));
+
+    EXPECT_EQ(MBError::SUCCESS, db->GetDictPtr()->RebuildKeyFilter(*db));
+    EXPECT_EQ(2*num, Lookup(0, 3*num));
+}
+
+TEST_F(KeyFilterTest, need_rebuild_test)
+{
+    int num = 20000;
+    OpenDB(CONSTS::WriterOptions() | CONSTS::KEY_FILTER, 64*1024);
+    ASSERT_TRUE(GetKeyFilter() != NULL);
+    Populate(0, num);
+    EXPECT_FALSE(GetKeyFilter()->NeedRebuild(num));
+    // Counters of most keys would be stale.
+    EXPECT_TRUE(GetKeyFilter()->NeedRebuild(num/4));
+
+    // Removed keys do not leave many stale counters. Rc does not rebuild
+    // the filter then.
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    for(int i = 0; i < num; i += 2) {
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(tkey.get_key(i)));
+    }
+    EXPECT_FALSE(GetKeyFilter()->NeedRebuild(num/2));
+    EXPECT_EQ(MBError::SUCCESS, db->CollectResource(1, 1));
+    EXPECT_EQ(num/2, Lookup(0, 2*num));
+}
+
+}
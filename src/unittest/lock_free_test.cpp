@@ -227,4 +227,19 @@ TEST_F(LockFreeTest, ReaderLockFreeStop_test_5)
     lfree.WriterLockFreeStop();
 }
 
+TEST_F(LockFreeTest, ReaderLockFreeCheck_test)
+{
+    LockFreeData snapshot;
+    lfree.ReaderLockFreeStart(snapshot);
+    EXPECT_EQ(lfree.ReaderLockFreeCheck(snapshot), MBError::SUCCESS);
+
+    lfree.WriterLockFreeStart(100);
+    EXPECT_EQ(lfree.ReaderLockFreeCheck(snapshot), MBError::TRY_AGAIN);
+    lfree.WriterLockFreeStop();
+    EXPECT_EQ(lfree.ReaderLockFreeCheck(snapshot), MBError::TRY_AGAIN);
+
+    lfree.ReaderLockFreeStart(snapshot);
+    EXPECT_EQ(lfree.ReaderLockFreeCheck(snapshot), MBError::SUCCESS);
+}
+
 }
@@ -0,0 +1,140 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mb_data.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_key.h"
+
+#define MB_DIR "/var/tmp/mabain_test/"
+
+using namespace mabain;
+
+namespace {
+
+class MultiFindTest : public ::testing::Test
+{
+public:
+    MultiFindTest() {
+        db = NULL;
+    }
+    virtual ~MultiFindTest() {
+        if(db != NULL)
+            delete db;
+    }
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + MB_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm ") + MB_DIR + "_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        db = new DB(MB_DIR, CONSTS::WriterOptions());
+    }
+    virtual void TearDown() {
+        db->Close();
+    }
+
+protected:
+    DB *db;
+};
+
+TEST_F(MultiFindTest, MultiFind_all)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_INT);
+    TestKey tkey1(MABAIN_TEST_KEY_TYPE_SHA_128);
+    int num = 2000;
+    std::string key;
+    for(int i = 0; i < num; i += 2) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+        key = tkey1.get_key(i);
+        EXPECT_EQ(MBError::SUCCESS, db->Add(key, key));
+    }
+
+    // Mix of existing keys, missing keys and prefixes of existing keys
+    std::vector<std::string> keys;
+    for(int i = 0; i < num; i++) {
+        keys.push_back(tkey.get_key(i));
+        key = tkey1.get_key(i);
+        keys.push_back(key);
+        keys.push_back(key.substr(0, 20));
+    }
+    keys.push_back("");
+
+    std::vector<MBData> results(keys.size());
+    std::vector<int> rvals(keys.size());
+    // The results are reused in the second round.
+    for(int round = 0; round < 2; round++) {
+        EXPECT_EQ(MBError::SUCCESS, db->MultiFind(keys, &results[0], &rvals[0]));
+
+        MBData mbd;
+        for(size_t i = 0; i < keys.size(); i++) {
+            if(keys[i].empty()) {
+                EXPECT_EQ(MBError::INVALID_ARG, rvals[i]);
+                continue;
+            }
+            int rval = db->Find(keys[i], mbd);
+            EXPECT_EQ(rval, rvals[i]);
+            if(rval == MBError::SUCCESS) {
+                EXPECT_EQ(keys[i], std::string((const char*)results[i].buff, results[i].data_len));
+                EXPECT_EQ((int)keys[i].size(), results[i].match_len);
+            }
+        }
+    }
+}
+
+TEST_F(MultiFindTest, MultiFind_view)
+{
+    TestKey tkey(MABAIN_TEST_KEY_TYPE_SHA_256);
+    int num = 100;
+    std::string key;
+    for(int i = 0; i < num; i++) {
+        key = tkey.get_key(i);
+        EXPECT_EQ(MBError::SUCCESS, db->Add(key, key + "_value"));
+    }
+
+    std::vector<const char*> keys(num);
+    std::vector<int> lens(num);
+    std::vector<std::string> key_strs(num);
+    std::vector<MBData> results(num);
+    std::vector<int> rvals(num);
+    for(int i = 0; i < num; i++) {
+        key_strs[i] = tkey.get_key(i);
+        keys[i] = key_strs[i].data();
+        lens[i] = key_strs[i].size();
+        results[i].options = CONSTS::OPTION_READ_VIEW;
+    }
+
+    EXPECT_EQ(MBError::SUCCESS, db->MultiFind(&keys[0], &lens[0], num, &results[0], &rvals[0]));
+    for(int i = 0; i < num; i++) {
+        EXPECT_EQ(MBError::SUCCESS, rvals[i]);
+        EXPECT_EQ(key_strs[i] + "_value",
+                  std::string((const char*)results[i].view, results[i].data_len));
+    }
+
+    EXPECT_EQ(MBError::SUCCESS, db->MultiFind(NULL, NULL, 0, NULL, NULL));
+    EXPECT_EQ(MBError::INVALID_ARG, db->MultiFind(NULL, &lens[0], num, &results[0], &rvals[0]));
+}
+
+}
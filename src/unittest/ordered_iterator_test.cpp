@@ -0,0 +1,169 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class OrderedIteratorTest : public TestDBFixture
+{
+public:
+    virtual void SetUp() {
+        TestDBFixture::SetUp();
+        OpenDB();
+    }
+
+    void AddKeys(int num) {
+        char buff[64];
+        for(int i = 0; i < num; i++) {
+            int len = snprintf(buff, sizeof(buff), "%x", (i * 7919) % 100003);
+            // Include bytes above 0x7f to check unsigned ordering.
+            if(i % 5 == 0)
+                buff[len++] = (char) 0xf0;
+            std::string key(buff, len);
+            db->Add(key, key, true);
+            keys.insert(key);
+        }
+    }
+
+protected:
+    std::set<std::string> keys;
+};
+
+TEST_F(OrderedIteratorTest, forward_test)
+{
+    AddKeys(3000);
+    DB::iterator iter = db_r->begin_range("", "");
+    std::set<std::string>::iterator it = keys.begin();
+    for(; iter != db_r->end(); ++iter) {
+        ASSERT_TRUE(it != keys.end());
+        EXPECT_EQ(*it, iter.key);
+        EXPECT_EQ(iter.key, std::string((const char *)iter.value.buff, iter.value.data_len));
+        ++it;
+    }
+    EXPECT_TRUE(it == keys.end());
+}
+
+TEST_F(OrderedIteratorTest, range_test)
+{
+    AddKeys(3000);
+    const char *bounds[][2] = {{"1", "2"}, {"a", ""}, {"", "3"}, {"4a", "4a7"},
+                               {"10", "10"}, {"ff", "g"}, {"g", "h"}};
+    for(size_t i = 0; i < sizeof(bounds)/sizeof(bounds[0]); i++) {
+        std::string lo = bounds[i][0];
+        std::string hi = bounds[i][1];
+        std::set<std::string>::iterator it = keys.lower_bound(lo);
+        std::set<std::string>::iterator it_end = hi.empty() ? keys.end() : keys.lower_bound(hi);
+        DB::iterator iter = db_r->begin_range(lo, hi);
+        for(; iter != db_r->end(); ++iter) {
+            ASSERT_TRUE(it != it_end) << lo << " " << hi << " " << iter.key;
+            EXPECT_EQ(*it, iter.key);
+            ++it;
+        }
+        EXPECT_TRUE(it == it_end) << lo << " " << hi;
+    }
+}
+
+TEST_F(OrderedIteratorTest, seek_test)
+{
+    AddKeys(3000);
+    DB::iterator iter = db_r->begin_range("", "");
+    const char *targets[] = {"", "0", "1", "1a2", "7fff", "b", "c3", "ff", "\xff"};
+    for(size_t i = 0; i < sizeof(targets)/sizeof(targets[0]); i++) {
+        std::string target = targets[i];
+        std::set<std::string>::iterator it = keys.lower_bound(target);
+        if(it == keys.end()) {
+            EXPECT_EQ(MBError::NOT_EXIST, iter.Seek(target));
+        } else {
+            EXPECT_EQ(MBError::SUCCESS, iter.Seek(target));
+            EXPECT_EQ(*it, iter.key);
+        }
+
+        it = keys.upper_bound(target);
+        if(it == keys.begin()) {
+            EXPECT_EQ(MBError::NOT_EXIST, iter.SeekForPrev(target));
+        } else {
+            --it;
+            EXPECT_EQ(MBError::SUCCESS, iter.SeekForPrev(target));
+            EXPECT_EQ(*it, iter.key);
+        }
+    }
+
+    // Seek to every existing key
+    for(std::set<std::string>::iterator it = keys.begin(); it != keys.end(); ++it) {
+        EXPECT_EQ(MBError::SUCCESS, iter.Seek(*it));
+        EXPECT_EQ(*it, iter.key);
+        EXPECT_EQ(MBError::SUCCESS, iter.SeekForPrev(*it));
+        EXPECT_EQ(*it, iter.key);
+    }
+}
+
+TEST_F(OrderedIteratorTest, next_prev_test)
+{
+    AddKeys(2000);
+    std::string lo = "2";
+    std::string hi = "9";
+    DB::iterator iter = db_r->begin_range(lo, hi);
+    std::set<std::string>::iterator it_begin = keys.lower_bound(lo);
+    std::set<std::string>::iterator it_end = keys.lower_bound(hi);
+
+    // Backward from the last key in range
+    std::set<std::string>::iterator it = it_end;
+    ASSERT_EQ(MBError::SUCCESS, iter.SeekToLast());
+    do {
+        --it;
+        EXPECT_EQ(*it, iter.key);
+    } while(iter.Prev() == MBError::SUCCESS);
+    EXPECT_TRUE(it == it_begin);
+
+    // Change direction in the middle of the range
+    ASSERT_EQ(MBError::SUCCESS, iter.SeekToFirst());
+    it = it_begin;
+    for(int i = 0; i < 100; i++) {
+        if(i % 3 == 2) {
+            ASSERT_EQ(MBError::SUCCESS, iter.Prev());
+            --it;
+        } else {
+            ASSERT_EQ(MBError::SUCCESS, iter.Next());
+            ++it;
+        }
+        EXPECT_EQ(*it, iter.key);
+    }
+    while(iter.Next() == MBError::SUCCESS) {
+        ++it;
+        EXPECT_EQ(*it, iter.key);
+    }
+    EXPECT_TRUE(++it == it_end);
+    EXPECT_FALSE(iter != db_r->end());
+
+    DB::iterator iter_unordered = db_r->begin();
+    EXPECT_EQ(MBError::NOT_ALLOWED, iter_unordered.Prev());
+}
+
+}
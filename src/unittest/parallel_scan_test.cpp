@@ -0,0 +1,139 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <pthread.h>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class ParallelScanTest : public TestDBFixture
+{
+public:
+    virtual void SetUp() {
+        TestDBFixture::SetUp();
+        OpenDB();
+    }
+
+    // Scan with num_threads and check that every key is seen exactly once
+    void Verify(int num_threads) {
+        std::vector<std::map<std::string, std::string> > seen(num_threads);
+        std::atomic<int> num_dup(0);
+        int rval = db_r->ParallelScan(num_threads,
+            [&](int worker, const std::string &key, const MBData &value) -> bool {
+                EXPECT_TRUE(worker >= 0 && worker < num_threads);
+                std::string v((const char *)value.buff, value.data_len);
+                if(!seen[worker].insert(std::make_pair(key, v)).second)
+                    num_dup++;
+                return true;
+            });
+        EXPECT_EQ(MBError::SUCCESS, rval);
+        EXPECT_EQ(0, num_dup.load());
+
+        std::map<std::string, std::string> all;
+        for(int i = 0; i < num_threads; i++) {
+            for(std::map<std::string, std::string>::iterator it = seen[i].begin();
+                it != seen[i].end(); ++it) {
+                EXPECT_TRUE(all.insert(*it).second) << it->first;
+            }
+        }
+        EXPECT_EQ(kvs, all);
+    }
+
+    void Add(const std::string &key) {
+        std::string value = "v_" + key;
+        db->Add(key, value, true);
+        kvs[key] = value;
+    }
+
+protected:
+    std::map<std::string, std::string> kvs;
+};
+
+TEST_F(ParallelScanTest, uniform_test)
+{
+    char buff[64];
+    for(int i = 0; i < 20000; i++) {
+        snprintf(buff, sizeof(buff), "%d", (i * 7919) % 1000003);
+        Add(buff);
+    }
+    Verify(1);
+    Verify(4);
+    Verify(16);
+}
+
+TEST_F(ParallelScanTest, skewed_test)
+{
+    // All keys share one long prefix except a few.
+    char buff[64];
+    for(int i = 0; i < 20000; i++) {
+        snprintf(buff, sizeof(buff), "tenant/0001/object-%d", i);
+        Add(buff);
+    }
+    Add("a");
+    Add("tenant");
+    Add("tenant/0002");
+    Verify(4);
+    Verify(8);
+}
+
+TEST_F(ParallelScanTest, stop_test)
+{
+    char buff[64];
+    for(int i = 0; i < 5000; i++) {
+        snprintf(buff, sizeof(buff), "key%d", i);
+        Add(buff);
+    }
+
+    std::atomic<int> count(0);
+    EXPECT_EQ(MBError::SUCCESS, db_r->ParallelScan(4,
+        [&](int, const std::string &, const MBData &) -> bool {
+            return ++count < 100;
+        }));
+    EXPECT_LT(count.load(), 5000);
+
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->ParallelScan(0,
+        [&](int, const std::string &, const MBData &) -> bool { return true; }));
+
+    // Scan with the writer handle
+    count = 0;
+    EXPECT_EQ(MBError::SUCCESS, db->ParallelScan(2,
+        [&](int, const std::string &, const MBData &) -> bool {
+            count++;
+            return true;
+        }));
+    EXPECT_EQ(5000, count.load());
+}
+
+TEST_F(ParallelScanTest, empty_test)
+{
+    Verify(4);
+}
+
+}
@@ -0,0 +1,128 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class PrefixIteratorTest : public TestDBFixture
+{
+public:
+    virtual void SetUp() {
+        TestDBFixture::SetUp();
+        OpenDB();
+    }
+
+    void Verify(const std::string &prefix) {
+        std::set<std::string> expected;
+        for(DB::iterator iter = db_r->begin(); iter != db_r->end(); ++iter) {
+            if(iter.key.compare(0, prefix.size(), prefix) == 0)
+                expected.insert(iter.key);
+        }
+
+        std::set<std::string> keys;
+        for(DB::iterator iter = db_r->begin_prefix(prefix); iter != db_r->end(); ++iter) {
+            EXPECT_EQ(0, iter.key.compare(0, prefix.size(), prefix)) << iter.key;
+            EXPECT_EQ(iter.key, std::string((const char *)iter.value.buff,
+                                             iter.value.data_len));
+            EXPECT_TRUE(keys.insert(iter.key).second) << iter.key;
+        }
+        EXPECT_EQ(expected, keys) << prefix;
+
+        int64_t count;
+        EXPECT_EQ(expected.empty() ? MBError::NOT_EXIST : MBError::SUCCESS,
+                  db_r->CountPrefix(prefix, count));
+        EXPECT_EQ((int64_t) expected.size(), count) << prefix;
+    }
+};
+
+TEST_F(PrefixIteratorTest, tenant_test)
+{
+    char buff[64];
+    for(int i = 0; i < 50; i++) {
+        for(int j = 0; j < i * 3; j++) {
+            snprintf(buff, sizeof(buff), "tenant%d/obj%d", i, j);
+            db->Add(buff, buff, true);
+        }
+    }
+    db->Add("tenant", "tenant", true);
+    db->Add("tenant42/", "tenant42/", true);
+    db->Add("other", "other", true);
+
+    Verify("tenant42/");
+    Verify("tenant42");
+    Verify("tenant4");
+    Verify("tenant");
+    Verify("tena");
+    Verify("t");
+    Verify("tenant42/obj1");
+    Verify("tenant42/obj100");
+    Verify("tenant1/obj2");
+    Verify("other");
+    Verify("oth");
+    Verify("otherx");
+    Verify("tenant99");
+    Verify("x");
+
+    int64_t count;
+    EXPECT_EQ(MBError::SUCCESS, db_r->CountPrefix("", count));
+    EXPECT_EQ(db_r->Count(), count);
+    EXPECT_EQ(MBError::INVALID_ARG, db_r->CountPrefix(NULL, 1, count));
+    DB::iterator iter = db_r->begin_prefix("tenant99");
+    EXPECT_FALSE(iter != db_r->end());
+
+    int num = 0;
+    for(DB::iterator it = db_r->begin_prefix(""); it != db_r->end(); ++it)
+        num++;
+    EXPECT_EQ(db_r->Count(), num);
+}
+
+TEST_F(PrefixIteratorTest, remove_test)
+{
+    char buff[64];
+    for(int i = 0; i < 2000; i++) {
+        snprintf(buff, sizeof(buff), "%d.%d.%d", i % 7, i % 13, i);
+        db->Add(buff, buff, true);
+    }
+    Verify("3.");
+    Verify("3.5");
+    Verify("3.5.");
+
+    for(int i = 0; i < 2000; i += 3) {
+        snprintf(buff, sizeof(buff), "%d.%d.%d", i % 7, i % 13, i);
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(buff));
+    }
+    EXPECT_EQ(MBError::SUCCESS, db->CollectResource(0, 0));
+    Verify("3.");
+    Verify("3.5");
+    Verify("3.5.");
+    Verify("6.12.");
+}
+
+}
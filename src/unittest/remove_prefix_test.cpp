@@ -0,0 +1,182 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class RemovePrefixTest : public TestDBFixture
+{
+public:
+    void OpenDB(size_t filter_size = 0, size_t hash_index_size = 0, int options = 0) {
+        config.options |= options;
+        config.key_filter_size = filter_size;
+        config.hash_index_size = hash_index_size;
+        TestDBFixture::OpenDB();
+    }
+
+    // Keys of several tenants. Some keys are prefixes of other keys.
+    void AddKeys(int num_tenants, int num_keys) {
+        char buff[64];
+        for(int t = 0; t < num_tenants; t++) {
+            for(int i = 0; i < num_keys; i++) {
+                snprintf(buff, sizeof(buff), "tenant%d/%d", t, i * 13);
+                EXPECT_EQ(MBError::SUCCESS, db->Add(buff, buff));
+                keys.insert(buff);
+            }
+        }
+    }
+
+    // Check the keys in DB are the keys in the set.
+    void CheckKeys() {
+        MBData mbd;
+        for(std::set<std::string>::iterator it = keys.begin(); it != keys.end(); ++it) {
+            ASSERT_EQ(MBError::SUCCESS, db_r->Find(*it, mbd)) << *it;
+            EXPECT_EQ(*it, std::string((const char *)mbd.buff, mbd.data_len));
+        }
+        EXPECT_EQ((int64_t) keys.size(), db->Count());
+
+        std::set<std::string> found;
+        for(DB::iterator iter = db_r->begin(); iter != db_r->end(); ++iter) {
+            found.insert(iter.key);
+        }
+        EXPECT_EQ(keys, found);
+    }
+
+    void RemoveFromSet(const std::string &prefix) {
+        std::set<std::string>::iterator it = keys.lower_bound(prefix);
+        while(it != keys.end() && it->compare(0, prefix.size(), prefix) == 0)
+            keys.erase(it++);
+    }
+
+protected:
+    std::set<std::string> keys;
+};
+
+TEST_F(RemovePrefixTest, remove_test)
+{
+    OpenDB();
+    AddKeys(10, 500);
+    const char *prefixes[] = {"tenant3/", "tenant5/1", "tenant7/26", "tenant1", "tenant9/0"};
+    for(size_t i = 0; i < sizeof(prefixes)/sizeof(prefixes[0]); i++) {
+        EXPECT_EQ(MBError::SUCCESS, db->RemovePrefix(prefixes[i])) << prefixes[i];
+        RemoveFromSet(prefixes[i]);
+        CheckKeys();
+
+        int64_t count;
+        EXPECT_EQ(MBError::NOT_EXIST, db_r->CountPrefix(prefixes[i], count));
+        EXPECT_EQ(MBError::NOT_EXIST, db->RemovePrefix(prefixes[i]));
+    }
+
+    EXPECT_EQ(MBError::NOT_EXIST, db->RemovePrefix("tenant99"));
+    EXPECT_EQ(MBError::NOT_EXIST, db->RemovePrefix("x"));
+    EXPECT_EQ(MBError::INVALID_ARG, db->RemovePrefix(""));
+    EXPECT_EQ(MBError::NOT_ALLOWED, db_r->RemovePrefix("tenant2"));
+    CheckKeys();
+}
+
+TEST_F(RemovePrefixTest, reuse_test)
+{
+    OpenDB();
+    AddKeys(4, 2000);
+    std::set<std::string> all_keys = keys;
+    for(int round = 0; round < 3; round++) {
+        EXPECT_EQ(MBError::SUCCESS, db->RemovePrefix("tenant2"));
+        EXPECT_EQ(MBError::SUCCESS, db->RemovePrefix("tenant0/1"));
+        RemoveFromSet("tenant2");
+        RemoveFromSet("tenant0/1");
+        CheckKeys();
+
+        // The released buffers are reused.
+        for(std::set<std::string>::iterator it = all_keys.begin(); it != all_keys.end(); ++it) {
+            if(keys.find(*it) == keys.end()) {
+                EXPECT_EQ(MBError::SUCCESS, db->Add(*it, *it));
+                keys.insert(*it);
+            }
+        }
+        CheckKeys();
+    }
+}
+
+TEST_F(RemovePrefixTest, remove_all_test)
+{
+    OpenDB();
+    AddKeys(3, 100);
+    EXPECT_EQ(MBError::SUCCESS, db->RemovePrefix("t"));
+    keys.clear();
+    CheckKeys();
+
+    AddKeys(3, 100);
+    CheckKeys();
+}
+
+TEST_F(RemovePrefixTest, index_test)
+{
+    OpenDB(1024*1024, 1024*1024);
+    AddKeys(5, 400);
+    EXPECT_EQ(MBError::SUCCESS, db->RemovePrefix("tenant4/"));
+    EXPECT_EQ(MBError::SUCCESS, db->RemovePrefix("tenant0/5"));
+    MBData mbd;
+    char buff[64];
+    for(int i = 0; i < 400; i++) {
+        snprintf(buff, sizeof(buff), "tenant4/%d", i * 13);
+        EXPECT_EQ(MBError::NOT_EXIST, db_r->Find(buff, mbd)) << buff;
+    }
+    RemoveFromSet("tenant4/");
+    RemoveFromSet("tenant0/5");
+    CheckKeys();
+}
+
+TEST_F(RemovePrefixTest, async_rc_test)
+{
+    // A prefix removal queued while rc is running is applied after rc.
+    OpenDB(0, 0, CONSTS::ASYNC_WRITER_MODE);
+    ASSERT_EQ(MBError::SUCCESS, db_r->SetAsyncWriterPtr(db));
+    char buff[64];
+    for(int i = 0; i < 20000; i++) {
+        snprintf(buff, sizeof(buff), "tenant%d/%d", i % 4, i);
+        EXPECT_EQ(MBError::SUCCESS, db_r->Add(buff, buff));
+        keys.insert(buff);
+    }
+    for(int i = 1; i < 20000; i += 2) {
+        snprintf(buff, sizeof(buff), "tenant%d/%d", i % 4, i);
+        EXPECT_EQ(MBError::SUCCESS, db_r->Remove(buff));
+        keys.erase(buff);
+    }
+    EXPECT_EQ(MBError::SUCCESS, db_r->CollectResource(1, 1));
+    EXPECT_EQ(MBError::SUCCESS, db_r->RemovePrefix("tenant2/"));
+    RemoveFromSet("tenant2/");
+    while(db_r->AsyncWriterBusy())
+        usleep(100);
+    EXPECT_EQ(MBError::SUCCESS, db_r->UnsetAsyncWriterPtr(db));
+    CheckKeys();
+}
+
+}
@@ -0,0 +1,338 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "../shm_queue.h"
+
+#define DB_DIR "/var/tmp/mabain_test/"
+#define NUM_PROC           4
+#define NUM_KEY_PER_PROC   500
+
+using namespace mabain;
+
+namespace {
+
+// Values larger than a slot go to blocks.
+static int value_size(int i)
+{
+    static const int sizes[] = { 1, 100, 231, 232, 1000, 8000, 30000 };
+    return sizes[i % 7];
+}
+
+static std::string make_key(int proc_id, int i)
+{
+    char buff[64];
+    snprintf(buff, sizeof(buff), "shmq/%d/%d", proc_id, i);
+    return buff;
+}
+
+static std::string make_value(int i)
+{
+    return std::string(value_size(i), 'a' + i % 26);
+}
+
+// Runs in a child process; the exit code tells the number of failures.
+static int run_producer(int proc_id, bool remove)
+{
+    DB db_r(DB_DIR, CONSTS::ReaderOptions() | CONSTS::SHM_ASYNC_QUEUE);
+    if(!db_r.is_open())
+        return 1;
+
+    int failed = 0;
+    for(int i = 0; i < NUM_KEY_PER_PROC; i++)
+    {
+        std::string key = make_key(proc_id, i);
+        if(db_r.Add(key, make_value(i)) != MBError::SUCCESS)
+            failed++;
+        if(remove && i % 3 == 0 && db_r.Remove(key) != MBError::SUCCESS)
+            failed++;
+    }
+    db_r.Close();
+    return failed > 0 ? 2 : 0;
+}
+
+class ShmQueueTest : public ::testing::Test
+{
+public:
+    ShmQueueTest() : db(NULL) {
+    }
+    virtual ~ShmQueueTest() {
+    }
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + DB_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm ") + DB_DIR + "_mabain_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        ResourcePool::getInstance().RemoveAll();
+    }
+    virtual void TearDown() {
+        CloseDB();
+        ResourcePool::getInstance().RemoveAll();
+    }
+
+    void OpenDB(int queue_size) {
+        MBConfig config;
+        memset(&config, 0, sizeof(config));
+        config.mbdir = DB_DIR;
+        config.options = CONSTS::WriterOptions() | CONSTS::ASYNC_WRITER_MODE |
+                         CONSTS::SHM_ASYNC_QUEUE;
+        config.memcap_index = 64*1024*1024LL;
+        config.memcap_data = 64*1024*1024LL;
+        config.async_queue_size = queue_size;
+        db = new DB(config);
+    }
+
+    void CloseDB() {
+        if(db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+    }
+
+    void WaitForWriter() {
+        for(int i = 0; i < 100000 && db->AsyncWriterBusy(); i++)
+            usleep(100);
+        EXPECT_FALSE(db->AsyncWriterBusy());
+    }
+
+    void RunProducers(bool remove) {
+        pid_t pids[NUM_PROC];
+        for(int i = 0; i < NUM_PROC; i++) {
+            pids[i] = fork();
+            ASSERT_GE(pids[i], 0);
+            if(pids[i] == 0)
+                _exit(run_producer(i, remove));
+        }
+        for(int i = 0; i < NUM_PROC; i++) {
+            int status;
+            ASSERT_EQ(pids[i], waitpid(pids[i], &status, 0));
+            EXPECT_TRUE(WIFEXITED(status));
+            EXPECT_EQ(0, WEXITSTATUS(status));
+        }
+        WaitForWriter();
+    }
+
+    void CheckKeys(bool remove) {
+        DB db_r(DB_DIR, CONSTS::ReaderOptions());
+        ASSERT_TRUE(db_r.is_open());
+        MBData mbd;
+        int64_t count = 0;
+        for(int p = 0; p < NUM_PROC; p++) {
+            for(int i = 0; i < NUM_KEY_PER_PROC; i++) {
+                std::string key = make_key(p, i);
+                if(remove && i % 3 == 0) {
+                    EXPECT_EQ(MBError::NOT_EXIST, db_r.Find(key, mbd)) << key;
+                    continue;
+                }
+                ASSERT_EQ(MBError::SUCCESS, db_r.Find(key, mbd)) << key;
+                EXPECT_EQ(make_value(i), std::string((const char *)mbd.buff, mbd.data_len));
+                count++;
+            }
+        }
+        EXPECT_EQ(count, db->Count());
+        db_r.Close();
+    }
+
+    // Map the queue file to simulate a producer dying in the middle.
+    ShmQueueHeader* MapQueue(size_t &size) {
+        std::string fpath = std::string(DB_DIR) + "_mabain_q";
+        int fd = open(fpath.c_str(), O_RDWR);
+        if(fd < 0)
+            return NULL;
+        struct stat st;
+        fstat(fd, &st);
+        size = st.st_size;
+        void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        return addr == MAP_FAILED ? NULL : static_cast<ShmQueueHeader *>(addr);
+    }
+
+protected:
+    DB *db;
+};
+
+TEST_F(ShmQueueTest, multi_process_add_test)
+{
+    OpenDB(0);
+    ASSERT_TRUE(db->is_open());
+    RunProducers(false);
+    CheckKeys(false);
+}
+
+TEST_F(ShmQueueTest, small_queue_test)
+{
+    // Producers keep waiting for free slots and blocks.
+    OpenDB(16);
+    ASSERT_TRUE(db->is_open());
+    RunProducers(true);
+    CheckKeys(true);
+}
+
+TEST_F(ShmQueueTest, pending_task_test)
+{
+    OpenDB(16);
+    ASSERT_TRUE(db->is_open());
+    CloseDB();
+
+    // Tasks are kept in the queue until a writer starts. Values fit in
+    // slots since there are only four blocks.
+    DB db_r(DB_DIR, CONSTS::ReaderOptions() | CONSTS::SHM_ASYNC_QUEUE);
+    ASSERT_TRUE(db_r.is_open());
+    for(int i = 0; i < 16; i++)
+        EXPECT_EQ(MBError::SUCCESS, db_r.Add(make_key(0, i), make_value(i % 2)));
+    EXPECT_TRUE(db_r.AsyncWriterBusy());
+    EXPECT_EQ(MBError::TRY_AGAIN, db_r.Add(make_key(0, 16), make_value(16 % 2)));
+
+    OpenDB(16);
+    ASSERT_TRUE(db->is_open());
+    WaitForWriter();
+    EXPECT_EQ(MBError::SUCCESS, db_r.Add(make_key(0, 16), make_value(16 % 2)));
+    WaitForWriter();
+
+    MBData mbd;
+    for(int i = 0; i <= 16; i++) {
+        ASSERT_EQ(MBError::SUCCESS, db_r.Find(make_key(0, i), mbd));
+        EXPECT_EQ(make_value(i % 2), std::string((const char *)mbd.buff, mbd.data_len));
+    }
+    EXPECT_EQ(17, db->Count());
+    db_r.Close();
+}
+
+TEST_F(ShmQueueTest, dead_producer_test)
+{
+    OpenDB(16);
+    ASSERT_TRUE(db->is_open());
+    CloseDB();
+
+    pid_t dead_pid = fork();
+    ASSERT_GE(dead_pid, 0);
+    if(dead_pid == 0)
+        _exit(0);
+    ASSERT_EQ(dead_pid, waitpid(dead_pid, NULL, 0));
+
+    // The dead producer claimed the first slot and a block.
+    size_t size = 0;
+    ShmQueueHeader *header = MapQueue(size);
+    ASSERT_TRUE(header != NULL);
+    ShmQueueSlot *slots = reinterpret_cast<ShmQueueSlot *>(
+                              reinterpret_cast<char *>(header) + SHM_QUEUE_HEADER_SIZE);
+    std::atomic<uint64_t> *block_owners = reinterpret_cast<std::atomic<uint64_t> *>(
+                              slots + header->queue_size);
+    uint64_t index = header->queue_index.load();
+    slots[index & (header->queue_size - 1)].state.store(
+        (static_cast<uint64_t>(dead_pid) << 32) | index);
+    header->queue_index.store(index + 1);
+    block_owners[0].store(SHM_QUEUE_BLOCK_PRODUCER | static_cast<uint64_t>(dead_pid));
+
+    DB db_r(DB_DIR, CONSTS::ReaderOptions() | CONSTS::SHM_ASYNC_QUEUE);
+    ASSERT_TRUE(db_r.is_open());
+    EXPECT_EQ(MBError::SUCCESS, db_r.Add(make_key(0, 0), make_value(5)));
+    EXPECT_TRUE(db_r.AsyncWriterBusy());
+
+    OpenDB(16);
+    ASSERT_TRUE(db->is_open());
+    WaitForWriter();
+    MBData mbd;
+    ASSERT_EQ(MBError::SUCCESS, db_r.Find(make_key(0, 0), mbd));
+    EXPECT_EQ(make_value(5), std::string((const char *)mbd.buff, mbd.data_len));
+    EXPECT_EQ(1, db->Count());
+
+    // The block is released when the writer times out waiting.
+    for(int i = 0; i < 100 && block_owners[0].load() != 0; i++)
+        usleep(10000);
+    EXPECT_EQ(0ULL, block_owners[0].load());
+
+    db_r.Close();
+    munmap(header, size);
+}
+
+TEST_F(ShmQueueTest, seq_test)
+{
+    OpenDB(16);
+    ASSERT_TRUE(db->is_open());
+
+    DB db_r(DB_DIR, CONSTS::ReaderOptions() | CONSTS::SHM_ASYNC_QUEUE);
+    ASSERT_TRUE(db_r.is_open());
+    MBData mbd;
+    uint64_t last_seq = 0;
+    uint64_t seq;
+    for(int i = 0; i < 100; i++) {
+        std::string key = make_key(0, i);
+        std::string value = make_value(i);
+        ASSERT_EQ(MBError::SUCCESS, db_r.AddAsync(key.data(), key.size(), value.data(),
+                                                  value.size(), false, seq));
+        EXPECT_GT(seq, last_seq);
+        last_seq = seq;
+        // Read the add back as soon as it is done.
+        ASSERT_EQ(MBError::SUCCESS, db_r.WaitForAsync(seq, 10000));
+        ASSERT_EQ(MBError::SUCCESS, db_r.Find(key, mbd));
+        EXPECT_EQ(value, std::string((const char *)mbd.buff, mbd.data_len));
+    }
+    std::string key = make_key(0, 0);
+    ASSERT_EQ(MBError::SUCCESS, db_r.RemoveAsync(key.data(), key.size(), seq));
+    ASSERT_EQ(MBError::SUCCESS, db_r.WaitForAsync(seq));
+    EXPECT_EQ(MBError::NOT_EXIST, db_r.Find(key, mbd));
+
+    // Callbacks cannot be run by the writer process.
+    EXPECT_EQ(MBError::NOT_ALLOWED, db_r.RemoveAsync(key.data(), key.size(), seq,
+                                                     [](uint64_t, int) {}));
+    EXPECT_EQ(MBError::INVALID_ARG, db_r.WaitForAsync(seq + 100, 0));
+
+    // Nothing runs the task without writer.
+    CloseDB();
+    key = make_key(0, 1);
+    ASSERT_EQ(MBError::SUCCESS, db_r.RemoveAsync(key.data(), key.size(), seq));
+    EXPECT_EQ(MBError::TRY_AGAIN, db_r.WaitForAsync(seq, 10));
+    EXPECT_EQ(MBError::TRY_AGAIN, db_r.WaitForAsync(seq));
+    db_r.Close();
+}
+
+TEST_F(ShmQueueTest, no_queue_test)
+{
+    // Readers fall back to the normal mode if there is no queue.
+    OpenDB(0);
+    ASSERT_TRUE(db->is_open());
+    CloseDB();
+    std::string cmd = std::string("rm ") + DB_DIR + "_mabain_q";
+    ResourcePool::getInstance().RemoveAll();
+    ASSERT_EQ(0, system(cmd.c_str()));
+
+    DB db_r(DB_DIR, CONSTS::ReaderOptions() | CONSTS::SHM_ASYNC_QUEUE);
+    ASSERT_TRUE(db_r.is_open());
+    EXPECT_FALSE(db_r.AsyncWriterBusy());
+    EXPECT_EQ(MBError::NOT_ALLOWED, db_r.Add(make_key(0, 0), make_value(0)));
+    db_r.Close();
+}
+
+}
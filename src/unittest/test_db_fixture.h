@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TEST_DB_FIXTURE_H__
+#define __TEST_DB_FIXTURE_H__
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../resource_pool.h"
+
+#define DB_DIR "/var/tmp/mabain_test/"
+
+namespace {
+
+// Fixture for tests using a writer and a reader handle on an empty DB in
+// DB_DIR. Tests may change config before calling OpenDB.
+class TestDBFixture : public ::testing::Test
+{
+public:
+    TestDBFixture() : db(NULL), db_r(NULL) {
+    }
+    virtual ~TestDBFixture() {
+    }
+    virtual void SetUp() {
+        std::string cmd = std::string("mkdir -p ") + DB_DIR;
+        if(system(cmd.c_str()) != 0) {
+        }
+        cmd = std::string("rm ") + DB_DIR + "_mabain_*";
+        if(system(cmd.c_str()) != 0) {
+        }
+        mabain::ResourcePool::getInstance().RemoveAll();
+
+        memset(&config, 0, sizeof(config));
+        config.mbdir = DB_DIR;
+        config.options = mabain::CONSTS::WriterOptions();
+        config.memcap_index = 64*1024*1024LL;
+        config.memcap_data = 64*1024*1024LL;
+    }
+    virtual void TearDown() {
+        CloseDB();
+        mabain::ResourcePool::getInstance().RemoveAll();
+    }
+
+    void OpenDB() {
+        db = new mabain::DB(config);
+        ASSERT_TRUE(db->is_open());
+        db_r = new mabain::DB(DB_DIR, mabain::CONSTS::ReaderOptions(),
+                              config.memcap_index, config.memcap_data);
+        ASSERT_TRUE(db_r->is_open());
+    }
+
+    void CloseDB() {
+        if(db_r != NULL) {
+            if(db_r->AsyncWriterEnabled())
+                db_r->UnsetAsyncWriterPtr(db);
+            db_r->Close();
+            delete db_r;
+            db_r = NULL;
+        }
+        if(db != NULL) {
+            db->Close();
+            delete db;
+            db = NULL;
+        }
+    }
+
+protected:
+    mabain::MBConfig config;
+    mabain::DB *db;
+    mabain::DB *db_r;
+};
+
+}
+
+#endif
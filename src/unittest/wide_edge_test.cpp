@@ -0,0 +1,168 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../dict.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "../resource_pool.h"
+#include "./test_db_fixture.h"
+#include "./test_key.h"
+
+using namespace mabain;
+
+namespace {
+
+class WideEdgeTest : public TestDBFixture
+{
+public:
+    // Reopen the DB with the writer options.
+    void OpenDB(int opts) {
+        CloseDB();
+        config.options = opts;
+        config.memcap_index = 128ULL*1024*1024;
+        config.memcap_data = 128ULL*1024*1024;
+        TestDBFixture::OpenDB();
+    }
+
+    // Keys sharing prefixes of various lengths so that edge labels are
+    // inline, split between the two parts of the wide edge, or out of line.
+    std::string GetKey(int i) {
+        char buff[128];
+        switch(i % 3) {
+            case 0:
+                snprintf(buff, sizeof(buff), "http://www.site%d.example.com/dir%d/item%d",
+                         i % 50, i % 7, i);
+                return std::string(buff);
+            case 1:
+                return TestKey(MABAIN_TEST_KEY_TYPE_SHA_256).get_key(i);
+            default:
+                return TestKey(MABAIN_TEST_KEY_TYPE_INT).get_key(i);
+        }
+    }
+
+    void Populate(int num, const std::string &suffix = "", bool overwrite = false) {
+        for(int i = 0; i < num; i++) {
+            std::string key = GetKey(i);
+            EXPECT_EQ(MBError::SUCCESS, db->Add(key, key + suffix, overwrite));
+        }
+    }
+
+    void Verify(DB *dbh, int num, int step_removed, const std::string &suffix = "") {
+        MBData mbd;
+        for(int i = 0; i < num; i++) {
+            std::string key = GetKey(i);
+            int rval = dbh->Find(key, mbd);
+            if(step_removed > 0 && i % step_removed == 0) {
+                EXPECT_EQ(MBError::NOT_EXIST, rval);
+            } else {
+                EXPECT_EQ(MBError::SUCCESS, rval);
+                EXPECT_EQ(key + suffix, std::string((const char *)mbd.buff, mbd.data_len));
+            }
+        }
+    }
+
+    int IndexFormat() {
+        return db->GetDictPtr()->GetHeaderPtr()->version[3];
+    }
+};
+
+TEST_F(WideEdgeTest, add_find_remove_test)
+{
+    OpenDB(CONSTS::WriterOptions() | CONSTS::WIDE_EDGE);
+    EXPECT_EQ(INDEX_FORMAT_WIDE_EDGE, IndexFormat());
+    EXPECT_EQ(WIDE_EDGE_SIZE, db->GetDictPtr()->GetMM()->GetEdgeSize());
+
+    int num = 6000;
+    Populate(num);
+    Verify(db, num, 0);
+    Verify(db_r, num, 0);
+    EXPECT_EQ(num, db->Count());
+
+    MBData mbd;
+    std::string key = GetKey(3) + "/more";
+    EXPECT_EQ(MBError::SUCCESS, db_r->FindLongestPrefix(key, mbd));
+    EXPECT_EQ(GetKey(3), std::string((const char *)mbd.buff, mbd.data_len));
+    key = GetKey(3);
+    key.resize(key.size() - 1);
+    EXPECT_EQ(MBError::NOT_EXIST, db_r->Find(key, mbd));
+
+    Populate(num, "_new", true);
+    Verify(db_r, num, 0, "_new");
+
+    for(int i = 0; i < num; i += 4) {
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(GetKey(i)));
+    }
+    Verify(db_r, num, 4, "_new");
+
+    int count = 0;
+    for(DB::iterator iter = db_r->begin(); iter != db_r->end(); ++iter) {
+        EXPECT_EQ(iter.key + "_new", std::string((const char *)iter.value.buff,
+                                                 iter.value.data_len));
+        count++;
+    }
+    EXPECT_EQ(db->Count(), count);
+
+    // Removed keys can be added back.
+    Populate(num, "_new", true);
+    Verify(db_r, num, 0, "_new");
+}
+
+TEST_F(WideEdgeTest, reopen_collect_test)
+{
+    OpenDB(CONSTS::WriterOptions() | CONSTS::WIDE_EDGE | CONSTS::ADAPTIVE_NODE_FORMAT);
+    EXPECT_EQ(INDEX_FORMAT_WIDE_EDGE | INDEX_FORMAT_ADAPTIVE, IndexFormat());
+
+    int num = 5000;
+    Populate(num);
+    for(int i = 0; i < num; i += 3) {
+        EXPECT_EQ(MBError::SUCCESS, db->Remove(GetKey(i)));
+    }
+    EXPECT_EQ(MBError::SUCCESS, db->CollectResource(0, 0));
+    Verify(db, num, 3);
+    Verify(db_r, num, 3);
+
+    // The edge format is kept after reopening the DB and after migrating
+    // the node format.
+    OpenDB(CONSTS::WriterOptions());
+    EXPECT_EQ(INDEX_FORMAT_WIDE_EDGE | INDEX_FORMAT_ADAPTIVE, IndexFormat());
+    Verify(db_r, num, 3);
+    EXPECT_EQ(MBError::SUCCESS, db->MigrateIndexFormat(false));
+    EXPECT_EQ(INDEX_FORMAT_WIDE_EDGE, IndexFormat());
+    Verify(db_r, num, 3);
+    Populate(num, "", true);
+    Verify(db_r, num, 0);
+
+    // Existing DB is not converted to the wide edge format.
+    CloseDB();
+    ResourcePool::getInstance().RemoveAll();
+    std::string cmd = std::string("rm ") + DB_DIR + "_mabain_*";
+    if(system(cmd.c_str()) != 0) {
+    }
+    OpenDB(CONSTS::WriterOptions());
+    Populate(100);
+    OpenDB(CONSTS::WriterOptions() | CONSTS::WIDE_EDGE);
+    EXPECT_EQ(0, IndexFormat());
+    Verify(db_r, 100, 0);
+}
+
+}
@@ -0,0 +1,241 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "../db.h"
+#include "../mabain_consts.h"
+#include "../error.h"
+#include "./test_db_fixture.h"
+
+using namespace mabain;
+
+namespace {
+
+class WriteBatchTest : public TestDBFixture
+{
+public:
+    void OpenDB(int options = 0) {
+        config.options |= options;
+        TestDBFixture::OpenDB();
+    }
+
+    // Shuffled keys sharing prefixes of different lengths
+    void MakeKeys(int num, std::vector<std::string> &keys) {
+        char buff[64];
+        for(int i = 0; i < num; i++) {
+            snprintf(buff, sizeof(buff), "user/%d/item/%d", i % 37, i);
+            keys.push_back(buff);
+        }
+        std::srand(1);
+        std::random_shuffle(keys.begin(), keys.end());
+    }
+
+    // Check the keys in DB are the keys in the map.
+    void CheckKeys() {
+        MBData mbd;
+        for(std::map<std::string, std::string>::iterator it = kvs.begin();
+            it != kvs.end(); ++it) {
+            ASSERT_EQ(MBError::SUCCESS, db_r->Find(it->first, mbd)) << it->first;
+            EXPECT_EQ(it->second, std::string((const char *)mbd.buff, mbd.data_len));
+        }
+        EXPECT_EQ((int64_t) kvs.size(), db->Count());
+
+        int64_t count = 0;
+        for(DB::iterator iter = db_r->begin(); iter != db_r->end(); ++iter) {
+            EXPECT_TRUE(kvs.find(iter.key) != kvs.end()) << iter.key;
+            count++;
+        }
+        EXPECT_EQ((int64_t) kvs.size(), count);
+    }
+
+protected:
+    std::map<std::string, std::string> kvs;
+};
+
+TEST_F(WriteBatchTest, add_test)
+{
+    OpenDB();
+    std::vector<std::string> keys;
+    MakeKeys(10000, keys);
+
+    WriteBatch batch;
+    for(size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(MBError::SUCCESS, batch.Add(keys[i], keys[i] + "_v"));
+        kvs[keys[i]] = keys[i] + "_v";
+    }
+    EXPECT_EQ((int) keys.size(), batch.Count());
+    EXPECT_EQ(MBError::SUCCESS, db->Write(batch));
+    CheckKeys();
+
+    // Entries are sorted by key after the batch is applied.
+    for(int i = 1; i < batch.Count(); i++) {
+        const WriteBatchEntry &prev = batch.GetEntry(i - 1);
+        const WriteBatchEntry &curr = batch.GetEntry(i);
+        std::string k0((const char *)batch.GetKey(prev), prev.key_len);
+        std::string k1((const char *)batch.GetKey(curr), curr.key_len);
+        EXPECT_LE(k0, k1);
+    }
+
+    batch.Clear();
+    EXPECT_EQ(0, batch.Count());
+    EXPECT_EQ(MBError::SUCCESS, db->Write(batch));
+    CheckKeys();
+}
+
+TEST_F(WriteBatchTest, mixed_test)
+{
+    OpenDB();
+    std::vector<std::string> keys;
+    MakeKeys(2000, keys);
+    for(size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(MBError::SUCCESS, db->Add(keys[i], keys[i]));
+        kvs[keys[i]] = keys[i];
+    }
+
+    WriteBatch batch;
+    for(size_t i = 0; i < keys.size(); i++) {
+        if(i % 3 == 0) {
+            batch.Remove(keys[i]);
+            kvs.erase(keys[i]);
+        } else if(i % 3 == 1) {
+            batch.Add(keys[i], "new", true);
+            kvs[keys[i]] = "new";
+        }
+    }
+    // Updates of the same key are applied in order.
+    batch.Add("user/x", "1");
+    batch.Remove("user/x");
+    batch.Remove("user/y");
+    batch.Add("user/y", "2");
+    batch.Add("user/y", "3", true);
+    kvs["user/y"] = "3";
+
+    EXPECT_EQ(MBError::NOT_EXIST, db->Write(batch));
+    CheckKeys();
+
+    // Existing keys are not overwritten but the rest of the batch is applied.
+    batch.Clear();
+    batch.Add(keys[1], "old");
+    batch.Add("user/z", "4");
+    kvs["user/z"] = "4";
+    EXPECT_EQ(MBError::IN_DICT, db->Write(batch));
+    CheckKeys();
+}
+
+TEST_F(WriteBatchTest, sync_test)
+{
+    OpenDB(CONSTS::SYNC_ON_WRITE);
+    std::vector<std::string> keys;
+    MakeKeys(3000, keys);
+
+    WriteBatch batch;
+    for(size_t i = 0; i < keys.size(); i++) {
+        batch.Add(keys[i], keys[i]);
+        kvs[keys[i]] = keys[i];
+    }
+    EXPECT_EQ(MBError::SUCCESS, db->Write(batch));
+    CheckKeys();
+
+    // Single updates are still synced after the batch.
+    EXPECT_EQ(MBError::SUCCESS, db->Add("single", "1"));
+    kvs["single"] = "1";
+    CheckKeys();
+}
+
+TEST_F(WriteBatchTest, async_test)
+{
+    OpenDB(CONSTS::ASYNC_WRITER_MODE);
+    ASSERT_EQ(MBError::SUCCESS, db_r->SetAsyncWriterPtr(db));
+    std::vector<std::string> keys;
+    MakeKeys(5000, keys);
+
+    WriteBatch batch;
+    for(size_t i = 0; i < keys.size(); i++) {
+        batch.Add(keys[i], keys[i]);
+        kvs[keys[i]] = keys[i];
+        if(batch.Count() == 1000) {
+            EXPECT_EQ(MBError::SUCCESS, db_r->Write(batch));
+            batch.Clear();
+        }
+    }
+    for(size_t i = 0; i < keys.size(); i += 2) {
+        batch.Remove(keys[i]);
+        kvs.erase(keys[i]);
+    }
+    EXPECT_EQ(MBError::SUCCESS, db_r->Write(batch));
+    while(db_r->AsyncWriterBusy())
+        usleep(10);
+    CheckKeys();
+}
+
+TEST_F(WriteBatchTest, async_rc_test)
+{
+    // A batch queued while rc is running is applied in full after rc.
+    OpenDB(CONSTS::ASYNC_WRITER_MODE);
+    ASSERT_EQ(MBError::SUCCESS, db_r->SetAsyncWriterPtr(db));
+    std::vector<std::string> keys;
+    MakeKeys(20000, keys);
+    for(size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(MBError::SUCCESS, db_r->Add(keys[i], keys[i]));
+        kvs[keys[i]] = keys[i];
+    }
+    for(size_t i = 1; i < keys.size(); i += 2) {
+        EXPECT_EQ(MBError::SUCCESS, db_r->Remove(keys[i]));
+        kvs.erase(keys[i]);
+    }
+    EXPECT_EQ(MBError::SUCCESS, db_r->CollectResource(1, 1));
+
+    WriteBatch batch;
+    for(size_t i = 0; i < keys.size(); i += 4) {
+        batch.Remove(keys[i]);
+        kvs.erase(keys[i]);
+        batch.Add(keys[i] + "/rc", "rc");
+        kvs[keys[i] + "/rc"] = "rc";
+    }
+    EXPECT_EQ(MBError::SUCCESS, db_r->Write(batch));
+    while(db_r->AsyncWriterBusy())
+        usleep(100);
+    EXPECT_EQ(MBError::SUCCESS, db_r->UnsetAsyncWriterPtr(db));
+    CheckKeys();
+}
+
+TEST_F(WriteBatchTest, invalid_arg_test)
+{
+    OpenDB();
+    WriteBatch batch;
+    EXPECT_EQ(MBError::INVALID_ARG, batch.Add(NULL, 1, "a", 1));
+    EXPECT_EQ(MBError::INVALID_ARG, batch.Add("a", 0, "a", 1));
+    EXPECT_EQ(MBError::INVALID_ARG, batch.Add("a", 1, NULL, 1));
+    EXPECT_EQ(MBError::INVALID_ARG, batch.Remove(NULL, 1));
+    EXPECT_EQ(MBError::INVALID_ARG, batch.Remove("", 0));
+    EXPECT_EQ(0, batch.Count());
+
+    // Reader handle without async writer cannot apply a batch.
+    batch.Add("a", "b");
+    EXPECT_EQ(MBError::NOT_ALLOWED, db_r->Write(batch));
+}
+
+}
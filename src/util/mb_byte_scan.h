@@ -0,0 +1,76 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MB_BYTE_SCAN_H__
+#define __MB_BYTE_SCAN_H__
+
+#include <stdint.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace mabain {
+
+// Scalar search of byte c in buff[0, len). Returns the index of the first
+// match or -1 if not found.
+static inline int ScalarByteScan(const uint8_t *buff, int len, uint8_t c)
+{
+    for(int i = 0; i < len; i++)
+    {
+        if(buff[i] == c)
+            return i;
+    }
+    return -1;
+}
+
+// Search the first byte array of a node for the edge starting with c.
+// Whole 32 or 16-byte chunks are compared first. The tail is scanned byte
+// by byte so that no load goes past the end of the buffer. The SSE2/AVX2
+// path is selected at compile time (SSE2 is always available on x86_64;
+// build with -mavx2 for the AVX2 path).
+static inline int ByteScan(const uint8_t *buff, int len, uint8_t c)
+{
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i key32 = _mm256_set1_epi8(static_cast<char>(c));
+    for(; i + 32 <= len; i += 32)
+    {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buff + i));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, key32)));
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i key16 = _mm_set1_epi8(static_cast<char>(c));
+    for(; i + 16 <= len; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buff + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, key16));
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+    int index = ScalarByteScan(buff + i, len - i, c);
+    if(index < 0)
+        return -1;
+    return i + index;
+}
+
+}
+
+#endif
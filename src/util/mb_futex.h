@@ -0,0 +1,57 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MB_FUTEX_H__
+#define __MB_FUTEX_H__
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <atomic>
+
+namespace mabain {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex word must be 32 bits");
+
+// Sleep while the futex word is val. Private futexes are faster but only
+// work among the threads of a process. Shared ones work across processes
+// on shared mappings. Returns -1 with errno ETIMEDOUT on timeout.
+static inline int FutexWait(std::atomic<uint32_t> *addr, uint32_t val, bool shared,
+                            const struct timespec *timeout = NULL)
+{
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr),
+                   shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, val, timeout, NULL, 0);
+}
+
+static inline void FutexWake(std::atomic<uint32_t> *addr, int num, bool shared)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr),
+            shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, num, NULL, NULL, 0);
+}
+
+static inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+}
+
+#endif
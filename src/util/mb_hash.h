@@ -0,0 +1,44 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MB_HASH_H__
+#define __MB_HASH_H__
+
+#include <stdint.h>
+
+namespace mabain {
+
+// 64-bit FNV-1a with a final mix so that all bits of the hash are usable.
+// Different seeds give independent hashes of the same key.
+static inline uint64_t MBHash64(const uint8_t *key, int len, uint64_t seed = 0)
+{
+    uint64_t hash = 14695981039346656037ULL ^ seed;
+    for(int i = 0; i < len; i++)
+    {
+        hash ^= key[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+}
+
+#endif
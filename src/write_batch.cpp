@@ -0,0 +1,126 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include "write_batch.h"
+#include "error.h"
+
+namespace mabain {
+
+WriteBatch::WriteBatch() : sorted(true)
+{
+}
+
+void WriteBatch::AddEntry(const char *key, int len, const char *data, int data_len,
+                          uint8_t type, bool overwrite)
+{
+    WriteBatchEntry entry;
+    entry.key_off = arena.size();
+    entry.key_len = len;
+    arena.append(key, len);
+    entry.value_off = arena.size();
+    entry.value_len = data_len;
+    if(data_len > 0)
+        arena.append(data, data_len);
+    entry.type = type;
+    entry.overwrite = overwrite;
+
+    if(sorted && !entries.empty())
+    {
+        const WriteBatchEntry &last = entries.back();
+        int min_len = (last.key_len < len) ? last.key_len : len;
+        int cmp = memcmp(arena.data() + last.key_off, key, min_len);
+        if(cmp > 0 || (cmp == 0 && last.key_len > len))
+            sorted = false;
+    }
+    entries.push_back(entry);
+}
+
+int WriteBatch::Add(const char *key, int len, const char *data, int data_len, bool overwrite)
+{
+    if(key == NULL || len <= 0 || data_len < 0 || (data == NULL && data_len > 0))
+        return MBError::INVALID_ARG;
+    AddEntry(key, len, data, data_len, WRITE_BATCH_ADD, overwrite);
+    return MBError::SUCCESS;
+}
+
+int WriteBatch::Add(const std::string &key, const std::string &value, bool overwrite)
+{
+    return Add(key.data(), key.size(), value.data(), value.size(), overwrite);
+}
+
+int WriteBatch::Remove(const char *key, int len)
+{
+    if(key == NULL || len <= 0)
+        return MBError::INVALID_ARG;
+    AddEntry(key, len, NULL, 0, WRITE_BATCH_REMOVE, false);
+    return MBError::SUCCESS;
+}
+
+int WriteBatch::Remove(const std::string &key)
+{
+    return Remove(key.data(), key.size());
+}
+
+void WriteBatch::Clear()
+{
+    entries.clear();
+    arena.clear();
+    sorted = true;
+}
+
+int WriteBatch::Count() const
+{
+    return static_cast<int>(entries.size());
+}
+
+// Stable sort keeps the updates of the same key in the order they were added.
+void WriteBatch::Sort()
+{
+    if(sorted)
+        return;
+
+    const char *base = arena.data();
+    std::stable_sort(entries.begin(), entries.end(),
+        [base](const WriteBatchEntry &a, const WriteBatchEntry &b)
+        {
+            int min_len = (a.key_len < b.key_len) ? a.key_len : b.key_len;
+            int cmp = memcmp(base + a.key_off, base + b.key_off, min_len);
+            if(cmp != 0)
+                return cmp < 0;
+            return a.key_len < b.key_len;
+        });
+    sorted = true;
+}
+
+const WriteBatchEntry& WriteBatch::GetEntry(int index) const
+{
+    return entries[index];
+}
+
+const uint8_t* WriteBatch::GetKey(const WriteBatchEntry &entry) const
+{
+    return reinterpret_cast<const uint8_t*>(arena.data() + entry.key_off);
+}
+
+const uint8_t* WriteBatch::GetValue(const WriteBatchEntry &entry) const
+{
+    return reinterpret_cast<const uint8_t*>(arena.data() + entry.value_off);
+}
+
+}
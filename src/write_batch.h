@@ -0,0 +1,73 @@
+/**
+ * Copyright (C) 2026 mabain contributors
+ *
+ * This program is free software: you can redistribute it and/or  modify
+ * it under the terms of the GNU General Public License, version 2,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __WRITE_BATCH_H__
+#define __WRITE_BATCH_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define WRITE_BATCH_ADD            1
+#define WRITE_BATCH_REMOVE         2
+
+namespace mabain {
+
+// Entry of WriteBatch. Keys and values are kept in the arena of the batch.
+typedef struct _WriteBatchEntry
+{
+    size_t key_off;
+    size_t value_off;
+    int    key_len;
+    int    value_len;
+    // WRITE_BATCH_ADD or WRITE_BATCH_REMOVE
+    uint8_t type;
+    bool   overwrite;
+} WriteBatchEntry;
+
+// Updates applied together by DB::Write. Entries are sorted by key before
+// they are applied so that neighbouring keys share the path walked by the
+// previous update. Updates of the same key are applied in the order they
+// were added to the batch.
+class WriteBatch
+{
+public:
+    WriteBatch();
+    int  Add(const char *key, int len, const char *data, int data_len, bool overwrite = false);
+    int  Add(const std::string &key, const std::string &value, bool overwrite = false);
+    int  Remove(const char *key, int len);
+    int  Remove(const std::string &key);
+    void Clear();
+    int  Count() const;
+    // Sort the entries by key. Called by DB::Write.
+    void Sort();
+
+    const WriteBatchEntry& GetEntry(int index) const;
+    const uint8_t* GetKey(const WriteBatchEntry &entry) const;
+    const uint8_t* GetValue(const WriteBatchEntry &entry) const;
+
+private:
+    void AddEntry(const char *key, int len, const char *data, int data_len,
+                  uint8_t type, bool overwrite);
+
+    std::vector<WriteBatchEntry> entries;
+    std::string arena;
+    bool sorted;
+};
+
+}
+
+#endif